@@ -0,0 +1,422 @@
+/**
+ * \file afpacketreader.cpp
+ * \brief Packet receiver using AF_PACKET TPACKET_V3 memory mapped ring.
+ * \author Jiri Havranek <havraji6@fit.cvut.cz>
+ * \date 2018
+ */
+/*
+ * Copyright (C) 2018 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <poll.h>
+#include <net/if.h>
+#include <net/if_arp.h>
+#include <arpa/inet.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <linux/if_ether.h>
+#include <linux/filter.h>
+#include <linux/net_tstamp.h>
+#include <linux/sockios.h>
+#include <pcap/pcap.h>
+
+#include "afpacketreader.h"
+
+using namespace std;
+
+/**
+ * \brief Constructor.
+ * \param [in] options Module options.
+ */
+AfPacketReader::AfPacketReader(const options_t &options) : fd(-1), ring(NULL), snaplen(MAXPCKTSIZE), loopback(false),
+   current_block(0), pkts_left(0), frame(NULL), hw_timestamps(false), hw_ts_cnt(0)
+{
+   block_size = options.afpacket_block_size;
+   block_cnt = options.afpacket_block_cnt;
+   fanout = options.afpacket_fanout;
+   print_pcap_stats = options.print_pcap_stats;
+   last_ts.tv_sec = 0;
+   last_ts.tv_usec = 0;
+   parser.block = NULL;
+   parser.parse_all = false;
+   parser.payload_limit = MAXPCKTSIZE;
+   parser.frags = (options.frag_entries != 0 ? new FragmentTable(options.frag_entries, options.frag_timeout, options.frag_reassembly) : NULL);
+   parser.frags_expired = 0;
+   parser.tunnels = options.tunnels;
+   parser.tunnel_depth = options.tunnel_depth;
+}
+
+/**
+ * \brief Destructor.
+ */
+AfPacketReader::~AfPacketReader()
+{
+   this->close();
+   delete parser.frags;
+}
+
+/**
+ * \brief Create socket with TPACKET_V3 ring and bind it to network interface.
+ * \param [in] interface Interface name.
+ * \param [in] snaplen Max length of packet passed to parser.
+ * \param [in] parse_every_pkt Try to parse every captured packet.
+ * \param [in] payload_limit Max number of payload bytes needed by plugins.
+ * \return 0 on success, non 0 on failure + error_msg is filled with error message
+ */
+int AfPacketReader::init_interface(const string &interface, int snaplen, bool parse_every_pkt, uint32_t payload_limit)
+{
+   if (fd >= 0) {
+      error_msg = "Interface is already opened.";
+      return 1;
+   }
+
+   fd = socket(AF_PACKET, SOCK_RAW, htons(ETH_P_ALL));
+   if (fd < 0) {
+      error_msg = string("Unable to create AF_PACKET socket: ") + strerror(errno);
+      return 2;
+   }
+
+   int version = TPACKET_V3;
+   if (setsockopt(fd, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) != 0) {
+      error_msg = string("TPACKET_V3 is not supported: ") + strerror(errno);
+      close();
+      return 2;
+   }
+
+   struct ifreq ifr;
+   memset(&ifr, 0, sizeof(ifr));
+   strncpy(ifr.ifr_name, interface.c_str(), IFNAMSIZ - 1);
+   if (ioctl(fd, SIOCGIFINDEX, &ifr) != 0) {
+      error_msg = "Unknown interface " + interface + ": " + strerror(errno);
+      close();
+      return 2;
+   }
+   int ifindex = ifr.ifr_ifindex;
+
+   if (ioctl(fd, SIOCGIFHWADDR, &ifr) != 0 ||
+      (ifr.ifr_hwaddr.sa_family != ARPHRD_ETHER && ifr.ifr_hwaddr.sa_family != ARPHRD_LOOPBACK)) {
+      error_msg = "Unsupported data link type.";
+      close();
+      return 3;
+   }
+   loopback = (ifr.ifr_hwaddr.sa_family == ARPHRD_LOOPBACK);
+
+   enable_hw_timestamps(interface);
+
+   struct tpacket_req3 req;
+   memset(&req, 0, sizeof(req));
+   req.tp_block_size = block_size;
+   req.tp_block_nr = block_cnt;
+   req.tp_frame_size = AFPACKET_FRAME_SIZE;
+   req.tp_frame_nr = (block_size / AFPACKET_FRAME_SIZE) * block_cnt;
+   req.tp_retire_blk_tov = AFPACKET_BLOCK_TIMEOUT;
+   if (setsockopt(fd, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req)) != 0) {
+      error_msg = string("Unable to create ring: ") + strerror(errno);
+      close();
+      return 2;
+   }
+
+   void *mem = mmap(NULL, (size_t) block_size * block_cnt, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, 0);
+   if (mem == MAP_FAILED) {
+      error_msg = string("Unable to map ring: ") + strerror(errno);
+      close();
+      return 2;
+   }
+   ring = (uint8_t *) mem;
+
+   struct sockaddr_ll addr;
+   memset(&addr, 0, sizeof(addr));
+   addr.sll_family = AF_PACKET;
+   addr.sll_protocol = htons(ETH_P_ALL);
+   addr.sll_ifindex = ifindex;
+   if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0) {
+      error_msg = "Unable to bind to interface " + interface + ": " + strerror(errno);
+      close();
+      return 2;
+   }
+
+   struct packet_mreq mreq;
+   memset(&mreq, 0, sizeof(mreq));
+   mreq.mr_ifindex = ifindex;
+   mreq.mr_type = PACKET_MR_PROMISC;
+   if (setsockopt(fd, SOL_PACKET, PACKET_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) != 0) {
+      fprintf(stderr, "AfPacketReader: warning: unable to set promiscuous mode: %s\n", strerror(errno));
+   }
+
+   if (fanout != AFPACKET_NO_FANOUT) {
+      /* Symmetric flow hash keeps both directions of flow in the same socket. */
+      int arg = fanout | ((PACKET_FANOUT_HASH | PACKET_FANOUT_FLAG_DEFRAG) << 16);
+      if (setsockopt(fd, SOL_PACKET, PACKET_FANOUT, &arg, sizeof(arg)) != 0) {
+         error_msg = string("Unable to join fanout group: ") + strerror(errno);
+         close();
+         return 2;
+      }
+   }
+
+   if (print_pcap_stats) {
+      /* Print stats header. */
+      printf("# recv   - number of packets received since previous line\n");
+      printf("# drop   - number of packets dropped because ring was full\n");
+      printf("# freeze - number of times ring was full\n");
+      printf("# hwts   - total number of packets with hardware timestamp (timestamping %s on interface)\n\n",
+         (hw_timestamps ? "enabled" : "not enabled"));
+      printf("recv\tdrop\tfreeze\thwts\n");
+   }
+
+   this->snaplen = snaplen;
+   current_block = 0;
+   pkts_left = 0;
+   parser.parse_all = parse_every_pkt;
+   parser.payload_limit = payload_limit;
+   error_msg = "";
+   return 0;
+}
+
+/**
+ * \brief Request hardware timestamps of received packets.
+ *
+ * Kernel uses software timestamps for packets without hardware timestamp,
+ * so failures are not reported.
+ * \param [in] interface Interface name.
+ */
+void AfPacketReader::enable_hw_timestamps(const string &interface)
+{
+   struct hwtstamp_config config;
+   struct ifreq ifr;
+
+   memset(&config, 0, sizeof(config));
+   config.tx_type = HWTSTAMP_TX_OFF;
+   config.rx_filter = HWTSTAMP_FILTER_ALL;
+
+   memset(&ifr, 0, sizeof(ifr));
+   strncpy(ifr.ifr_name, interface.c_str(), IFNAMSIZ - 1);
+   ifr.ifr_data = (char *) &config;
+
+   hw_timestamps = (ioctl(fd, SIOCSHWTSTAMP, &ifr) == 0);
+
+   int req = SOF_TIMESTAMPING_RAW_HARDWARE;
+   setsockopt(fd, SOL_PACKET, PACKET_TIMESTAMP, &req, sizeof(req));
+}
+
+/**
+ * \brief Install BPF filter to socket.
+ * \param [in] filter_str String containing program.
+ * \return 0 on success, non 0 on failure.
+ */
+int AfPacketReader::set_filter(const string &filter_str)
+{
+   if (fd < 0) {
+      error_msg = "No live capture opened.";
+      return 1;
+   }
+
+   pcap_t *dead = pcap_open_dead(DLT_EN10MB, snaplen);
+   if (dead == NULL) {
+      error_msg = "Couldn't parse filter " + string(filter_str);
+      return 1;
+   }
+
+   struct bpf_program filter;
+   if (pcap_compile(dead, &filter, filter_str.c_str(), 0, PCAP_NETMASK_UNKNOWN) == -1) {
+      error_msg = "Couldn't parse filter " + string(filter_str) + ": " + string(pcap_geterr(dead));
+      pcap_close(dead);
+      return 1;
+   }
+   pcap_close(dead);
+
+   struct sock_fprog prog;
+   prog.len = filter.bf_len;
+   prog.filter = (struct sock_filter *) filter.bf_insns;
+   if (setsockopt(fd, SOL_SOCKET, SO_ATTACH_FILTER, &prog, sizeof(prog)) != 0) {
+      pcap_freecode(&filter);
+      error_msg = "Couldn't install filter " + string(filter_str) + ": " + strerror(errno);
+      return 1;
+   }
+
+   pcap_freecode(&filter);
+   return 0;
+}
+
+/**
+ * \brief Unmap ring and close socket.
+ */
+void AfPacketReader::close()
+{
+   if (ring != NULL) {
+      munmap(ring, (size_t) block_size * block_cnt);
+      ring = NULL;
+   }
+   if (fd >= 0) {
+      ::close(fd);
+      fd = -1;
+   }
+}
+
+void AfPacketReader::print_stats()
+{
+   struct timeval tmp;
+
+   gettimeofday(&tmp, NULL);
+   if (tmp.tv_sec - last_ts.tv_sec >= STATS_PRINT_INTERVAL) {
+      struct tpacket_stats_v3 stats;
+      socklen_t len = sizeof(stats);
+      if (getsockopt(fd, SOL_PACKET, PACKET_STATISTICS, &stats, &len) != 0) {
+         printf("AfPacketReader: error: %s\n", strerror(errno));
+         print_pcap_stats = false; /* Turn off printing stats. */
+         return;
+      }
+      printf("%u\t%u\t%u\t%lu\n", stats.tp_packets, stats.tp_drops, stats.tp_freeze_q_cnt, (unsigned long) hw_ts_cnt);
+
+      last_ts = tmp;
+   }
+}
+
+/**
+ * \brief Print statistics of packet parser.
+ */
+void AfPacketReader::print_report()
+{
+   if (parser.frags != NULL) {
+      parser.frags->print_report();
+   }
+}
+
+/**
+ * \brief Return current block to kernel and move to the next one.
+ */
+void AfPacketReader::release_block()
+{
+   struct tpacket_block_desc *desc = (struct tpacket_block_desc *) (ring + (size_t) current_block * block_size);
+
+   __atomic_store_n(&desc->hdr.bh1.block_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+   current_block = (current_block + 1) % block_cnt;
+   pkts_left = 0;
+}
+
+int AfPacketReader::get_pkts(PacketBlock &block)
+{
+   if (fd < 0) {
+      error_msg = "No live capture opened.";
+      return -3;
+   }
+
+   block.cnt = 0;
+   block.total = 0;
+   parser.block = &block;
+
+   if (print_pcap_stats) {
+      print_stats();
+   }
+
+   expire_fragments(&parser);
+   size_t released = block.cnt;
+   while (released + block.total < block.size) {
+      if (pkts_left == 0) {
+         struct tpacket_block_desc *desc = (struct tpacket_block_desc *) (ring + (size_t) current_block * block_size);
+
+         if (!(__atomic_load_n(&desc->hdr.bh1.block_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER)) {
+            if (block.cnt > 0 || block.total > 0) {
+               break;
+            }
+
+            /* Wait for kernel to pass filled block. */
+            struct pollfd pfd;
+            pfd.fd = fd;
+            pfd.events = POLLIN | POLLERR;
+            pfd.revents = 0;
+
+            int ret = poll(&pfd, 1, READ_TIMEOUT);
+            if (ret == 0 || (ret < 0 && errno == EINTR)) {
+               expire_fragments(&parser);
+               return (block.cnt > 0 ? 2 : 3);
+            } else if (ret < 0) {
+               error_msg = string("Poll failed: ") + strerror(errno);
+               return -1;
+            }
+            continue;
+         }
+
+         pkts_left = desc->hdr.bh1.num_pkts;
+         frame = (struct tpacket3_hdr *) ((uint8_t *) desc + desc->hdr.bh1.offset_to_first_pkt);
+         if (pkts_left == 0) {
+            release_block();
+            continue;
+         }
+      }
+
+      struct tpacket3_hdr *pkt = frame;
+      bool skip = false;
+
+      if (loopback) {
+         /* Packets sent over loopback are seen twice, skip outgoing copy like libpcap does. */
+         struct sockaddr_ll *sll = (struct sockaddr_ll *) ((uint8_t *) pkt + TPACKET_ALIGN(sizeof(struct tpacket3_hdr)));
+         skip = (sll->sll_pkttype == PACKET_OUTGOING);
+      }
+
+      if (!skip) {
+         struct pcap_pkthdr hdr;
+         hdr.ts.tv_sec = pkt->tp_sec;
+         hdr.ts.tv_usec = pkt->tp_nsec / 1000;
+         hdr.caplen = (pkt->tp_snaplen < snaplen ? pkt->tp_snaplen : snaplen);
+         hdr.len = pkt->tp_len;
+         if (pkt->tp_status & TP_STATUS_TS_RAW_HARDWARE) {
+            hw_ts_cnt++;
+         }
+
+         packet_handler((u_char *) &parser, &hdr, (const u_char *) pkt + pkt->tp_mac);
+      }
+
+      /* Packet data were copied by parser, block can be returned to kernel after its last packet. */
+      frame = (struct tpacket3_hdr *) ((uint8_t *) pkt + pkt->tp_next_offset);
+      if (--pkts_left == 0) {
+         release_block();
+      }
+   }
+
+   // Return 2 if at least one packet is valid and ready to process by flow_cache.
+   return (block.cnt > 0 ? 2 : 1);
+}
+
+int AfPacketReader::get_held_pkts(PacketBlock &block)
+{
+   parser.block = &block;
+   return release_held_fragments(&parser);
+}
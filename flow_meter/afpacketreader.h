@@ -0,0 +1,106 @@
+/**
+ * \file afpacketreader.h
+ * \brief Packet receiver using AF_PACKET TPACKET_V3 memory mapped ring.
+ * \author Jiri Havranek <havraji6@fit.cvut.cz>
+ * \date 2018
+ */
+/*
+ * Copyright (C) 2018 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#ifndef AFPACKETREADER_H
+#define AFPACKETREADER_H
+
+#include <string>
+#include <stdint.h>
+#include <sys/time.h>
+#include <linux/if_packet.h>
+
+#include "flow_meter.h"
+#include "packet.h"
+#include "packetreceiver.h"
+#include "pcapreader.h"
+
+using namespace std;
+
+#define AFPACKET_BLOCK_SIZE    (1 << 20) /**< Default size of ring block in bytes. */
+#define AFPACKET_BLOCK_CNT     64        /**< Default number of ring blocks. */
+#define AFPACKET_FRAME_SIZE    2048      /**< Nominal frame size, TPACKET_V3 stores variable sized frames. */
+#define AFPACKET_BLOCK_TIMEOUT 100       /**< Time in miliseconds after which kernel passes partially filled block. */
+#define AFPACKET_NO_FANOUT     -1        /**< Fanout group value for not joining any group. */
+
+/**
+ * \brief Class for capturing packets from network interface using TPACKET_V3 ring.
+ *
+ * Kernel fills whole blocks of packets which are parsed in place and returned to kernel
+ * once all their packets were parsed. Sockets of several processes or threads can join
+ * the same fanout group, packets of one flow are always delivered to the same socket.
+ */
+class AfPacketReader : public PacketReceiver
+{
+public:
+   AfPacketReader(const options_t &options);
+   ~AfPacketReader();
+
+   int init_interface(const string &interface, int snaplen, bool parse_every_pkt, uint32_t payload_limit);
+   int set_filter(const string &filter_str);
+   void print_stats();
+   void close();
+   int get_pkts(PacketBlock &block);
+   int get_held_pkts(PacketBlock &block);
+   void print_report();
+private:
+   int fd;                          /**< AF_PACKET socket. */
+   uint8_t *ring;                   /**< Memory mapped ring. */
+   uint32_t block_size;             /**< Size of ring block. */
+   uint32_t block_cnt;              /**< Number of ring blocks. */
+   int fanout;                      /**< Fanout group ID or AFPACKET_NO_FANOUT. */
+   uint32_t snaplen;                /**< Max captured length of packet passed to parser. */
+   bool loopback;                   /**< Interface is loopback. */
+   uint32_t current_block;          /**< Index of block which is processed or waited for. */
+   uint32_t pkts_left;              /**< Number of packets left in current block, 0 if block is not opened. */
+   struct tpacket3_hdr *frame;      /**< Next packet of current block. */
+   bool print_pcap_stats;           /**< Print socket stats. */
+   bool hw_timestamps;              /**< Hardware timestamping was enabled on interface. */
+   uint64_t hw_ts_cnt;              /**< Number of packets with hardware timestamp. */
+   struct timeval last_ts;          /**< Time of last stats print. */
+   parser_opt_t parser;             /**< Packet parser state. */
+
+   void enable_hw_timestamps(const string &interface);
+   void release_block();
+};
+
+#endif
@@ -211,6 +211,14 @@ void ARPPlugin::finish()
    }
 }
 
+/**
+ * \brief Plugin processes ARP packets only.
+ */
+plugin_interest ARPPlugin::get_interest()
+{
+   return plugin_interest().ethertype(ETH_P_ARP);
+}
+
 string ARPPlugin::get_unirec_field_string()
 {
    return ARP_UNIREC_TEMPLATE;
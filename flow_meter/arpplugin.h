@@ -68,6 +68,8 @@ struct RecordExtARP : RecordExt {
    uint8_t dst_ha[254]; /**< Destination hardware address. */
    uint8_t dst_pa[254]; /**< Destination protocol address. */
 
+   RECORD_EXT_POOLED(arp)
+
    /**
     * \brief Constructor.
     */
@@ -128,6 +130,7 @@ public:
    ARPPlugin(const options_t &module_options, vector<plugin_opt> plugin_options);
    int pre_create(Packet &pkt);
    void finish();
+   plugin_interest get_interest();
    string get_unirec_field_string();
    const char **get_ipfix_string();
    bool include_basic_flow_fields();
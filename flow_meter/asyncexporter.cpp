@@ -0,0 +1,154 @@
+/**
+ * \file asyncexporter.cpp
+ * \brief Exporter passing flows to exporter thread.
+ * \author Jiri Havranek <havraji6@fit.cvut.cz>
+ * \date 2018
+ */
+/*
+ * Copyright (C) 2018 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#include <iostream>
+#include <sched.h>
+#include <unistd.h>
+
+#include "asyncexporter.h"
+
+using namespace std;
+
+/**
+ * \brief Constructor.
+ * \param [in] exporter Exporter which receives flows in exporter thread.
+ * \param [in] size Minimal number of queue slots, rounded up to power of two.
+ */
+AsyncExporter::AsyncExporter(FlowExporter *exporter, uint32_t size) : queue(size), exporter(exporter), running(false),
+   stop(0), exported(0), peak(0)
+{
+}
+
+AsyncExporter::~AsyncExporter()
+{
+   finish(false);
+}
+
+/**
+ * \brief Start exporter thread.
+ * \return 0 on success, -1 when thread cannot be created.
+ */
+int AsyncExporter::start()
+{
+   if (pthread_create(&thread, NULL, &AsyncExporter::worker, this) != 0) {
+      return -1;
+   }
+   running = true;
+   return 0;
+}
+
+/**
+ * \brief Wait until exporter thread exports all queued items and stop it.
+ * \param [in] print_stats Print queue statistics.
+ */
+void AsyncExporter::finish(bool print_stats)
+{
+   if (!running) {
+      return;
+   }
+
+   __atomic_store_n(&stop, 1, __ATOMIC_RELEASE);
+   pthread_join(thread, NULL);
+   running = false;
+
+   if (print_stats) {
+      cout << "Export queue: items " << exported <<
+         ", peak occupancy " << peak << "/" << queue.capacity() <<
+         ", queue full " << queue.get_full_cnt() << endl;
+   }
+}
+
+int AsyncExporter::export_flow(Flow &flow)
+{
+   return queue.export_flow(flow);
+}
+
+int AsyncExporter::export_packet(Packet &pkt)
+{
+   return queue.export_packet(pkt);
+}
+
+void AsyncExporter::flush()
+{
+   queue.flush();
+}
+
+/**
+ * \brief Exporter thread draining queue into exporter.
+ * \param [in] arg Pointer to AsyncExporter.
+ */
+void *AsyncExporter::worker(void *arg)
+{
+   AsyncExporter *exp = (AsyncExporter *) arg;
+   uint32_t idle = 0;
+   uint32_t cnt;
+
+   while (1) {
+      cnt = exp->queue.count();
+      if (cnt > exp->peak) {
+         exp->peak = cnt;
+      }
+
+      cnt = exp->queue.drain(exp->exporter, ASYNC_EXPORT_BATCH);
+      if (cnt == 0) {
+         if (__atomic_load_n(&exp->stop, __ATOMIC_ACQUIRE)) {
+            /* Stop flag could be set after last check of queue. */
+            if (exp->queue.count() == 0) {
+               break;
+            }
+            continue;
+         }
+         if (++idle > ASYNC_EXPORT_IDLE_SPINS) {
+            usleep(ASYNC_EXPORT_IDLE_SLEEP);
+         } else {
+            sched_yield();
+         }
+         continue;
+      }
+
+      idle = 0;
+      exp->exported += cnt;
+   }
+
+   return NULL;
+}
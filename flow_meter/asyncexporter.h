@@ -0,0 +1,99 @@
+/**
+ * \file asyncexporter.h
+ * \brief Exporter passing flows to exporter thread.
+ * \author Jiri Havranek <havraji6@fit.cvut.cz>
+ * \date 2018
+ */
+/*
+ * Copyright (C) 2018 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#ifndef ASYNCEXPORTER_H
+#define ASYNCEXPORTER_H
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include "flowifc.h"
+#include "packet.h"
+#include "flowexporter.h"
+#include "flowqueue.h"
+
+#define ASYNC_EXPORT_BATCH 256       /**< Maximal number of items exported by thread in one pass. */
+#define ASYNC_EXPORT_IDLE_SPINS 1000 /**< Number of empty polls before exporter thread goes to sleep. */
+#define ASYNC_EXPORT_IDLE_SLEEP 100  /**< Exporter thread sleep time in microseconds. */
+
+/**
+ * \brief Exporter moving flows into lock-free queue, which is drained into real exporter by dedicated thread.
+ *
+ * Slow collector or full output interface blocks only exporter thread until queue is full. Number of times
+ * flow cache had to wait for free slot and peak queue occupancy tell whether export is the bottleneck.
+ */
+class AsyncExporter : public FlowExporter
+{
+   FlowQueue queue;
+   FlowExporter *exporter; /**< Exporter called by exporter thread. */
+   pthread_t thread;
+   bool running;
+   int stop;               /**< Set by producer when no more flows come. */
+
+   uint64_t exported;      /**< Number of items passed to exporter. */
+   uint32_t peak;          /**< Maximal number of items seen in queue by exporter thread. */
+
+   static void *worker(void *arg);
+
+public:
+   AsyncExporter(FlowExporter *exporter, uint32_t size);
+   ~AsyncExporter();
+
+   int start();
+   void finish(bool print_stats);
+
+   int export_flow(Flow &flow);
+   int export_packet(Packet &pkt);
+   void flush();
+
+   /**
+    * \brief Get current queue occupancy.
+    * \return Occupancy in percent.
+    */
+   uint32_t get_occupancy() const
+   {
+      return (uint64_t) queue.count() * 100 / queue.capacity();
+   }
+};
+
+#endif
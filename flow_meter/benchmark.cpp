@@ -0,0 +1,887 @@
+/**
+ * \file benchmark.cpp
+ * \brief Microbenchmark of flow_meter packet parser, flow cache, plugins and exporters.
+ * \author Jiri Havranek <havraji6@fit.cvut.cz>
+ * \date 2018
+ */
+/*
+ * Copyright (C) 2018 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#include <config.h>
+#include <getopt.h>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <pcap/pcap.h>
+#include <libtrap/trap.h>
+
+#include "flow_meter.h"
+#include "packet.h"
+#include "flowifc.h"
+#include "flowexporter.h"
+#include "pcapreader.h"
+#include "nhtflowcache.h"
+#include "unirecexporter.h"
+#include "ipfixexporter.h"
+#include "sampler.h"
+#include "conversion.h"
+#include "strscan.h"
+
+#include "httpplugin.h"
+#include "httpsplugin.h"
+#include "dnsplugin.h"
+#include "sipplugin.h"
+#include "ntpplugin.h"
+#include "arpplugin.h"
+#include "passivednsplugin.h"
+#include "smtpplugin.h"
+
+using namespace std;
+
+trap_module_info_t *module_info = NULL;
+
+#define MODULE_BASIC_INFO(BASIC) \
+  BASIC("flow_meter_bench", "Measure per-packet cost of flow_meter hot paths: packet parser, flow cache lookups, plugins and exporters. "\
+  "Traffic is replayed from memory, pcap files are given as positional arguments. Results are printed to stdout in CSV format.", 0, 2)
+
+#define MODULE_PARAMS(PARAM) \
+  PARAM('n', "packets", "Minimal number of packets processed by each benchmark. Default 1000000.", required_argument, "uint32") \
+  PARAM('c', "count", "Max number of packets loaded from each pcap file. Default 16384.", required_argument, "uint32") \
+  PARAM('s', "cache_size", "Size of flow cache used for synthetic traffic. Parameter is used as an exponent to the power of two. Default 16.", required_argument, "uint32") \
+  PARAM('p', "plugins", "Plugins to measure. Format: plugin_name[,...] Default http,https,dns,sip,ntp,smtp,arp,passivedns", required_argument, "string")
+
+#define BENCH_DEFAULT_PACKETS 1000000
+#define BENCH_DEFAULT_COUNT 16384
+#define BENCH_DEFAULT_CACHE_EXP 16
+#define BENCH_ALL_PLUGINS "http,https,dns,sip,ntp,smtp,arp,passivedns"
+
+#define BENCH_SYNTH_PACKETS (1 << 18) /**< Number of packets in synthetic traffic. */
+#define BENCH_SYNTH_FLOWS 4096        /**< Number of flows in synthetic traffic used by parser and exporter benchmarks. */
+#define BENCH_REPLAY_MIN_CACHE 256    /**< Minimal flow cache size used for replaying pcap files. */
+
+/**
+ * \brief Number of flows in synthetic traffic relative to flow cache size in percents.
+ */
+static const uint32_t fill_ratios[] = {25, 50, 75, 90, 100, 150};
+
+/*
+ * Allocations are counted by wrapping glibc allocator. Other platforms and sanitizer
+ * builds do not support it, allocs_per_pkt column is -1 there.
+ */
+static uint64_t alloc_cnt = 0;
+
+#if defined(__GLIBC__) && !defined(__SANITIZE_ADDRESS__)
+#define BENCH_COUNT_ALLOCS
+
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t nmemb, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+
+void *malloc(size_t size) __THROW
+{
+   alloc_cnt++;
+   return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size) __THROW
+{
+   alloc_cnt++;
+   return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size) __THROW
+{
+   alloc_cnt++;
+   return __libc_realloc(ptr, size);
+}
+}
+#endif
+
+/**
+ * \brief Get monotonic time in nanoseconds.
+ */
+static inline uint64_t now_ns()
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * \brief Print one result line.
+ * \param [in] bench Benchmark name.
+ * \param [in] input Name of replayed traffic.
+ * \param [in] packets Number of processed packets (records for exporter benchmarks).
+ * \param [in] ns Total time in nanoseconds.
+ * \param [in] allocs Number of allocations.
+ */
+static void report(const string &bench, const string &input, uint64_t packets, int64_t ns, int64_t allocs)
+{
+   double ns_per_pkt = (packets ? (double) ns / packets : 0.0);
+
+   printf("%s,%s,%llu,%.2f,%.0f,", bench.c_str(), input.c_str(), (unsigned long long) packets, ns_per_pkt,
+      (ns_per_pkt > 0.0 ? 1000000000.0 / ns_per_pkt : 0.0));
+#ifdef BENCH_COUNT_ALLOCS
+   printf("%.4f\n", (packets ? (double) allocs / packets : 0.0));
+#else
+   printf("-1\n");
+#endif
+   fflush(stdout);
+}
+
+/**
+ * \brief Number of replays of traffic needed to process at least min_pkts packets.
+ */
+static uint64_t rounds_for(size_t trace_size, uint64_t min_pkts)
+{
+   if (trace_size == 0) {
+      return 0;
+   }
+   return (min_pkts + trace_size - 1) / trace_size;
+}
+
+/**
+ * \brief Captured packets stored in memory.
+ */
+struct RawTrace {
+   string name;
+   vector<struct pcap_pkthdr> hdrs;
+   vector<size_t> offsets;
+   vector<u_char> data;
+
+   void add(const struct pcap_pkthdr *h, const u_char *bytes)
+   {
+      hdrs.push_back(*h);
+      offsets.push_back(data.size());
+      data.insert(data.end(), bytes, bytes + h->caplen);
+   }
+
+   size_t size() const
+   {
+      return hdrs.size();
+   }
+};
+
+/**
+ * \brief Parsed packets stored in memory, ready to be put into flow cache.
+ */
+struct ParsedTrace {
+   vector<Packet> pkts;
+   vector<char> data;
+};
+
+/**
+ * \brief Endpoints of synthetic flow.
+ */
+struct SynthFlow {
+   uint32_t src_ip;
+   uint32_t dst_ip;
+   uint16_t src_port;
+   uint16_t dst_port;
+   uint8_t proto;
+};
+
+/**
+ * \brief Flow exporter which only counts records, isolates flow cache from exporter cost.
+ */
+class NullExporter : public FlowExporter
+{
+public:
+   uint64_t flows;
+   uint64_t packets;
+
+   NullExporter() : flows(0), packets(0)
+   {
+   }
+   int export_flow(Flow &flow)
+   {
+      flows++;
+      return 0;
+   }
+   int export_packet(Packet &pkt)
+   {
+      packets++;
+      return 0;
+   }
+};
+
+/**
+ * \brief Exit and print an error message.
+ * \param [in] e String containing an error message
+ * \return EXIT_FAILURE
+ */
+static int error(const string &e)
+{
+   cerr << "flow_meter_bench: " << e << endl;
+   return EXIT_FAILURE;
+}
+
+/**
+ * \brief Deterministic pseudo random generator, synthetic traffic is the same in every run.
+ */
+static uint32_t bench_rand()
+{
+   static uint32_t state = 2463534242U;
+
+   state ^= state << 13;
+   state ^= state >> 17;
+   state ^= state << 5;
+   return state;
+}
+
+/**
+ * \brief Generate endpoints of synthetic TCP and UDP flows.
+ * \param [out] flows Generated flows.
+ * \param [in] cnt Number of flows.
+ */
+static void gen_flows(vector<SynthFlow> &flows, size_t cnt)
+{
+   flows.resize(cnt);
+   for (size_t i = 0; i < cnt; i++) {
+      flows[i].src_ip = bench_rand();
+      flows[i].dst_ip = bench_rand();
+      flows[i].src_port = 1024 + bench_rand() % 64512;
+      flows[i].dst_port = (i % 4 == 0 ? 53 : 443);
+      flows[i].proto = (i % 4 == 0 ? IPPROTO_UDP : IPPROTO_TCP);
+   }
+}
+
+/**
+ * \brief Append Ethernet/IPv4/TCP or UDP frame of synthetic flow to trace.
+ * \param [in,out] trace Trace to append to.
+ * \param [in] flow Flow of the packet.
+ * \param [in] seq Sequence number of packet in trace, used for timestamp and payload size.
+ */
+static void gen_packet(RawTrace &trace, const SynthFlow &flow, uint32_t seq)
+{
+   u_char frame[14 + 20 + 20 + 32];
+   uint16_t l4_len = (flow.proto == IPPROTO_TCP ? 20 : 8);
+   uint16_t payload_len = seq % 32;
+   uint16_t ip_len = 20 + l4_len + payload_len;
+   struct pcap_pkthdr hdr;
+
+   memset(frame, 0, sizeof(frame));
+   memcpy(frame, "\x00\x11\x22\x33\x44\x55\x66\x77\x88\x99\xaa\xbb\x08\x00", 14);
+
+   u_char *ip = frame + 14;
+   ip[0] = 0x45;
+   *(uint16_t *) (ip + 2) = htons(ip_len);
+   *(uint16_t *) (ip + 4) = htons(seq & 0xFFFF);
+   ip[8] = 64;
+   ip[9] = flow.proto;
+   *(uint32_t *) (ip + 12) = htonl(flow.src_ip);
+   *(uint32_t *) (ip + 16) = htonl(flow.dst_ip);
+
+   u_char *l4 = ip + 20;
+   *(uint16_t *) (l4) = htons(flow.src_port);
+   *(uint16_t *) (l4 + 2) = htons(flow.dst_port);
+   if (flow.proto == IPPROTO_TCP) {
+      *(uint32_t *) (l4 + 4) = htonl(seq);
+      l4[12] = 5 << 4;
+      l4[13] = 0x10; /* ACK */
+      *(uint16_t *) (l4 + 14) = htons(65535);
+   } else {
+      *(uint16_t *) (l4 + 4) = htons(l4_len + payload_len);
+   }
+
+   hdr.ts.tv_sec = 1500000000 + seq / 1000000;
+   hdr.ts.tv_usec = seq % 1000000;
+   hdr.caplen = 14 + ip_len;
+   hdr.len = hdr.caplen;
+   trace.add(&hdr, frame);
+}
+
+/**
+ * \brief Load packets from pcap file into memory.
+ * \param [in] file Pcap file name.
+ * \param [in] max_cnt Max number of loaded packets.
+ * \param [out] trace Loaded packets.
+ * \return True on success.
+ */
+static bool load_pcap(const string &file, uint32_t max_cnt, RawTrace &trace)
+{
+   char errbuf[PCAP_ERRBUF_SIZE];
+   struct pcap_pkthdr *hdr;
+   const u_char *data;
+   int ret;
+
+   pcap_t *handle = pcap_open_offline(file.c_str(), errbuf);
+   if (handle == NULL) {
+      cerr << "flow_meter_bench: " << errbuf << endl;
+      return false;
+   }
+
+   size_t slash = file.rfind('/');
+   trace.name = (slash == string::npos ? file : file.substr(slash + 1));
+   while (trace.size() < max_cnt && (ret = pcap_next_ex(handle, &hdr, &data)) > 0) {
+      trace.add(hdr, data);
+   }
+
+   pcap_close(handle);
+   return true;
+}
+
+/**
+ * \brief Parse packets of raw trace by flow_meter packet parser.
+ * \param [in] raw Captured packets.
+ * \param [in] parse_all Keep packets of unknown ethertype.
+ * \param [out] parsed Parsed packets.
+ */
+static void parse_trace(const RawTrace &raw, bool parse_all, ParsedTrace &parsed)
+{
+   PacketBlock block(1);
+   parser_opt_t opt;
+   vector<size_t> offsets, payload_offsets;
+
+   opt.block = &block;
+   opt.parse_all = parse_all;
+   opt.payload_limit = MAXPCKTSIZE;
+   opt.frags = NULL;
+   opt.tunnels = 0;
+   opt.tunnel_depth = 0;
+
+   parsed.pkts.reserve(raw.size());
+   for (size_t i = 0; i < raw.size(); i++) {
+      block.cnt = 0;
+      packet_handler((u_char *) &opt, &raw.hdrs[i], &raw.data[raw.offsets[i]]);
+      if (block.cnt == 0) {
+         continue;
+      }
+
+      Packet &pkt = block.pkts[0];
+      offsets.push_back(parsed.data.size());
+      payload_offsets.push_back(pkt.payload - pkt.packet);
+      parsed.data.insert(parsed.data.end(), pkt.packet, pkt.packet + pkt.total_length + 1);
+      parsed.pkts.push_back(pkt);
+   }
+
+   /* Packets point to their own copy of data, storage does not change from now on. */
+   for (size_t i = 0; i < parsed.pkts.size(); i++) {
+      parsed.pkts[i].packet = &parsed.data[offsets[i]];
+      parsed.pkts[i].payload = parsed.pkts[i].packet + payload_offsets[i];
+   }
+}
+
+/**
+ * \brief Create plugin instance by name.
+ * \param [in] name Plugin name.
+ * \param [in] options Module options.
+ * \return New plugin or NULL for unknown name.
+ */
+static FlowCachePlugin *create_plugin(const string &name, const options_t &options)
+{
+   vector<plugin_opt> tmp;
+
+   if (name == "http") {
+      tmp.push_back(plugin_opt("http-req", http_request, 0));
+      tmp.push_back(plugin_opt("http-resp", http_response, 0));
+      return new HTTPPlugin(options, tmp);
+   } else if (name == "https") {
+      tmp.push_back(plugin_opt("https", https, 0));
+      return new HTTPSPlugin(options, tmp);
+   } else if (name == "dns") {
+      tmp.push_back(plugin_opt("dns", dns, 0));
+      return new DNSPlugin(options, tmp);
+   } else if (name == "sip") {
+      tmp.push_back(plugin_opt("sip", sip, 0));
+      return new SIPPlugin(options, tmp);
+   } else if (name == "ntp") {
+      tmp.push_back(plugin_opt("ntp", ntp, 0));
+      return new NTPPlugin(options, tmp);
+   } else if (name == "smtp") {
+      tmp.push_back(plugin_opt("smtp", smtp, 0));
+      return new SMTPPlugin(options, tmp);
+   } else if (name == "arp") {
+      tmp.push_back(plugin_opt("arp", arp, 0));
+      return new ARPPlugin(options, tmp);
+   } else if (name == "passivedns") {
+      tmp.push_back(plugin_opt("passivedns", passivedns, 0));
+      return new PassiveDNSPlugin(options, tmp);
+   }
+
+   return NULL;
+}
+
+/**
+ * \brief Measure packet parser throughput.
+ * \param [in] raw Captured packets.
+ * \param [in] min_pkts Minimal number of parsed packets.
+ */
+static void bench_parser(const RawTrace &raw, uint64_t min_pkts)
+{
+   PacketBlock block(PACKET_BURST_SIZE);
+   parser_opt_t opt;
+   uint64_t rounds = rounds_for(raw.size(), min_pkts);
+
+   opt.block = &block;
+   opt.parse_all = false;
+   opt.payload_limit = MAXPCKTSIZE;
+   opt.frags = NULL;
+   opt.tunnels = 0;
+   opt.tunnel_depth = 0;
+
+   uint64_t allocs = alloc_cnt;
+   uint64_t start = now_ns();
+   for (uint64_t r = 0; r < rounds; r++) {
+      for (size_t i = 0; i < raw.size(); i++) {
+         if (block.cnt == block.size) {
+            block.cnt = 0;
+         }
+         packet_handler((u_char *) &opt, &raw.hdrs[i], &raw.data[raw.offsets[i]]);
+      }
+   }
+   uint64_t end = now_ns();
+
+   report("parser", raw.name, rounds * raw.size(), end - start, alloc_cnt - allocs);
+}
+
+/**
+ * \brief Replay parsed packets through flow cache, flow cache is emptied after each replay.
+ * \param [in] options Flow cache options.
+ * \param [in] plugin Plugin to add into flow cache or NULL.
+ * \param [in] trace Parsed packets.
+ * \param [in] rounds Number of replays.
+ * \param [out] allocs Number of allocations during put_pkt() calls.
+ * \return Time spent in put_pkt() calls in nanoseconds.
+ */
+static uint64_t replay(const options_t &options, FlowCachePlugin *plugin, ParsedTrace &trace, uint64_t rounds, uint64_t &allocs)
+{
+   NullExporter exporter;
+   NHTFlowCache cache(options);
+   uint64_t ns = 0;
+
+   allocs = 0;
+   cache.set_exporter(&exporter);
+   if (plugin != NULL) {
+      cache.add_plugin(plugin);
+   }
+   cache.init();
+
+   for (uint64_t r = 0; r < rounds; r++) {
+      uint64_t allocs_start = alloc_cnt;
+      uint64_t start = now_ns();
+      for (size_t i = 0; i < trace.pkts.size(); i++) {
+         cache.put_pkt(trace.pkts[i]);
+      }
+      ns += now_ns() - start;
+      allocs += alloc_cnt - allocs_start;
+
+      cache.finish();
+   }
+
+   return ns;
+}
+
+/**
+ * \brief Measure flow cache and per-plugin cost on packets from pcap file.
+ *
+ * Plugin rows contain time and allocations added by the plugin to flow cache row of the same input.
+ * \param [in] raw Captured packets.
+ * \param [in] plugins Names of measured plugins.
+ * \param [in] base_options Module options.
+ * \param [in] min_pkts Minimal number of processed packets.
+ */
+static void bench_replay(const RawTrace &raw, const vector<string> &plugins, const options_t &base_options, uint64_t min_pkts)
+{
+   ParsedTrace trace;
+   options_t options = base_options;
+
+   parse_trace(raw, true, trace);
+   options.flow_cache_size = BENCH_REPLAY_MIN_CACHE;
+   while (options.flow_cache_size < 2 * trace.pkts.size()) {
+      options.flow_cache_size <<= 1;
+   }
+
+   uint64_t rounds = rounds_for(trace.pkts.size(), min_pkts);
+   uint64_t packets = rounds * trace.pkts.size();
+   uint64_t base_allocs;
+   uint64_t base_ns = replay(options, NULL, trace, rounds, base_allocs);
+   report("cache", raw.name, packets, base_ns, base_allocs);
+
+   for (size_t i = 0; i < plugins.size(); i++) {
+      FlowCachePlugin *plugin = create_plugin(plugins[i], options);
+      uint64_t allocs;
+      uint64_t ns = replay(options, plugin, trace, rounds, allocs);
+      report("plugin-" + plugins[i], raw.name, packets, (int64_t) ns - (int64_t) base_ns, (int64_t) allocs - (int64_t) base_allocs);
+      delete plugin;
+   }
+}
+
+/**
+ * \brief Measure splitting of packet payloads into lines with every text scanner implementation supported by CPU.
+ * \param [in] raw Captured packets.
+ * \param [in] min_pkts Minimal number of processed packets.
+ */
+static void bench_scan(const RawTrace &raw, uint64_t min_pkts)
+{
+   static const char *impls[] = {"scalar", "sse4.2", "avx2"};
+   string selected = scan_impl_name();
+   ParsedTrace trace;
+
+   parse_trace(raw, true, trace);
+   uint64_t rounds = rounds_for(trace.pkts.size(), min_pkts);
+
+   for (size_t i = 0; i < sizeof(impls) / sizeof(impls[0]); i++) {
+      if (!scan_use_impl(impls[i])) {
+         continue;
+      }
+
+      uint64_t allocs = alloc_cnt;
+      uint64_t start = now_ns();
+      for (uint64_t r = 0; r < rounds; r++) {
+         for (size_t j = 0; j < trace.pkts.size(); j++) {
+            const char *begin = trace.pkts[j].payload;
+            scan_iter it;
+            scan_line line;
+            scan_init(it, begin, begin + trace.pkts[j].payload_length, "\n:");
+            while (scan_next_line(it, begin, ':', line)) {
+               begin = line.end + 1;
+            }
+         }
+      }
+      uint64_t end = now_ns();
+
+      report(string("scan-") + impls[i], raw.name, rounds * trace.pkts.size(), end - start, alloc_cnt - allocs);
+   }
+
+   scan_use_impl(selected.c_str());
+}
+
+/**
+ * \brief Measure flow cache lookups with given number of flows relative to cache size.
+ *
+ * Every flow is put into cache once before measurement, measured packets belong to random flows.
+ * \param [in] base_options Module options.
+ * \param [in] ratio Number of flows in percents of flow cache size.
+ * \param [in] min_pkts Minimal number of processed packets.
+ */
+static void bench_cache_fill(const options_t &base_options, uint32_t ratio, uint64_t min_pkts)
+{
+   vector<SynthFlow> flows;
+   RawTrace warm_raw, raw;
+   ParsedTrace warm, trace;
+   NullExporter exporter;
+   char name[32];
+
+   gen_flows(flows, (uint64_t) base_options.flow_cache_size * ratio / 100);
+   for (size_t i = 0; i < flows.size(); i++) {
+      gen_packet(warm_raw, flows[i], i);
+   }
+   for (uint32_t i = 0; i < BENCH_SYNTH_PACKETS; i++) {
+      gen_packet(raw, flows[bench_rand() % flows.size()], flows.size() + i);
+   }
+   parse_trace(warm_raw, false, warm);
+   parse_trace(raw, false, trace);
+
+   NHTFlowCache cache(base_options);
+   cache.set_exporter(&exporter);
+   cache.init();
+   for (size_t i = 0; i < warm.pkts.size(); i++) {
+      cache.put_pkt(warm.pkts[i]);
+   }
+
+   uint64_t rounds = rounds_for(trace.pkts.size(), min_pkts);
+   uint64_t allocs = alloc_cnt;
+   uint64_t start = now_ns();
+   for (uint64_t r = 0; r < rounds; r++) {
+      for (size_t i = 0; i < trace.pkts.size(); i++) {
+         cache.put_pkt(trace.pkts[i]);
+      }
+   }
+   uint64_t end = now_ns();
+
+   snprintf(name, sizeof(name), "synthetic-fill%u", ratio);
+   report("cache", name, rounds * trace.pkts.size(), end - start, alloc_cnt - allocs);
+   cache.finish();
+}
+
+/**
+ * \brief Measure cost of filling and sending basic flow records by exporter.
+ * \param [in] exporter Initialized exporter.
+ * \param [in] flows Flow records to export.
+ * \param [in] name Benchmark name.
+ * \param [in] min_pkts Minimal number of exported records.
+ */
+static void bench_exporter(FlowExporter &exporter, vector<Flow> &flows, const string &name, uint64_t min_pkts)
+{
+   uint64_t rounds = rounds_for(flows.size(), min_pkts);
+   uint64_t allocs = alloc_cnt;
+   uint64_t start = now_ns();
+   for (uint64_t r = 0; r < rounds; r++) {
+      for (size_t i = 0; i < flows.size(); i++) {
+         exporter.export_flow(flows[i]);
+      }
+   }
+   exporter.flush();
+   uint64_t end = now_ns();
+
+   report(name, "synthetic", rounds * flows.size(), end - start, alloc_cnt - allocs);
+}
+
+/**
+ * \brief Measure UniRec and IPFIX exporters. Basic UniRec records are sent to the first output interface,
+ * records of flows with HTTP request and response extensions to the second one. IPFIX messages are sent
+ * over UDP to local socket which is never read.
+ * \param [in] options Module options.
+ * \param [in] min_pkts Minimal number of exported flows.
+ */
+static void bench_exporters(const options_t &options, uint64_t min_pkts)
+{
+   vector<SynthFlow> synth;
+   vector<Flow> flows;
+   vector<FlowCachePlugin *> no_plugins;
+
+   gen_flows(synth, BENCH_SYNTH_FLOWS);
+   flows.resize(synth.size());
+   for (size_t i = 0; i < synth.size(); i++) {
+      Flow &flow = flows[i];
+      flow.time_first.tv_sec = 1500000000;
+      flow.time_first.tv_usec = i;
+      flow.time_last = flow.time_first;
+      flow.octet_total_length = 64 * (i + 1);
+      flow.pkt_total_cnt = i + 1;
+      flow.tcp_control_bits = (synth[i].proto == IPPROTO_TCP ? 0x12 : 0);
+      flow.rev_octet_total_length = 0;
+      flow.rev_pkt_total_cnt = 0;
+      flow.rev_tcp_control_bits = 0;
+      flow.ip_version = 4;
+      flow.ip_tos = 0;
+      flow.ip_ttl = 64;
+      flow.ip_proto = synth[i].proto;
+      flow.src_port = synth[i].src_port;
+      flow.dst_port = synth[i].dst_port;
+      memset(&flow.src_ip, 0, sizeof(flow.src_ip));
+      memset(&flow.dst_ip, 0, sizeof(flow.dst_ip));
+      flow.src_ip.v4 = htonl(synth[i].src_ip);
+      flow.dst_ip.v4 = htonl(synth[i].dst_ip);
+      memcpy(flow.src_mac, "\x66\x77\x88\x99\xaa\xbb", 6);
+      memcpy(flow.dst_mac, "\x00\x11\x22\x33\x44\x55", 6);
+   }
+
+   vector<Flow> http_flows(flows);
+   for (size_t i = 0; i < http_flows.size(); i++) {
+      RecordExtHTTPReq *req = new RecordExtHTTPReq();
+      RecordExtHTTPResp *resp = new RecordExtHTTPResp();
+
+      strcpy(req->method, "GET");
+      strcpy(req->host, "www.example.com");
+      strcpy(req->uri, "/index.html");
+      resp->code = 200;
+      strcpy(resp->content_type, "text/html");
+      http_flows[i].addExtension(req);
+      http_flows[i].addExtension(resp);
+   }
+
+   vector<plugin_opt> http_opts;
+   http_opts.push_back(plugin_opt("http-req", http_request, 1));
+   http_opts.push_back(plugin_opt("http-resp", http_response, 1));
+   HTTPPlugin http(options, http_opts);
+   vector<FlowCachePlugin *> unirec_plugins(1, &http);
+
+   UnirecExporter unirec(false);
+   if (unirec.init(unirec_plugins, 2, 0, 0, 0, false, false, false, false) == 0) {
+      bench_exporter(unirec, flows, "exporter-unirec", min_pkts);
+      bench_exporter(unirec, http_flows, "exporter-unirec-http", min_pkts);
+   } else {
+      cerr << "flow_meter_bench: unable to initialize UnirecExporter, skipping" << endl;
+   }
+   unirec.close();
+
+   struct sockaddr_in addr;
+   socklen_t addr_len = sizeof(addr);
+   int sink = socket(AF_INET, SOCK_DGRAM, 0);
+   memset(&addr, 0, sizeof(addr));
+   addr.sin_family = AF_INET;
+   addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+   if (sink < 0 || bind(sink, (struct sockaddr *) &addr, sizeof(addr)) != 0 ||
+       getsockname(sink, (struct sockaddr *) &addr, &addr_len) != 0) {
+      cerr << "flow_meter_bench: unable to create IPFIX sink socket, skipping" << endl;
+      if (sink >= 0) {
+         ::close(sink);
+      }
+      return;
+   }
+
+   char port[8];
+   snprintf(port, sizeof(port), "%u", ntohs(addr.sin_port));
+
+   IPFIXExporter ipfix;
+   if (ipfix.init(no_plugins, 0, 0, "127.0.0.1", port, true, false) == 0) {
+      bench_exporter(ipfix, flows, "exporter-ipfix", min_pkts);
+   } else {
+      cerr << "flow_meter_bench: unable to initialize IPFIXExporter, skipping" << endl;
+   }
+   ipfix.shutdown();
+   ::close(sink);
+}
+
+int main(int argc, char *argv[])
+{
+   options_t options;
+   options.flow_cache_size = 1 << BENCH_DEFAULT_CACHE_EXP;
+   options.flow_line_size = DEFAULT_FLOW_LINE_SIZE;
+   options.inactive_timeout.tv_sec = (long) DEFAULT_INACTIVE_TIMEOUT;
+   options.inactive_timeout.tv_usec = 0;
+   options.active_timeout.tv_sec = (long) DEFAULT_ACTIVE_TIMEOUT;
+   options.active_timeout.tv_usec = 0;
+   options.cache_stats_interval.tv_sec = 0;
+   options.cache_stats_interval.tv_usec = 0;
+   options.print_stats = false;
+   options.print_pcap_stats = false;
+   options.interface = "";
+   options.basic_ifc_num = 0;
+   options.snaplen = 0;
+   options.worker_cnt = 0;
+   options.flow_hash = FLOW_HASH_XXHASH;
+   options.biflow = false;
+   options.afpacket = false;
+   options.stream_flow_limit = 0;
+   options.stream_total_limit = DEFAULT_STREAM_TOTAL_LIMIT;
+   options.frag_entries = 0;
+   options.frag_timeout = DEFAULT_FRAG_TIMEOUT;
+   options.frag_reassembly = false;
+   options.tunnels = 0;
+   options.tunnel_depth = 0;
+   options.sampling_mode = SAMPLING_OFF;
+   options.sampling_interval = 1;
+   options.evict_policy = EVICT_LRU;
+   options.victim_size = 0;
+   options.inspect_limit = 0;
+   options.tcp_close = false;
+   options.tcp_linger = 0;
+   options.hugepages = HUGEPAGES_OFF;
+   options.numa_node = NUMA_NODE_NONE;
+   options.eof = false;
+
+   uint32_t min_pkts = BENCH_DEFAULT_PACKETS, max_cnt = BENCH_DEFAULT_COUNT, tmp;
+   string plugin_settings = BENCH_ALL_PLUGINS;
+   vector<string> plugins;
+
+   INIT_MODULE_INFO_STRUCT(MODULE_BASIC_INFO, MODULE_PARAMS);
+   TRAP_DEFAULT_INITIALIZATION(argc, argv, *module_info);
+
+   signed char opt;
+   while ((opt = TRAP_GETOPT(argc, argv, module_getopt_string, long_options)) != -1) {
+      switch (opt) {
+      case 'n':
+         if (!str_to_uint32(optarg, min_pkts) || min_pkts == 0) {
+            FREE_MODULE_INFO_STRUCT(MODULE_BASIC_INFO, MODULE_PARAMS);
+            TRAP_DEFAULT_FINALIZATION();
+            return error("Invalid argument for option -n");
+         }
+         break;
+      case 'c':
+         if (!str_to_uint32(optarg, max_cnt) || max_cnt == 0) {
+            FREE_MODULE_INFO_STRUCT(MODULE_BASIC_INFO, MODULE_PARAMS);
+            TRAP_DEFAULT_FINALIZATION();
+            return error("Invalid argument for option -c");
+         }
+         break;
+      case 's':
+         if (!str_to_uint32(optarg, tmp) || tmp <= 3 || tmp > 30) {
+            FREE_MODULE_INFO_STRUCT(MODULE_BASIC_INFO, MODULE_PARAMS);
+            TRAP_DEFAULT_FINALIZATION();
+            return error("Invalid argument for option -s");
+         }
+         options.flow_cache_size = 1 << tmp;
+         break;
+      case 'p':
+         plugin_settings = string(optarg);
+         break;
+      default:
+         FREE_MODULE_INFO_STRUCT(MODULE_BASIC_INFO, MODULE_PARAMS);
+         TRAP_DEFAULT_FINALIZATION();
+         return error("Invalid arguments");
+      }
+   }
+
+   FREE_MODULE_INFO_STRUCT(MODULE_BASIC_INFO, MODULE_PARAMS);
+
+   size_t begin = 0, end = 0;
+   while (end != string::npos && plugin_settings != "") {
+      end = plugin_settings.find(",", begin);
+      string name = plugin_settings.substr(begin, (end == string::npos ? (plugin_settings.length() - begin) : (end - begin)));
+      FlowCachePlugin *plugin = create_plugin(name, options);
+      if (plugin == NULL) {
+         TRAP_DEFAULT_FINALIZATION();
+         return error("Unsupported plugin: " + name);
+      }
+      delete plugin;
+      plugins.push_back(name);
+      begin = end + 1;
+   }
+
+   printf("benchmark,input,packets,ns_per_pkt,pkts_per_sec,allocs_per_pkt\n");
+
+   RawTrace synth;
+   vector<SynthFlow> flows;
+   synth.name = "synthetic";
+   gen_flows(flows, BENCH_SYNTH_FLOWS);
+   for (uint32_t i = 0; i < BENCH_SYNTH_PACKETS; i++) {
+      gen_packet(synth, flows[bench_rand() % flows.size()], i);
+   }
+   bench_parser(synth, min_pkts);
+
+   for (int i = optind; i < argc; i++) {
+      RawTrace raw;
+      if (!load_pcap(argv[i], max_cnt, raw)) {
+         TRAP_DEFAULT_FINALIZATION();
+         return error(string("Can't open input file: ") + argv[i]);
+      }
+      bench_parser(raw, min_pkts);
+      bench_replay(raw, plugins, options, min_pkts);
+      bench_scan(raw, min_pkts);
+   }
+
+   for (size_t i = 0; i < sizeof(fill_ratios) / sizeof(fill_ratios[0]); i++) {
+      bench_cache_fill(options, fill_ratios[i], min_pkts);
+   }
+
+   bench_exporters(options, min_pkts);
+
+   TRAP_DEFAULT_FINALIZATION();
+   return EXIT_SUCCESS;
+}
@@ -0,0 +1,277 @@
+/**
+ * \file checkpoint.cpp
+ * \brief Flow cache checkpoint file (CheckpointWriter and CheckpointReader classes)
+ * \author Jiri Havranek <havraji6@fit.cvut.cz>
+ * \date 2018
+ */
+/*
+ * Copyright (C) 2018 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "checkpoint.h"
+
+using namespace std;
+
+CheckpointWriter::CheckpointWriter() : file(NULL), length(0), skipped_exts(0)
+{
+   memset(&header, 0, sizeof(header));
+   record = new uint8_t[CHECKPOINT_MAX_RECORD];
+}
+
+CheckpointWriter::~CheckpointWriter()
+{
+   if (file != NULL) {
+      fclose(file);
+      unlink(tmp_path.c_str());
+   }
+   delete [] record;
+}
+
+/**
+ * \brief Start writing checkpoint.
+ * \param [in] file Path of checkpoint file.
+ * \param [in] flags CHECKPOINT_* flags.
+ * \return 0 on success, -1 on error and error_msg is set.
+ */
+int CheckpointWriter::open(const string &file, uint32_t flags)
+{
+   path = file;
+   tmp_path = file + ".tmp";
+   this->file = fopen(tmp_path.c_str(), "w");
+   if (this->file == NULL) {
+      error_msg = "unable to create " + tmp_path + ": " + strerror(errno);
+      return -1;
+   }
+   setvbuf(this->file, NULL, _IOFBF, 1 << 20);
+
+   header.magic = CHECKPOINT_MAGIC;
+   header.version = CHECKPOINT_VERSION;
+   header.flags = flags;
+   header.record_size = sizeof(checkpoint_flow);
+   header.flows = 0;
+   skipped_exts = 0;
+
+   /* Header is written again with number of flows when checkpoint is closed. */
+   if (fwrite(&header, sizeof(header), 1, this->file) != 1) {
+      error_msg = "unable to write " + tmp_path + ": " + strerror(errno);
+      return -1;
+   }
+   return 0;
+}
+
+/**
+ * \brief Start new flow record.
+ * \return Zeroed flow record to be filled by caller.
+ */
+checkpoint_flow *CheckpointWriter::new_flow()
+{
+   checkpoint_flow *rec = (checkpoint_flow *) record;
+
+   memset(rec, 0, sizeof(checkpoint_flow));
+   length = sizeof(checkpoint_flow);
+   return rec;
+}
+
+/**
+ * \brief Append extension to flow record. Extensions which do not support serialization are skipped.
+ * \param [in] ext Flow record extension.
+ */
+void CheckpointWriter::add_ext(const RecordExt *ext)
+{
+   checkpoint_ext *item = (checkpoint_ext *) (record + length);
+   checkpoint_flow *rec = (checkpoint_flow *) record;
+   int size = CHECKPOINT_MAX_RECORD - length - sizeof(checkpoint_ext);
+   int data_len = (size > 0 && rec->ext_cnt < 255 ? ext->serialize((uint8_t *) (item + 1), size) : -1);
+
+   if (data_len < 0) {
+      skipped_exts++;
+      return;
+   }
+
+   item->type = ext->extType;
+   item->reserved = 0;
+   item->length = data_len;
+   memset((uint8_t *) (item + 1) + data_len, 0, CHECKPOINT_ALIGN(data_len) - data_len);
+   length = CHECKPOINT_ALIGN(length + sizeof(checkpoint_ext) + data_len);
+   rec->ext_cnt++;
+}
+
+/**
+ * \brief Write finished flow record.
+ * \return 0 on success, -1 on error and error_msg is set.
+ */
+int CheckpointWriter::write_flow()
+{
+   ((checkpoint_flow *) record)->length = length;
+   if (fwrite(record, length, 1, file) != 1) {
+      error_msg = "unable to write " + tmp_path + ": " + strerror(errno);
+      return -1;
+   }
+   header.flows++;
+   return 0;
+}
+
+/**
+ * \brief Finish checkpoint and replace previous checkpoint file by it.
+ * \return 0 on success, -1 on error and error_msg is set.
+ */
+int CheckpointWriter::close()
+{
+   int ret = 0;
+
+   if (fseek(file, 0, SEEK_SET) != 0 || fwrite(&header, sizeof(header), 1, file) != 1 ||
+       fflush(file) != 0 || fsync(fileno(file)) != 0) {
+      error_msg = "unable to write " + tmp_path + ": " + strerror(errno);
+      ret = -1;
+   }
+   if (fclose(file) != 0 && ret == 0) {
+      error_msg = "unable to write " + tmp_path + ": " + strerror(errno);
+      ret = -1;
+   }
+   file = NULL;
+
+   if (ret == 0 && rename(tmp_path.c_str(), path.c_str()) != 0) {
+      error_msg = "unable to rename " + tmp_path + " to " + path + ": " + strerror(errno);
+      ret = -1;
+   }
+   if (ret != 0) {
+      unlink(tmp_path.c_str());
+   }
+   return ret;
+}
+
+CheckpointReader::CheckpointReader() : map(NULL), length(0), offset(0), left(0)
+{
+}
+
+CheckpointReader::~CheckpointReader()
+{
+   close();
+}
+
+/**
+ * \brief Map checkpoint file into memory and check its header.
+ * \param [in] file Path of checkpoint file.
+ * \return 0 on success, -1 on error and error_msg is set. errno is ENOENT when file does not exist.
+ */
+int CheckpointReader::open(const string &file)
+{
+   struct stat st;
+   int fd = ::open(file.c_str(), O_RDONLY);
+
+   if (fd < 0) {
+      error_msg = "unable to open " + file + ": " + strerror(errno);
+      return -1;
+   }
+   if (fstat(fd, &st) != 0 || st.st_size < (off_t) sizeof(checkpoint_header)) {
+      ::close(fd);
+      error_msg = file + " is not a flow cache checkpoint";
+      errno = EINVAL;
+      return -1;
+   }
+
+   length = st.st_size;
+   map = (uint8_t *) mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+   ::close(fd);
+   if (map == MAP_FAILED) {
+      map = NULL;
+      error_msg = "unable to map " + file + ": " + strerror(errno);
+      return -1;
+   }
+   madvise(map, length, MADV_SEQUENTIAL);
+
+   const checkpoint_header *header = (const checkpoint_header *) map;
+   if (header->magic != CHECKPOINT_MAGIC || header->version != CHECKPOINT_VERSION || header->record_size != sizeof(checkpoint_flow)) {
+      close();
+      error_msg = file + " is not a flow cache checkpoint of this version of flow_meter";
+      errno = EINVAL;
+      return -1;
+   }
+   offset = sizeof(checkpoint_header);
+   left = header->flows;
+   return 0;
+}
+
+/**
+ * \brief Get next flow record. Bounds of record and its extensions are checked.
+ * \return Pointer to flow record or NULL when there are no more valid records.
+ */
+const checkpoint_flow *CheckpointReader::next_flow()
+{
+   if (left == 0 || offset > length || length - offset < sizeof(checkpoint_flow)) {
+      return NULL;
+   }
+
+   const checkpoint_flow *rec = (const checkpoint_flow *) (map + offset);
+   if (rec->length < sizeof(checkpoint_flow) || rec->length > length - offset || rec->key_len > CHECKPOINT_KEY_LENGTH) {
+      left = 0;
+      return NULL;
+   }
+
+   const uint8_t *end = map + offset + rec->length;
+   const checkpoint_ext *ext = first_ext(rec);
+   for (int i = 0; i < rec->ext_cnt; i++) {
+      if ((const uint8_t *) (ext + 1) > end || ext->length > (uint32_t) (end - ext_data(ext))) {
+         left = 0;
+         return NULL;
+      }
+      ext = next_ext(ext);
+   }
+
+   offset += CHECKPOINT_ALIGN(rec->length);
+   left--;
+   return rec;
+}
+
+/**
+ * \brief Unmap checkpoint file.
+ */
+void CheckpointReader::close()
+{
+   if (map != NULL) {
+      munmap(map, length);
+   }
+   map = NULL;
+   length = 0;
+   left = 0;
+}
@@ -0,0 +1,226 @@
+/**
+ * \file checkpoint.h
+ * \brief Flow cache checkpoint file (CheckpointWriter and CheckpointReader classes)
+ * \author Jiri Havranek <havraji6@fit.cvut.cz>
+ * \date 2018
+ */
+/*
+ * Copyright (C) 2018 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+
+#include "flowifc.h"
+#include "ipaddr.h"
+
+using namespace std;
+
+#define CHECKPOINT_MAGIC      0x50434d46 /**< "FMCP" at the beginning of checkpoint file. */
+#define CHECKPOINT_VERSION    1
+#define CHECKPOINT_BIFLOW     0x1        /**< Flow keys of checkpoint were created in biflow mode. */
+#define CHECKPOINT_KEY_LENGTH 40         /**< Space for flow key, at least MAX_KEY_LENGTH of NHTFlowCache. */
+#define CHECKPOINT_MAX_RECORD 65536      /**< Max length of flow record with extensions. */
+
+/**
+ * \brief Round length of checkpoint item up to 8 bytes, so that following item is aligned.
+ */
+#define CHECKPOINT_ALIGN(len) (((len) + 7) & ~7U)
+
+/**
+ * \brief Header of checkpoint file.
+ */
+struct checkpoint_header {
+   uint32_t magic;
+   uint32_t version;
+   uint32_t flags;       /**< Settings flow keys depend on, CHECKPOINT_* flags. */
+   uint32_t record_size; /**< Size of checkpoint_flow, detects files written by incompatible build. */
+   uint64_t flows;       /**< Number of flow records following header. */
+};
+
+/**
+ * \brief Flow record saved in checkpoint, followed by ext_cnt extensions.
+ */
+struct checkpoint_flow {
+   uint32_t length;       /**< Length of record including extensions. */
+   uint8_t ext_cnt;       /**< Number of extensions. */
+   uint8_t key_len;
+   uint8_t key_swapped;
+   uint8_t end_reason;
+   char key[CHECKPOINT_KEY_LENGTH];
+
+   int64_t time_first_sec;
+   int64_t time_first_usec;
+   int64_t time_last_sec;
+   int64_t time_last_usec;
+   uint64_t octet_total_length;
+   uint64_t rev_octet_total_length;
+   uint32_t pkt_total_cnt;
+   uint32_t rev_pkt_total_cnt;
+   uint32_t sampling_interval;
+   uint16_t src_port;
+   uint16_t dst_port;
+   ipaddr_t src_ip;
+   ipaddr_t dst_ip;
+   uint8_t src_mac[6];
+   uint8_t dst_mac[6];
+   uint8_t tcp_control_bits;
+   uint8_t rev_tcp_control_bits;
+   uint8_t ip_version;
+   uint8_t ip_tos;
+   uint8_t ip_ttl;
+   uint8_t ip_proto;
+};
+
+/**
+ * \brief Flow record extension saved in checkpoint, followed by data written by RecordExt::serialize().
+ */
+struct checkpoint_ext {
+   uint16_t type;     /**< Type of extension from extTypeEnum. */
+   uint16_t reserved;
+   uint32_t length;   /**< Length of data. */
+};
+
+/**
+ * \brief Writer of checkpoint file.
+ *
+ * Records are written to temporary file which replaces checkpoint when it is closed, so interrupted
+ * write never leaves incomplete checkpoint behind.
+ */
+class CheckpointWriter
+{
+   FILE *file;
+   string path;
+   string tmp_path;
+   checkpoint_header header;
+   uint8_t *record;        /**< Flow record being built. */
+   uint32_t length;        /**< Length of record being built. */
+   uint64_t skipped_exts;  /**< Number of extensions which cannot be saved. */
+
+   CheckpointWriter(const CheckpointWriter &);
+   CheckpointWriter &operator=(const CheckpointWriter &);
+
+public:
+   string error_msg; /**< Error message of failed operation. */
+
+   CheckpointWriter();
+   ~CheckpointWriter();
+
+   int open(const string &file, uint32_t flags);
+   checkpoint_flow *new_flow();
+   void add_ext(const RecordExt *ext);
+   int write_flow();
+   int close();
+
+   /**
+    * \brief Get number of written flow records.
+    */
+   uint64_t get_flows() const
+   {
+      return header.flows;
+   }
+
+   /**
+    * \brief Get number of extensions which were not saved because their type does not support it.
+    */
+   uint64_t get_skipped_exts() const
+   {
+      return skipped_exts;
+   }
+};
+
+/**
+ * \brief Reader of checkpoint file, file is mapped into memory.
+ */
+class CheckpointReader
+{
+   uint8_t *map;
+   size_t length;
+   size_t offset; /**< Offset of next flow record. */
+   uint64_t left; /**< Number of flow records not read yet. */
+
+   CheckpointReader(const CheckpointReader &);
+   CheckpointReader &operator=(const CheckpointReader &);
+
+public:
+   string error_msg; /**< Error message of failed operation. */
+
+   CheckpointReader();
+   ~CheckpointReader();
+
+   int open(const string &file);
+   const checkpoint_flow *next_flow();
+   void close();
+
+   /**
+    * \brief Get flags of checkpoint.
+    * \return CHECKPOINT_* flags.
+    */
+   uint32_t get_flags() const
+   {
+      return ((const checkpoint_header *) map)->flags;
+   }
+
+   /**
+    * \brief Get first extension of flow record.
+    */
+   static const checkpoint_ext *first_ext(const checkpoint_flow *rec)
+   {
+      return (const checkpoint_ext *) (rec + 1);
+   }
+
+   /**
+    * \brief Get extension which follows given one in flow record.
+    */
+   static const checkpoint_ext *next_ext(const checkpoint_ext *ext)
+   {
+      return (const checkpoint_ext *) ((const uint8_t *) (ext + 1) + CHECKPOINT_ALIGN(ext->length));
+   }
+
+   /**
+    * \brief Get data of extension.
+    */
+   static const uint8_t *ext_data(const checkpoint_ext *ext)
+   {
+      return (const uint8_t *) (ext + 1);
+   }
+};
+
+#endif
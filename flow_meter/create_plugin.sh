@@ -218,6 +218,8 @@ print_todo() {
    echo "Optional work:"
    echo "1) Add pcap traffic sample for ${PLUGIN} plugin to traffic-samples directory"
    echo "2) Add test for ${PLUGIN} to tests directory"
+   echo "3) Implement get_interest in ${PLUGIN}plugin.cpp when plugin processes only some ports, IP protocols or ethertypes"
+   echo "4) Add RECORD_EXT_SERIALIZED to RecordExt${PLUGIN_UPPER} and implement deserialize in ${PLUGIN}plugin.cpp, so that flows keep extension across restart with checkpoint (-C)"
    echo
    echo "NOTE: If you didn't modify pre_create, post_create, pre_update, post_update, pre_export or include_basic_flow_fields functions, please remove them from ${PLUGIN}plugin.cpp and ${PLUGIN}plugin.h"
 }
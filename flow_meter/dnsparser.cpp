@@ -0,0 +1,206 @@
+/**
+ * \file dnsparser.cpp
+ * \brief Allocation free DNS wire format decoding.
+ * \author Jiri Havranek <havraji6@fit.cvut.cz>
+ * \date 2018
+ */
+/*
+ * Copyright (C) 2018 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "dnsparser.h"
+
+/**
+ * \brief Check for label pointer in DNS name.
+ */
+#define IS_POINTER(ch) (((ch) & 0xC0) == 0xC0)
+
+/**
+ * \brief Get offset from 2 byte pointer.
+ */
+#define GET_OFFSET(half1, half2) ((((uint8_t)(half1) & 0x3F) << 8) | (uint8_t)(half2))
+
+/**
+ * \brief Get number of bytes occupied by name at its position in message, compression pointers are not followed.
+ * \param [in] msg Pointer to begin of DNS message.
+ * \param [in] msg_len Length of DNS message.
+ * \param [in] data Pointer to name.
+ * \param [out] length Number of bytes occupied by name.
+ * \return DNS_OK on success, DNS_ERR_OVERFLOW when name exceeds end of message.
+ */
+int dns_name_length(const char *msg, uint32_t msg_len, const char *data, uint32_t &length)
+{
+   uint32_t offset = data - msg;
+   uint32_t start = offset;
+
+   while (1) {
+      if (offset >= msg_len) {
+         return DNS_ERR_OVERFLOW;
+      }
+      uint8_t ch = msg[offset];
+      if (!ch) {
+         break;
+      }
+      if (IS_POINTER(ch)) {
+         length = offset - start + 2;
+         return DNS_OK;
+      }
+
+      offset += ch + 1;
+   }
+
+   length = offset - start + 1;
+   return DNS_OK;
+}
+
+/**
+ * \brief Decompress name into caller provided buffer.
+ *
+ * Labels are separated by dots. Output is always zero terminated and cut off when it does not fit into buffer,
+ * whole name is validated anyway. Number of followed pointers is bounded by DNS_MAX_LABEL_CNT, so pointer loops
+ * are detected.
+ *
+ * \param [in] msg Pointer to begin of DNS message.
+ * \param [in] msg_len Length of DNS message.
+ * \param [in] data Pointer to compressed name.
+ * \param [out] out Output buffer.
+ * \param [in] out_size Size of output buffer, must be at least 1.
+ * \param [out] length Length of whole decompressed name, may be greater or equal to out_size when name was cut off.
+ * \return DNS_OK on success, DNS_ERR_OVERFLOW or DNS_ERR_LABEL on malformed name.
+ */
+int dns_decode_name(const char *msg, uint32_t msg_len, const char *data, char *out, uint32_t out_size, uint32_t &length)
+{
+   uint32_t offset = data - msg;
+   uint32_t avail = out_size - 1;
+   uint32_t len = 0;
+   int label_cnt = 0;
+
+   while (1) {
+      if (offset >= msg_len) {
+         out[len < avail ? len : avail] = 0;
+         return DNS_ERR_OVERFLOW;
+      }
+      uint8_t ch = msg[offset];
+      if (!ch) { /* Check for terminating character. */
+         break;
+      }
+
+      if (IS_POINTER(ch)) { /* Check for label pointer (11xxxxxx byte) */
+         if (label_cnt++ > DNS_MAX_LABEL_CNT || offset + 2 > msg_len) {
+            out[len < avail ? len : avail] = 0;
+            return DNS_ERR_LABEL;
+         }
+         offset = GET_OFFSET(ch, msg[offset + 1]);
+         continue;
+      }
+
+      if (label_cnt++ > DNS_MAX_LABEL_CNT || ch > 63 || offset + ch + 2 > msg_len) {
+         out[len < avail ? len : avail] = 0;
+         return DNS_ERR_LABEL;
+      }
+
+      if (len) {
+         if (len < avail) {
+            out[len] = '.';
+         }
+         len++;
+      }
+      if (len < avail) {
+         memcpy(out + len, msg + offset + 1, len + ch <= avail ? ch : avail - len);
+      }
+      len += ch;
+      offset += ch + 1;
+   }
+
+   out[len < avail ? len : avail] = 0;
+   length = len;
+   return DNS_OK;
+}
+
+/**
+ * \brief Append characters to bounded string.
+ * \param [in,out] buf Output string.
+ * \param [in] str Characters to append.
+ * \param [in] len Number of characters.
+ */
+void dns_buf_append(dns_buf &buf, const char *str, uint32_t len)
+{
+   uint32_t avail = buf.size - 1 - buf.len;
+   if (len > avail) {
+      len = avail;
+   }
+
+   memcpy(buf.data + buf.len, str, len);
+   buf.len += len;
+   buf.data[buf.len] = 0;
+}
+
+/**
+ * \brief Append decimal representation of number to bounded string.
+ * \param [in,out] buf Output string.
+ * \param [in] value Number to append.
+ */
+void dns_buf_append_uint(dns_buf &buf, uint32_t value)
+{
+   char tmp[16];
+   int len = snprintf(tmp, sizeof(tmp), "%u", value);
+
+   dns_buf_append(buf, tmp, len);
+}
+
+/**
+ * \brief Append decompressed name to bounded string.
+ * \param [in,out] buf Output string.
+ * \param [in] msg Pointer to begin of DNS message.
+ * \param [in] msg_len Length of DNS message.
+ * \param [in] data Pointer to compressed name.
+ * \return DNS_OK on success, error code from dns_decode_name() otherwise.
+ */
+int dns_buf_append_name(dns_buf &buf, const char *msg, uint32_t msg_len, const char *data)
+{
+   uint32_t length;
+   int ret = dns_decode_name(msg, msg_len, data, buf.data + buf.len, buf.size - buf.len, length);
+   if (ret != DNS_OK) {
+      buf.data[buf.len] = 0;
+      return ret;
+   }
+
+   buf.len += (length < buf.size - 1 - buf.len ? length : buf.size - 1 - buf.len);
+   return DNS_OK;
+}
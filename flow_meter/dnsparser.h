@@ -0,0 +1,87 @@
+/**
+ * \file dnsparser.h
+ * \brief Allocation free DNS wire format decoding.
+ * \author Jiri Havranek <havraji6@fit.cvut.cz>
+ * \date 2018
+ */
+/*
+ * Copyright (C) 2018 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#ifndef DNSPARSER_H
+#define DNSPARSER_H
+
+#include <stdint.h>
+
+#include "dns.h"
+
+/* Return codes of DNS decoding functions. */
+#define DNS_OK                0  /**< Name was decoded successfully. */
+#define DNS_ERR_OVERFLOW      -1 /**< Name exceeds end of message. */
+#define DNS_ERR_LABEL         -2 /**< Invalid label length or too many labels and pointers. */
+
+/**
+ * \brief Maximal number of labels and followed compression pointers in single name.
+ */
+#define DNS_MAX_LABEL_CNT     127
+
+/**
+ * \brief Size of buffer able to hold any name valid according to RFC 1035 including terminating zero.
+ */
+#define DNS_NAME_BUF_SIZE     256
+
+/**
+ * \brief Bounded output string, contents exceeding capacity are silently cut off.
+ */
+struct dns_buf {
+   char *data;       /**< Output buffer. */
+   uint32_t size;    /**< Capacity of buffer including terminating zero. */
+   uint32_t len;     /**< Number of characters stored. */
+
+   dns_buf(char *buffer, uint32_t buffer_size) : data(buffer), size(buffer_size), len(0)
+   {
+      data[0] = 0;
+   }
+};
+
+int dns_name_length(const char *msg, uint32_t msg_len, const char *data, uint32_t &length);
+int dns_decode_name(const char *msg, uint32_t msg_len, const char *data, char *out, uint32_t out_size, uint32_t &length);
+
+void dns_buf_append(dns_buf &buf, const char *str, uint32_t len);
+void dns_buf_append_uint(dns_buf &buf, uint32_t value);
+int dns_buf_append_name(dns_buf &buf, const char *msg, uint32_t msg_len, const char *data);
+
+#endif
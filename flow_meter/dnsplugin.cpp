@@ -45,7 +45,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <iostream>
-#include <sstream>
+#include <string.h>
 #include <arpa/inet.h>
 #include <unirec/unirec.h>
 
@@ -74,18 +74,6 @@ using namespace std;
 #define DEBUG_CODE(code)
 #endif
 
-/**
- * \brief Check for label pointer in DNS name.
- */
-#define IS_POINTER(ch) ((ch & 0xC0) == 0xC0)
-
-#define MAX_LABEL_CNT 127
-
-/**
- * \brief Get offset from 2 byte pointer.
- */
-#define GET_OFFSET(half1, half2) ((((uint8_t)(half1) & 0x3F) << 8) | (uint8_t)(half2))
-
 #define DNS_UNIREC_TEMPLATE "DNS_ID,DNS_ANSWERS,DNS_RCODE,DNS_NAME,DNS_QTYPE,DNS_CLASS,DNS_RR_TTL,DNS_RLENGTH,DNS_RDATA,DNS_PSIZE,DNS_DO"
 
 UR_FIELDS (
@@ -157,6 +145,22 @@ void DNSPlugin::finish()
    }
 }
 
+/**
+ * \brief Plugin processes DNS traffic on port 53 only.
+ */
+plugin_interest DNSPlugin::get_interest()
+{
+   return plugin_interest().port(53);
+}
+
+/**
+ * \brief Create DNS extension saved in flow cache checkpoint.
+ */
+RecordExt *DNSPlugin::deserialize(extTypeEnum type, const uint8_t *data, int size)
+{
+   return (type == dns ? RecordExtDNS::deserialize(data, size) : NULL);
+}
+
 string DNSPlugin::get_unirec_field_string()
 {
    return DNS_UNIREC_TEMPLATE;
@@ -172,99 +176,32 @@ const char **DNSPlugin::get_ipfix_string()
    return dns_ipfix_string;
 }
 
-/**
- * \brief Get name length.
- * \param [in] data Pointer to string.
- * \return Number of characters in string.
- */
-size_t DNSPlugin::get_name_length(const char *data) const
-{
-   size_t len = 0;
-
-   while (1) {
-      if ((uint32_t) (data - data_begin) + 1 > data_len) {
-         throw "Error: overflow";
-      }
-      if (!data[0]) {
-         break;
-      }
-      if (IS_POINTER(data[0])) {
-         return len + 2;
-      }
-
-      len += (uint8_t) data[0] + 1;
-      data += (uint8_t) data[0] + 1;
-   }
-
-   return len + 1;
-}
-
-/**
- * \brief Decompress dns name.
- * \param [in] data Pointer to compressed data.
- * \return String with decompressed dns name.
- */
-string DNSPlugin::get_name(const char *data) const
-{
-   string name = "";
-   int label_cnt = 0;
-
-   if ((uint32_t) (data - data_begin) > data_len) {
-      throw "Error: overflow";
-   }
-
-   while (data[0]) { /* Check for terminating character. */
-      if (IS_POINTER(data[0])) { /* Check for label pointer (11xxxxxx byte) */
-         data = data_begin + GET_OFFSET(data[0], data[1]);
-
-         /* Check for possible errors.*/
-         if (label_cnt++ > MAX_LABEL_CNT || (uint32_t) (data - data_begin) > data_len) {
-            throw "Error: label count exceed or overflow";
-         }
-
-         continue;
-      }
-
-      /* Check for possible errors.*/
-      if (label_cnt++ > MAX_LABEL_CNT || (uint8_t) data[0] > 63 ||
-         (uint32_t) ((data - data_begin) + (uint8_t) data[0] + 2) > data_len) {
-         throw "Error: label count exceed or overflow";
-      }
-
-      name += '.' + string(data + 1, (uint8_t) data[0]);
-      data += ((uint8_t) data[0] + 1);
-   }
-
-   if (name[0] == '.') {
-      name.erase(0, 1);
-   }
-
-   return name;
-}
-
 /**
  * \brief Process SRV strings.
  * \param [in,out] str Raw SRV string.
+ * \param [in,out] len Length of SRV string.
  */
-void DNSPlugin::process_srv(string &str) const
+void DNSPlugin::process_srv(char *str, uint32_t &len) const
 {
    bool underline_found = false;
-   for (int i = 0; str[i]; i++) {
+   for (uint32_t i = 0; i < len && str[i]; i++) {
       if (str[i] == '_') {
-         str.erase(i--, 1);
+         memmove(str + i, str + i + 1, len - i - 1);
+         str[--len] = 0;
+         i--;
          if (underline_found) {
             break;
          }
          underline_found = true;
       }
    }
-   size_t pos = str.find('.');
-   if (pos != string::npos) {
-      str[pos] = ' ';
+   char *pos = (char *) memchr(str, '.', len);
+   if (pos != NULL) {
+      *pos = ' ';
 
-      pos = str.find('.', pos);
-      if (pos != string::npos) {
-         str[pos] = ' ';
+      pos = (char *) memchr(pos, '.', len - (pos - str));
+      if (pos != NULL) {
+         *pos = ' ';
       }
    }
 }
@@ -276,52 +213,60 @@ void DNSPlugin::process_srv(string &str) const
  * \param [out] rdata String which stores processed data.
  * \param [in] type Type of RDATA section.
  * \param [in] length Length of RDATA section.
+ * \return DNS_OK on success, error code of DNS decoder otherwise.
  */
-void DNSPlugin::process_rdata(const char *record_begin, const char *data, ostringstream &rdata, uint16_t type, size_t length) const
+int DNSPlugin::process_rdata(const char *record_begin, const char *data, dns_buf &rdata, uint16_t type, size_t length) const
 {
-   rdata.str("");
-   rdata.clear();
+   int ret = DNS_OK;
 
    switch (type){
    case DNS_TYPE_A:
-      rdata << inet_ntoa(*(struct in_addr *) (data));
-      DEBUG_MSG("\tData A:\t\t\t%s\n",       rdata.str().c_str());
+      {
+         const char *addr = inet_ntoa(*(struct in_addr *) (data));
+         dns_buf_append(rdata, addr, strlen(addr));
+         DEBUG_MSG("\tData A:\t\t\t%s\n",    rdata.data);
+      }
       break;
    case DNS_TYPE_AAAA:
       {
          char addr[INET6_ADDRSTRLEN];
          inet_ntop(AF_INET6, (const void *) data, addr, INET6_ADDRSTRLEN);
-         rdata << addr;
-         DEBUG_MSG("\tData AAAA:\t\t%s\n",   rdata.str().c_str());
+         dns_buf_append(rdata, addr, strlen(addr));
+         DEBUG_MSG("\tData AAAA:\t\t%s\n",   rdata.data);
       }
       break;
    case DNS_TYPE_NS:
-      rdata << get_name(data);
-      DEBUG_MSG("\tData NS:\t\t\t%s\n",      rdata.str().c_str());
+      ret = dns_buf_append_name(rdata, data_begin, data_len, data);
+      DEBUG_MSG("\tData NS:\t\t\t%s\n",      rdata.data);
       break;
    case DNS_TYPE_CNAME:
-      rdata << get_name(data);
-      DEBUG_MSG("\tData CNAME:\t\t%s\n",     rdata.str().c_str());
+      ret = dns_buf_append_name(rdata, data_begin, data_len, data);
+      DEBUG_MSG("\tData CNAME:\t\t%s\n",     rdata.data);
       break;
    case DNS_TYPE_PTR:
-      rdata << get_name(data);
-      DEBUG_MSG("\tData PTR:\t\t%s\n",       rdata.str().c_str());
+      ret = dns_buf_append_name(rdata, data_begin, data_len, data);
+      DEBUG_MSG("\tData PTR:\t\t%s\n",       rdata.data);
       break;
    case DNS_TYPE_DNAME:
-      rdata << get_name(data);
-      DEBUG_MSG("\tData DNAME:\t\t%s\n",     rdata.str().c_str());
+      ret = dns_buf_append_name(rdata, data_begin, data_len, data);
+      DEBUG_MSG("\tData DNAME:\t\t%s\n",     rdata.data);
       break;
    case DNS_TYPE_SOA:
       {
-         rdata << get_name(data);
-         data += get_name_length(data);
-         string tmp = get_name(data);
-         data += get_name_length(data);
-
-         DEBUG_MSG("\t\tMName:\t\t%s\n",     rdata.str().c_str());
-         DEBUG_MSG("\t\tRName:\t\t%s\n",     tmp.c_str());
+         uint32_t name_len;
+         if ((ret = dns_buf_append_name(rdata, data_begin, data_len, data)) != DNS_OK ||
+            (ret = dns_name_length(data_begin, data_len, data, name_len)) != DNS_OK) {
+            break;
+         }
+         data += name_len;
+         dns_buf_append(rdata, " ", 1);
+         if ((ret = dns_buf_append_name(rdata, data_begin, data_len, data)) != DNS_OK ||
+            (ret = dns_name_length(data_begin, data_len, data, name_len)) != DNS_OK) {
+            break;
+         }
+         data += name_len;
 
-         rdata << " " << tmp;
+         DEBUG_MSG("\t\tMName RName:\t%s\n", rdata.data);
 
          struct dns_soa *soa = (struct dns_soa *) data;
          DEBUG_MSG("\t\tSerial:\t\t%u\n",    ntohl(soa->serial));
@@ -329,35 +274,60 @@ void DNSPlugin::process_rdata(const char *record_begin, const char *data, ostrin
          DEBUG_MSG("\t\tRetry:\t\t%u\n",     ntohl(soa->retry));
          DEBUG_MSG("\t\tExpiration:\t%u\n",  ntohl(soa->expiration));
          DEBUG_MSG("\t\tMin TTL:\t%u\n",     ntohl(soa->ttl));
-         rdata << " " << ntohl(soa->serial) << " " << ntohl(soa->refresh) << " "
-               << ntohl(soa->retry) << " " << ntohl(soa->expiration) << " " << ntohl(soa->ttl);
+         dns_buf_append(rdata, " ", 1);
+         dns_buf_append_uint(rdata, ntohl(soa->serial));
+         dns_buf_append(rdata, " ", 1);
+         dns_buf_append_uint(rdata, ntohl(soa->refresh));
+         dns_buf_append(rdata, " ", 1);
+         dns_buf_append_uint(rdata, ntohl(soa->retry));
+         dns_buf_append(rdata, " ", 1);
+         dns_buf_append_uint(rdata, ntohl(soa->expiration));
+         dns_buf_append(rdata, " ", 1);
+         dns_buf_append_uint(rdata, ntohl(soa->ttl));
       }
       break;
    case DNS_TYPE_SRV:
       {
          DEBUG_MSG("\tData SRV:\n");
-         string tmp = get_name(record_begin);
-         process_srv(tmp);
+         char owner[DNS_NAME_BUF_SIZE];
+         uint32_t owner_len;
+         if ((ret = dns_decode_name(data_begin, data_len, record_begin, owner, sizeof(owner), owner_len)) != DNS_OK) {
+            break;
+         }
+         if (owner_len >= sizeof(owner)) {
+            owner_len = sizeof(owner) - 1;
+         }
+         process_srv(owner, owner_len);
          struct dns_srv *srv = (struct dns_srv *) data;
 
          DEBUG_MSG("\t\tPriority:\t%u\n",    ntohs(srv->priority));
          DEBUG_MSG("\t\tWeight:\t\t%u\n",    ntohs(srv->weight));
          DEBUG_MSG("\t\tPort:\t\t%u\n",      ntohs(srv->port));
 
-         rdata << tmp << " ";
-         tmp = get_name(data + 6);
+         dns_buf_append(rdata, owner, owner_len);
+         dns_buf_append(rdata, " ", 1);
+         if ((ret = dns_buf_append_name(rdata, data_begin, data_len, data + 6)) != DNS_OK) {
+            break;
+         }
 
-         DEBUG_MSG("\t\tTarget:\t\t%s\n", tmp.c_str());
-         rdata << tmp << " " << ntohs(srv->priority) << " " <<  ntohs(srv->weight) << " " << ntohs(srv->port);
+         DEBUG_MSG("\t\tTarget:\t\t%s\n", rdata.data);
+         dns_buf_append(rdata, " ", 1);
+         dns_buf_append_uint(rdata, ntohs(srv->priority));
+         dns_buf_append(rdata, " ", 1);
+         dns_buf_append_uint(rdata, ntohs(srv->weight));
+         dns_buf_append(rdata, " ", 1);
+         dns_buf_append_uint(rdata, ntohs(srv->port));
       }
       break;
    case DNS_TYPE_MX:
       {
          uint16_t preference = ntohs(*(uint16_t *) data);
-         rdata << preference << " " << get_name(data + 2);
+         dns_buf_append_uint(rdata, preference);
+         dns_buf_append(rdata, " ", 1);
+         ret = dns_buf_append_name(rdata, data_begin, data_len, data + 2);
          DEBUG_MSG("\tData MX:\n");
          DEBUG_MSG("\t\tPreference:\t%u\n",     preference);
-         DEBUG_MSG("\t\tMail exchanger:\t%s\n", get_name(data + 2).c_str());
+         DEBUG_MSG("\t\tMail exchanger:\t%s\n", rdata.data);
       }
       break;
    case DNS_TYPE_TXT:
@@ -368,37 +338,43 @@ void DNSPlugin::process_rdata(const char *record_begin, const char *data, ostrin
          size_t total_len = len + 1;
 
          while (length != 0 && total_len <= length) {
-            DEBUG_MSG("\t\tTXT data:\t%s\n",    string(data, len).c_str());
-            rdata << string(data, len);
+            DEBUG_MSG("\t\tTXT data:\t%.*s\n",  (int) len, data);
+            dns_buf_append(rdata, data, len);
 
             data += len;
             len = (uint8_t) *(data++);
             total_len += len + 1;
 
             if (total_len <= length) {
-               rdata << " ";
+               dns_buf_append(rdata, " ", 1);
             }
          }
       }
       break;
    case DNS_TYPE_MINFO:
       DEBUG_MSG("\tData MINFO:\n");
-      rdata << get_name(data);
-      DEBUG_MSG("\t\tRMAILBX:\t%s\n",  rdata.str().c_str());
-      data += get_name_length(data);
+      {
+         uint32_t name_len;
+         if ((ret = dns_buf_append_name(rdata, data_begin, data_len, data)) != DNS_OK ||
+            (ret = dns_name_length(data_begin, data_len, data, name_len)) != DNS_OK) {
+            break;
+         }
+         DEBUG_MSG("\t\tRMAILBX:\t%s\n",  rdata.data);
+         data += name_len;
 
-      rdata << get_name(data);
-      DEBUG_MSG("\t\tEMAILBX:\t%s\n",  get_name(data).c_str());
+         ret = dns_buf_append_name(rdata, data_begin, data_len, data);
+         DEBUG_MSG("\t\tEMAILBX:\t%s\n",  rdata.data);
+      }
       break;
    case DNS_TYPE_HINFO:
       DEBUG_MSG("\tData HINFO:\n");
-      rdata << string(data, length);
-      DEBUG_MSG("\t\tData:\t%s\n", rdata.str().c_str());
+      dns_buf_append(rdata, data, length);
+      DEBUG_MSG("\t\tData:\t%s\n", rdata.data);
       break;
    case DNS_TYPE_ISDN:
       DEBUG_MSG("\tData ISDN:\n");
-      rdata << string(data, length);
-      DEBUG_MSG("\t\tData:\t%s\n", rdata.str().c_str());
+      dns_buf_append(rdata, data, length);
+      DEBUG_MSG("\t\tData:\t%s\n", rdata.data);
       break;
    case DNS_TYPE_DS:
       {
@@ -408,14 +384,17 @@ void DNSPlugin::process_rdata(const char *record_begin, const char *data, ostrin
          DEBUG_MSG("\t\tAlgorithm:\t%u\n",      ds->algorithm);
          DEBUG_MSG("\t\tDigest type:\t%u\n",    ds->digest_type);
          DEBUG_MSG("\t\tDigest:\t\t(binary)\n");
-         rdata << ntohs(ds->keytag) << " " << (uint16_t) ds->keytag << " "
-               << (uint16_t) ds->digest_type << " <key>";
+         dns_buf_append_uint(rdata, ntohs(ds->keytag));
+         dns_buf_append(rdata, " ", 1);
+         dns_buf_append_uint(rdata, (uint16_t) ds->keytag);
+         dns_buf_append(rdata, " ", 1);
+         dns_buf_append_uint(rdata, ds->digest_type);
+         dns_buf_append(rdata, " <key>", 6);
       }
       break;
    case DNS_TYPE_RRSIG:
       {
          struct dns_rrsig *rrsig = (struct dns_rrsig *) data;
-         string tmp = "";
          DEBUG_MSG("\tData RRSIG:\n");
          DEBUG_MSG("\t\tType:\t\t%u\n",         ntohs(rrsig->type));
          DEBUG_MSG("\t\tAlgorithm:\t%u\n",      rrsig->algorithm);
@@ -424,13 +403,26 @@ void DNSPlugin::process_rdata(const char *record_begin, const char *data, ostrin
          DEBUG_MSG("\t\tSig expiration:\t%u\n", ntohl(rrsig->sig_expiration));
          DEBUG_MSG("\t\tSig inception:\t%u\n",  ntohl(rrsig->sig_inception));
          DEBUG_MSG("\t\tKey tag:\t%u\n",        ntohs(rrsig->keytag));
-         rdata << ntohs(rrsig->type) << " " << (uint16_t) rrsig->algorithm << " " // Conversion needed, otherwise uint8_t will be threated as a char.
-               << (uint16_t) rrsig->labels << " " << ntohl(rrsig->ttl) << " "
-               << ntohl(rrsig->sig_expiration) << " " << ntohl(rrsig->sig_inception)
-               << " " << ntohs(rrsig->keytag) << " <key>";
-
-         tmp = get_name(data + 18);
-         DEBUG_MSG("\t\tSigner's name:\t%s\n",  tmp.c_str());
+         dns_buf_append_uint(rdata, ntohs(rrsig->type));
+         dns_buf_append(rdata, " ", 1);
+         dns_buf_append_uint(rdata, rrsig->algorithm);
+         dns_buf_append(rdata, " ", 1);
+         dns_buf_append_uint(rdata, rrsig->labels);
+         dns_buf_append(rdata, " ", 1);
+         dns_buf_append_uint(rdata, ntohl(rrsig->ttl));
+         dns_buf_append(rdata, " ", 1);
+         dns_buf_append_uint(rdata, ntohl(rrsig->sig_expiration));
+         dns_buf_append(rdata, " ", 1);
+         dns_buf_append_uint(rdata, ntohl(rrsig->sig_inception));
+         dns_buf_append(rdata, " ", 1);
+         dns_buf_append_uint(rdata, ntohs(rrsig->keytag));
+         dns_buf_append(rdata, " <key>", 6);
+
+         /* Signer's name is not exported, but it must be valid. */
+         char signer[DNS_NAME_BUF_SIZE];
+         uint32_t signer_len;
+         ret = dns_decode_name(data_begin, data_len, data + 18, signer, sizeof(signer), signer_len);
+         DEBUG_MSG("\t\tSigner's name:\t%s\n",  signer);
          DEBUG_MSG("\t\tSignature:\t(binary)\n");
       }
       break;
@@ -442,15 +434,22 @@ void DNSPlugin::process_rdata(const char *record_begin, const char *data, ostrin
          DEBUG_MSG("\t\tProtocol:\t%u\n",       dnskey->protocol);
          DEBUG_MSG("\t\tAlgorithm:\t%u\n",      dnskey->algorithm);
 
-         rdata << ntohs(dnskey->flags) << " " << (uint16_t) dnskey->protocol << " " << (uint16_t) dnskey->algorithm << " <key>";
+         dns_buf_append_uint(rdata, ntohs(dnskey->flags));
+         dns_buf_append(rdata, " ", 1);
+         dns_buf_append_uint(rdata, dnskey->protocol);
+         dns_buf_append(rdata, " ", 1);
+         dns_buf_append_uint(rdata, dnskey->algorithm);
+         dns_buf_append(rdata, " <key>", 6);
          DEBUG_MSG("\t\tPublic key:\t(binary data)\n");
       }
       break;
    default:
       DEBUG_MSG("\tData:\t\t\t(format not supported yet)\n");
-      rdata << "(not_impl)";
+      dns_buf_append(rdata, "(not_impl)", 10);
       break;
    }
+
+   return ret;
 }
 
 #ifdef DEBUG_DNS
@@ -468,229 +467,251 @@ uint32_t s_responses = 0;
  */
 bool DNSPlugin::parse_dns(const char *data, unsigned int payload_len, bool tcp, RecordExtDNS *rec)
 {
-   try {
-      total++;
+   char name[sizeof(rec->qname)];
+   uint32_t name_len;
 
-      DEBUG_MSG("---------- dns parser #%u ----------\n", total);
-      DEBUG_MSG("Payload length: %u\n", payload_len);
+   total++;
 
-      if (tcp) {
-         payload_len -= 2;
-         if (ntohs(*(uint16_t *) data) != payload_len) {
-            DEBUG_MSG("parser quits: fragmented tcp pkt");
-            return false;
-         }
-         data += 2;
+   DEBUG_MSG("---------- dns parser #%u ----------\n", total);
+   DEBUG_MSG("Payload length: %u\n", payload_len);
+
+   if (tcp) {
+      payload_len -= 2;
+      if (ntohs(*(uint16_t *) data) != payload_len) {
+         DEBUG_MSG("parser quits: fragmented tcp pkt");
+         return false;
+      }
+      data += 2;
+   }
+
+   if (payload_len < sizeof(struct dns_hdr)) {
+      DEBUG_MSG("parser quits: payload length < %ld\n", sizeof(struct dns_hdr));
+      return false;
+   }
+
+   data_begin = data;
+   data_len = payload_len;
+
+   struct dns_hdr *dns = (struct dns_hdr *) data;
+   uint16_t flags = ntohs(dns->flags);
+   uint16_t question_cnt = ntohs(dns->question_rec_cnt);
+   uint16_t answer_rr_cnt = ntohs(dns->answer_rec_cnt);
+   uint16_t authority_rr_cnt = ntohs(dns->name_server_rec_cnt);
+   uint16_t additional_rr_cnt = ntohs(dns->additional_rec_cnt);
+
+   rec->answers = answer_rr_cnt;
+   rec->id = ntohs(dns->id);
+   rec->rcode = DNS_HDR_GET_RESPCODE(flags);
+
+   DEBUG_MSG("%s number: %u\n",                    DNS_HDR_GET_QR(flags) ? "Response" : "Query",
+                                                   DNS_HDR_GET_QR(flags) ? s_queries++ : s_responses++);
+   DEBUG_MSG("DNS message header\n");
+   DEBUG_MSG("\tTransaction ID:\t\t%#06x\n",       ntohs(dns->id));
+   DEBUG_MSG("\tFlags:\t\t\t%#06x\n",              ntohs(dns->flags));
+
+   DEBUG_MSG("\t\tQuestion/reply:\t\t%u\n",        DNS_HDR_GET_QR(flags));
+   DEBUG_MSG("\t\tOP code:\t\t%u\n",               DNS_HDR_GET_OPCODE(flags));
+   DEBUG_MSG("\t\tAuthoritative answer:\t%u\n",    DNS_HDR_GET_AA(flags));
+   DEBUG_MSG("\t\tTruncation:\t\t%u\n",            DNS_HDR_GET_TC(flags));
+   DEBUG_MSG("\t\tRecursion desired:\t%u\n",       DNS_HDR_GET_RD(flags));
+   DEBUG_MSG("\t\tRecursion available:\t%u\n",     DNS_HDR_GET_RA(flags));
+   DEBUG_MSG("\t\tReserved:\t\t%u\n",              DNS_HDR_GET_Z(flags));
+   DEBUG_MSG("\t\tAuth data:\t\t%u\n",             DNS_HDR_GET_AD(flags));
+   DEBUG_MSG("\t\tChecking disabled:\t%u\n",       DNS_HDR_GET_CD(flags));
+   DEBUG_MSG("\t\tResponse code:\t\t%u\n",         DNS_HDR_GET_RESPCODE(flags));
+
+   DEBUG_MSG("\tQuestions:\t\t%u\n",               question_cnt);
+   DEBUG_MSG("\tAnswer RRs:\t\t%u\n",              answer_rr_cnt);
+   DEBUG_MSG("\tAuthority RRs:\t\t%u\n",           authority_rr_cnt);
+   DEBUG_MSG("\tAdditional RRs:\t\t%u\n",          additional_rr_cnt);
+
+   /********************************************************************
+   *****                   DNS Question section                    *****
+   ********************************************************************/
+   data += sizeof(struct dns_hdr);
+   for (int i = 0; i < question_cnt; i++) {
+      DEBUG_MSG("\nDNS question #%d\n",            i + 1);
+      if (dns_decode_name(data_begin, data_len, data, name, sizeof(name), name_len) != DNS_OK) {
+         DEBUG_MSG("DNS parser quits: malformed name\n\n");
+         return false;
       }
+      DEBUG_MSG("\tName:\t\t\t%s\n",               name);
 
-      if (payload_len < sizeof(struct dns_hdr)) {
-         DEBUG_MSG("parser quits: payload length < %ld\n", sizeof(struct dns_hdr));
+      uint32_t skip;
+      if (dns_name_length(data_begin, data_len, data, skip) != DNS_OK) {
+         DEBUG_MSG("DNS parser quits: overflow\n\n");
          return false;
       }
+      data += skip;
+      struct dns_question *question = (struct dns_question *) data;
 
-      data_begin = data;
-      data_len = payload_len;
-
-      struct dns_hdr *dns = (struct dns_hdr *) data;
-      uint16_t flags = ntohs(dns->flags);
-      uint16_t question_cnt = ntohs(dns->question_rec_cnt);
-      uint16_t answer_rr_cnt = ntohs(dns->answer_rec_cnt);
-      uint16_t authority_rr_cnt = ntohs(dns->name_server_rec_cnt);
-      uint16_t additional_rr_cnt = ntohs(dns->additional_rec_cnt);
-
-      rec->answers = answer_rr_cnt;
-      rec->id = ntohs(dns->id);
-      rec->rcode = DNS_HDR_GET_RESPCODE(flags);
-
-      DEBUG_MSG("%s number: %u\n",                    DNS_HDR_GET_QR(flags) ? "Response" : "Query",
-                                                      DNS_HDR_GET_QR(flags) ? s_queries++ : s_responses++);
-      DEBUG_MSG("DNS message header\n");
-      DEBUG_MSG("\tTransaction ID:\t\t%#06x\n",       ntohs(dns->id));
-      DEBUG_MSG("\tFlags:\t\t\t%#06x\n",              ntohs(dns->flags));
-
-      DEBUG_MSG("\t\tQuestion/reply:\t\t%u\n",        DNS_HDR_GET_QR(flags));
-      DEBUG_MSG("\t\tOP code:\t\t%u\n",               DNS_HDR_GET_OPCODE(flags));
-      DEBUG_MSG("\t\tAuthoritative answer:\t%u\n",    DNS_HDR_GET_AA(flags));
-      DEBUG_MSG("\t\tTruncation:\t\t%u\n",            DNS_HDR_GET_TC(flags));
-      DEBUG_MSG("\t\tRecursion desired:\t%u\n",       DNS_HDR_GET_RD(flags));
-      DEBUG_MSG("\t\tRecursion available:\t%u\n",     DNS_HDR_GET_RA(flags));
-      DEBUG_MSG("\t\tReserved:\t\t%u\n",              DNS_HDR_GET_Z(flags));
-      DEBUG_MSG("\t\tAuth data:\t\t%u\n",             DNS_HDR_GET_AD(flags));
-      DEBUG_MSG("\t\tChecking disabled:\t%u\n",       DNS_HDR_GET_CD(flags));
-      DEBUG_MSG("\t\tResponse code:\t\t%u\n",         DNS_HDR_GET_RESPCODE(flags));
-
-      DEBUG_MSG("\tQuestions:\t\t%u\n",               question_cnt);
-      DEBUG_MSG("\tAnswer RRs:\t\t%u\n",              answer_rr_cnt);
-      DEBUG_MSG("\tAuthority RRs:\t\t%u\n",           authority_rr_cnt);
-      DEBUG_MSG("\tAdditional RRs:\t\t%u\n",          additional_rr_cnt);
-
-      /********************************************************************
-      *****                   DNS Question section                    *****
-      ********************************************************************/
-      data += sizeof(struct dns_hdr);
-      for (int i = 0; i < question_cnt; i++) {
-         DEBUG_MSG("\nDNS question #%d\n",            i + 1);
-         string name = get_name(data);
-         DEBUG_MSG("\tName:\t\t\t%s\n",               name.c_str());
-
-         data += get_name_length(data);
-         struct dns_question *question = (struct dns_question *) data;
-
-         if ((data - data_begin) + sizeof(struct dns_question) > payload_len) {
-            DEBUG_MSG("DNS parser quits: overflow\n\n");
-            return 1;
-         }
+      if ((data - data_begin) + sizeof(struct dns_question) > payload_len) {
+         DEBUG_MSG("DNS parser quits: overflow\n\n");
+         return 1;
+      }
 
-         if (i == 0) { // Copy only first question.
-            rec->qtype = ntohs(question->qtype);
-            rec->qclass = ntohs(question->qclass);
+      if (i == 0) { // Copy only first question.
+         rec->qtype = ntohs(question->qtype);
+         rec->qclass = ntohs(question->qclass);
 
-            size_t length = name.length();
-            if (length >= sizeof(rec->qname)) {
-               DEBUG_MSG("Truncating qname (length = %lu) to %lu.\n", length, sizeof(rec->qname) - 1);
-               length = sizeof(rec->qname) - 1;
-            }
-            memcpy(rec->qname, name.c_str(), length);
-            rec->qname[length] = 0;
+         if (name_len >= sizeof(rec->qname)) {
+            DEBUG_MSG("Truncating qname (length = %u) to %lu.\n", name_len, sizeof(rec->qname) - 1);
+            name_len = sizeof(rec->qname) - 1;
          }
-         DEBUG_MSG("\tType:\t\t\t%u\n",               ntohs(question->qtype));
-         DEBUG_MSG("\tClass:\t\t\t%u\n",              ntohs(question->qclass));
-         data += sizeof(struct dns_question);
+         memcpy(rec->qname, name, name_len);
+         rec->qname[name_len] = 0;
       }
+      DEBUG_MSG("\tType:\t\t\t%u\n",               ntohs(question->qtype));
+      DEBUG_MSG("\tClass:\t\t\t%u\n",              ntohs(question->qclass));
+      data += sizeof(struct dns_question);
+   }
 
-      /********************************************************************
-      *****                    DNS Answers section                    *****
-      ********************************************************************/
-      const char *record_begin;
-      size_t rdlength;
-      ostringstream rdata;
-      for (int i = 0; i < answer_rr_cnt; i++) { // Process answers section.
-         record_begin = data;
-
-         DEBUG_MSG("DNS answer #%d\n", i + 1);
-         DEBUG_MSG("\tAnswer name:\t\t%s\n",          get_name(data).c_str());
-         data += get_name_length(data);
-
-         struct dns_answer *answer = (struct dns_answer *) data;
-
-         uint32_t tmp = (data - data_begin) + sizeof(dns_answer);
-         if (tmp > payload_len || tmp + ntohs(answer->rdlength) > payload_len) {
-            DEBUG_MSG("DNS parser quits: overflow\n\n");
-            return 1;
-         }
+   /********************************************************************
+   *****                    DNS Answers section                    *****
+   ********************************************************************/
+   const char *record_begin;
+   size_t rdlength;
+   DEBUG_CODE(char rdata_str[sizeof(rec->data)]);
+   for (int i = 0; i < answer_rr_cnt; i++) { // Process answers section.
+      record_begin = data;
+
+      DEBUG_MSG("DNS answer #%d\n", i + 1);
+      DEBUG_CODE(dns_decode_name(data_begin, data_len, data, name, sizeof(name), name_len));
+      DEBUG_MSG("\tAnswer name:\t\t%s\n",          name);
+      if (dns_name_length(data_begin, data_len, data, name_len) != DNS_OK) {
+         DEBUG_MSG("DNS parser quits: overflow\n\n");
+         return false;
+      }
+      data += name_len;
 
-         DEBUG_MSG("\tType:\t\t\t%u\n",               ntohs(answer->atype));
-         DEBUG_MSG("\tClass:\t\t\t%u\n",              ntohs(answer->aclass));
-         DEBUG_MSG("\tTTL:\t\t\t%u\n",                ntohl(answer->ttl));
-         DEBUG_MSG("\tRD length:\t\t%u\n",            ntohs(answer->rdlength));
+      struct dns_answer *answer = (struct dns_answer *) data;
 
-         data += sizeof(struct dns_answer);
-         rdlength = ntohs(answer->rdlength);
+      uint32_t tmp = (data - data_begin) + sizeof(dns_answer);
+      if (tmp > payload_len || tmp + ntohs(answer->rdlength) > payload_len) {
+         DEBUG_MSG("DNS parser quits: overflow\n\n");
+         return 1;
+      }
 
-         if (i == 0) { // Copy only first answer.
-            process_rdata(record_begin, data, rdata, ntohs(answer->atype), rdlength);
-            rec->rr_ttl = ntohl(answer->ttl);
+      DEBUG_MSG("\tType:\t\t\t%u\n",               ntohs(answer->atype));
+      DEBUG_MSG("\tClass:\t\t\t%u\n",              ntohs(answer->aclass));
+      DEBUG_MSG("\tTTL:\t\t\t%u\n",                ntohl(answer->ttl));
+      DEBUG_MSG("\tRD length:\t\t%u\n",            ntohs(answer->rdlength));
 
-            size_t length = rdata.str().length();
-            if (length >= sizeof(rec->data)) {
-               DEBUG_MSG("Truncating rdata (length = %lu) to %lu.\n", length, sizeof(rec->data) - 1);
-               length = sizeof(rec->data) - 1;
-            }
-            memcpy(rec->data, rdata.str().c_str(), length); // Copy processed rdata.
-            rec->data[length] = 0; // Add terminating '\0' char.
-            rec->rlength = length; // Report length.
-         }
-         data += rdlength;
-      }
+      data += sizeof(struct dns_answer);
+      rdlength = ntohs(answer->rdlength);
 
-      /********************************************************************
-      *****                 DNS Authority RRs section                 *****
-      ********************************************************************/
+      if (i == 0) { // Copy only first answer.
+         char rdata_tmp[sizeof(rec->data)];
+         dns_buf rdata(rdata_tmp, sizeof(rdata_tmp));
 
-      for (int i = 0; i < authority_rr_cnt; i++) { // Unused yet.
-         record_begin = data;
+         if (process_rdata(record_begin, data, rdata, ntohs(answer->atype), rdlength) != DNS_OK) {
+            DEBUG_MSG("DNS parser quits: malformed rdata\n\n");
+            return false;
+         }
+         rec->rr_ttl = ntohl(answer->ttl);
 
-         DEBUG_MSG("DNS authority RR #%d\n", i + 1);
-         DEBUG_MSG("\tAnswer name:\t\t%s\n",          get_name(data).c_str());
-         data += get_name_length(data);
+         memcpy(rec->data, rdata.data, rdata.len + 1); // Copy processed rdata with terminating '\0' char.
+         rec->rlength = rdata.len; // Report length.
+      }
+      data += rdlength;
+   }
 
-         struct dns_answer *answer = (struct dns_answer *) data;
+   /********************************************************************
+   *****                 DNS Authority RRs section                 *****
+   ********************************************************************/
 
-         uint32_t tmp = (data - data_begin) + sizeof(dns_answer);
-         if (tmp > payload_len || tmp + ntohs(answer->rdlength) > payload_len) {
-            DEBUG_MSG("DNS parser quits: overflow\n\n");
-            return 1;
-         }
+   for (int i = 0; i < authority_rr_cnt; i++) { // Unused yet.
+      record_begin = data;
 
-         DEBUG_MSG("\tType:\t\t\t%u\n",               ntohs(answer->atype));
-         DEBUG_MSG("\tClass:\t\t\t%u\n",              ntohs(answer->aclass));
-         DEBUG_MSG("\tTTL:\t\t\t%u\n",                ntohl(answer->ttl));
-         DEBUG_MSG("\tRD length:\t\t%u\n",            ntohs(answer->rdlength));
+      DEBUG_MSG("DNS authority RR #%d\n", i + 1);
+      DEBUG_CODE(dns_decode_name(data_begin, data_len, data, name, sizeof(name), name_len));
+      DEBUG_MSG("\tAnswer name:\t\t%s\n",          name);
+      if (dns_name_length(data_begin, data_len, data, name_len) != DNS_OK) {
+         DEBUG_MSG("DNS parser quits: overflow\n\n");
+         return false;
+      }
+      data += name_len;
 
-         data += sizeof(struct dns_answer);
-         rdlength = ntohs(answer->rdlength);
-         DEBUG_CODE(process_rdata(record_begin, data, rdata, ntohs(answer->atype), rdlength));
+      struct dns_answer *answer = (struct dns_answer *) data;
 
-         data += rdlength;
+      uint32_t tmp = (data - data_begin) + sizeof(dns_answer);
+      if (tmp > payload_len || tmp + ntohs(answer->rdlength) > payload_len) {
+         DEBUG_MSG("DNS parser quits: overflow\n\n");
+         return 1;
       }
 
-      /********************************************************************
-      *****                 DNS Additional RRs section                *****
-      ********************************************************************/
-      for (int i = 0; i < additional_rr_cnt; i++) { // Unused yet.
-         record_begin = data;
+      DEBUG_MSG("\tType:\t\t\t%u\n",               ntohs(answer->atype));
+      DEBUG_MSG("\tClass:\t\t\t%u\n",              ntohs(answer->aclass));
+      DEBUG_MSG("\tTTL:\t\t\t%u\n",                ntohl(answer->ttl));
+      DEBUG_MSG("\tRD length:\t\t%u\n",            ntohs(answer->rdlength));
 
-         DEBUG_MSG("DNS additional RR #%d\n", i + 1);
-         DEBUG_MSG("\tAnswer name:\t\t%s\n",          get_name(data).c_str());
-         data += get_name_length(data);
+      data += sizeof(struct dns_answer);
+      rdlength = ntohs(answer->rdlength);
+      DEBUG_CODE(dns_buf rdata(rdata_str, sizeof(rdata_str)));
+      DEBUG_CODE(process_rdata(record_begin, data, rdata, ntohs(answer->atype), rdlength));
 
-         struct dns_answer *answer = (struct dns_answer *) data;
+      data += rdlength;
+   }
 
-         uint32_t tmp = (data - data_begin) + sizeof(dns_answer);
-         if (tmp > payload_len || tmp + ntohs(answer->rdlength) > payload_len) {
-            DEBUG_MSG("DNS parser quits: overflow\n\n");
-            return 1;
-         }
+   /********************************************************************
+   *****                 DNS Additional RRs section                *****
+   ********************************************************************/
+   for (int i = 0; i < additional_rr_cnt; i++) { // Unused yet.
+      record_begin = data;
+
+      DEBUG_MSG("DNS additional RR #%d\n", i + 1);
+      DEBUG_CODE(dns_decode_name(data_begin, data_len, data, name, sizeof(name), name_len));
+      DEBUG_MSG("\tAnswer name:\t\t%s\n",          name);
+      if (dns_name_length(data_begin, data_len, data, name_len) != DNS_OK) {
+         DEBUG_MSG("DNS parser quits: overflow\n\n");
+         return false;
+      }
+      data += name_len;
 
-         DEBUG_MSG("\tType:\t\t\t%u\n",               ntohs(answer->atype));
-         if (ntohs(answer->atype) != DNS_TYPE_OPT) {
-            DEBUG_MSG("\tClass:\t\t\t%u\n",           ntohs(answer->aclass));
-            DEBUG_MSG("\tTTL:\t\t\t%u\n",             ntohl(answer->ttl));
-            DEBUG_MSG("\tRD length:\t\t%u\n",         ntohs(answer->rdlength));
-
-            data += sizeof(struct dns_answer);
-            rdlength = ntohs(answer->rdlength);
-            DEBUG_CODE(process_rdata(record_begin, data, rdata, ntohs(answer->atype), rdlength));
-         } else { // Process OPT record.
-            DEBUG_MSG("\tReq UDP payload:\t%u\n",     ntohs(answer->aclass));
-            DEBUG_CODE(uint32_t ttl = ntohl(answer->ttl));
-            DEBUG_MSG("\tExtended RCODE:\t\t%#x\n",   (ttl & 0xFF000000) >> 24);
-            DEBUG_MSG("\tVersion:\t\t%#x\n",          (ttl & 0x00FF0000) >> 16);
-            DEBUG_MSG("\tDO bit:\t\t\t%u\n",          ((ttl & 0x8000) >> 15));
-            DEBUG_MSG("\tReserved:\t\t%u\n",          (ttl & 0x7FFF));
-            DEBUG_MSG("\tRD length:\t\t%u\n",         ntohs(answer->rdlength));
-
-            data += sizeof(struct dns_answer);
-            rdlength = ntohs(answer->rdlength);
-            rec->psize = ntohs(answer->aclass); // Copy requested UDP payload size. RFC 6891
-            rec->dns_do = ((ntohl(answer->ttl) & 0x8000) >> 15); // Copy DO bit.
-         }
+      struct dns_answer *answer = (struct dns_answer *) data;
 
-         data += rdlength;
+      uint32_t tmp = (data - data_begin) + sizeof(dns_answer);
+      if (tmp > payload_len || tmp + ntohs(answer->rdlength) > payload_len) {
+         DEBUG_MSG("DNS parser quits: overflow\n\n");
+         return 1;
       }
 
-      if (DNS_HDR_GET_QR(flags)) {
-         responses++;
-      } else {
-         queries++;
+      DEBUG_MSG("\tType:\t\t\t%u\n",               ntohs(answer->atype));
+      if (ntohs(answer->atype) != DNS_TYPE_OPT) {
+         DEBUG_MSG("\tClass:\t\t\t%u\n",           ntohs(answer->aclass));
+         DEBUG_MSG("\tTTL:\t\t\t%u\n",             ntohl(answer->ttl));
+         DEBUG_MSG("\tRD length:\t\t%u\n",         ntohs(answer->rdlength));
+
+         data += sizeof(struct dns_answer);
+         rdlength = ntohs(answer->rdlength);
+         DEBUG_CODE(dns_buf rdata(rdata_str, sizeof(rdata_str)));
+         DEBUG_CODE(process_rdata(record_begin, data, rdata, ntohs(answer->atype), rdlength));
+      } else { // Process OPT record.
+         DEBUG_MSG("\tReq UDP payload:\t%u\n",     ntohs(answer->aclass));
+         DEBUG_CODE(uint32_t ttl = ntohl(answer->ttl));
+         DEBUG_MSG("\tExtended RCODE:\t\t%#x\n",   (ttl & 0xFF000000) >> 24);
+         DEBUG_MSG("\tVersion:\t\t%#x\n",          (ttl & 0x00FF0000) >> 16);
+         DEBUG_MSG("\tDO bit:\t\t\t%u\n",          ((ttl & 0x8000) >> 15));
+         DEBUG_MSG("\tReserved:\t\t%u\n",          (ttl & 0x7FFF));
+         DEBUG_MSG("\tRD length:\t\t%u\n",         ntohs(answer->rdlength));
+
+         data += sizeof(struct dns_answer);
+         rdlength = ntohs(answer->rdlength);
+         rec->psize = ntohs(answer->aclass); // Copy requested UDP payload size. RFC 6891
+         rec->dns_do = ((ntohl(answer->ttl) & 0x8000) >> 15); // Copy DO bit.
       }
 
-      DEBUG_MSG("DNS parser quits: parsing done\n\n");
-   } catch (const char *err) {
-      DEBUG_MSG("%s\n", err);
-      return false;
+      data += rdlength;
    }
 
+   if (DNS_HDR_GET_QR(flags)) {
+      responses++;
+   } else {
+      queries++;
+   }
+
+   DEBUG_MSG("DNS parser quits: parsing done\n\n");
+
    return true;
 }
 
@@ -54,6 +54,7 @@
 #include "packet.h"
 #include "flow_meter.h"
 #include "dns.h"
+#include "dnsparser.h"
 
 using namespace std;
 
@@ -73,6 +74,9 @@ struct RecordExtDNS : RecordExt {
    uint16_t psize;
    uint8_t dns_do;
 
+   RECORD_EXT_POOLED(dns)
+   RECORD_EXT_SERIALIZED(RecordExtDNS, id)
+
    /**
     * \brief Constructor.
     */
@@ -142,17 +146,16 @@ public:
    int post_create(Flow &rec, const Packet &pkt);
    int pre_update(Flow &rec, Packet &pkt);
    void finish();
+   plugin_interest get_interest();
    string get_unirec_field_string();
    const char **get_ipfix_string();
+   RecordExt *deserialize(extTypeEnum type, const uint8_t *data, int size);
 
 private:
    bool parse_dns(const char *data, unsigned int payload_len, bool tcp, RecordExtDNS *rec);
    int  add_ext_dns(const char *data, unsigned int payload_len, bool tcp, Flow &rec);
-   void process_srv(string &str) const;
-   void process_rdata(const char *record_begin, const char *data, ostringstream &rdata, uint16_t type, size_t length) const;
-
-   string get_name(const char *data) const;
-   size_t get_name_length(const char *data) const;
+   void process_srv(char *str, uint32_t &len) const;
+   int  process_rdata(const char *record_begin, const char *data, dns_buf &rdata, uint16_t type, size_t length) const;
 
    bool print_stats;       /**< Indicator whether to print stats when flow cache is finishing or not. */
    uint32_t queries;       /**< Total number of parsed DNS queries. */
@@ -51,19 +51,29 @@
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <cerrno>
 #include <signal.h>
 #include <stdlib.h>
+#include <unistd.h>
+#include <sys/time.h>
 
 #include "flow_meter.h"
 #include "packet.h"
 #include "flowifc.h"
 #include "pcapreader.h"
+#include "afpacketreader.h"
 #include "nhtflowcache.h"
+#include "tcpreassembler.h"
+#include "shardedcache.h"
+#include "flowhash.h"
 #include "unirecexporter.h"
 #include "ipfixexporter.h"
+#include "asyncexporter.h"
+#include "sampler.h"
 #include "stats.h"
 #include "fields.h"
 #include "conversion.h"
+#include "checkpoint.h"
 
 #include "httpplugin.h"
 #include "httpsplugin.h"
@@ -73,11 +83,13 @@
 #include "arpplugin.h"
 #include "passivednsplugin.h"
 #include "smtpplugin.h"
+#include "tunnelplugin.h"
 
 using namespace std;
 
 trap_module_info_t *module_info = NULL;
 static int stop = 0;
+static int checkpoint_req = 0; /**< Save checkpoint of flow cache, requested by SIGUSR1. */
 
 #define MODULE_BASIC_INFO(BASIC) \
   BASIC("flow_meter", "Convert packets from PCAP file or network interface into flow records.", 0, -1)
@@ -85,7 +97,7 @@ static int stop = 0;
 #define MODULE_PARAMS(PARAM) \
   PARAM('p', "plugins", "Activate specified parsing plugins. Output interface for each plugin correspond the order which you specify items in -i and -p param. "\
   "For example: \'-i u:a,u:b,u:c -p http,basic,dns\' http traffic will be send to interface u:a, basic flow to u:b etc. If you don't specify -p parameter, flow meter"\
-  " will require one output interface for basic flow by default. Format: plugin_name[,...] Supported plugins: http,https,dns,sip,ntp,smtp,basic,arp,passivedns", required_argument, "string")\
+  " will require one output interface for basic flow by default. Format: plugin_name[,...] Supported plugins: http,https,dns,sip,ntp,smtp,basic,arp,passivedns,tunnel", required_argument, "string")\
   PARAM('c', "count", "Quit after number of packets are captured.", required_argument, "uint32")\
   PARAM('I', "interface", "Capture from given network interface. Parameter require interface name (eth0 for example).", required_argument, "string")\
   PARAM('r', "file", "Pcap file to read. - to read from stdin.", required_argument, "string") \
@@ -100,7 +112,38 @@ static int stop = 0;
   PARAM('F', "filter", "String containing filter expression to filter traffic. See man pcap-filter.", required_argument, "string") \
   PARAM('O', "odid", "Send ODID field instead of LINK_BIT_FIELD in unirec message.", no_argument, "none") \
   PARAM('x', "ipfix", "Export to IPFIX collector. Format: HOST:PORT or [HOST]:PORT", required_argument, "string") \
-  PARAM('u', "udp", "Use UDP when exporting to IPFIX collector.", no_argument, "none")
+  PARAM('u', "udp", "Use UDP when exporting to IPFIX collector.", no_argument, "none") \
+  PARAM('w', "workers", "Number of flow cache worker threads. Packets are distributed to workers by symmetric hash of flow key, each worker owns part of flow cache and its own plugin instances. Default 0 processes packets in capture thread.", required_argument, "uint32") \
+  PARAM('H', "hash", "Hash function used by flow cache: xxhash (default) or crc32c. CRC32C is computed by SSE4.2 instruction when supported by CPU.", required_argument, "string") \
+  PARAM('A', "afpacket", "Capture from interface (-I) using AF_PACKET TPACKET_V3 ring instead of libpcap. Format: BLOCK_SIZE:BLOCK_COUNT[:FANOUT_GROUP] or default (1048576:64). "\
+  "Block size must be power of two multiple of page size. Instances with the same FANOUT_GROUP (0-65535) share traffic of interface, packets of a flow go to the same instance.", required_argument, "string") \
+  PARAM('b', "biflow", "Aggregate both directions of communication into one flow record. Counters of dst->src direction are exported in *_REV fields (IPFIX reverse elements, RFC 5103).", no_argument, "none") \
+  PARAM('e', "export-queue", "Export flows from separate thread. Flow cache passes expired flows to exporter thread through queue of given number of records (rounded up to power of two). "\
+  "Default 0 exports flows in flow cache thread.", required_argument, "uint32") \
+  PARAM('m', "ipfix-msg-size", "Maximal size of IPFIX message in bytes (1458-65535). More data sets are packed into one message and up to 16 messages are sent by one syscall. "\
+  "Use values above 1458 with UDP only when path MTU allows. Default 1458.", required_argument, "uint16") \
+  PARAM('R', "tcp-reassembly", "Reassemble beginning of TCP streams for plugins which parse data spanning more segments (https). Format: FLOW_LIMIT[:TOTAL_LIMIT] or default (16384:67108864). "\
+  "Limits are sizes of buffers of one flow and of whole flow cache (of each worker) in bytes.", required_argument, "string") \
+  PARAM('f', "fragments", "Tracking of IP fragments, non-first fragments get ports of first fragment of datagram. Format: ENTRIES[:TIMEOUT][:reassembly], default (1024:3) or off. "\
+  "ENTRIES is size of fragment table, TIMEOUT is time in seconds datagram is tracked. With reassembly UDP datagrams up to 1600 bytes are reassembled for plugins.", required_argument, "string") \
+  PARAM('T', "tunnels", "Decapsulate tunnels, flows are created from innermost packet. Format: TYPE[,TYPE...][:DEPTH], TYPE is gre, vxlan, gtp, ipip or all. "\
+  "DEPTH is max number of nested tunnels (1-8), default 2. Use tunnel plugin to export tunnel endpoints and GRE key, VNI or TEID.", required_argument, "string") \
+  PARAM('N', "sampling", "Sample packets before flow cache. Format: [count:]N processes every N-th packet, flow:N processes all packets of 1 in N flows (by hash of flow key), "\
+  "adaptive[:MAX[:EVICT_RATE[:BACKLOG]]] doubles flow sampling interval up to MAX (power of two, default 64) when flow cache evicts more than EVICT_RATE flows/s (default 10000) "\
+  "or export queue (-e) is more than BACKLOG percent full (default 50) and lowers it when load drops. Interval is exported in SAMPLING_INTERVAL field.", required_argument, "string") \
+  PARAM('E', "eviction", "Policy choosing flow exported when flow cache line is full: lru (default) exports least recently used flow, size exports flow with fewest packets "\
+  "from less recently used half of line, victim[:SIZE] moves least recently used flow to victim area where it can be found again. SIZE is exponent like in -s, "\
+  "default is 1/16 of flow cache.", required_argument, "string") \
+  PARAM('B', "inspect-limit", "Pass only first N packets of each flow to plugins, later packets only update flow counters. "\
+  "Plugins also stop inspecting flow by themselves once they extracted what they export. Default 0 does not limit number of packets.", required_argument, "uint32") \
+  PARAM('k', "tcp-close", "Export TCP flow LINGER seconds after its connection was closed by FIN in both directions (in its direction without -b) or RST "\
+  "instead of waiting for inactive timeout. New connection with the same flow key starts new flow. Reason of export is sent in FLOW_END_REASON field.", required_argument, "uint32") \
+  PARAM('g', "hugepages", "Back flow cache by huge pages and bind it to NUMA node. Format: PAGES[:NODE], PAGES is 1g, 2m, thp or off. "\
+  "Missing 1 GiB pages fall back to 2 MiB pages and those to transparent huge pages. Default NODE is node of capture thread. "\
+  "Achieved page size is printed at startup.", required_argument, "string") \
+  PARAM('C', "checkpoint", "Save flows of flow cache into FILE instead of exporting them when flow_meter stops. "\
+  "Flows saved in FILE are loaded at startup and continue, FILE is removed once it is loaded. SIGUSR1 saves snapshot of flow cache "\
+  "into FILE for recovery after crash, flows are still exported, those exported after the snapshot are exported again when it is loaded.", required_argument, "string")
 
 /**
  * \brief Parse input plugin settings.
@@ -167,6 +210,11 @@ int parse_plugin_settings(const string &settings, vector<FlowCachePlugin *> &plu
          tmp.push_back(plugin_opt("passivedns", passivedns, ifc_num++));
 
          plugins.push_back(new PassiveDNSPlugin(module_options, tmp));
+      } else if (proto == "tunnel"){
+         vector<plugin_opt> tmp;
+         tmp.push_back(plugin_opt("tunnel", tunnel, ifc_num++));
+
+         plugins.push_back(new TunnelPlugin(module_options, tmp));
       } else {
          fprintf(stderr, "Unsupported plugin: \"%s\"\n", proto.c_str());
          return -1;
@@ -204,6 +252,272 @@ int count_trap_interfaces(int argc, char *argv[])
    return ifc_cnt;
 }
 
+/**
+ * \brief Parse AF_PACKET ring settings.
+ * \param [in] str Settings in format BLOCK_SIZE:BLOCK_COUNT[:FANOUT_GROUP] or default.
+ * \param [out] options Options where settings are stored.
+ * \return True on success.
+ */
+bool parse_afpacket_settings(char *str, options_t &options)
+{
+   options.afpacket = true;
+   if (!strcmp(str, "default")) {
+      return true;
+   }
+
+   char *cnt_str = strchr(str, ':');
+   if (cnt_str == NULL) {
+      return false;
+   }
+   *(cnt_str++) = 0;
+
+   char *fanout_str = strchr(cnt_str, ':');
+   if (fanout_str != NULL) {
+      uint32_t fanout;
+      *(fanout_str++) = 0;
+      if (!str_to_uint32(fanout_str, fanout) || fanout > 0xFFFF) {
+         return false;
+      }
+      options.afpacket_fanout = fanout;
+   }
+
+   uint32_t page_size = sysconf(_SC_PAGESIZE);
+   if (!str_to_uint32(str, options.afpacket_block_size) || !str_to_uint32(cnt_str, options.afpacket_block_cnt) ||
+      options.afpacket_block_size < page_size || options.afpacket_block_size % page_size != 0 ||
+      (options.afpacket_block_size & (options.afpacket_block_size - 1)) != 0 || options.afpacket_block_cnt == 0) {
+      return false;
+   }
+
+   return true;
+}
+
+/**
+ * \brief Parse TCP reassembly settings.
+ * \param [in] str Settings in format FLOW_LIMIT[:TOTAL_LIMIT] or default.
+ * \param [out] options Options where settings are stored.
+ * \return True on success.
+ */
+bool parse_stream_settings(char *str, options_t &options)
+{
+   options.stream_flow_limit = DEFAULT_STREAM_FLOW_LIMIT;
+   if (!strcmp(str, "default")) {
+      return true;
+   }
+
+   char *total_str = strchr(str, ':');
+   if (total_str != NULL) {
+      *(total_str++) = 0;
+      if (!str_to_uint64(total_str, options.stream_total_limit)) {
+         return false;
+      }
+   }
+
+   if (!str_to_uint32(str, options.stream_flow_limit) || options.stream_flow_limit == 0 ||
+      options.stream_flow_limit > options.stream_total_limit) {
+      return false;
+   }
+
+   return true;
+}
+
+/**
+ * \brief Parse IP fragment tracking settings.
+ * \param [in] str Settings in format ENTRIES[:TIMEOUT][:reassembly], default[:reassembly] or off.
+ * \param [out] options Options where settings are stored.
+ * \return True on success.
+ */
+bool parse_frag_settings(char *str, options_t &options)
+{
+   options.frag_entries = DEFAULT_FRAG_ENTRIES;
+   options.frag_timeout = DEFAULT_FRAG_TIMEOUT;
+   options.frag_reassembly = false;
+   if (!strcmp(str, "off")) {
+      options.frag_entries = 0;
+      return true;
+   }
+
+   char *reassembly_str = strstr(str, "reassembly");
+   if (reassembly_str != NULL) {
+      if (strcmp(reassembly_str, "reassembly") || (reassembly_str != str && *(reassembly_str - 1) != ':')) {
+         return false;
+      }
+      options.frag_reassembly = true;
+      if (reassembly_str == str) {
+         return true;
+      }
+      *(reassembly_str - 1) = 0;
+   }
+   if (!strcmp(str, "default")) {
+      return true;
+   }
+
+   char *timeout_str = strchr(str, ':');
+   if (timeout_str != NULL) {
+      *(timeout_str++) = 0;
+      if (!str_to_uint32(timeout_str, options.frag_timeout) || options.frag_timeout == 0) {
+         return false;
+      }
+   }
+
+   if (!str_to_uint32(str, options.frag_entries) || options.frag_entries == 0 || options.frag_entries > MAX_FRAG_ENTRIES) {
+      return false;
+   }
+
+   return true;
+}
+
+/**
+ * \brief Parse tunnel decapsulation settings.
+ * \param [in] str Settings in format TYPE[,TYPE...][:DEPTH].
+ * \param [out] options Options where settings are stored.
+ * \return True on success.
+ */
+bool parse_tunnel_settings(char *str, options_t &options)
+{
+   options.tunnels = 0;
+   options.tunnel_depth = DEFAULT_TUNNEL_DEPTH;
+
+   char *depth_str = strchr(str, ':');
+   if (depth_str != NULL) {
+      uint32_t depth;
+      *(depth_str++) = 0;
+      if (!str_to_uint32(depth_str, depth) || depth == 0 || depth > MAX_TUNNEL_DEPTH) {
+         return false;
+      }
+      options.tunnel_depth = depth;
+   }
+
+   char *type = strtok(str, ",");
+   while (type != NULL) {
+      if (!strcmp(type, "gre")) {
+         options.tunnels |= (1 << TUNNEL_GRE);
+      } else if (!strcmp(type, "vxlan")) {
+         options.tunnels |= (1 << TUNNEL_VXLAN);
+      } else if (!strcmp(type, "gtp")) {
+         options.tunnels |= (1 << TUNNEL_GTPU);
+      } else if (!strcmp(type, "ipip")) {
+         options.tunnels |= (1 << TUNNEL_IPIP);
+      } else if (!strcmp(type, "all")) {
+         options.tunnels |= (1 << TUNNEL_GRE) | (1 << TUNNEL_VXLAN) | (1 << TUNNEL_GTPU) | (1 << TUNNEL_IPIP);
+      } else {
+         return false;
+      }
+      type = strtok(NULL, ",");
+   }
+
+   return options.tunnels != 0;
+}
+
+/**
+ * \brief Parse packet sampling settings.
+ * \param [in] str Settings in format [count:]N, flow:N or adaptive[:MAX[:EVICT_RATE[:BACKLOG]]].
+ * \param [out] options Options where settings are stored.
+ * \return True on success.
+ */
+bool parse_sampling_settings(char *str, options_t &options)
+{
+   options.sampling_mode = SAMPLING_COUNT;
+   options.sampling_interval = 1;
+   options.sampling_max = DEFAULT_SAMPLING_MAX;
+   options.sampling_evict_rate = DEFAULT_SAMPLING_EVICT_RATE;
+   options.sampling_backlog = DEFAULT_SAMPLING_BACKLOG;
+
+   char *mode = strtok(str, ":");
+   if (mode == NULL) {
+      return false;
+   }
+   if (!strcmp(mode, "adaptive")) {
+      uint32_t *params[] = {&options.sampling_max, &options.sampling_evict_rate, &options.sampling_backlog};
+      char *param;
+
+      options.sampling_mode = SAMPLING_ADAPTIVE;
+      for (int i = 0; i < 3 && (param = strtok(NULL, ":")) != NULL; i++) {
+         if (!str_to_uint32(param, *params[i])) {
+            return false;
+         }
+      }
+      return strtok(NULL, ":") == NULL && options.sampling_max > 1 && options.sampling_max <= MAX_SAMPLING_INTERVAL &&
+         (options.sampling_max & (options.sampling_max - 1)) == 0 && options.sampling_evict_rate > 0 &&
+         options.sampling_backlog > 0 && options.sampling_backlog <= 100;
+   }
+
+   char *interval = mode;
+   if (!strcmp(mode, "count") || !strcmp(mode, "flow")) {
+      options.sampling_mode = (mode[0] == 'c' ? SAMPLING_COUNT : SAMPLING_FLOW);
+      interval = strtok(NULL, ":");
+   }
+   return interval != NULL && strtok(NULL, ":") == NULL && str_to_uint32(interval, options.sampling_interval) &&
+      options.sampling_interval > 0 && options.sampling_interval <= MAX_SAMPLING_INTERVAL;
+}
+
+/**
+ * \brief Parse flow cache eviction policy settings.
+ * \param [in] str Settings in format lru, size or victim[:SIZE].
+ * \param [out] options Options where settings are stored.
+ * \return True on success.
+ */
+bool parse_eviction_settings(char *str, options_t &options)
+{
+   options.victim_size = 0;
+   if (!strcmp(str, "lru")) {
+      options.evict_policy = EVICT_LRU;
+      return true;
+   } else if (!strcmp(str, "size")) {
+      options.evict_policy = EVICT_SIZE;
+      return true;
+   } else if (strncmp(str, "victim", 6)) {
+      return false;
+   }
+
+   options.evict_policy = EVICT_VICTIM;
+   if (str[6] == 0) {
+      return true;
+   }
+
+   uint32_t exponent;
+   if (str[6] != ':' || !str_to_uint32(str + 7, exponent) || exponent <= 3 || exponent > 30) {
+      return false;
+   }
+   options.victim_size = 1 << exponent;
+   return true;
+}
+
+/**
+ * \brief Parse flow cache memory settings.
+ * \param [in] str Settings in format PAGES[:NODE], PAGES is 1g, 2m, thp or off.
+ * \param [out] options Options where settings are stored.
+ * \return True on success.
+ */
+bool parse_hugepages_settings(char *str, options_t &options)
+{
+   char *node = strchr(str, ':');
+   if (node != NULL) {
+      *node++ = 0;
+   }
+
+   if (!strcmp(str, "1g")) {
+      options.hugepages = HUGEPAGES_1G;
+   } else if (!strcmp(str, "2m")) {
+      options.hugepages = HUGEPAGES_2M;
+   } else if (!strcmp(str, "thp")) {
+      options.hugepages = HUGEPAGES_THP;
+   } else if (!strcmp(str, "off")) {
+      options.hugepages = HUGEPAGES_OFF;
+   } else {
+      return false;
+   }
+
+   options.numa_node = NUMA_NODE_LOCAL;
+   if (node != NULL) {
+      uint32_t tmp;
+      if (!str_to_uint32(node, tmp) || tmp >= 63) {
+         return false;
+      }
+      options.numa_node = tmp;
+   }
+   return true;
+}
+
 /**
  * \brief Convert double to struct timeval.
  * \param [in] value Value to convert.
@@ -232,7 +546,111 @@ inline bool error(const string &e)
  */
 void signal_handler(int sig)
 {
-   stop = 1;
+   if (sig == SIGUSR1) {
+      checkpoint_req = 1;
+   } else {
+      stop = 1;
+   }
+}
+
+/**
+ * \brief Load flows saved in checkpoint file into flow cache. File is removed once it is loaded,
+ * so that flows are not loaded again after crash.
+ * \param [in,out] flowcache Initialized flow cache.
+ * \param [in] options Module settings.
+ * \param [out] err Error message.
+ * \return True on success or when checkpoint file does not exist.
+ */
+bool load_checkpoint(FlowCache *flowcache, const options_t &options, string &err)
+{
+   CheckpointReader reader;
+   struct timeval start, end;
+
+   if (access(options.checkpoint_file.c_str(), F_OK) != 0 && errno == ENOENT) {
+      return true;
+   }
+   if (reader.open(options.checkpoint_file) != 0) {
+      err = "Unable to load checkpoint: " + reader.error_msg;
+      return false;
+   }
+   if ((reader.get_flags() & CHECKPOINT_BIFLOW) != (options.biflow ? CHECKPOINT_BIFLOW : 0)) {
+      err = "Unable to load checkpoint: " + options.checkpoint_file + " was saved with different biflow (-b) setting";
+      return false;
+   }
+
+   gettimeofday(&start, NULL);
+   uint64_t loaded = flowcache->load_flows(reader);
+   gettimeofday(&end, NULL);
+   reader.close();
+   unlink(options.checkpoint_file.c_str());
+
+   cout << "Loaded " << loaded << " flows from checkpoint " << options.checkpoint_file << " in " <<
+      (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1000000.0 << " s" << endl;
+   return true;
+}
+
+/**
+ * \brief Save flows of flow cache into checkpoint file.
+ * \param [in,out] flowcache Flow cache.
+ * \param [in] options Module settings.
+ * \param [in] drop Remove saved flows from flow cache, so that they are not exported.
+ * \return True on success.
+ */
+bool save_checkpoint(FlowCache *flowcache, const options_t &options, bool drop)
+{
+   CheckpointWriter writer;
+
+   if (writer.open(options.checkpoint_file, (options.biflow ? CHECKPOINT_BIFLOW : 0)) != 0 ||
+       flowcache->save_flows(writer) != 0 || writer.close() != 0) {
+      error("Unable to save checkpoint: " + writer.error_msg);
+      return false;
+   }
+   if (drop) {
+      flowcache->drop_flows();
+   }
+
+   cout << "Saved " << writer.get_flows() << " flows to checkpoint " << options.checkpoint_file;
+   if (writer.get_skipped_exts() != 0) {
+      cout << ", " << writer.get_skipped_exts() << " extensions of plugins without checkpoint support were left out";
+   }
+   cout << endl;
+   return true;
+}
+
+/**
+ * \brief Pass parsed packets of block to flow cache.
+ * \param [in,out] block Block of parsed packets.
+ * \param [in] flowcache Flow cache.
+ * \param [in] sampler Packet sampler or NULL.
+ * \param [in] pkt_limit Limit of parsed packets, 0 = no limit.
+ * \param [in,out] pkt_parsed Number of parsed packets.
+ * \return True if packet limit was reached.
+ */
+static bool process_block(PacketBlock &block, FlowCache *flowcache, PacketSampler *sampler, uint32_t pkt_limit, uint64_t &pkt_parsed)
+{
+   if (sampler != NULL) {
+      sampler->sample(block);
+   }
+   for (size_t i = 0; i < block.cnt && i < PACKET_PREFETCH_DIST; i++) {
+      if (block.pkts[i].sampling_interval != 0) {
+         flowcache->prefetch(block.pkts[i]);
+      }
+   }
+   for (size_t i = 0; i < block.cnt; i++) {
+      if (i + PACKET_PREFETCH_DIST < block.cnt && block.pkts[i + PACKET_PREFETCH_DIST].sampling_interval != 0) {
+         flowcache->prefetch(block.pkts[i + PACKET_PREFETCH_DIST]);
+      }
+      if (block.pkts[i].sampling_interval != 0) {
+         flowcache->put_pkt(block.pkts[i]);
+      }
+      pkt_parsed++;
+
+      /* Check if packet limit is reached. */
+      if (pkt_limit != 0 && pkt_parsed >= pkt_limit) {
+         return true;
+      }
+   }
+   return false;
 }
 
 int main(int argc, char *argv[])
@@ -248,6 +666,33 @@ int main(int argc, char *argv[])
    options.interface = "";
    options.basic_ifc_num = 0;
    options.snaplen = 0;
+   options.worker_cnt = 0;
+   options.export_queue_size = 0;
+   options.flow_hash = FLOW_HASH_XXHASH;
+   options.biflow = false;
+   options.afpacket = false;
+   options.afpacket_block_size = AFPACKET_BLOCK_SIZE;
+   options.afpacket_block_cnt = AFPACKET_BLOCK_CNT;
+   options.afpacket_fanout = AFPACKET_NO_FANOUT;
+   options.stream_flow_limit = 0;
+   options.stream_total_limit = DEFAULT_STREAM_TOTAL_LIMIT;
+   options.frag_entries = DEFAULT_FRAG_ENTRIES;
+   options.frag_timeout = DEFAULT_FRAG_TIMEOUT;
+   options.frag_reassembly = false;
+   options.tunnels = 0;
+   options.tunnel_depth = 0;
+   options.sampling_mode = SAMPLING_OFF;
+   options.sampling_interval = 1;
+   options.sampling_max = DEFAULT_SAMPLING_MAX;
+   options.sampling_evict_rate = DEFAULT_SAMPLING_EVICT_RATE;
+   options.sampling_backlog = DEFAULT_SAMPLING_BACKLOG;
+   options.evict_policy = EVICT_LRU;
+   options.victim_size = 0;
+   options.inspect_limit = 0;
+   options.tcp_close = false;
+   options.tcp_linger = 0;
+   options.hugepages = HUGEPAGES_OFF;
+   options.numa_node = NUMA_NODE_NONE;
    options.eof = true;
 
    bool odid = false, export_unirec = false, export_ipfix = false, help = false, udp = false;
@@ -255,7 +700,8 @@ int main(int argc, char *argv[])
    uint64_t link = 1;
    uint32_t pkt_limit = 0; /* Limit of packets for packet parser. 0 = no limit */
    uint8_t dir = 0;
-   string host = "", port = "", filter = "";
+   uint16_t ipfix_msg_size = PACKET_DATA_SIZE;
+   string host = "", port = "", filter = "", plugin_settings = "";
 
    for (int i = 0; i < argc; i++) {
       if (!strcmp(argv[i], "-i")) {
@@ -302,6 +748,7 @@ int main(int argc, char *argv[])
 
    signal(SIGTERM, signal_handler);
    signal(SIGINT, signal_handler);
+   signal(SIGUSR1, signal_handler);
    signal(SIGPIPE, SIG_IGN);
 
    signed char opt;
@@ -310,7 +757,8 @@ int main(int argc, char *argv[])
       case 'p':
          {
             options.basic_ifc_num = -1;
-            int ret = parse_plugin_settings(string(optarg), plugin_wrapper.plugins, options);
+            plugin_settings = string(optarg);
+            int ret = parse_plugin_settings(plugin_settings, plugin_wrapper.plugins, options);
             if (ret < 0) {
                TRAP_DEFAULT_FINALIZATION();
                return error("Invalid argument for option -p");
@@ -462,6 +910,105 @@ int main(int argc, char *argv[])
       case 'u':
          udp = true;
          break;
+      case 'H':
+         options.flow_hash = flow_hash_type(optarg);
+         if (options.flow_hash < 0) {
+            FREE_MODULE_INFO_STRUCT(MODULE_BASIC_INFO, MODULE_PARAMS);
+            TRAP_DEFAULT_FINALIZATION();
+            return error("Invalid argument for option -H");
+         }
+         break;
+      case 'w':
+         if (!str_to_uint32(optarg, options.worker_cnt) || options.worker_cnt > MAX_WORKER_CNT) {
+            FREE_MODULE_INFO_STRUCT(MODULE_BASIC_INFO, MODULE_PARAMS);
+            TRAP_DEFAULT_FINALIZATION();
+            return error("Invalid argument for option -w");
+         }
+         break;
+      case 'A':
+         if (!parse_afpacket_settings(optarg, options)) {
+            FREE_MODULE_INFO_STRUCT(MODULE_BASIC_INFO, MODULE_PARAMS);
+            TRAP_DEFAULT_FINALIZATION();
+            return error("Invalid argument for option -A");
+         }
+         break;
+      case 'b':
+         options.biflow = true;
+         break;
+      case 'e':
+         if (!str_to_uint32(optarg, options.export_queue_size) || options.export_queue_size > MAX_EXPORT_QUEUE_SIZE) {
+            FREE_MODULE_INFO_STRUCT(MODULE_BASIC_INFO, MODULE_PARAMS);
+            TRAP_DEFAULT_FINALIZATION();
+            return error("Invalid argument for option -e");
+         }
+         break;
+      case 'm':
+         if (!str_to_uint16(optarg, ipfix_msg_size) || ipfix_msg_size < PACKET_DATA_SIZE) {
+            FREE_MODULE_INFO_STRUCT(MODULE_BASIC_INFO, MODULE_PARAMS);
+            TRAP_DEFAULT_FINALIZATION();
+            return error("Invalid argument for option -m");
+         }
+         break;
+      case 'R':
+         if (!parse_stream_settings(optarg, options)) {
+            FREE_MODULE_INFO_STRUCT(MODULE_BASIC_INFO, MODULE_PARAMS);
+            TRAP_DEFAULT_FINALIZATION();
+            return error("Invalid argument for option -R");
+         }
+         break;
+      case 'f':
+         if (!parse_frag_settings(optarg, options)) {
+            FREE_MODULE_INFO_STRUCT(MODULE_BASIC_INFO, MODULE_PARAMS);
+            TRAP_DEFAULT_FINALIZATION();
+            return error("Invalid argument for option -f");
+         }
+         break;
+      case 'T':
+         if (!parse_tunnel_settings(optarg, options)) {
+            FREE_MODULE_INFO_STRUCT(MODULE_BASIC_INFO, MODULE_PARAMS);
+            TRAP_DEFAULT_FINALIZATION();
+            return error("Invalid argument for option -T");
+         }
+         break;
+      case 'N':
+         if (!parse_sampling_settings(optarg, options)) {
+            FREE_MODULE_INFO_STRUCT(MODULE_BASIC_INFO, MODULE_PARAMS);
+            TRAP_DEFAULT_FINALIZATION();
+            return error("Invalid argument for option -N");
+         }
+         break;
+      case 'E':
+         if (!parse_eviction_settings(optarg, options)) {
+            FREE_MODULE_INFO_STRUCT(MODULE_BASIC_INFO, MODULE_PARAMS);
+            TRAP_DEFAULT_FINALIZATION();
+            return error("Invalid argument for option -E");
+         }
+         break;
+      case 'k':
+         if (!str_to_uint32(optarg, options.tcp_linger)) {
+            FREE_MODULE_INFO_STRUCT(MODULE_BASIC_INFO, MODULE_PARAMS);
+            TRAP_DEFAULT_FINALIZATION();
+            return error("Invalid argument for option -k");
+         }
+         options.tcp_close = true;
+         break;
+      case 'g':
+         if (!parse_hugepages_settings(optarg, options)) {
+            FREE_MODULE_INFO_STRUCT(MODULE_BASIC_INFO, MODULE_PARAMS);
+            TRAP_DEFAULT_FINALIZATION();
+            return error("Invalid argument for option -g");
+         }
+         break;
+      case 'C':
+         options.checkpoint_file = string(optarg);
+         break;
+      case 'B':
+         if (!str_to_uint32(optarg, options.inspect_limit)) {
+            FREE_MODULE_INFO_STRUCT(MODULE_BASIC_INFO, MODULE_PARAMS);
+            TRAP_DEFAULT_FINALIZATION();
+            return error("Invalid argument for option -B");
+         }
+         break;
       default:
          FREE_MODULE_INFO_STRUCT(MODULE_BASIC_INFO, MODULE_PARAMS);
          TRAP_DEFAULT_FINALIZATION();
@@ -477,6 +1024,14 @@ int main(int argc, char *argv[])
    } else if (options.interface == "" && options.pcap_file == "") {
       TRAP_DEFAULT_FINALIZATION();
       return error("Specify capture interface (-I) or file for reading (-r). ");
+   } else if (options.afpacket && options.interface == "") {
+      TRAP_DEFAULT_FINALIZATION();
+      return error("AF_PACKET capture (-A) requires capture interface (-I).");
+   }
+
+   if (plugin_wrapper.plugins.size() >= DISPATCH_MAX_PLUGINS) { /* One slot is kept for stats plugin. */
+      TRAP_DEFAULT_FINALIZATION();
+      return error("Too many plugins specified in -p parameter.");
    }
 
    bool parse_every_pkt = false;
@@ -501,9 +1056,11 @@ int main(int argc, char *argv[])
       options.snaplen = max_snaplen;
    }
 
-   PcapReader packetloader(options);
+   PcapReader pcapreader(options);
+   AfPacketReader afpacketreader(options);
+   PacketReceiver &packetloader = (options.afpacket ? (PacketReceiver &) afpacketreader : (PacketReceiver &) pcapreader);
    if (options.interface == "") {
-      if (packetloader.open_file(options.pcap_file, parse_every_pkt) != 0) {
+      if (pcapreader.open_file(options.pcap_file, parse_every_pkt, max_payload_size) != 0) {
          TRAP_DEFAULT_FINALIZATION();
          return error("Can't open input file: " + options.pcap_file);
       }
@@ -514,9 +1071,14 @@ int main(int argc, char *argv[])
          }
       }
 
-      if (packetloader.init_interface(options.interface, options.snaplen, parse_every_pkt) != 0) {
+      if (options.afpacket) {
+         if (afpacketreader.init_interface(options.interface, options.snaplen, parse_every_pkt, max_payload_size) != 0) {
+            TRAP_DEFAULT_FINALIZATION();
+            return error("Unable to initialize AF_PACKET capture: " + afpacketreader.error_msg);
+         }
+      } else if (pcapreader.init_interface(options.interface, options.snaplen, parse_every_pkt, max_payload_size) != 0) {
          TRAP_DEFAULT_FINALIZATION();
-         return error("Unable to initialize libpcap: " + packetloader.error_msg);
+         return error("Unable to initialize libpcap: " + pcapreader.error_msg);
       }
    }
 
@@ -527,63 +1089,131 @@ int main(int argc, char *argv[])
       }
    }
 
-   NHTFlowCache flowcache(options);
+   FlowCache *flowcache;
+   if (options.worker_cnt > 0) {
+      ShardedFlowCache *sharded = new ShardedFlowCache(options);
+
+      /* Every shard needs its own instances of plugins. */
+      for (uint32_t i = 0; i < options.worker_cnt; i++) {
+         vector<FlowCachePlugin *> shard_plugins;
+         options_t shard_options = options;
+
+         if (plugin_settings != "") {
+            parse_plugin_settings(plugin_settings, shard_plugins, shard_options);
+         }
+         if (!options.print_stats) {
+            shard_plugins.push_back(new StatsPlugin(options.cache_stats_interval, cout));
+         }
+         for (unsigned int j = 0; j < shard_plugins.size(); j++) {
+            sharded->add_shard_plugin(i, shard_plugins[j]);
+         }
+      }
+      flowcache = sharded;
+   } else {
+      flowcache = new NHTFlowCache(options);
+   }
+
    UnirecExporter flowwriter(options.eof);
    IPFIXExporter flow_writer_ipfix;
 
    if (export_unirec) {
-      if (flowwriter.init(plugin_wrapper.plugins, ifc_cnt, options.basic_ifc_num, link, dir, odid) != 0) {
+      if (flowwriter.init(plugin_wrapper.plugins, ifc_cnt, options.basic_ifc_num, link, dir, odid, options.biflow,
+            options.sampling_mode != SAMPLING_OFF, options.tcp_close) != 0) {
+         delete flowcache;
          TRAP_DEFAULT_FINALIZATION();
          return error("Unable to initialize UnirecExporter.");
       }
-      flowcache.set_exporter(&flowwriter);
    } else {
-      if (flow_writer_ipfix.init(plugin_wrapper.plugins, options.basic_ifc_num, link, host, port, udp, (verbose >= 0), dir) != 0) {
+      if (flow_writer_ipfix.init(plugin_wrapper.plugins, options.basic_ifc_num, link, host, port, udp, (verbose >= 0), dir, options.biflow,
+            options.sampling_mode != SAMPLING_OFF, options.tcp_close, ipfix_msg_size) != 0) {
+         delete flowcache;
          TRAP_DEFAULT_FINALIZATION();
          return error("Unable to initialize IPFIXExporter.");
       }
-      flowcache.set_exporter(&flow_writer_ipfix);
    }
 
-   if (!options.print_stats) {
-      plugin_wrapper.plugins.push_back(new StatsPlugin(options.cache_stats_interval, cout));
+   FlowExporter *exporter = (export_unirec ? (FlowExporter *) &flowwriter : (FlowExporter *) &flow_writer_ipfix);
+   AsyncExporter *async_exporter = NULL;
+   if (options.export_queue_size > 0) {
+      async_exporter = new AsyncExporter(exporter, options.export_queue_size);
+      if (async_exporter->start() != 0) {
+         delete async_exporter;
+         delete flowcache;
+         TRAP_DEFAULT_FINALIZATION();
+         return error("Unable to start exporter thread.");
+      }
+      exporter = async_exporter;
    }
+   flowcache->set_exporter(exporter);
 
-   for (unsigned int i = 0; i < plugin_wrapper.plugins.size(); i++) {
-      flowcache.add_plugin(plugin_wrapper.plugins[i]);
+   if (options.worker_cnt == 0) {
+      if (!options.print_stats) {
+         plugin_wrapper.plugins.push_back(new StatsPlugin(options.cache_stats_interval, cout));
+      }
+
+      for (unsigned int i = 0; i < plugin_wrapper.plugins.size(); i++) {
+         flowcache->add_plugin(plugin_wrapper.plugins[i]);
+      }
    }
 
-   flowcache.init();
+   if (flowcache->init() != 0) {
+      delete flowcache;
+      delete async_exporter;
+      flowwriter.close();
+      TRAP_DEFAULT_FINALIZATION();
+      return error("Unable to start flow cache worker thread.");
+   }
 
-   Packet packet;
+   if (options.checkpoint_file != "") {
+      string err;
+      if (!load_checkpoint(flowcache, options, err)) {
+         delete flowcache;
+         delete async_exporter;
+         flowwriter.close();
+         TRAP_DEFAULT_FINALIZATION();
+         return error(err);
+      }
+   }
+
+   PacketSampler *sampler = NULL;
+   if (options.sampling_mode != SAMPLING_OFF) {
+      sampler = new PacketSampler(options, flowcache, async_exporter);
+   }
+
+   PacketBlock block(PACKET_BURST_SIZE);
    int ret = 0;
+   bool limit_reached = false;
    uint64_t pkt_total = 0, pkt_parsed = 0;
 
-   packet.packet = new char[MAXPCKTSIZE + 1];
-
    /* Main packet capture loop. */
-   while (!stop && (ret = packetloader.get_pkt(packet)) > 0) {
+   while (!stop && !limit_reached && (ret = packetloader.get_pkts(block)) > 0) {
       if (ret == 3) { /* Process timeout. */
-         flowcache.export_expired(time(NULL));
-         continue;
+         flowcache->export_expired(time(NULL));
+      } else {
+         pkt_total += block.total;
+         limit_reached = process_block(block, flowcache, sampler, pkt_limit, pkt_parsed);
       }
 
-      pkt_total++;
-      if (ret == 2) {
-         flowcache.put_pkt(packet);
-         pkt_parsed++;
-
-         /* Check if packet limit is reached. */
-         if (pkt_limit != 0 && pkt_parsed >= pkt_limit) {
-            break;
+      /* Checkpoint is saved after the block is processed, so that it contains all packets read before SIGUSR1. */
+      if (checkpoint_req) {
+         checkpoint_req = 0;
+         if (options.checkpoint_file != "") {
+            save_checkpoint(flowcache, options, false);
          }
       }
    }
 
+   /* Fragments held for reassembly on stopped capture, so they are not missing in flow counters. */
+   while (ret >= 0 && !limit_reached && packetloader.get_held_pkts(block) > 0) {
+      limit_reached = process_block(block, flowcache, sampler, pkt_limit, pkt_parsed);
+   }
+
    if (ret < 0) {
       packetloader.close();
+      delete sampler;
+      delete flowcache;
+      delete async_exporter;
       flowwriter.close();
-      delete [] packet.packet;
       TRAP_DEFAULT_FINALIZATION();
       return error("Error during reading: " + packetloader.error_msg);
    }
@@ -591,14 +1221,27 @@ int main(int argc, char *argv[])
    if (options.print_stats) {
       cout << "Total packets captured: " << pkt_total << endl;
       cout << "Packets parsed: " << pkt_parsed << endl;
+      if (sampler != NULL) {
+         sampler->print_report();
+      }
+      packetloader.print_report();
    }
 
    /* Cleanup. */
-   flowcache.finish();
+   delete sampler;
+   if (options.checkpoint_file != "") {
+      /* Flows continue after restart, those which cannot be saved are exported by finish(). */
+      save_checkpoint(flowcache, options, true);
+   }
+   flowcache->finish();
+   delete flowcache;
+   if (async_exporter != NULL) {
+      async_exporter->finish(options.print_stats);
+      delete async_exporter;
+   }
    flowwriter.close();
    packetloader.close();
 
-   delete [] packet.packet;
    TRAP_DEFAULT_FINALIZATION();
 
    return EXIT_SUCCESS;
@@ -59,9 +59,17 @@ const unsigned int DEFAULT_FLOW_CACHE_SIZE = 131072;
 #else
 const unsigned int DEFAULT_FLOW_CACHE_SIZE = FLOW_CACHE_SIZE;
 #endif
-const unsigned int DEFAULT_FLOW_LINE_SIZE = 16;
+const unsigned int DEFAULT_FLOW_LINE_SIZE = 16; /* Multiple of 16 and at most 32, tags of a line are matched by SSE2. */
 const double DEFAULT_INACTIVE_TIMEOUT = 30.0;
 const double DEFAULT_ACTIVE_TIMEOUT = 300.0;
+const unsigned int MAX_WORKER_CNT = 64;
+const unsigned int MAX_EXPORT_QUEUE_SIZE = 1 << 22;
+const unsigned int PACKET_PREFETCH_DIST = 4; /* Number of packets flow cache is asked to prefetch ahead. */
+const unsigned int MAX_FRAG_ENTRIES = 1 << 20;
+const unsigned int DEFAULT_TUNNEL_DEPTH = 2;
+const unsigned int MAX_TUNNEL_DEPTH = 8;
+const unsigned int MAX_SAMPLING_INTERVAL = 1 << 20;
+const unsigned int DEFAULT_VICTIM_RATIO = 16; /* Default victim area is 1/16 of flow cache. */
 
 /**
  * \brief Struct containing module settings.
@@ -74,11 +82,39 @@ struct options_t {
    uint32_t flow_cache_size;
    uint32_t flow_line_size;
    uint32_t snaplen;
+   uint32_t worker_cnt;
+   uint32_t export_queue_size;
+   int flow_hash;
+   bool biflow;
+   bool afpacket;
+   uint32_t afpacket_block_size;
+   uint32_t afpacket_block_cnt;
+   int afpacket_fanout;
+   uint32_t stream_flow_limit;
+   uint64_t stream_total_limit;
+   uint32_t frag_entries;
+   uint32_t frag_timeout;
+   bool frag_reassembly;
+   uint8_t tunnels;
+   uint8_t tunnel_depth;
+   int sampling_mode;
+   uint32_t sampling_interval;
+   uint32_t sampling_max;
+   uint32_t sampling_evict_rate;
+   uint32_t sampling_backlog;
+   int evict_policy;
+   uint32_t victim_size;
+   uint32_t inspect_limit;
+   bool tcp_close;
+   uint32_t tcp_linger;
+   int hugepages;
+   int numa_node;
    struct timeval inactive_timeout;
    struct timeval active_timeout;
    struct timeval cache_stats_interval;
    string interface;
    string pcap_file;
+   string checkpoint_file;
 };
 
 /**
@@ -52,7 +52,10 @@
 #include "packet.h"
 #include "flowifc.h"
 #include "flowcacheplugin.h"
+#include "plugindispatch.h"
 #include "flowexporter.h"
+#include "tcpreassembler.h"
+#include "checkpoint.h"
 
 using namespace std;
 
@@ -66,13 +69,14 @@ protected:
 private:
    FlowCachePlugin **plugins; /**< Array of plugins. */
    uint32_t plugin_cnt;
+   PluginDispatch dispatch;   /**< Plugins interested in packets, built by plugins_init(). */
 
 public:
    FlowCache() : plugins(NULL), plugin_cnt(0)
    {
    }
 
-   ~FlowCache()
+   virtual ~FlowCache()
    {
       if (plugins != NULL) {
          delete [] plugins;
@@ -89,10 +93,12 @@ public:
    /**
     * \brief Initialize flow cache.
     * Should be called before first call of recv_pkt, after all plugins are added.
+    * \return 0 on success, non 0 when flow cache cannot be started.
     */
-   virtual void init()
+   virtual int init()
    {
       plugins_init();
+      return 0;
    }
 
    /**
@@ -104,6 +110,59 @@ public:
       plugins_finish();
    }
 
+   /**
+    * \brief Export flow records which are inactive at given time.
+    * \param [in] ts Current time.
+    */
+   virtual void export_expired(time_t ts)
+   {
+   }
+
+   /**
+    * \brief Hint that packet will be put into the cache soon, cache can prefetch memory it will access.
+    * \param [in] pkt Parsed packet.
+    */
+   virtual void prefetch(const Packet &pkt)
+   {
+   }
+
+   /**
+    * \brief Get number of flows exported prematurely because there was no room for new flow.
+    * Can be called by another thread than the one putting packets.
+    * \return Number of evicted flows.
+    */
+   virtual uint64_t get_evicted() const
+   {
+      return 0;
+   }
+
+   /**
+    * \brief Save flow records into checkpoint, flows stay in cache.
+    * \param [in,out] writer Opened checkpoint.
+    * \return 0 on success, -1 on write error and writer.error_msg is set.
+    */
+   virtual int save_flows(CheckpointWriter &writer)
+   {
+      return 0;
+   }
+
+   /**
+    * \brief Insert flow records from checkpoint, should be called after init().
+    * \param [in,out] reader Opened checkpoint.
+    * \return Number of loaded flow records.
+    */
+   virtual uint64_t load_flows(CheckpointReader &reader)
+   {
+      return 0;
+   }
+
+   /**
+    * \brief Remove all flow records without exporting them, used after they were saved into checkpoint.
+    */
+   virtual void drop_flows()
+   {
+   }
+
    /**
     * \brief Set an instance of FlowExporter used to export flows.
     */
@@ -114,7 +173,7 @@ public:
 
    /**
     * \brief Add plugin to internal list of plugins.
-    * Plugins are always called in the same order, as they were added.
+    * Plugins are always called in the same order, as they were added. At most DISPATCH_MAX_PLUGINS can be added.
     */
    void add_plugin(FlowCachePlugin *plugin)
    {
@@ -142,27 +201,28 @@ protected:
     */
    void plugins_init()
    {
+      dispatch.build(plugins, plugin_cnt);
       for (unsigned int i = 0; i < plugin_cnt; i++) {
          plugins[i]->init();
       }
    }
 
    /**
-    * \brief Call pre_create function for each added plugin.
+    * \brief Call pre_create function of plugins interested in packet.
     * \param [in] pkt Input parsed packet.
     * \return Options for flow cache.
     */
    int plugins_pre_create(Packet &pkt)
    {
       int ret = 0;
-      for (unsigned int i = 0; i < plugin_cnt; i++) {
-         ret |= plugins[i]->pre_create(pkt);
+      for (uint32_t mask = dispatch.match(pkt); mask != 0; mask &= mask - 1) {
+         ret |= plugins[__builtin_ctz(mask)]->pre_create(pkt);
       }
       return ret;
    }
 
    /**
-    * \brief Call post_create function for each added plugin.
+    * \brief Call post_create function of plugins interested in packet, they start inspecting the flow.
     * \param [in,out] rec Stored flow record.
     * \param [in] pkt Input parsed packet.
     * \return Options for flow cache.
@@ -170,14 +230,20 @@ protected:
    int plugins_post_create(Flow &rec, const Packet &pkt)
    {
       int ret = 0;
-      for (unsigned int i = 0; i < plugin_cnt; i++) {
-         ret |= plugins[i]->post_create(rec, pkt);
+      rec.inspect_mask = dispatch.match(pkt);
+      for (uint32_t mask = rec.inspect_mask; mask != 0; mask &= mask - 1) {
+         uint32_t i = __builtin_ctz(mask);
+         int plugin_ret = plugins[i]->post_create(rec, pkt);
+         if (plugin_ret & INSPECT_DONE) {
+            rec.inspect_mask &= ~(1U << i);
+         }
+         ret |= plugin_ret;
       }
       return ret;
    }
 
    /**
-    * \brief Call pre_update function for each added plugin.
+    * \brief Call pre_update function of plugins which still inspect the flow.
     * \param [in,out] rec Stored flow record.
     * \param [in] pkt Input parsed packet.
     * \return Options for flow cache.
@@ -185,35 +251,111 @@ protected:
    int plugins_pre_update(Flow &rec, Packet &pkt)
    {
       int ret = 0;
-      for (unsigned int i = 0; i < plugin_cnt; i++) {
-         ret |= plugins[i]->pre_update(rec, pkt);
+      for (uint32_t mask = rec.inspect_mask; mask != 0; mask &= mask - 1) {
+         uint32_t i = __builtin_ctz(mask);
+         int plugin_ret = plugins[i]->pre_update(rec, pkt);
+         if (plugin_ret & INSPECT_DONE) {
+            rec.inspect_mask &= ~(1U << i);
+         }
+         ret |= plugin_ret;
       }
       return ret;
    }
 
    /**
-    * \brief Call post_update function for each added plugin.
+    * \brief Call post_update function of plugins which still inspect the flow.
     * \param [in,out] rec Stored flow record.
     * \param [in] pkt Input parsed packet.
     */
    int plugins_post_update(Flow &rec, const Packet &pkt)
    {
       int ret = 0;
-      for (unsigned int i = 0; i < plugin_cnt; i++) {
-         ret |= plugins[i]->post_update(rec, pkt);
+      for (uint32_t mask = rec.inspect_mask; mask != 0; mask &= mask - 1) {
+         uint32_t i = __builtin_ctz(mask);
+         int plugin_ret = plugins[i]->post_update(rec, pkt);
+         if (plugin_ret & INSPECT_DONE) {
+            rec.inspect_mask &= ~(1U << i);
+         }
+         ret |= plugin_ret;
       }
       return ret;
    }
 
    /**
-    * \brief Call pre_export function for each added plugin.
+    * \brief Tell plugins that TCP streams are reassembled.
+    */
+   void plugins_enable_streams()
+   {
+      for (unsigned int i = 0; i < plugin_cnt; i++) {
+         plugins[i]->enable_streams();
+      }
+   }
+
+   /**
+    * \brief Ask plugins how much data from beginning of new TCP stream direction they want.
+    * \param [in] rec Stored flow record.
+    * \param [in] reverse Direction of stream.
+    * \param [out] wanted Requested lengths, array of STREAM_MAX_SUBSCRIBERS items indexed by plugin.
+    * \return True if at least one plugin wants stream data.
+    */
+   bool plugins_stream_request(const Flow &rec, bool reverse, uint32_t *wanted)
+   {
+      bool any = false;
+      for (unsigned int i = 0; i < STREAM_MAX_SUBSCRIBERS; i++) {
+         wanted[i] = (i < plugin_cnt ? plugins[i]->stream_request(rec, reverse) : 0);
+         any |= (wanted[i] != 0);
+      }
+      return any;
+   }
+
+   /**
+    * \brief Pass reassembled data to plugins which waited for them.
+    * \param [in,out] rec Stored flow record.
+    * \param [in,out] stream Stream direction, requested lengths are updated by plugins.
+    * \param [in] reverse Direction of stream.
+    * \param [in,out] reass Reassembler counting delivered data.
+    * \return True if at least one plugin waits for more data.
+    */
+   bool plugins_stream_data(Flow &rec, TCPStream &stream, bool reverse, TCPReassembler &reass)
+   {
+      bool any = false;
+      for (unsigned int i = 0; i < plugin_cnt && i < STREAM_MAX_SUBSCRIBERS; i++) {
+         if (stream.wanted[i] != 0 && stream.wanted[i] <= stream.length) {
+            reass.count_delivered();
+            stream.wanted[i] = plugins[i]->stream_data(rec, stream.data, stream.length, reverse);
+         }
+         any |= (stream.wanted[i] != 0);
+      }
+      return any;
+   }
+
+   /**
+    * \brief Call pre_export function of plugins interested in flow.
     * \param [in,out] rec Stored flow record.
     */
    void plugins_pre_export(Flow &rec)
+   {
+      for (uint32_t mask = dispatch.match(rec); mask != 0; mask &= mask - 1) {
+         plugins[__builtin_ctz(mask)]->pre_export(rec);
+      }
+   }
+
+   /**
+    * \brief Ask plugins to create extension saved in flow cache checkpoint.
+    * \param [in] type Type of saved extension.
+    * \param [in] data Saved extension data.
+    * \param [in] size Length of data.
+    * \return New extension or NULL if no plugin creates extensions of the type.
+    */
+   RecordExt *plugins_deserialize(extTypeEnum type, const uint8_t *data, int size)
    {
       for (unsigned int i = 0; i < plugin_cnt; i++) {
-         plugins[i]->pre_export(rec);
+         RecordExt *ext = plugins[i]->deserialize(type, data, size);
+         if (ext != NULL) {
+            return ext;
+         }
       }
+      return NULL;
    }
 
    /**
@@ -66,6 +66,13 @@
  */
 #define EXPORT_PACKET   (0x1 << 1)
 
+/**
+ * \brief Tell FlowCache that plugin does not need more packets of currently processed flow.
+ * This return value has effect when called from post_create, pre_update or post_update method. Packet hooks
+ * of plugin are not called for the rest of flow, pre_export is still called.
+ */
+#define INSPECT_DONE   (0x1 << 2)
+
 #define MAX_PAYLOAD_LENGTH MAXPCKTSIZE
 
 using namespace std;
@@ -86,6 +93,43 @@ struct plugin_opt {
    }
 };
 
+/**
+ * \brief Packets and flows plugin wants to see, flow cache calls packet and flow hooks of plugin only for them.
+ *
+ * Plugin which wants all packets keeps default. Otherwise a packet or flow matches when its source or destination
+ * port is in ports or its IP protocol is in protocols. Ethertypes match packets without IP header, which only reach
+ * pre_create(). Plugins must still check what they parse, other plugins can match the same packet.
+ */
+struct plugin_interest {
+   bool all;                     /**< Plugin wants all packets. */
+   vector<uint16_t> ports;       /**< Transport layer ports. */
+   vector<uint8_t> protocols;    /**< IP protocols. */
+   vector<uint16_t> ethertypes;  /**< Ethertypes of non-IP packets. */
+
+   plugin_interest() : all(true)
+   {
+   }
+
+   plugin_interest &port(uint16_t port)
+   {
+      all = false;
+      ports.push_back(port);
+      return *this;
+   }
+   plugin_interest &protocol(uint8_t proto)
+   {
+      all = false;
+      protocols.push_back(proto);
+      return *this;
+   }
+   plugin_interest &ethertype(uint16_t type)
+   {
+      all = false;
+      ethertypes.push_back(type);
+      return *this;
+   }
+};
+
 /**
  * \brief Class template for flow cache plugins.
  */
@@ -129,7 +173,7 @@ public:
     * \brief Called after a new flow record is created.
     * \param [in,out] rec Reference to flow record.
     * \param [in] pkt Parsed packet.
-    * \return 0 on success or FLOW_FLUSH option.
+    * \return 0 on success, FLOW_FLUSH or INSPECT_DONE option.
     */
    virtual int post_create(Flow &rec, const Packet &pkt)
    {
@@ -140,7 +184,7 @@ public:
     * \brief Called before an existing record is update.
     * \param [in,out] rec Reference to flow record.
     * \param [in,out] pkt Parsed packet.
-    * \return 0 on success or FLOW_FLUSH option.
+    * \return 0 on success, FLOW_FLUSH or INSPECT_DONE option.
     */
    virtual int pre_update(Flow &rec, Packet &pkt)
    {
@@ -151,13 +195,46 @@ public:
     * \brief Called after an existing record is updated.
     * \param [in,out] rec Reference to flow record.
     * \param [in,out] pkt Parsed packet.
-    * \return 0 on success or FLOW_FLUSH option.
+    * \return 0 on success, FLOW_FLUSH or INSPECT_DONE option.
     */
    virtual int post_update(Flow &rec, const Packet &pkt)
    {
       return 0;
    }
 
+   /**
+    * \brief Called before init() when flow cache reassembles TCP streams.
+    * Plugin can then receive beginning of TCP streams through stream_request() and stream_data().
+    */
+   virtual void enable_streams()
+   {
+   }
+
+   /**
+    * \brief Called when first packet of TCP stream direction is seen.
+    * \param [in] rec Reference to flow record.
+    * \param [in] reverse True for direction opposite to the first packet of flow.
+    * \return Number of bytes from beginning of stream plugin waits for or 0 if plugin does not want stream data.
+    */
+   virtual uint32_t stream_request(const Flow &rec, bool reverse)
+   {
+      return 0;
+   }
+
+   /**
+    * \brief Called when number of contiguous bytes from beginning of TCP stream requested by plugin is available.
+    * Requests which cannot be satisfied within reassembly memory limits or before flow is exported are dropped.
+    * \param [in,out] rec Reference to flow record.
+    * \param [in] data Reassembled data from beginning of stream.
+    * \param [in] len Length of data, at least requested number of bytes.
+    * \param [in] reverse True for direction opposite to the first packet of flow.
+    * \return Number of bytes from beginning of stream plugin waits for next or 0 if plugin does not want more data.
+    */
+   virtual uint32_t stream_data(Flow &rec, const char *data, uint32_t len, bool reverse)
+   {
+      return 0;
+   }
+
    /**
     * \brief Called before a flow record is exported from the cache.
     * \param [in,out] rec Reference to flow record.
@@ -166,6 +243,19 @@ public:
    {
    }
 
+   /**
+    * \brief Create flow record extension of plugin from data saved in flow cache checkpoint by RecordExt::serialize().
+    * Flows loaded from checkpoint are not inspected by plugins, their extensions are exported as they were saved.
+    * \param [in] type Type of saved extension.
+    * \param [in] data Saved extension data.
+    * \param [in] size Length of data.
+    * \return New extension or NULL if type does not belong to plugin or data are not valid.
+    */
+   virtual RecordExt *deserialize(extTypeEnum type, const uint8_t *data, int size)
+   {
+      return NULL;
+   }
+
    /**
     * \brief Called when everything is processed.
     */
@@ -214,6 +304,16 @@ public:
       return MAX_PAYLOAD_LENGTH;
    }
 
+   /**
+    * \brief Get packets plugin wants to see, asked once before init().
+    * Hooks pre_create(), post_create(), pre_update(), post_update() and pre_export() are not called for other packets.
+    * \return Plugin interest, default is all packets.
+    */
+   virtual plugin_interest get_interest()
+   {
+      return plugin_interest();
+   }
+
    vector<plugin_opt> options; /**< Plugin options. */
 };
 
@@ -0,0 +1,162 @@
+/**
+ * \file flowhash.cpp
+ * \brief Hash functions used for flow cache lookup.
+ * \author Jiri Havranek <havraji6@fit.cvut.cz>
+ * \date 2018
+ */
+/*
+ * Copyright (C) 2018 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#include <cstring>
+#ifdef __x86_64__
+#include <nmmintrin.h>
+#endif
+
+#include "flowhash.h"
+
+#define CRC32C_POLY 0x82F63B78 /**< Reversed Castagnoli polynomial. */
+
+static uint32_t crc32c_table[256];
+static bool crc32c_hw = false;
+
+/**
+ * \brief Initialize CRC32C table and detect SSE4.2 support. Must be called before any hash is computed.
+ */
+void flow_hash_init()
+{
+   for (uint32_t i = 0; i < 256; i++) {
+      uint32_t crc = i;
+      for (int j = 0; j < 8; j++) {
+         crc = (crc >> 1) ^ (crc & 1 ? CRC32C_POLY : 0);
+      }
+      crc32c_table[i] = crc;
+   }
+
+#ifdef __x86_64__
+   __builtin_cpu_init();
+   crc32c_hw = __builtin_cpu_supports("sse4.2");
+#endif
+}
+
+/**
+ * \brief Get hash type from its name.
+ * \param [in] name Name of hash function.
+ * \return Hash type or -1 when name is not known.
+ */
+int flow_hash_type(const char *name)
+{
+   if (!strcmp(name, "xxhash")) {
+      return FLOW_HASH_XXHASH;
+   } else if (!strcmp(name, "crc32c")) {
+      return FLOW_HASH_CRC32C;
+   }
+   return -1;
+}
+
+/**
+ * \brief Get name of hash type.
+ */
+const char *flow_hash_name(int type)
+{
+   return (type == FLOW_HASH_CRC32C ? "crc32c" : "xxhash");
+}
+
+/**
+ * \brief Check if CRC32C is computed by hardware.
+ */
+bool flow_hash_crc32c_hw()
+{
+   return crc32c_hw;
+}
+
+#ifdef __x86_64__
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_sse42(const char *data, uint32_t len, uint32_t crc)
+{
+   uint64_t tmp;
+
+   while (len >= 8) {
+      memcpy(&tmp, data, 8);
+      crc = (uint32_t) _mm_crc32_u64(crc, tmp);
+      data += 8;
+      len -= 8;
+   }
+   while (len > 0) {
+      crc = _mm_crc32_u8(crc, (uint8_t) *data);
+      data++;
+      len--;
+   }
+
+   return crc;
+}
+#endif
+
+static uint32_t crc32c_sw(const char *data, uint32_t len, uint32_t crc)
+{
+   while (len > 0) {
+      crc = crc32c_table[(crc ^ (uint8_t) *data) & 0xFF] ^ (crc >> 8);
+      data++;
+      len--;
+   }
+
+   return crc;
+}
+
+/**
+ * \brief Compute CRC32C of flow key and spread it to 64 bits.
+ * \param [in] data Flow key.
+ * \param [in] len Length of flow key.
+ * \return Hash value, never 0.
+ */
+uint64_t flow_hash_crc32c(const char *data, uint32_t len)
+{
+   uint32_t crc;
+
+#ifdef __x86_64__
+   if (crc32c_hw) {
+      crc = crc32c_sse42(data, len, 0xFFFFFFFF);
+   } else {
+      crc = crc32c_sw(data, len, 0xFFFFFFFF);
+   }
+#else
+   crc = crc32c_sw(data, len, 0xFFFFFFFF);
+#endif
+
+   /* Multiplication by odd constant keeps all 2^32 values distinct and fills upper bits. */
+   uint64_t hash = ((uint64_t) ~crc) * 0x9E3779B97F4A7C15ULL;
+   return (hash == 0 ? 1 : hash);
+}
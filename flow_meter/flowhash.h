@@ -0,0 +1,63 @@
+/**
+ * \file flowhash.h
+ * \brief Hash functions used for flow cache lookup.
+ * \author Jiri Havranek <havraji6@fit.cvut.cz>
+ * \date 2018
+ */
+/*
+ * Copyright (C) 2018 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#ifndef FLOWHASH_H
+#define FLOWHASH_H
+
+#include <stdint.h>
+
+/**
+ * \brief Hash functions which can be used to index flow cache.
+ */
+enum flowHashType {
+   FLOW_HASH_XXHASH = 0,   /**< XXH64, default. */
+   FLOW_HASH_CRC32C        /**< CRC32C computed by SSE4.2 instruction when available. */
+};
+
+void flow_hash_init();
+int flow_hash_type(const char *name);
+const char *flow_hash_name(int type);
+bool flow_hash_crc32c_hw();
+uint64_t flow_hash_crc32c(const char *data, uint32_t len);
+
+#endif
@@ -51,6 +51,7 @@
 
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unirec/unirec.h>
 
 #include "ipaddr.h"
@@ -71,15 +72,131 @@ enum extTypeEnum {
    smtp,
    arp,
    passivedns,
+   tunnel,
    /* Add extension header identifiers for your plugins here */
-   EXTENSION_CNT
+   EXTENSION_CNT /* At most 32 types, see Record::ext_mask. */
+};
+
+/* Reasons of flow record export, values of IPFIX flowEndReason (RFC 5102). */
+#define FLOW_END_INACTIVE 0x01 /**< Inactive timeout. */
+#define FLOW_END_ACTIVE   0x02 /**< Active timeout. */
+#define FLOW_END_EOF      0x03 /**< TCP connection closed by FIN in both directions or RST. */
+#define FLOW_END_FORCED   0x04 /**< Flushed by plugin or exported at the end of processing. */
+#define FLOW_END_NO_RES   0x05 /**< Evicted from full flow line. */
+
+#define EXT_POOL_MAX_CACHED 8192 /**< Max number of released extensions of one type kept by pool. */
+
+/**
+ * \brief Pool of released flow record extensions.
+ *
+ * Every flow cache owns one pool and binds it to thread processing its packets. Extensions
+ * allocated and deleted by that thread are recycled through per-type free lists instead of heap.
+ * Threads without bound pool use heap directly. Pooled extensions are allocated by malloc,
+ * so any pool or free() can release them.
+ */
+class RecordExtPool
+{
+   struct FreeNode {
+      FreeNode *next;
+   };
+
+   FreeNode *free_list[EXTENSION_CNT]; /**< Released extensions of each type. */
+   uint32_t cached[EXTENSION_CNT];     /**< Number of extensions in free lists. */
+   uint64_t allocs[EXTENSION_CNT];     /**< Number of allocations. */
+   uint64_t reused[EXTENSION_CNT];     /**< Number of allocations served from free list. */
+
+   static __thread RecordExtPool *thread_pool; /**< Pool bound to current thread. */
+
+   RecordExtPool(const RecordExtPool &);
+   RecordExtPool &operator=(const RecordExtPool &);
+
+public:
+   RecordExtPool();
+   ~RecordExtPool();
+
+   /**
+    * \brief Use this pool for extensions allocated and deleted by calling thread.
+    */
+   void bind()
+   {
+      thread_pool = this;
+   }
+
+   /**
+    * \brief Stop using pool in calling thread.
+    */
+   static void unbind()
+   {
+      thread_pool = NULL;
+   }
+
+   /**
+    * \brief Get pool bound to calling thread.
+    * \return Pointer to pool or NULL.
+    */
+   static RecordExtPool *current()
+   {
+      return thread_pool;
+   }
+
+   static void *alloc(extTypeEnum type, size_t size);
+   static void release(extTypeEnum type, void *ptr);
+
+   uint64_t get_allocs() const;
+   uint64_t get_reused() const;
+   uint64_t get_cached() const;
+   void print_report() const;
 };
 
+/**
+ * \brief Declare operators new and delete of flow record extension which use RecordExtPool.
+ * \param [in] type Type of extension from extTypeEnum.
+ */
+#define RECORD_EXT_POOLED(type) \
+   static void *operator new(size_t size) \
+   { \
+      return RecordExtPool::alloc(type, size); \
+   } \
+   static void operator delete(void *ptr) \
+   { \
+      RecordExtPool::release(type, ptr); \
+   }
+
+/**
+ * \brief Declare saving of flow record extension into flow cache checkpoint and its loading.
+ *
+ * Data members from first to the end of extension are copied as one block, so they must not hold pointers
+ * and checkpoint can be loaded only by the same build. Plugin returns deserialize() result from
+ * FlowCachePlugin::deserialize().
+ * \param [in] ext_struct Name of extension struct.
+ * \param [in] first First data member of extension.
+ */
+#define RECORD_EXT_SERIALIZED(ext_struct, first) \
+   virtual int serialize(uint8_t *buffer, int size) const \
+   { \
+      int length = (const uint8_t *) (this + 1) - (const uint8_t *) &first; \
+      if (length > size) { \
+         return -1; \
+      } \
+      memcpy(buffer, &first, length); \
+      return length; \
+   } \
+   static RecordExt *deserialize(const uint8_t *buffer, int size) \
+   { \
+      ext_struct *ext = new ext_struct(); \
+      if ((const uint8_t *) (ext + 1) - (const uint8_t *) &ext->first != size) { \
+         delete ext; \
+         return NULL; \
+      } \
+      memcpy(&ext->first, buffer, size); \
+      return ext; \
+   }
+
 /**
  * \brief Flow record extension base struct.
  */
 struct RecordExt {
-   RecordExt *next; /**< Pointer to next extension */
+   RecordExt *next; /**< Pointer to next extension of the same type */
    extTypeEnum extType; /**< Type of extension. */
 
    /**
@@ -127,6 +244,17 @@ struct RecordExt {
       return 0;
    }
 
+   /**
+    * \brief Save extension data into flow cache checkpoint, see RECORD_EXT_SERIALIZED.
+    * \param [out] buffer Buffer for extension data.
+    * \param [in] size Size of buffer.
+    * \return Number of bytes written to buffer or -1 if extension cannot be saved.
+    */
+   virtual int serialize(uint8_t *buffer, int size) const
+   {
+      return -1;
+   }
+
    /**
     * \brief Virtual destructor.
     */
@@ -139,7 +267,8 @@ struct RecordExt {
 };
 
 struct Record {
-   RecordExt *exts; /**< Extension headers. */
+   RecordExt *exts[EXTENSION_CNT]; /**< Extension headers indexed by type, extensions of the same type are chained. */
+   uint32_t ext_mask;              /**< Bit mask of occupied extension slots. */
 
    /**
     * \brief Add new extension header.
@@ -147,14 +276,11 @@ struct Record {
     */
    void addExtension(RecordExt* ext)
    {
-      if (exts == NULL) {
-         exts = ext;
+      if (exts[ext->extType] == NULL) {
+         exts[ext->extType] = ext;
+         ext_mask |= (1U << ext->extType);
       } else {
-         RecordExt *ext_ptr = exts;
-         while (ext_ptr->next != NULL) {
-            ext_ptr = ext_ptr->next;
-         }
-         ext_ptr->next = ext;
+         exts[ext->extType]->addExtension(ext);
       }
    }
 
@@ -165,14 +291,7 @@ struct Record {
     */
    RecordExt *getExtension(extTypeEnum extType)
    {
-      RecordExt *ext_ptr = exts;
-      while (ext_ptr != NULL) {
-         if (ext_ptr->extType == extType) {
-            return ext_ptr;
-         }
-         ext_ptr = ext_ptr->next;
-      }
-      return NULL;
+      return exts[extType];
    }
 
    /**
@@ -180,17 +299,34 @@ struct Record {
     */
    void removeExtensions()
    {
-      if (exts != NULL) {
-         delete exts;
-         exts = NULL;
+      while (ext_mask) {
+         int type = __builtin_ctz(ext_mask);
+         ext_mask &= ext_mask - 1;
+
+         delete exts[type];
+         exts[type] = NULL;
+      }
+   }
+
+   /**
+    * \brief Forget extension headers without deleting them, used after their ownership was passed to another record.
+    */
+   void detachExtensions()
+   {
+      while (ext_mask) {
+         exts[__builtin_ctz(ext_mask)] = NULL;
+         ext_mask &= ext_mask - 1;
       }
    }
 
    /**
     * \brief Constructor.
     */
-   Record() : exts(NULL)
+   Record() : ext_mask(0)
    {
+      for (int i = 0; i < EXTENSION_CNT; i++) {
+         exts[i] = NULL;
+      }
    }
 
    /**
@@ -212,6 +348,11 @@ struct Flow : public Record {
    uint32_t pkt_total_cnt;
    uint8_t  tcp_control_bits;
 
+   /* Counters of dst->src direction, used in biflow mode only. */
+   uint64_t rev_octet_total_length;
+   uint32_t rev_pkt_total_cnt;
+   uint8_t  rev_tcp_control_bits;
+
    uint8_t  ip_version;
    uint8_t  ip_tos;
    uint8_t  ip_ttl;
@@ -224,6 +365,10 @@ struct Flow : public Record {
 
    uint8_t src_mac[6];
    uint8_t dst_mac[6];
+
+   uint32_t sampling_interval; /**< Packet sampling interval at flow creation. */
+   uint32_t inspect_mask;      /**< Plugins which still inspect packets of flow, see INSPECT_DONE. */
+   uint8_t end_reason;         /**< Reason of export (FLOW_END_*), FLOW_END_EOF is set as soon as TCP connection closes. */
 };
 
 #endif
@@ -0,0 +1,135 @@
+/**
+ * \file flowqueue.cpp
+ * \brief Queue passing exported flows between threads.
+ * \author Jiri Havranek <havraji6@fit.cvut.cz>
+ * \date 2018
+ */
+/*
+ * Copyright (C) 2018 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#include <sched.h>
+#include <cstring>
+
+#include "flowqueue.h"
+
+FlowQueue::FlowQueue(uint32_t size) : ring(size), full_cnt(0)
+{
+}
+
+/**
+ * \brief Wait for free slot and release extensions left in it from previous use.
+ * \return Pointer to free slot.
+ */
+FlowQueueItem *FlowQueue::get_slot()
+{
+   FlowQueueItem *item;
+
+   while ((item = ring.producer_slot()) == NULL) {
+      full_cnt++;
+      sched_yield();
+   }
+
+   item->flow.removeExtensions();
+   item->pkt.removeExtensions();
+
+   return item;
+}
+
+int FlowQueue::export_flow(Flow &flow)
+{
+   FlowQueueItem *item = get_slot();
+
+   item->type = FLOW_QUEUE_FLOW;
+   item->flow = flow;
+   flow.detachExtensions(); /* Extensions are owned by queue now. */
+
+   ring.push();
+   return 0;
+}
+
+int FlowQueue::export_packet(Packet &pkt)
+{
+   FlowQueueItem *item = get_slot();
+   uint16_t hdr_len = (pkt.total_length < FLOW_QUEUE_PKT_HDR ? pkt.total_length : FLOW_QUEUE_PKT_HDR);
+
+   item->type = FLOW_QUEUE_PACKET;
+   item->pkt = pkt;
+   pkt.detachExtensions(); /* Extensions are owned by queue now. */
+
+   memcpy(item->pkt_hdr, pkt.packet, hdr_len);
+   item->pkt.packet = item->pkt_hdr;
+   item->pkt.total_length = hdr_len;
+   item->pkt.payload = NULL;
+   item->pkt.payload_length = 0;
+
+   ring.push();
+   return 0;
+}
+
+void FlowQueue::flush()
+{
+   FlowQueueItem *item = get_slot();
+
+   item->type = FLOW_QUEUE_FLUSH;
+   ring.push();
+}
+
+/**
+ * \brief Pass queued items to exporter. Must be called from single consumer thread.
+ * \param [in] exporter Exporter which receives queued items.
+ * \param [in] max Maximal number of items to process.
+ * \return Number of processed items.
+ */
+uint32_t FlowQueue::drain(FlowExporter *exporter, uint32_t max)
+{
+   FlowQueueItem *item;
+   uint32_t cnt = 0;
+
+   while (cnt < max && (item = ring.consumer_slot()) != NULL) {
+      if (item->type == FLOW_QUEUE_FLOW) {
+         exporter->export_flow(item->flow);
+      } else if (item->type == FLOW_QUEUE_PACKET) {
+         exporter->export_packet(item->pkt);
+      } else {
+         exporter->flush();
+      }
+      ring.pop();
+      cnt++;
+   }
+
+   return cnt;
+}
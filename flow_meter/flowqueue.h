@@ -0,0 +1,126 @@
+/**
+ * \file flowqueue.h
+ * \brief Queue passing exported flows between threads.
+ * \author Jiri Havranek <havraji6@fit.cvut.cz>
+ * \date 2018
+ */
+/*
+ * Copyright (C) 2018 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#ifndef FLOWQUEUE_H
+#define FLOWQUEUE_H
+
+#include <stdint.h>
+
+#include "flowifc.h"
+#include "packet.h"
+#include "flowexporter.h"
+#include "ringbuffer.h"
+
+#define FLOW_QUEUE_PKT_HDR 14 /**< Number of packet bytes (ethernet header) kept with exported packet. */
+
+/**
+ * \brief Type of item stored in flow queue.
+ */
+enum flowQueueItemType {
+   FLOW_QUEUE_FLOW = 0,
+   FLOW_QUEUE_PACKET,
+   FLOW_QUEUE_FLUSH
+};
+
+/**
+ * \brief Slot of flow queue.
+ */
+struct FlowQueueItem {
+   int type;                             /**< Type of item. */
+   Flow flow;                            /**< Exported flow. */
+   Packet pkt;                           /**< Exported packet. */
+   char pkt_hdr[FLOW_QUEUE_PKT_HDR];     /**< Copy of exported packet header. */
+
+   FlowQueueItem() : type(FLOW_QUEUE_FLUSH)
+   {
+   }
+};
+
+/**
+ * \brief Exporter moving flows into lock-free queue, which is drained into real exporter by another thread.
+ *
+ * Flow extensions are moved into the queue without copying. Consumer only reads queued items, extensions
+ * are released by producer thread when the slot is reused.
+ */
+class FlowQueue : public FlowExporter
+{
+   RingBuffer<FlowQueueItem> ring;
+   uint64_t full_cnt; /**< Number of times producer waited for free slot. */
+
+   FlowQueueItem *get_slot();
+
+public:
+   FlowQueue(uint32_t size);
+
+   int export_flow(Flow &flow);
+   int export_packet(Packet &pkt);
+   void flush();
+
+   uint32_t drain(FlowExporter *exporter, uint32_t max);
+
+   /**
+    * \brief Get number of items waiting in queue.
+    */
+   uint32_t count() const
+   {
+      return ring.count();
+   }
+
+   /**
+    * \brief Get number of queue slots.
+    */
+   uint32_t capacity() const
+   {
+      return ring.capacity();
+   }
+
+   /**
+    * \brief Get number of times producer waited because queue was full.
+    */
+   uint64_t get_full_cnt() const
+   {
+      return full_cnt;
+   }
+};
+
+#endif
@@ -0,0 +1,362 @@
+/**
+ * \file fragmenttable.cpp
+ * \brief Tracking and reassembly of IP fragments (FragmentTable class)
+ * \author Jiri Havranek <havraji6@fit.cvut.cz>
+ * \date 2018
+ */
+/*
+ * Copyright (C) 2018 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#include <iostream>
+#include <cstring>
+#include <netinet/in.h>
+
+#include "fragmenttable.h"
+#include "xxhash.h"
+
+using namespace std;
+
+/**
+ * \brief Constructor.
+ * \param [in] entries Number of entries, rounded up to power of two.
+ * \param [in] timeout Time in seconds fragments of one datagram are tracked.
+ * \param [in] reassembly Reassemble small UDP datagrams.
+ */
+FragmentTable::FragmentTable(uint32_t entries, uint32_t timeout, bool reassembly) : buffers(NULL), held(NULL), released_next(0),
+   timeout(timeout), fragments(0), attributed(0), unattributed(0), evicted(0), reassembled(0), failed(0), duplicate(0),
+   released_cnt(0)
+{
+   size = FRAG_BUCKET_SIZE;
+   while (size < entries) {
+      size <<= 1;
+   }
+
+   this->entries = new FragmentEntry[size];
+   memset(this->entries, 0, size * sizeof(FragmentEntry));
+   if (reassembly) {
+      buffers = new char[(size_t) size * FRAG_MAX_DATAGRAM];
+      held = new FragmentHeld[(size_t) size * FRAG_MAX_HELD];
+      for (uint32_t i = 0; i < size; i++) {
+         this->entries[i].data = buffers + (size_t) i * FRAG_MAX_DATAGRAM;
+         this->entries[i].held = held + (size_t) i * FRAG_MAX_HELD;
+      }
+   }
+}
+
+/**
+ * \brief Destructor.
+ */
+FragmentTable::~FragmentTable()
+{
+   delete [] entries;
+   delete [] buffers;
+   delete [] held;
+}
+
+/**
+ * \brief Stop tracking datagram, release its held fragments when it was not reassembled.
+ * \param [in,out] entry Entry of datagram.
+ */
+void FragmentTable::drop(FragmentEntry &entry)
+{
+   if (entry.reassemble && !entry.done) {
+      failed++;
+      release(entry);
+   }
+   entry.used = false;
+}
+
+/**
+ * \brief Move held fragments of datagram to queue of fragments waiting to be passed to flow cache.
+ * \param [in,out] entry Entry of datagram.
+ */
+void FragmentTable::release(FragmentEntry &entry)
+{
+   for (uint8_t i = 0; i < entry.held_cnt; i++) {
+      const FragmentHeld &held = entry.held[i];
+
+      released.push_back(FragmentReleased());
+      released.back().held = held;
+      released.back().data.assign(entry.data + held.pkt.frag_off, held.data_len);
+   }
+   released_cnt += entry.held_cnt;
+   entry.held_cnt = 0;
+}
+
+/**
+ * \brief Find entry of datagram, create new one when datagram is not tracked.
+ * \param [in] key Key of datagram.
+ * \param [in] ts Timestamp of current fragment.
+ * \return Entry of datagram.
+ */
+FragmentEntry *FragmentTable::lookup(const FragmentKey &key, time_t ts)
+{
+   uint64_t hash = XXH64(&key, sizeof(key), 0);
+   FragmentEntry *bucket = entries + (hash & (size / FRAG_BUCKET_SIZE - 1)) * FRAG_BUCKET_SIZE;
+   FragmentEntry *entry = NULL, *oldest = bucket;
+
+   for (int i = 0; i < FRAG_BUCKET_SIZE; i++) {
+      FragmentEntry &cur = bucket[i];
+      bool expired = !cur.used || ts - cur.last > (time_t) timeout;
+
+      if (!expired && !memcmp(&cur.key, &key, sizeof(key))) {
+         cur.last = ts;
+         return &cur;
+      }
+      if (expired) {
+         if (cur.used) {
+            drop(cur);
+         }
+         if (entry == NULL) {
+            entry = &cur;
+         }
+      } else if (cur.last < oldest->last) {
+         oldest = &cur;
+      }
+   }
+
+   if (entry == NULL) {
+      entry = oldest;
+      evicted++;
+      drop(*entry);
+   }
+
+   entry->key = key;
+   entry->last = ts;
+   entry->used = true;
+   entry->first_seen = false;
+   entry->reassemble = (buffers != NULL && key.ip_proto == IPPROTO_UDP);
+   entry->done = false;
+   entry->datagram_len = 0;
+   entry->held_cnt = 0;
+   memset(entry->blocks, 0, sizeof(entry->blocks));
+   return entry;
+}
+
+/**
+ * \brief Store fragment data to reassembly buffer of datagram.
+ * \param [in,out] entry Entry of datagram.
+ * \param [in] pkt Parsed fragment.
+ * \param [in] hdr_len Length of network headers of fragment.
+ * \param [in] data Fragment data or NULL if fragment was not captured whole.
+ * \param [in] len Length of fragment data.
+ * \return FRAG_HOLD, FRAG_REASSEMBLED when fragment completed datagram or FRAG_PASS when datagram cannot be reassembled.
+ */
+int FragmentTable::reassemble(FragmentEntry &entry, const Packet &pkt, uint16_t hdr_len, const char *data, uint16_t len)
+{
+   uint32_t end = pkt.frag_off + len;
+
+   if (data == NULL || end > FRAG_MAX_DATAGRAM || (pkt.frag_more && (len & 7) != 0) ||
+      (pkt.frag_off == 0 && (len < 8 || ntohs(*(const uint16_t *) (data + 4)) > FRAG_MAX_DATAGRAM)) ||
+      (entry.datagram_len != 0 && (end > entry.datagram_len || (!pkt.frag_more && end != entry.datagram_len))) ||
+      hdr_len > FRAG_HELD_HDR || entry.held_cnt == FRAG_MAX_HELD) {
+      entry.reassemble = false;
+      failed++;
+      release(entry);
+      return FRAG_PASS;
+   }
+
+   memcpy(entry.data + pkt.frag_off, data, len);
+   for (uint32_t block = pkt.frag_off / 8; block < (end + 7) / 8; block++) {
+      entry.blocks[block / 64] |= (uint64_t) 1 << (block % 64);
+   }
+   if (!pkt.frag_more) {
+      entry.datagram_len = end;
+   }
+
+   bool complete = (entry.datagram_len >= 8);
+   uint32_t blocks = (entry.datagram_len + 7) / 8;
+   for (uint32_t i = 0; complete && i < blocks / 64; i++) {
+      complete = (entry.blocks[i] == ~(uint64_t) 0);
+   }
+   if (complete && blocks % 64 != 0) {
+      uint64_t mask = ((uint64_t) 1 << (blocks % 64)) - 1;
+      complete = ((entry.blocks[blocks / 64] & mask) == mask);
+   }
+
+   if (!complete) {
+      /* Keep parsed fragment and its headers, its data are already in reassembly buffer. */
+      FragmentHeld &held = entry.held[entry.held_cnt++];
+      held.pkt = pkt;
+      held.hdr_len = hdr_len;
+      held.data_len = (pkt.total_length > hdr_len ? pkt.total_length - hdr_len : 0);
+      if (held.data_len > len) {
+         /* Drop link layer trailer, it is not stored in reassembly buffer. */
+         uint16_t trailer = held.data_len - len;
+         held.data_len = len;
+         held.pkt.total_length -= trailer;
+         held.pkt.payload_length = (pkt.payload_length > trailer ? pkt.payload_length - trailer : 0);
+      }
+      memcpy(held.hdr, pkt.packet, hdr_len);
+      return FRAG_HOLD;
+   }
+
+   entry.done = true;
+   reassembled++;
+   return FRAG_REASSEMBLED;
+}
+
+/**
+ * \brief Track fragment of IP datagram.
+ *
+ * Non-first fragments get ports of first fragment if it was already seen, their payload is hidden
+ * because it does not start with transport header.
+ * \param [in,out] pkt Parsed fragment.
+ * \param [in] hdr_len Length of network headers of fragment.
+ * \param [in] data Fragment data following network headers or NULL if fragment was not captured whole.
+ * \param [in] len Length of fragment data.
+ * \param [out] datagram Reassembled IP payload when FRAG_REASSEMBLED is returned.
+ * \param [out] datagram_len Length of reassembled IP payload.
+ * \return FRAG_PASS, FRAG_HOLD or FRAG_REASSEMBLED.
+ */
+int FragmentTable::add(Packet &pkt, uint16_t hdr_len, const char *data, uint16_t len, const char *&datagram, uint16_t &datagram_len)
+{
+   FragmentKey key;
+
+   memset(&key, 0, sizeof(key));
+   if (pkt.ip_version == 4) {
+      key.src_ip.v4 = pkt.src_ip.v4;
+      key.dst_ip.v4 = pkt.dst_ip.v4;
+   } else {
+      memcpy(key.src_ip.v6, pkt.src_ip.v6, 16);
+      memcpy(key.dst_ip.v6, pkt.dst_ip.v6, 16);
+   }
+   key.id = pkt.frag_id;
+   key.ip_proto = pkt.ip_proto;
+   key.ip_version = pkt.ip_version;
+
+   fragments++;
+   FragmentEntry *entry = lookup(key, pkt.timestamp.tv_sec);
+   if (pkt.frag_off == 0) {
+      if (!entry->first_seen) {
+         entry->first_seen = true;
+         entry->src_port = pkt.src_port;
+         entry->dst_port = pkt.dst_port;
+         entry->l4_flags = pkt.field_indicator & (PCKT_TCP | PCKT_UDP | PCKT_ICMP | PCKT_PAYLOAD);
+      }
+   } else {
+      if (entry->first_seen) {
+         pkt.src_port = entry->src_port;
+         pkt.dst_port = entry->dst_port;
+         pkt.field_indicator |= entry->l4_flags;
+         attributed++;
+      } else {
+         unattributed++;
+      }
+      pkt.payload_length = 0;
+   }
+
+   if (!entry->reassemble) {
+      return FRAG_PASS;
+   }
+   if (entry->done) {
+      /* Late duplicate of fragment of reassembled datagram. */
+      duplicate++;
+      return FRAG_HOLD;
+   }
+   int ret = reassemble(*entry, pkt, hdr_len, data, len);
+   if (ret == FRAG_REASSEMBLED) {
+      datagram = entry->data;
+      datagram_len = entry->datagram_len;
+   }
+   return ret;
+}
+
+/**
+ * \brief Get next fragment released from table.
+ * \param [out] pkt Packet with MAXPCKTSIZE + 1 bytes of data storage where fragment is stored.
+ * \return True if fragment was stored, false when there are no released fragments.
+ */
+bool FragmentTable::get_released(Packet &pkt)
+{
+   if (released_next == released.size()) {
+      released.clear();
+      released_next = 0;
+      return false;
+   }
+
+   const FragmentReleased &frag = released[released_next++];
+   char *packet = pkt.packet;
+
+   pkt = frag.held.pkt;
+   pkt.packet = packet;
+   memcpy(packet, frag.held.hdr, frag.held.hdr_len);
+   memcpy(packet + frag.held.hdr_len, frag.data.data(), frag.data.size());
+   packet[pkt.total_length] = 0;
+   pkt.payload = packet + pkt.total_length - pkt.payload_length; /* Payload always spans to end of captured data. */
+   return true;
+}
+
+/**
+ * \brief Stop tracking datagrams which timed out and release their held fragments.
+ *
+ * Used on live capture, where entry of datagram is otherwise expired only when its bucket is looked up again.
+ * \param [in] now Current time in seconds.
+ */
+void FragmentTable::expire(time_t now)
+{
+   for (uint32_t i = 0; i < size; i++) {
+      if (entries[i].used && now - entries[i].last > (time_t) timeout) {
+         drop(entries[i]);
+      }
+   }
+}
+
+/**
+ * \brief Stop tracking all datagrams and release fragments held for reassembly, used when capture ends.
+ */
+void FragmentTable::flush()
+{
+   for (uint32_t i = 0; i < size; i++) {
+      if (entries[i].used) {
+         drop(entries[i]);
+      }
+   }
+}
+
+/**
+ * \brief Print fragment statistics.
+ */
+void FragmentTable::print_report() const
+{
+   cout << "IP fragments: " << fragments << " (" << attributed << " attributed to flow, " << unattributed << " not attributed), " <<
+      evicted << " table evictions" << endl;
+   if (buffers != NULL) {
+      cout << "IP reassembly: " << reassembled << " datagrams reassembled, " << failed << " failed (" << released_cnt << " fragments released), " <<
+         duplicate << " duplicate fragments" << endl;
+   }
+}
@@ -0,0 +1,166 @@
+/**
+ * \file fragmenttable.h
+ * \brief Tracking and reassembly of IP fragments (FragmentTable class)
+ * \author Jiri Havranek <havraji6@fit.cvut.cz>
+ * \date 2018
+ */
+/*
+ * Copyright (C) 2018 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#ifndef FRAGMENTTABLE_H
+#define FRAGMENTTABLE_H
+
+#include <stdint.h>
+#include <time.h>
+#include <string>
+#include <vector>
+
+#include "packet.h"
+
+#define FRAG_BUCKET_SIZE 4                      /**< Number of entries in one bucket of fragment table. */
+#define FRAG_MAX_DATAGRAM MAXPCKTSIZE           /**< Max size of reassembled IP payload, larger datagrams are only tracked. */
+#define FRAG_BLOCK_WORDS ((FRAG_MAX_DATAGRAM / 8 + 63) / 64) /**< Number of words of bitmap of received 8 byte blocks. */
+#define FRAG_MAX_HELD 32    /**< Max number of fragments of one datagram held for reassembly. */
+#define FRAG_HELD_HDR 128   /**< Max length of network headers of held fragment. */
+
+#define FRAG_PASS 0         /**< Pass fragment to flow cache. */
+#define FRAG_HOLD 1         /**< Fragment is stored for reassembly, do not pass it to flow cache. */
+#define FRAG_REASSEMBLED 2  /**< Fragment completed datagram, pass reassembled datagram to flow cache instead. */
+
+#define DEFAULT_FRAG_ENTRIES 1024   /**< Default number of entries of fragment table. */
+#define DEFAULT_FRAG_TIMEOUT 3      /**< Default time in seconds fragments of one datagram are tracked. */
+
+/**
+ * \brief Key of fragmented datagram.
+ */
+struct FragmentKey {
+   ipaddr_t src_ip;
+   ipaddr_t dst_ip;
+   uint32_t id;
+   uint8_t ip_proto;
+   uint8_t ip_version;
+   uint16_t padding;
+};
+
+/**
+ * \brief Fragment held for reassembly, data following network headers are kept in reassembly buffer.
+ */
+struct FragmentHeld {
+   Packet pkt;                   /**< Parsed fragment, packet and payload pointers are not valid. */
+   uint16_t hdr_len;             /**< Length of network headers. */
+   uint16_t data_len;            /**< Length of captured data following network headers. */
+   char hdr[FRAG_HELD_HDR];      /**< Network headers. */
+};
+
+/**
+ * \brief Held fragment of datagram which was not reassembled, waiting to be passed to flow cache.
+ */
+struct FragmentReleased {
+   FragmentHeld held;            /**< Parsed fragment and its network headers. */
+   std::string data;             /**< Data following network headers. */
+};
+
+/**
+ * \brief Entry of fragment table describing one fragmented datagram.
+ */
+struct FragmentEntry {
+   FragmentKey key;
+   time_t last;                        /**< Timestamp of last fragment in seconds. */
+   bool used;                          /**< Entry describes datagram, it can still be expired. */
+   uint16_t src_port;                  /**< Source port from first fragment. */
+   uint16_t dst_port;                  /**< Destination port from first fragment. */
+   uint16_t l4_flags;                  /**< Transport protocol bits of Packet::field_indicator of first fragment. */
+   bool first_seen;                    /**< First fragment was seen and ports are valid. */
+   bool reassemble;                    /**< Datagram is reassembled, false if reassembly failed. */
+   bool done;                          /**< Datagram was reassembled. */
+   uint16_t datagram_len;              /**< Length of IP payload, 0 until last fragment is seen. */
+   uint64_t blocks[FRAG_BLOCK_WORDS];  /**< Bitmap of received 8 byte blocks. */
+   char *data;                         /**< Reassembly buffer of FRAG_MAX_DATAGRAM bytes or NULL. */
+   FragmentHeld *held;                 /**< Fragments held for reassembly, array of FRAG_MAX_HELD items or NULL. */
+   uint8_t held_cnt;                   /**< Number of held fragments. */
+};
+
+/**
+ * \brief Table of recently seen fragmented IP datagrams.
+ *
+ * Non-first fragments carry no transport header, table remembers ports from first fragment
+ * of datagram and assigns them to following fragments, so all fragments belong to the same flow.
+ * Table has fixed number of entries, entries are reused after timeout or the oldest entry of bucket
+ * is evicted. Optionally UDP datagrams up to FRAG_MAX_DATAGRAM bytes are reassembled, their fragments
+ * are replaced by one packet containing whole datagram, as if the datagram was not fragmented.
+ * Fragments of datagram which times out, is evicted or cannot be reassembled are released
+ * and must be passed to flow cache later, so they are not missing in flow counters.
+ */
+class FragmentTable
+{
+   FragmentEntry *entries; /**< Array of entries. */
+   char *buffers;          /**< Reassembly buffers of all entries or NULL. */
+   FragmentHeld *held;     /**< Held fragments of all entries or NULL. */
+   std::vector<FragmentReleased> released; /**< Released fragments. */
+   size_t released_next;   /**< Index of next released fragment to be passed to flow cache. */
+   uint32_t size;          /**< Number of entries, power of two. */
+   uint32_t timeout;       /**< Time in seconds fragments of one datagram are tracked. */
+
+   uint64_t fragments;     /**< Number of fragments. */
+   uint64_t attributed;    /**< Non-first fragments which got ports of first fragment. */
+   uint64_t unattributed;  /**< Non-first fragments seen before first fragment or after entry was dropped. */
+   uint64_t evicted;       /**< Entries replaced before timeout. */
+   uint64_t reassembled;   /**< Reassembled datagrams. */
+   uint64_t failed;        /**< Datagrams which could not be reassembled. */
+   uint64_t duplicate;     /**< Fragments received after their datagram was reassembled. */
+   uint64_t released_cnt;  /**< Held fragments released because their datagram was not reassembled. */
+
+   FragmentTable(const FragmentTable &);
+   FragmentTable &operator=(const FragmentTable &);
+
+   FragmentEntry *lookup(const FragmentKey &key, time_t ts);
+   int reassemble(FragmentEntry &entry, const Packet &pkt, uint16_t hdr_len, const char *data, uint16_t len);
+   void drop(FragmentEntry &entry);
+   void release(FragmentEntry &entry);
+
+public:
+   FragmentTable(uint32_t entries, uint32_t timeout, bool reassembly);
+   ~FragmentTable();
+
+   int add(Packet &pkt, uint16_t hdr_len, const char *data, uint16_t len, const char *&datagram, uint16_t &datagram_len);
+   bool get_released(Packet &pkt);
+   void expire(time_t now);
+   void flush();
+   void print_report() const;
+};
+
+#endif
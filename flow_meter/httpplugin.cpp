@@ -51,6 +51,7 @@
 #include "flowifc.h"
 #include "httpplugin.h"
 #include "ipfix-elements.h"
+#include "strscan.h"
 
 using namespace std;
 
@@ -73,6 +74,7 @@ using namespace std;
 #define HTTP_UNIREC_TEMPLATE  "HTTP_REQUEST_METHOD,HTTP_REQUEST_HOST,HTTP_REQUEST_URL,HTTP_REQUEST_AGENT,HTTP_REQUEST_REFERER,HTTP_RESPONSE_STATUS_CODE,HTTP_RESPONSE_CONTENT_TYPE"
 #define HTTP_LINE_DELIMITER   '\n'
 #define HTTP_KEYVAL_DELIMITER ':'
+#define HTTP_SCAN_DELIMITERS  " \n:"
 
 UR_FIELDS (
    string HTTP_REQUEST_METHOD,
@@ -164,6 +166,27 @@ void HTTPPlugin::finish()
    }
 }
 
+/**
+ * \brief Plugin processes HTTP traffic on port 80 only.
+ */
+plugin_interest HTTPPlugin::get_interest()
+{
+   return plugin_interest().port(80);
+}
+
+/**
+ * \brief Create HTTP extension saved in flow cache checkpoint.
+ */
+RecordExt *HTTPPlugin::deserialize(extTypeEnum type, const uint8_t *data, int size)
+{
+   if (type == http_request) {
+      return RecordExtHTTPReq::deserialize(data, size);
+   } else if (type == http_response) {
+      return RecordExtHTTPResp::deserialize(data, size);
+   }
+   return NULL;
+}
+
 string HTTPPlugin::get_unirec_field_string()
 {
    return HTTP_UNIREC_TEMPLATE;
@@ -192,6 +215,8 @@ void copy_str(char *dst, ssize_t size, const char *begin, const char *end)
    ssize_t len = end - begin;
    if (len >= size) {
       len = size - 1;
+   } else if (len < 0) {
+      len = 0;
    }
 
    memcpy(dst, begin, len);
@@ -202,6 +227,18 @@ void copy_str(char *dst, ssize_t size, const char *begin, const char *end)
    dst[len] = 0;
 }
 
+/**
+ * \brief Check name of header field.
+ * \param [in] line Header line.
+ * \param [in] name Expected field name.
+ * \param [in] len Length of expected field name.
+ * \return True if field name matches.
+ */
+static inline bool field_is(const scan_line &line, const char *name, size_t len)
+{
+   return (size_t) (line.delim - line.begin) == len && !memcmp(line.begin, name, len);
+}
+
 #ifdef DEBUG_HTTP
 static uint32_t s_requests = 0, s_responses = 0;
 #endif /* DEBUG_HTTP */
@@ -217,7 +254,9 @@ static uint32_t s_requests = 0, s_responses = 0;
 bool HTTPPlugin::parse_http_request(const char *data, int payload_len, RecordExtHTTPReq *rec, bool create)
 {
    char buffer[64];
-   const char *begin, *end, *keyval_delimiter;
+   const char *begin, *end;
+   scan_iter it;
+   scan_line line;
 
    total++;
 
@@ -239,15 +278,18 @@ bool HTTPPlugin::parse_http_request(const char *data, int payload_len, RecordExt
     * ----- ------------ data
     */
 
+   /* Classify spaces, line and field delimiters of whole header in one pass. */
+   scan_init(it, data, data + payload_len, HTTP_SCAN_DELIMITERS);
+
    /* Find begin of URI. */
-   begin = strchr(data, ' ');
+   begin = scan_find(it, ' ');
    if (begin == NULL) {
       DEBUG_MSG("Parser quits:\tnot a http request header\n");
       return false;
    }
 
    /* Find end of URI. */
-   end = strchr(begin + 1, ' ');
+   end = scan_find(it, ' ');
    if (end == NULL) {
       DEBUG_MSG("Parser quits:\trequest is fragmented\n");
       return false;
@@ -273,7 +315,7 @@ bool HTTPPlugin::parse_http_request(const char *data, int payload_len, RecordExt
    DEBUG_MSG("\tURI: %s\n",      rec->uri);
 
    /* Find begin of next line after request line. */
-   begin = strchr(end, HTTP_LINE_DELIMITER);
+   begin = scan_find(it, HTTP_LINE_DELIMITER);
    if (begin == NULL) {
       DEBUG_MSG("Parser quits:\tNo line delim after request line\n");
       return false;
@@ -293,36 +335,33 @@ bool HTTPPlugin::parse_http_request(const char *data, int payload_len, RecordExt
    rec->user_agent[0] = 0;
    rec->referer[0] = 0;
    /* Process headers. */
-   while (begin - data < payload_len) {
-      end = strchr(begin, HTTP_LINE_DELIMITER);
-      keyval_delimiter = strchr(begin, HTTP_KEYVAL_DELIMITER);
-
-      int tmp = end - begin;
-      if (tmp == 0 || tmp == 1) { /* Check for blank line with \r\n or \n ending. */
-         break; /* Double LF found - end of header section. */
-      } else if (end == NULL || keyval_delimiter == NULL) {
+   while (begin < data + payload_len) {
+      if (!scan_next_line(it, begin, HTTP_KEYVAL_DELIMITER, line)) {
          DEBUG_MSG("Parser quits:\theader is fragmented\n");
          return  false;
       }
+      begin = line.end + 1;
 
-      /* Copy field name. */
-      copy_str(buffer, sizeof(buffer), begin, keyval_delimiter);
+      if (line.end - line.begin <= 1) { /* Check for blank line with \r\n or \n ending. */
+         break; /* Double LF found - end of header section. */
+      } else if (line.delim == NULL) {
+         DEBUG_MSG("\tSkipping line without field delimiter\n");
+         continue;
+      }
 
+      DEBUG_CODE(copy_str(buffer, sizeof(buffer), line.begin, line.delim));
       DEBUG_CODE(char debug_buffer[4096]);
-      DEBUG_CODE(copy_str(debug_buffer, sizeof(debug_buffer), keyval_delimiter + 2, end));
+      DEBUG_CODE(copy_str(debug_buffer, sizeof(debug_buffer), line.delim + 2, line.end));
       DEBUG_MSG("\t%s: %s\n", buffer, debug_buffer);
 
       /* Copy interesting field values. */
-      if (!strcmp(buffer, "Host")) {
-         copy_str(rec->host, sizeof(rec->host), keyval_delimiter + 2, end);
-      } else if (!strcmp(buffer, "User-Agent")) {
-         copy_str(rec->user_agent, sizeof(rec->user_agent), keyval_delimiter + 2, end);
-      } else if (!strcmp(buffer, "Referer")) {
-         copy_str(rec->referer, sizeof(rec->referer), keyval_delimiter + 2, end);
+      if (field_is(line, "Host", 4)) {
+         copy_str(rec->host, sizeof(rec->host), line.delim + 2, line.end);
+      } else if (field_is(line, "User-Agent", 10)) {
+         copy_str(rec->user_agent, sizeof(rec->user_agent), line.delim + 2, line.end);
+      } else if (field_is(line, "Referer", 7)) {
+         copy_str(rec->referer, sizeof(rec->referer), line.delim + 2, line.end);
       }
-
-      /* Go to next line. */
-      begin = end + 1 ;
    }
 
    DEBUG_MSG("Parser quits:\tend of header section\n");
@@ -341,7 +380,9 @@ bool HTTPPlugin::parse_http_request(const char *data, int payload_len, RecordExt
 bool HTTPPlugin::parse_http_response(const char *data, int payload_len, RecordExtHTTPResp *rec, bool create)
 {
    char buffer[64];
-   const char *begin, *end, *keyval_delimiter;
+   const char *begin, *end;
+   scan_iter it;
+   scan_line line;
    int code;
 
    total++;
@@ -356,7 +397,7 @@ bool HTTPPlugin::parse_http_response(const char *data, int payload_len, RecordEx
    }
 
    /* Check begin of response header. */
-   if (memcmp(data, "HTTP", 4)) {
+   if (payload_len < 4 || memcmp(data, "HTTP", 4)) {
       DEBUG_MSG("Parser quits:\tpacket contains http response data\n");
       return false;
    }
@@ -370,15 +411,18 @@ bool HTTPPlugin::parse_http_response(const char *data, int payload_len, RecordEx
     * --------------------- data
     */
 
+   /* Classify spaces, line and field delimiters of whole header in one pass. */
+   scan_init(it, data, data + payload_len, HTTP_SCAN_DELIMITERS);
+
    /* Find begin of status code. */
-   begin = strchr(data, ' ');
+   begin = scan_find(it, ' ');
    if (begin == NULL) {
       DEBUG_MSG("Parser quits:\tnot a http response header\n");
       return false;
    }
 
    /* Find end of status code. */
-   end = strchr(begin + 1, ' ');
+   end = scan_find(it, ' ');
    if (end == NULL) {
       DEBUG_MSG("Parser quits:\tresponse is fragmented\n");
       return false;
@@ -402,7 +446,7 @@ bool HTTPPlugin::parse_http_response(const char *data, int payload_len, RecordEx
    rec->code = code;
 
    /* Find begin of next line after request line. */
-   begin = strchr(end, HTTP_LINE_DELIMITER);
+   begin = scan_find(it, HTTP_LINE_DELIMITER);
    if (begin == NULL) {
       DEBUG_MSG("Parser quits:\tNo line delim after request line\n");
       return false;
@@ -420,32 +464,29 @@ bool HTTPPlugin::parse_http_response(const char *data, int payload_len, RecordEx
 
    rec->content_type[0] = 0;
    /* Process headers. */
-   while (begin - data < payload_len) {
-      end = strchr(begin, HTTP_LINE_DELIMITER);
-      keyval_delimiter = strchr(begin, HTTP_KEYVAL_DELIMITER);
-
-      int tmp = end - begin;
-      if (tmp == 0 || tmp == 1) { /* Check for blank line with \r\n or \n ending. */
-         break; /* Double LF found - end of header section. */
-      } else if (end == NULL || keyval_delimiter == NULL) {
+   while (begin < data + payload_len) {
+      if (!scan_next_line(it, begin, HTTP_KEYVAL_DELIMITER, line)) {
          DEBUG_MSG("Parser quits:\theader is fragmented\n");
          return  false;
       }
+      begin = line.end + 1;
 
-      /* Copy field name. */
-      copy_str(buffer, sizeof(buffer), begin, keyval_delimiter);
+      if (line.end - line.begin <= 1) { /* Check for blank line with \r\n or \n ending. */
+         break; /* Double LF found - end of header section. */
+      } else if (line.delim == NULL) {
+         DEBUG_MSG("\tSkipping line without field delimiter\n");
+         continue;
+      }
 
+      DEBUG_CODE(copy_str(buffer, sizeof(buffer), line.begin, line.delim));
       DEBUG_CODE(char debug_buffer[4096]);
-      DEBUG_CODE(copy_str(debug_buffer, sizeof(debug_buffer), keyval_delimiter + 2, end));
+      DEBUG_CODE(copy_str(debug_buffer, sizeof(debug_buffer), line.delim + 2, line.end));
       DEBUG_MSG("\t%s: %s\n", buffer, debug_buffer);
 
       /* Copy interesting field values. */
-      if (!strcmp(buffer, "Content-Type")) {
-         copy_str(rec->content_type, sizeof(rec->content_type), keyval_delimiter + 2, end);
+      if (field_is(line, "Content-Type", 12)) {
+         copy_str(rec->content_type, sizeof(rec->content_type), line.delim + 2, line.end);
       }
-
-      /* Go to next line. */
-      begin = end + 1 ;
    }
 
    DEBUG_MSG("Parser quits:\tend of header section\n");
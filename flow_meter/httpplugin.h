@@ -67,6 +67,9 @@ struct RecordExtHTTPReq : RecordExt {
    char user_agent[128];
    char referer[128];
 
+   RECORD_EXT_POOLED(http_request)
+   RECORD_EXT_SERIALIZED(RecordExtHTTPReq, method)
+
    /**
     * \brief Constructor.
     */
@@ -147,6 +150,9 @@ struct RecordExtHTTPResp : RecordExt {
    uint16_t code;
    char content_type[32];
 
+   RECORD_EXT_POOLED(http_response)
+   RECORD_EXT_SERIALIZED(RecordExtHTTPResp, code)
+
    /**
     * \brief Constructor.
     */
@@ -193,8 +199,10 @@ public:
    int post_create(Flow &rec, const Packet &pkt);
    int pre_update(Flow &rec, Packet &pkt);
    void finish();
+   plugin_interest get_interest();
    string get_unirec_field_string();
    const char **get_ipfix_string();
+   RecordExt *deserialize(extTypeEnum type, const uint8_t *data, int size);
 
 private:
    bool parse_http_request(const char *data, int payload_len, RecordExtHTTPReq *rec, bool create);
@@ -62,7 +62,9 @@ HTTPSPlugin::HTTPSPlugin(const options_t &module_options)
 {
    print_stats = module_options.print_stats;
    parsed_sni = 0;
+   total = 0;
    flow_flush = false;
+   streams = false;
    ext_ptr = NULL;
 }
 
@@ -70,14 +72,16 @@ HTTPSPlugin::HTTPSPlugin(const options_t &module_options, vector<plugin_opt> plu
 {
    print_stats = module_options.print_stats;
    parsed_sni = 0;
+   total = 0;
    flow_flush = false;
+   streams = false;
    ext_ptr = NULL;
 }
 
 int HTTPSPlugin::post_create(Flow &rec, const Packet &pkt)
 {
-   if (rec.src_port == 443 || rec.dst_port == 443) {
-      add_https_record(rec, pkt);
+   if (!streams && (rec.src_port == 443 || rec.dst_port == 443)) {
+      return add_https_record(rec, pkt);
    }
 
    return 0;
@@ -90,9 +94,49 @@ int HTTPSPlugin::pre_update(Flow &rec, Packet &pkt)
       if (ext != NULL) {
          return FLOW_FLUSH;
       }
-      add_https_record(rec, pkt);
+      if (!streams) {
+         return add_https_record(rec, pkt);
+      }
+   }
+
+   return 0;
+}
+
+void HTTPSPlugin::enable_streams()
+{
+   streams = true;
+}
+
+uint32_t HTTPSPlugin::stream_request(const Flow &rec, bool reverse)
+{
+   if (rec.src_port == 443 || rec.dst_port == 443) {
+      return sizeof(tls_rec);
+   }
+   return 0;
+}
+
+/**
+ * \brief Parse ClientHello from reassembled stream once its whole TLS record is available.
+ */
+uint32_t HTTPSPlugin::stream_data(Flow &rec, const char *data, uint32_t len, bool reverse)
+{
+   const tls_rec *tls = (const tls_rec *) data;
+   uint32_t rec_len = sizeof(tls_rec) + ntohs(tls->length);
+
+   if (tls->type != TLS_HANDSHAKE || rec.getExtension(https) != NULL) {
+      return 0;
+   }
+   if (len < rec_len) {
+      return rec_len;
    }
 
+   if (ext_ptr == NULL) {
+      ext_ptr = new RecordExtHTTPS();
+   }
+   if (parse_sni(data, rec_len, ext_ptr)) {
+      rec.addExtension(ext_ptr);
+      ext_ptr = NULL;
+   }
    return 0;
 }
 
@@ -189,7 +233,13 @@ bool HTTPSPlugin::parse_sni(const char *data, int payload_len, RecordExtHTTPS *r
    return false;
 }
 
-void HTTPSPlugin::add_https_record(Flow &rec, const Packet &pkt)
+/**
+ * \brief Add HTTPS extension to flow when packet contains ClientHello with SNI.
+ * \param [in,out] rec Flow record.
+ * \param [in] pkt Parsed packet.
+ * \return INSPECT_DONE when packet carries application data, ClientHello cannot follow in the flow.
+ */
+int HTTPSPlugin::add_https_record(Flow &rec, const Packet &pkt)
 {
    if (ext_ptr == NULL) {
       ext_ptr = new RecordExtHTTPS();
@@ -198,7 +248,10 @@ void HTTPSPlugin::add_https_record(Flow &rec, const Packet &pkt)
    if (parse_sni(pkt.payload, pkt.payload_length, ext_ptr)) {
       rec.addExtension(ext_ptr);
       ext_ptr = NULL;
+   } else if (pkt.payload_length >= sizeof(tls_rec) && ((const tls_rec *) pkt.payload)->type == TLS_APPLICATION_DATA) {
+      return INSPECT_DONE;
    }
+   return 0;
 }
 
 void HTTPSPlugin::finish()
@@ -210,6 +263,14 @@ void HTTPSPlugin::finish()
    }
 }
 
+/**
+ * \brief Plugin processes TLS traffic on port 443 only.
+ */
+plugin_interest HTTPSPlugin::get_interest()
+{
+   return plugin_interest().port(443);
+}
+
 const char *ipfix_https_template[] = {
    IPFIX_HTTPS_TEMPLATE(IPFIX_FIELD_NAMES)
    NULL
@@ -220,6 +281,14 @@ const char **HTTPSPlugin::get_ipfix_string()
    return ipfix_https_template;
 }
 
+/**
+ * \brief Create HTTPS extension saved in flow cache checkpoint.
+ */
+RecordExt *HTTPSPlugin::deserialize(extTypeEnum type, const uint8_t *data, int size)
+{
+   return (type == https ? RecordExtHTTPS::deserialize(data, size) : NULL);
+}
+
 string HTTPSPlugin::get_unirec_field_string()
 {
    return HTTPS_UNIREC_TEMPLATE;
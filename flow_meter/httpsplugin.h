@@ -60,6 +60,9 @@ using namespace std;
 struct RecordExtHTTPS : RecordExt {
    char sni[255];
 
+   RECORD_EXT_POOLED(https)
+   RECORD_EXT_SERIALIZED(RecordExtHTTPS, sni)
+
    /**
     * \brief Constructor.
     */
@@ -98,6 +101,7 @@ union __attribute__ ((packed)) tls_version {
 };
 
 #define TLS_HANDSHAKE 22
+#define TLS_APPLICATION_DATA 23
 struct __attribute__ ((packed)) tls_rec {
    uint8_t type;
    tls_version version;
@@ -138,13 +142,18 @@ public:
    HTTPSPlugin(const options_t &module_options, vector<plugin_opt> plugin_options);
    int post_create(Flow &rec, const Packet &pkt);
    int pre_update(Flow &rec, Packet &pkt);
+   void enable_streams();
+   uint32_t stream_request(const Flow &rec, bool reverse);
+   uint32_t stream_data(Flow &rec, const char *data, uint32_t len, bool reverse);
    void finish();
+   plugin_interest get_interest();
    const char **get_ipfix_string();
+   RecordExt *deserialize(extTypeEnum type, const uint8_t *data, int size);
    string get_unirec_field_string();
    bool include_basic_flow_fields();
 
 private:
-   void add_https_record(Flow &rec, const Packet &pkt);
+   int add_https_record(Flow &rec, const Packet &pkt);
    bool parse_sni(const char *data, int payload_len, RecordExtHTTPS *rec);
 
    RecordExtHTTPS *ext_ptr;
@@ -152,6 +161,7 @@ private:
    uint32_t total;
    uint32_t parsed_sni;
    bool flow_flush;
+   bool streams;           /**< ClientHello is parsed from reassembled TCP stream instead of single packets. */
 };
 
 #endif
@@ -0,0 +1,288 @@
+/**
+ * \file hugemem.cpp
+ * \brief Memory backed by huge pages and bound to NUMA node (HugeMem class)
+ * \author Jiri Havranek <havraji6@fit.cvut.cz>
+ * \date 2018
+ */
+/*
+ * Copyright (C) 2018 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sstream>
+
+#include "hugemem.h"
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+#ifndef MAP_HUGE_2MB
+#define MAP_HUGE_2MB (21 << MAP_HUGE_SHIFT)
+#endif
+#ifndef MAP_HUGE_1GB
+#define MAP_HUGE_1GB (30 << MAP_HUGE_SHIFT)
+#endif
+#ifndef MPOL_PREFERRED
+#define MPOL_PREFERRED 1
+#endif
+
+#define HUGE_2M (2UL << 20)
+#define HUGE_1G (1UL << 30)
+
+/**
+ * \brief Round size up to multiple of page size.
+ * \param [in] size Size to round.
+ * \param [in] pg_size Page size, power of two.
+ * \return Rounded size.
+ */
+static inline size_t round_up(size_t size, size_t pg_size)
+{
+   return (size + pg_size - 1) & ~(pg_size - 1);
+}
+
+/**
+ * \brief Format size in bytes with binary unit.
+ * \param [in] size Size in bytes.
+ * \return Size like 2 MiB.
+ */
+static string format_size(size_t size)
+{
+   ostringstream out;
+   if (size >= HUGE_1G && size % HUGE_1G == 0) {
+      out << (size >> 30) << " GiB";
+   } else if (size >= (1UL << 20)) {
+      out << (size >> 20) << " MiB";
+   } else {
+      out << (size >> 10) << " KiB";
+   }
+   return out.str();
+}
+
+HugeMem::HugeMem() : addr(NULL), length(0), page_size(0), thp(false), node(NUMA_NODE_NONE)
+{
+}
+
+HugeMem::~HugeMem()
+{
+   release();
+}
+
+/**
+ * \brief Map memory from hugetlb pool.
+ * \param [in] size Requested size.
+ * \param [in] pg_size Huge page size.
+ * \param [in] flags Flag selecting huge page size.
+ * \return True when pool had enough pages.
+ */
+bool HugeMem::map_hugetlb(size_t size, size_t pg_size, int flags)
+{
+#ifdef MAP_HUGETLB
+   size_t len = round_up(size, pg_size);
+   void *ptr = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | flags, -1, 0);
+   if (ptr == MAP_FAILED) {
+      return false;
+   }
+   addr = ptr;
+   length = len;
+   page_size = pg_size;
+   return true;
+#else
+   return false;
+#endif
+}
+
+/**
+ * \brief Map memory backed by regular pages.
+ * \param [in] size Requested size.
+ * \param [in] advise Align mapping to 2 MiB and ask kernel to back it by transparent huge pages.
+ * \return True on success.
+ */
+bool HugeMem::map_regular(size_t size, bool advise)
+{
+   page_size = sysconf(_SC_PAGESIZE);
+#ifdef MADV_HUGEPAGE
+   if (advise) {
+      /* Map one more huge page and trim both ends so that mapping starts on huge page boundary. */
+      size_t len = round_up(size, HUGE_2M);
+      uint8_t *ptr = (uint8_t *) mmap(NULL, len + HUGE_2M, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (ptr == MAP_FAILED) {
+         return false;
+      }
+      uint8_t *start = (uint8_t *) round_up((uintptr_t) ptr, HUGE_2M);
+      if (start != ptr) {
+         munmap(ptr, start - ptr);
+      }
+      munmap(start + len, ptr + len + HUGE_2M - (start + len));
+
+      addr = start;
+      length = len;
+      thp = (madvise(addr, length, MADV_HUGEPAGE) == 0);
+      return true;
+   }
+#endif
+   size_t len = round_up(size, page_size);
+   void *ptr = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+   if (ptr == MAP_FAILED) {
+      return false;
+   }
+   addr = ptr;
+   length = len;
+   return true;
+}
+
+/**
+ * \brief Prefer allocating pages of mapping on NUMA node, must be called before memory is touched.
+ * \param [in] numa_node Node number, NUMA_NODE_LOCAL or NUMA_NODE_NONE.
+ */
+void HugeMem::bind(int numa_node)
+{
+   node = NUMA_NODE_NONE;
+#if defined(SYS_mbind) && defined(SYS_getcpu)
+   if (numa_node == NUMA_NODE_LOCAL) {
+      unsigned int cpu, local;
+      if (syscall(SYS_getcpu, &cpu, &local, NULL) != 0) {
+         return;
+      }
+      numa_node = local;
+   }
+   if (numa_node < 0 || numa_node >= (int) sizeof(unsigned long) * 8 - 1) {
+      return;
+   }
+
+   /* Preferred policy falls back to other nodes instead of failing page faults when node is full. */
+   unsigned long mask = 1UL << numa_node;
+   if (syscall(SYS_mbind, addr, length, MPOL_PREFERRED, &mask, sizeof(mask) * 8, 0) == 0) {
+      node = numa_node;
+   }
+#endif
+}
+
+/**
+ * \brief Allocate memory, previous allocation is released.
+ * \param [in] size Requested size.
+ * \param [in] pages Preferred pages, one of HUGEPAGES_* values.
+ * \param [in] numa_node NUMA node number, NUMA_NODE_LOCAL or NUMA_NODE_NONE.
+ * \return Pointer to zeroed page aligned memory or NULL.
+ */
+void *HugeMem::alloc(size_t size, int pages, int numa_node)
+{
+   release();
+
+   bool mapped = false;
+   if (pages == HUGEPAGES_1G) {
+      mapped = map_hugetlb(size, HUGE_1G, MAP_HUGE_1GB);
+   }
+   if (!mapped && pages >= HUGEPAGES_2M) {
+      mapped = map_hugetlb(size, HUGE_2M, MAP_HUGE_2MB);
+   }
+   if (!mapped) {
+      mapped = map_regular(size, pages != HUGEPAGES_OFF);
+   }
+   if (!mapped) {
+      return NULL;
+   }
+
+   if (numa_node != NUMA_NODE_NONE) {
+      bind(numa_node);
+   }
+   return addr;
+}
+
+/**
+ * \brief Unmap memory.
+ */
+void HugeMem::release()
+{
+   if (addr != NULL) {
+      munmap(addr, length);
+   }
+   addr = NULL;
+   length = 0;
+   page_size = 0;
+   thp = false;
+   node = NUMA_NODE_NONE;
+}
+
+/**
+ * \brief Get amount of memory backed by transparent huge pages.
+ * \return Number of bytes according to /proc/self/smaps.
+ */
+size_t HugeMem::thp_backed() const
+{
+   FILE *smaps = fopen("/proc/self/smaps", "r");
+   if (smaps == NULL) {
+      return 0;
+   }
+
+   char line[256];
+   bool inside = false;
+   size_t backed = 0;
+   while (fgets(line, sizeof(line), smaps) != NULL) {
+      unsigned long start, end, kb;
+      if (sscanf(line, "%lx-%lx ", &start, &end) == 2) {
+         inside = (start < (uintptr_t) addr + length && end > (uintptr_t) addr);
+      } else if (inside && sscanf(line, "AnonHugePages: %lu kB", &kb) == 1) {
+         backed += kb << 10;
+      }
+   }
+   fclose(smaps);
+
+   /* Neighbouring mapping merged into the same area may be counted too. */
+   return (backed > length ? length : backed);
+}
+
+/**
+ * \brief Describe achieved page size and NUMA placement, should be called after memory was touched.
+ * \return Text like 512 MiB in 2 MiB pages on NUMA node 0.
+ */
+string HugeMem::describe() const
+{
+   ostringstream out;
+   out << format_size(length) << " in " << format_size(page_size) << " pages";
+   if (thp) {
+      out << ", " << format_size(thp_backed()) << " merged to transparent huge pages";
+   }
+   if (node >= 0) {
+      out << " on NUMA node " << node;
+   } else {
+      out << ", not bound to NUMA node";
+   }
+   return out.str();
+}
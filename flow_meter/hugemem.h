@@ -0,0 +1,109 @@
+/**
+ * \file hugemem.h
+ * \brief Memory backed by huge pages and bound to NUMA node (HugeMem class)
+ * \author Jiri Havranek <havraji6@fit.cvut.cz>
+ * \date 2018
+ */
+/*
+ * Copyright (C) 2018 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#ifndef HUGEMEM_H
+#define HUGEMEM_H
+
+#include <stddef.h>
+#include <string>
+
+using namespace std;
+
+#define HUGEPAGES_OFF 0 /**< Regular pages. */
+#define HUGEPAGES_THP 1 /**< Regular pages advised to be merged to transparent huge pages. */
+#define HUGEPAGES_2M  2 /**< 2 MiB pages from hugetlb pool, falls back to HUGEPAGES_THP. */
+#define HUGEPAGES_1G  3 /**< 1 GiB pages from hugetlb pool, falls back to HUGEPAGES_2M. */
+
+#define NUMA_NODE_NONE  -2 /**< Memory is not bound to any NUMA node. */
+#define NUMA_NODE_LOCAL -1 /**< Memory is bound to NUMA node of allocating thread. */
+
+/**
+ * \brief Anonymous memory mapping for large tables touched at random, like flow cache.
+ *
+ * Huge pages cut TLB misses of random accesses. Mapping falls back to smaller pages when
+ * hugetlb pool is empty or not configured, so allocation fails only when there is no memory at all.
+ */
+class HugeMem
+{
+   void *addr;       /**< Start of mapping or NULL. */
+   size_t length;    /**< Length of mapping. */
+   size_t page_size; /**< Size of pages backing mapping. */
+   bool thp;         /**< Transparent huge pages were advised. */
+   int node;         /**< NUMA node mapping is bound to or NUMA_NODE_NONE. */
+
+   HugeMem(const HugeMem &);
+   HugeMem &operator=(const HugeMem &);
+
+   bool map_hugetlb(size_t size, size_t pg_size, int flags);
+   bool map_regular(size_t size, bool advise);
+   void bind(int numa_node);
+   size_t thp_backed() const;
+
+public:
+   HugeMem();
+   ~HugeMem();
+
+   void *alloc(size_t size, int pages, int numa_node);
+   void release();
+   string describe() const;
+
+   /**
+    * \brief Get size of pages backing memory.
+    * \return Page size in bytes.
+    */
+   size_t get_page_size() const
+   {
+      return page_size;
+   }
+
+   /**
+    * \brief Get NUMA node memory is bound to.
+    * \return Node number or NUMA_NODE_NONE.
+    */
+   int get_node() const
+   {
+      return node;
+   }
+};
+
+#endif
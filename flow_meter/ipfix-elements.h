@@ -89,6 +89,11 @@
 #define L4_PORT_SRC(F)                F(0,        7,    2,   &flow.src_port)
 #define L4_PORT_DST(F)                F(0,       11,    2,   &flow.dst_port)
 #define L4_ICMP_TYPE_CODE(F)          F(0,       32,    2,   NULL)
+#define BYTES_REV(F)                  F(29305,    1,    8,   &flow.rev_octet_total_length)
+#define PACKETS_REV(F)                F(29305,    2,    8,   (temp = (uint64_t) flow.rev_pkt_total_cnt, &temp))
+#define L4_TCP_FLAGS_REV(F)           F(29305,    6,    1,   &flow.rev_tcp_control_bits)
+#define SAMPLING_INTERVAL(F)          F(0,       34,    4,   &flow.sampling_interval)
+#define FLOW_END_REASON(F)            F(0,      136,    1,   &flow.end_reason)
 #define HTTP_USERAGENT(F)             F(16982,  100,   -1,   NULL)
 #define HTTP_METHOD(F)                F(16982,  101,   -1,   NULL)
 #define HTTP_DOMAIN(F)                F(16982,  102,   -1,   NULL)
@@ -164,6 +169,10 @@
 #define SMTP_CODE_4XX_COUNT(F)        F(8057,    818,   4,   NULL)
 #define SMTP_CODE_5XX_COUNT(F)        F(8057,    819,   4,   NULL)
 #define SMTP_DOMAIN(F)                F(8057,    820,  -1,   NULL)
+#define TUNNEL_TYPE(F)                F(8057,    821,   1,   NULL)
+#define TUNNEL_ID(F)                  F(8057,    822,   4,   NULL)
+#define TUNNEL_SRC_IP(F)              F(8057,    823,  -1,   NULL)
+#define TUNNEL_DST_IP(F)              F(8057,    824,  -1,   NULL)
 
 /**
  * IPFIX Templates - list of elements
@@ -216,6 +225,20 @@
    F(L2_SRC_MAC) \
    F(L2_DST_MAC)
 
+/* Reverse direction counters (RFC 5103), appended to basic template in biflow mode. */
+#define BASIC_TMPLT_REV(F) \
+   F(BYTES_REV) \
+   F(PACKETS_REV) \
+   F(L4_TCP_FLAGS_REV)
+
+/* Packet sampling interval, appended to basic template when sampling is enabled. */
+#define BASIC_TMPLT_SAMPLING(F) \
+   F(SAMPLING_INTERVAL)
+
+/* Reason of flow export, appended to basic template when TCP connections are tracked. */
+#define BASIC_TMPLT_END_REASON(F) \
+   F(FLOW_END_REASON)
+
 #define IPFIX_HTTP_TEMPLATE(F) \
    F(HTTP_USERAGENT) \
    F(HTTP_METHOD) \
@@ -296,6 +319,12 @@
    F(SIP_REQUEST_URI) \
    F(SIP_VIA)
 
+#define IPFIX_TUNNEL_TEMPLATE(F) \
+   F(TUNNEL_TYPE) \
+   F(TUNNEL_ID) \
+   F(TUNNEL_SRC_IP) \
+   F(TUNNEL_DST_IP)
+
 /**
  * List of all known templated.
  *
@@ -306,6 +335,9 @@
    PACKET_TMPLT(F) \
    BASIC_TMPLT_V4(F) \
    BASIC_TMPLT_V6(F) \
+   BASIC_TMPLT_REV(F) \
+   BASIC_TMPLT_SAMPLING(F) \
+   BASIC_TMPLT_END_REASON(F) \
    IPFIX_HTTP_TEMPLATE(F) \
    IPFIX_HTTPS_TEMPLATE(F) \
    IPFIX_NTP_TEMPLATE(F) \
@@ -313,7 +345,8 @@
    IPFIX_SIP_TEMPLATE(F) \
    IPFIX_DNS_TEMPLATE(F) \
    IPFIX_PASSIVEDNS_TEMPLATE(F) \
-   IPFIX_SMTP_TEMPLATE(F)
+   IPFIX_SMTP_TEMPLATE(F) \
+   IPFIX_TUNNEL_TEMPLATE(F)
 
 
 /**
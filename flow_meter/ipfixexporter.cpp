@@ -41,6 +41,7 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
+#include <sys/uio.h>
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <arpa/inet.h>
@@ -126,11 +127,44 @@ const char *basic_tmplt_v6[] = {
    NULL
 };
 
+/* Reverse direction counters appended to basic templates in biflow mode. */
+const char *basic_tmplt_rev[] = {
+   BASIC_TMPLT_REV(IPFIX_FIELD_NAMES)
+   NULL
+};
+
+/* Sampling interval appended to basic templates. */
+const char *basic_tmplt_sampling[] = {
+   BASIC_TMPLT_SAMPLING(IPFIX_FIELD_NAMES)
+   NULL
+};
+
+/* Flow end reason appended to basic templates. */
+const char *basic_tmplt_end_reason[] = {
+   BASIC_TMPLT_END_REASON(IPFIX_FIELD_NAMES)
+   NULL
+};
+
+/**
+ * \brief Append NULL terminated list of template fields to basic template.
+ * \param [in,out] tmplt Basic template without terminating NULL.
+ * \param [in] fields Fields to append.
+ */
+static void append_fields(vector<const char *> &tmplt, const char **fields)
+{
+   for (; *fields != NULL; fields++) {
+      tmplt.push_back(*fields);
+   }
+}
+
 IPFIXExporter::IPFIXExporter()
 {
    templateArray = NULL;
    templates = NULL;
    templatesDataSize = 0;
+   maxMsgSize = PACKET_DATA_SIZE;
+   tmpltBufferSize = PACKET_DATA_SIZE - IPFIX_HEADER_SIZE;
+   sendBuffer = NULL;
    tmpltMapping = NULL;
    basic_ifc_num = -1;
    verbose = false;
@@ -150,6 +184,10 @@ IPFIXExporter::IPFIXExporter()
    odid = 0;
    templateRefreshTime = TEMPLATE_REFRESH_TIME;
    templateRefreshPackets = TEMPLATE_REFRESH_PACKETS;
+   dir_bit_field = 0;
+   biflow = false;
+   sampling = false;
+   end_reason = false;
 }
 
 IPFIXExporter::~IPFIXExporter()
@@ -178,6 +216,7 @@ void IPFIXExporter::shutdown()
    template_t *tmp = templates;
    while (tmp != NULL) {
       templates = templates->next;
+      free(tmp->buffer);
       free(tmp);
       tmp = templates;
    }
@@ -187,11 +226,15 @@ void IPFIXExporter::shutdown()
       delete [] tmpltMapping;
       tmpltMapping = NULL;
    }
+   if (sendBuffer) {
+      delete [] sendBuffer;
+      sendBuffer = NULL;
+   }
 }
 
 int IPFIXExporter::export_flow(Flow &flow)
 {
-   RecordExt *ext = flow.exts;
+   uint32_t mask = flow.ext_mask;
    template_t *tmplt;
    int ipv6_tmplt = 0;
 
@@ -199,7 +242,7 @@ int IPFIXExporter::export_flow(Flow &flow)
       ipv6_tmplt = 1;
    }
 
-   if (ext == NULL && basic_ifc_num >= 0) {
+   if (mask == 0 && basic_ifc_num >= 0) {
       tmplt = templateArray[basic_ifc_num * 2 + ipv6_tmplt];
 
       int length = fill_basic_flow(flow, tmplt);
@@ -212,11 +255,16 @@ int IPFIXExporter::export_flow(Flow &flow)
       tmplt->bufferSize += length;
       tmplt->recordCount++;
    } else {
-      while (ext != NULL) {
-         int tmplt_num = tmpltMapping[ext->extType];
-         if (tmplt_num >= 0) {
-            tmplt = templateArray[tmplt_num * 2 + ipv6_tmplt];
+      while (mask) {
+         int type = __builtin_ctz(mask);
+         int tmplt_num = tmpltMapping[type];
+         mask &= mask - 1;
+         if (tmplt_num < 0) {
+            continue;
+         }
 
+         tmplt = templateArray[tmplt_num * 2 + ipv6_tmplt];
+         for (RecordExt *ext = flow.exts[type]; ext != NULL; ext = ext->next) {
             int length_basic = fill_basic_flow(flow, tmplt);
             if (length_basic == -1) {
                send_templates();
@@ -226,20 +274,19 @@ int IPFIXExporter::export_flow(Flow &flow)
             }
 
             int length_ext = ext->fillIPFIX(tmplt->buffer + tmplt->bufferSize + length_basic,
-                              TEMPLATE_BUFFER_SIZE - tmplt->bufferSize - length_basic);
+                              tmpltBufferSize - tmplt->bufferSize - length_basic);
             if (length_ext == -1) {
                send_templates();
                send_data();
 
                length_basic = fill_basic_flow(flow, tmplt);
                length_ext = ext->fillIPFIX(tmplt->buffer + tmplt->bufferSize + length_basic,
-                              TEMPLATE_BUFFER_SIZE - tmplt->bufferSize - length_basic);
+                              tmpltBufferSize - tmplt->bufferSize - length_basic);
             }
 
             tmplt->bufferSize += length_basic + length_ext;
             tmplt->recordCount++;
          }
-         ext = ext->next;
       }
    }
 
@@ -248,14 +295,19 @@ int IPFIXExporter::export_flow(Flow &flow)
 
 int IPFIXExporter::export_packet(Packet &pkt)
 {
-   RecordExt *ext = pkt.exts;
+   uint32_t mask = pkt.ext_mask;
    template_t *tmplt;
 
-   while (ext != NULL) {
-      int tmplt_num = tmpltMapping[ext->extType];
-      if (tmplt_num >= 0) {
-         tmplt = templateArray[tmplt_num * 2];
+   while (mask) {
+      int type = __builtin_ctz(mask);
+      int tmplt_num = tmpltMapping[type];
+      mask &= mask - 1;
+      if (tmplt_num < 0) {
+         continue;
+      }
 
+      tmplt = templateArray[tmplt_num * 2];
+      for (RecordExt *ext = pkt.exts[type]; ext != NULL; ext = ext->next) {
          int length_packet = fill_packet_fields(pkt, tmplt);
          if (length_packet == -1) {
             send_templates();
@@ -265,20 +317,19 @@ int IPFIXExporter::export_packet(Packet &pkt)
          }
 
          int length_ext = ext->fillIPFIX(tmplt->buffer + tmplt->bufferSize + length_packet,
-               TEMPLATE_BUFFER_SIZE - tmplt->bufferSize - length_packet);
+               tmpltBufferSize - tmplt->bufferSize - length_packet);
          if (length_ext == -1) {
             send_templates();
             send_data();
 
             length_packet = fill_packet_fields(pkt, tmplt);
             length_ext = ext->fillIPFIX(tmplt->buffer + tmplt->bufferSize + length_packet,
-                  TEMPLATE_BUFFER_SIZE - tmplt->bufferSize - length_packet);
+                  tmpltBufferSize - tmplt->bufferSize - length_packet);
          }
 
          tmplt->bufferSize += length_packet + length_ext;
          tmplt->recordCount++;
       }
-      ext = ext->next;
    }
    return 0;
 }
@@ -292,11 +343,36 @@ int IPFIXExporter::export_packet(Packet &pkt)
  * @param host Collector address
  * @param port Collector port
  * @param udp Use UDP instead of TCP
+ * @param biflow Export counters of reverse direction
+ * @param sampling Export sampling interval
+ * @param end_reason Export reason of flow export
+ * @param msg_size Maximal size of IPFIX message
  * @return Returns 0 on succes, non 0 otherwise.
  */
-int IPFIXExporter::init(const vector<FlowCachePlugin *> &plugins, int basic_num, uint32_t odid, string host, string port, bool udp, bool verbose, uint8_t dir)
+int IPFIXExporter::init(const vector<FlowCachePlugin *> &plugins, int basic_num, uint32_t odid, string host, string port, bool udp, bool verbose, uint8_t dir, bool biflow,
+      bool sampling, bool end_reason, uint16_t msg_size)
 {
    int ret, templateCnt;
+   vector<const char *> basic_fields_v4, basic_fields_v6;
+
+   append_fields(basic_fields_v4, basic_tmplt_v4);
+   append_fields(basic_fields_v6, basic_tmplt_v6);
+   if (biflow) {
+      append_fields(basic_fields_v4, basic_tmplt_rev);
+      append_fields(basic_fields_v6, basic_tmplt_rev);
+   }
+   if (sampling) {
+      append_fields(basic_fields_v4, basic_tmplt_sampling);
+      append_fields(basic_fields_v6, basic_tmplt_sampling);
+   }
+   if (end_reason) {
+      append_fields(basic_fields_v4, basic_tmplt_end_reason);
+      append_fields(basic_fields_v6, basic_tmplt_end_reason);
+   }
+   basic_fields_v4.push_back(NULL);
+   basic_fields_v6.push_back(NULL);
+   const char **basic_v4 = &basic_fields_v4[0];
+   const char **basic_v6 = &basic_fields_v6[0];
 
    if (verbose) {
       fprintf(stderr, "VERBOSE: IPFIX export plugin init start\n");
@@ -314,14 +390,26 @@ int IPFIXExporter::init(const vector<FlowCachePlugin *> &plugins, int basic_num,
    this->odid = odid;
    basic_ifc_num = basic_num;
    this->dir_bit_field = dir;
+   this->biflow = biflow;
+   this->sampling = sampling;
+   this->end_reason = end_reason;
 
    if (udp) {
       protocol = IPPROTO_UDP;
    }
 
+   if (msg_size < PACKET_DATA_SIZE || (udp && msg_size > IPFIX_MAX_UDP_MSG_SIZE)) {
+      fprintf(stderr, "Invalid IPFIX message size %u.\n", msg_size);
+      shutdown();
+      return 1;
+   }
+   maxMsgSize = msg_size;
+   tmpltBufferSize = msg_size - IPFIX_HEADER_SIZE;
+   sendBuffer = new char[maxMsgSize * IPFIX_SEND_BATCH];
+
    if (basic_num >= 0) {
-      templateArray[basic_ifc_num * 2] = create_template(basic_tmplt_v4, NULL);
-      templateArray[basic_ifc_num * 2 + 1] = create_template(basic_tmplt_v6, NULL);
+      templateArray[basic_ifc_num * 2] = create_template(basic_v4, NULL);
+      templateArray[basic_ifc_num * 2 + 1] = create_template(basic_v6, NULL);
 
       if (templateArray[basic_ifc_num * 2] == NULL || templateArray[basic_ifc_num * 2 + 1] == NULL) {
          fprintf(stderr, "IPFIX template creation failed.\n");
@@ -346,8 +434,8 @@ int IPFIXExporter::init(const vector<FlowCachePlugin *> &plugins, int basic_num,
 
       if (ifc >= 0) {
          if (tmp->include_basic_flow_fields()) {
-            templateArray[ifc * 2] = create_template(basic_tmplt_v4, tmp->get_ipfix_string());
-            templateArray[ifc * 2 + 1] = create_template(basic_tmplt_v6, tmp->get_ipfix_string());
+            templateArray[ifc * 2] = create_template(basic_v4, tmp->get_ipfix_string());
+            templateArray[ifc * 2 + 1] = create_template(basic_v6, tmp->get_ipfix_string());
          } else {
             templateArray[ifc * 2] = create_template(packet_tmplt, tmp->get_ipfix_string());
          }
@@ -521,6 +609,12 @@ template_t *IPFIXExporter::create_template(const char **tmplt, const char **ext)
       fprintf(stderr, "Error: Not enough memory for IPFIX template.\n");
       return NULL;
    }
+   newTemplate->buffer = (uint8_t *) malloc(tmpltBufferSize);
+   if (!newTemplate->buffer) {
+      fprintf(stderr, "Error: Not enough memory for IPFIX template.\n");
+      free(newTemplate);
+      return NULL;
+   }
    newTemplate->fieldCount = 0;
    newTemplate->recordCount = 0;
 
@@ -559,6 +653,7 @@ template_t *IPFIXExporter::create_template(const char **tmplt, const char **ext)
             /* Set element length */
             if (tmpFileRecord->length == 0) {
                fprintf(stderr, "Error: Template field cannot be zero length.\n");
+               free(newTemplate->buffer);
                free(newTemplate);
                return NULL;
             } else {
@@ -580,6 +675,7 @@ template_t *IPFIXExporter::create_template(const char **tmplt, const char **ext)
             newTemplate->fieldCount++;
          } else {
             fprintf(stderr, "Error: Cannot find field specification for name %s\n", *tmp);
+            free(newTemplate->buffer);
             free(newTemplate);
             return NULL;
          }
@@ -684,7 +780,9 @@ uint16_t IPFIXExporter::create_template_packet(ipfix_packet_t *packet)
 /**
  * \brief Creates data packet from template buffers
  *
- * Removes the data from the template buffers
+ * Removes the data from the template buffers. Data sets of as many templates as fit into
+ * maximal message size are packed into the packet, the rest stays in buffers.
+ * Sequence number is filled in by send_packets().
  *
  * @param packet Pointer to packet to fill
  * @return length of the IPFIX data packet on success, 0 otherwise
@@ -703,7 +801,7 @@ uint16_t IPFIXExporter::create_data_packet(ipfix_packet_t *packet)
    templatesDataSize = 0; /* Erase total data size */
    while (tmp != NULL) {
       /* Add only templates with data that fits to one packet */
-      if (tmp->recordCount > 0 && totalSize + tmp->bufferSize <= PACKET_DATA_SIZE) {
+      if (tmp->recordCount > 0 && totalSize + tmp->bufferSize <= maxMsgSize) {
          memcpy(ptr, tmp->buffer, tmp->bufferSize);
          /* Set SET length */
          ((ipfix_template_set_header_t *) ptr)->length = htons(tmp->bufferSize);
@@ -761,20 +859,28 @@ void IPFIXExporter::send_templates()
 
 /**
  * \brief Send data in all buffers to collector
+ *
+ * Data are packed into as few messages as possible, up to IPFIX_SEND_BATCH messages
+ * are passed to kernel at once.
  */
 void IPFIXExporter::send_data()
 {
-   char buffer[PACKET_DATA_SIZE];
-   ipfix_packet_t pkt;
-   pkt.data = buffer;
+   ipfix_packet_t pkts[IPFIX_SEND_BATCH];
+   int cnt, sent;
+
+   do {
+      for (cnt = 0; cnt < IPFIX_SEND_BATCH; cnt++) {
+         pkts[cnt].data = sendBuffer + cnt * maxMsgSize;
+         if (!create_data_packet(&pkts[cnt])) {
+            break;
+         }
+      }
 
-   /* Send all new templates */
-   if (create_data_packet(&pkt)) {
-      if (send_packet(&pkt) == 1) {
-         /* Collector reconnected, resend the packet */
-         send_packet(&pkt);
+      if (cnt > 0 && send_packets(pkts, cnt, sent) == 1) {
+         /* Collector reconnected, resend the packets which were not sent */
+         send_packets(pkts + sent, cnt - sent, sent);
       }
-   }
+   } while (cnt == IPFIX_SEND_BATCH);
 }
 
 /**
@@ -799,81 +905,149 @@ void IPFIXExporter::flush()
  */
 int IPFIXExporter::send_packet(ipfix_packet_t *packet)
 {
-   int ret; /* Return value of sendto */
-   int sent = 0; /* Sent data size */
+   int sent;
+
+   return send_packets(packet, 1, sent);
+}
+
+/**
+ * \brief Sends packets using UDP or TCP as defined in plugin configuration
+ *
+ * TCP stream is written by writev(), UDP datagrams are sent by sendmmsg() when available.
+ * When the collector disconnects, tries to reconnect and resend the data
+ *
+ * \param packets Array of packets to send
+ * \param cnt Number of packets, at most IPFIX_SEND_BATCH
+ * \param sent Number of packets which were sent whole, only the rest needs to be resent after reconnect
+ * \return 0 on success, -1 on socket error, 1 when data needs to be resent (after reconnect)
+ */
+int IPFIXExporter::send_packets(ipfix_packet_t *packets, int cnt, int &sent)
+{
+   struct iovec iov[IPFIX_SEND_BATCH];
+   uint32_t seq = sequenceNum;
+   ssize_t ret;
+
+   sent = 0;
 
    /* Check that connection is OK or drop packet */
    if (reconnect()) {
       return -1;
    }
 
-   /* sendto() does not guarantee that everything will be send in one piece */
-   while (sent < packet->length) {
-      /* Send data to collector (TCP and SCTP ignores last two arguments) */
-      ret = sendto(fd, (void *) (packet->data + sent), packet->length - sent, 0,
-            addrinfo->ai_addr, addrinfo->ai_addrlen);
-
-      /* Check that the data were sent correctly */
-      if (ret == -1) {
-         switch (errno) {
-         case 0: break; /* OK */
-         case ECONNRESET:
-         case EINTR:
-         case ENOTCONN:
-         case ENOTSOCK:
-         case EPIPE:
-         case EHOSTUNREACH:
-         case ENETDOWN:
-         case ENETUNREACH:
-         case ENOBUFS:
-         case ENOMEM:
-
-            /* The connection is broken */
-            if (verbose) {
-               fprintf(stderr, "VERBOSE: Collector closed connection\n");
-            }
-
-            /* free resources */
-            close(fd);
-            fd = -1;
-            freeaddrinfo(addrinfo);
-
-            /* Set last connection try time so that we would reconnect immediatelly */
-            lastReconnect = 1;
-
-            /* Reset the sequences number since it is unique per connection */
-            sequenceNum = 0;
-            ((ipfix_header_t *) packet->data)->sequenceNumber = 0; /* no need to change byteorder of 0 */
+   /* Sequence number of a message is the number of data records sent before it */
+   for (int i = 0; i < cnt; i++) {
+      ((ipfix_header_t *) packets[i].data)->sequenceNumber = htonl(seq);
+      seq += packets[i].flows;
+      iov[i].iov_base = packets[i].data;
+      iov[i].iov_len = packets[i].length;
+   }
 
-            /* Say that we should try to connect and send data again */
-            return 1;
-         default:
-            /* Unknown error */
-            if (verbose) {
-               perror("VERBOSE: Cannot send data to collector");
-            }
-            return -1;
+   if (protocol == IPPROTO_UDP) {
+      /* Every message is sent in its own datagram */
+#ifdef HAVE_SENDMMSG
+      struct mmsghdr msgs[IPFIX_SEND_BATCH];
+
+      memset(msgs, 0, sizeof(msgs[0]) * cnt);
+      for (int i = 0; i < cnt; i++) {
+         msgs[i].msg_hdr.msg_name = addrinfo->ai_addr;
+         msgs[i].msg_hdr.msg_namelen = addrinfo->ai_addrlen;
+         msgs[i].msg_hdr.msg_iov = &iov[i];
+         msgs[i].msg_hdr.msg_iovlen = 1;
+      }
+      while (sent < cnt) {
+         ret = sendmmsg(fd, msgs + sent, cnt - sent, 0);
+         if (ret == -1) {
+            return send_error();
          }
+         sent += ret;
       }
+#else
+      for (; sent < cnt; sent++) {
+         if (sendto(fd, iov[sent].iov_base, iov[sent].iov_len, 0, addrinfo->ai_addr, addrinfo->ai_addrlen) == -1) {
+            return send_error();
+         }
+      }
+#endif
+   } else {
+      /* writev() does not guarantee that everything will be send in one piece */
+      while (sent < cnt) {
+         ret = writev(fd, iov + sent, cnt - sent);
+         if (ret == -1) {
+            return send_error();
+         }
 
-      /* No error from sendto(), add sent data count to total */
-      sent += ret;
+         /* Skip written messages and move to the rest of partially written one */
+         while (sent < cnt && (size_t) ret >= iov[sent].iov_len) {
+            ret -= iov[sent].iov_len;
+            sent++;
+         }
+         if (sent < cnt) {
+            iov[sent].iov_base = (char *) iov[sent].iov_base + ret;
+            iov[sent].iov_len -= ret;
+         }
+      }
    }
 
    /* Update sequence number for next packet */
-   sequenceNum += packet->flows;
+   sequenceNum = seq;
 
    /* Increase packet counter */
-   exportedPackets++;
+   exportedPackets += cnt;
 
    if (verbose) {
-      fprintf(stderr, "VERBOSE: Packet (%" PRIu64 ") sent to %s on port %s. Next sequence number is %i\n",
-            exportedPackets, host.c_str(), port.c_str(), sequenceNum);
+      fprintf(stderr, "VERBOSE: %i packets (%" PRIu64 " total) sent to %s on port %s. Next sequence number is %i\n",
+            cnt, exportedPackets, host.c_str(), port.c_str(), sequenceNum);
    }
 
    return 0;
 }
 
+/**
+ * \brief Handle error of send call, close the connection when it is broken
+ *
+ * \return 1 when data needs to be resent (after reconnect), -1 otherwise
+ */
+int IPFIXExporter::send_error()
+{
+   switch (errno) {
+   case ECONNRESET:
+   case EINTR:
+   case ENOTCONN:
+   case ENOTSOCK:
+   case EPIPE:
+   case EHOSTUNREACH:
+   case ENETDOWN:
+   case ENETUNREACH:
+   case ENOBUFS:
+   case ENOMEM:
+
+      /* The connection is broken */
+      if (verbose) {
+         fprintf(stderr, "VERBOSE: Collector closed connection\n");
+      }
+
+      /* free resources */
+      close(fd);
+      fd = -1;
+      freeaddrinfo(addrinfo);
+
+      /* Set last connection try time so that we would reconnect immediatelly */
+      lastReconnect = 1;
+
+      /* Reset the sequences number since it is unique per connection */
+      sequenceNum = 0;
+
+      /* Say that we should try to connect and send data again */
+      return 1;
+   default:
+      /* Unknown error */
+      if (verbose) {
+         perror("VERBOSE: Cannot send data to collector");
+      }
+      return -1;
+   }
+}
+
 /**
  * \brief Create connection to collector
  *
@@ -1022,7 +1196,7 @@ int IPFIXExporter::fill_packet_fields(Packet &pkt, template_t *tmplt)
 {
    uint8_t *buffer;
 
-   if (tmplt->bufferSize + 22 > TEMPLATE_BUFFER_SIZE) {
+   if (tmplt->bufferSize + 22 > tmpltBufferSize) {
       return -1;
    }
 
@@ -1049,6 +1223,18 @@ BASIC_TMPLT_V4(GEN_FILLFIELDS_INT) \
 BASIC_TMPLT_V6(GEN_FILLFIELDS_INT) \
 } while (0)
 
+#define GENERATE_FILL_FIELDS_REV() do { \
+BASIC_TMPLT_REV(GEN_FILLFIELDS_INT) \
+} while (0)
+
+#define GENERATE_FILL_FIELDS_SAMPLING() do { \
+BASIC_TMPLT_SAMPLING(GEN_FILLFIELDS_INT) \
+} while (0)
+
+#define GENERATE_FILL_FIELDS_END_REASON() do { \
+BASIC_TMPLT_END_REASON(GEN_FILLFIELDS_INT) \
+} while (0)
+
 #define GENERATE_FIELDS_SUMLEN(TMPL) TMPL(GEN_FIELDS_SUMLEN_INT) 0
 
 /**
@@ -1062,11 +1248,14 @@ int IPFIXExporter::fill_basic_flow(Flow &flow, template_t *tmplt)
    uint8_t *buffer, *p;
    int length;
    uint64_t temp;
+   int rev_length = (biflow ? GENERATE_FIELDS_SUMLEN(BASIC_TMPLT_REV) : 0);
+   int extra_length = (sampling ? GENERATE_FIELDS_SUMLEN(BASIC_TMPLT_SAMPLING) : 0) +
+      (end_reason ? GENERATE_FIELDS_SUMLEN(BASIC_TMPLT_END_REASON) : 0);
 
    buffer = tmplt->buffer + tmplt->bufferSize;
    p = buffer;
    if (flow.ip_version == 4) {
-      if (tmplt->bufferSize + GENERATE_FIELDS_SUMLEN(BASIC_TMPLT_V4) > TEMPLATE_BUFFER_SIZE) {
+      if (tmplt->bufferSize + GENERATE_FIELDS_SUMLEN(BASIC_TMPLT_V4) + rev_length + extra_length > tmpltBufferSize) {
          return -1;
       }
 
@@ -1084,7 +1273,7 @@ int IPFIXExporter::fill_basic_flow(Flow &flow, template_t *tmplt)
 #endif
 
    } else {
-      if (tmplt->bufferSize + GENERATE_FIELDS_SUMLEN(BASIC_TMPLT_V6) > TEMPLATE_BUFFER_SIZE) {
+      if (tmplt->bufferSize + GENERATE_FIELDS_SUMLEN(BASIC_TMPLT_V6) + rev_length + extra_length > tmpltBufferSize) {
          return -1;
       }
 
@@ -1102,6 +1291,24 @@ int IPFIXExporter::fill_basic_flow(Flow &flow, template_t *tmplt)
 #endif
    }
 
+   if (biflow) {
+#if GCC_CHECK_PRAGMA
+# pragma GCC diagnostic push
+# pragma GCC diagnostic ignored "-Wstrict-aliasing"
+#endif
+      /* Generate code for copying reverse direction counters into IPFIX message. */
+      GENERATE_FILL_FIELDS_REV();
+#if GCC_CHECK_PRAGMA
+# pragma GCC diagnostic pop
+#endif
+   }
+   if (sampling) {
+      GENERATE_FILL_FIELDS_SAMPLING();
+   }
+   if (end_reason) {
+      GENERATE_FILL_FIELDS_END_REASON();
+   }
+
    length = p - buffer;
 
    return length;
@@ -50,9 +50,11 @@ using namespace std;
 #define FIRST_TEMPLATE_ID 258
 #define IPFIX_VERISON 10
 #define PACKET_DATA_SIZE 1458 /* ethernet 14, ip 20, udp 8 */
+#define IPFIX_MAX_MSG_SIZE 65535 /* length field of IPFIX header */
+#define IPFIX_MAX_UDP_MSG_SIZE 65507 /* ip 20, udp 8 */
+#define IPFIX_SEND_BATCH 16 /* maximal number of messages passed to kernel in one syscall */
 #define IPFIX_HEADER_SIZE 16
 #define IPFIX_SET_HEADER_SIZE 4
-#define TEMPLATE_BUFFER_SIZE (PACKET_DATA_SIZE - IPFIX_HEADER_SIZE)
 #define RECONNECT_TIMEOUT 60
 #define TEMPLATE_REFRESH_TIME 600
 #define TEMPLATE_REFRESH_PACKETS 0
@@ -71,7 +73,7 @@ typedef struct template_t {
 	uint16_t id; /**< Template ID */
 	uint8_t templateRecord[200]; /**< Buffer for template record */
 	uint16_t templateSize; /**< Size of template record buffer */
-	uint8_t buffer[TEMPLATE_BUFFER_SIZE]; /**< Buffer with data for template */
+	uint8_t *buffer; /**< Buffer with data for template */
 	uint16_t bufferSize; /**< Size of data buffer */
 	uint16_t recordCount; /**< Number of records in buffer */
 	uint16_t fieldCount; /**< Number of elements in template */
@@ -190,14 +192,18 @@ public:
    ~IPFIXExporter();
    int export_flow(Flow &flow);
    int export_packet(Packet &pkt);
-   int init(const vector<FlowCachePlugin *> &plugins, int basic_ifc_num, uint32_t odid, string host, string port, bool udp, bool verbose, uint8_t dir = 1);
+   int init(const vector<FlowCachePlugin *> &plugins, int basic_ifc_num, uint32_t odid, string host, string port, bool udp, bool verbose, uint8_t dir = 1, bool biflow = false,
+      bool sampling = false, bool end_reason = false, uint16_t msg_size = PACKET_DATA_SIZE);
    void flush();
    void shutdown();
 private:
 	/* Templates */
 	template_t **templateArray;
 	template_t *templates; /**< Templates in use by plugin */
-	uint16_t templatesDataSize; /**< Total data size stored in templates */
+	uint32_t templatesDataSize; /**< Total data size stored in templates */
+	uint16_t maxMsgSize; /**< Maximal size of IPFIX message */
+	uint16_t tmpltBufferSize; /**< Size of template data buffer, data sets of one template fit into one message */
+	char *sendBuffer; /**< Buffer for IPFIX_SEND_BATCH data messages */
    int *tmpltMapping;
    int basic_ifc_num;
    bool verbose;
@@ -219,6 +225,9 @@ private:
 	uint32_t templateRefreshTime; /**< UDP template refresh time interval */
 	uint32_t templateRefreshPackets; /**< UDP template refresh packet interval */
    uint8_t dir_bit_field;     /**< Direction bit field value. */
+   bool biflow;               /**< Export counters of reverse direction. */
+   bool sampling;             /**< Export sampling interval. */
+   bool end_reason;           /**< Export reason of flow export. */
 
    void init_template_buffer(template_t *tmpl);
    int fill_template_set_header(char *ptr, uint16_t size);
@@ -232,6 +241,8 @@ private:
    void send_templates();
    void send_data();
    int send_packet(ipfix_packet_t *packet);
+   int send_packets(ipfix_packet_t *packets, int cnt, int &sent);
+   int send_error();
    int connect_to_collector();
    int reconnect();
    int fill_basic_flow(Flow &flow, template_t *tmplt);
@@ -48,6 +48,9 @@
 #include <cstdlib>
 #include <iostream>
 #include <sys/time.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #include "nhtflowcache.h"
 #include "flowcache.h"
@@ -60,19 +63,39 @@ inline __attribute__((always_inline)) bool FlowRecord::is_empty() const
    return hash == 0;
 }
 
-inline __attribute__((always_inline)) bool FlowRecord::belongs(uint64_t pkt_hash) const
+inline __attribute__((always_inline)) bool FlowRecord::belongs(uint64_t pkt_hash, const char *pkt_key, uint8_t pkt_key_len) const
+{
+   return pkt_hash == hash && pkt_key_len == key_len && !memcmp(pkt_key, key, key_len);
+}
+
+inline __attribute__((always_inline)) bool FlowRecord::has_hash(uint64_t pkt_hash) const
 {
    return pkt_hash == hash;
 }
 
-void FlowRecord::create(const Packet &pkt, uint64_t pkt_hash)
+/**
+ * \brief Get tag of flow record stored in flow line, never equal to FLOW_TAG_EMPTY.
+ * \param [in] hash Hash of flow key.
+ * \return Tag from upper hash bits (lower bits select flow line).
+ */
+static inline uint8_t flow_tag(uint64_t hash)
+{
+   uint8_t tag = hash >> 56;
+   return (tag == FLOW_TAG_EMPTY ? 1 : tag);
+}
+
+void FlowRecord::create(const Packet &pkt, uint64_t pkt_hash, const char *pkt_key, uint8_t pkt_key_len, bool pkt_key_swapped)
 {
    flow.pkt_total_cnt = 1;
 
    hash = pkt_hash;
+   key_len = pkt_key_len;
+   key_swapped = pkt_key_swapped;
+   memcpy(key, pkt_key, pkt_key_len);
 
    flow.time_first = pkt.timestamp;
    flow.time_last = pkt.timestamp;
+   flow.sampling_interval = pkt.sampling_interval;
 
    memcpy(flow.src_mac, pkt.src_mac, 6);
    memcpy(flow.dst_mac, pkt.dst_mac, 6);
@@ -108,10 +131,22 @@ void FlowRecord::create(const Packet &pkt, uint64_t pkt_hash)
    }
 }
 
-void FlowRecord::update(const Packet &pkt)
+void FlowRecord::update(const Packet &pkt, bool pkt_key_swapped)
 {
-   flow.pkt_total_cnt++;
    flow.time_last = pkt.timestamp;
+
+   if (pkt_key_swapped != key_swapped) {
+      /* Packet goes in opposite direction than the first packet of flow. */
+      flow.rev_pkt_total_cnt++;
+      flow.rev_octet_total_length += pkt.ip_length;
+
+      if (pkt.field_indicator & PCKT_TCP) {
+         flow.rev_tcp_control_bits |= pkt.tcp_control_bits;
+      }
+      return;
+   }
+
+   flow.pkt_total_cnt++;
    flow.octet_total_length += pkt.ip_length;
 
    if (pkt.field_indicator & PCKT_TCP) {
@@ -119,21 +154,106 @@ void FlowRecord::update(const Packet &pkt)
    }
 }
 
-void NHTFlowCache::init()
+/**
+ * \brief Copy flow key and basic fields of flow into checkpoint record.
+ * \param [out] rec Checkpoint record.
+ */
+void FlowRecord::save(checkpoint_flow &rec) const
 {
+   rec.key_len = key_len;
+   rec.key_swapped = key_swapped;
+   memcpy(rec.key, key, key_len);
+   rec.end_reason = flow.end_reason;
+
+   rec.time_first_sec = flow.time_first.tv_sec;
+   rec.time_first_usec = flow.time_first.tv_usec;
+   rec.time_last_sec = flow.time_last.tv_sec;
+   rec.time_last_usec = flow.time_last.tv_usec;
+   rec.octet_total_length = flow.octet_total_length;
+   rec.rev_octet_total_length = flow.rev_octet_total_length;
+   rec.pkt_total_cnt = flow.pkt_total_cnt;
+   rec.rev_pkt_total_cnt = flow.rev_pkt_total_cnt;
+   rec.sampling_interval = flow.sampling_interval;
+   rec.src_port = flow.src_port;
+   rec.dst_port = flow.dst_port;
+   rec.src_ip = flow.src_ip;
+   rec.dst_ip = flow.dst_ip;
+   memcpy(rec.src_mac, flow.src_mac, 6);
+   memcpy(rec.dst_mac, flow.dst_mac, 6);
+   rec.tcp_control_bits = flow.tcp_control_bits;
+   rec.rev_tcp_control_bits = flow.rev_tcp_control_bits;
+   rec.ip_version = flow.ip_version;
+   rec.ip_tos = flow.ip_tos;
+   rec.ip_ttl = flow.ip_ttl;
+   rec.ip_proto = flow.ip_proto;
+}
+
+/**
+ * \brief Fill empty flow record from checkpoint record. Plugins do not inspect loaded flow and
+ * its TCP streams are not reassembled, because they would miss data seen before checkpoint.
+ * \param [in] rec Checkpoint record.
+ * \param [in] rec_hash Hash of flow key.
+ */
+void FlowRecord::load(const checkpoint_flow &rec, uint64_t rec_hash)
+{
+   hash = rec_hash;
+   key_len = rec.key_len;
+   key_swapped = rec.key_swapped;
+   memcpy(key, rec.key, key_len);
+   streams_off = true;
+
+   flow.end_reason = rec.end_reason;
+   flow.inspect_mask = 0;
+   flow.time_first.tv_sec = rec.time_first_sec;
+   flow.time_first.tv_usec = rec.time_first_usec;
+   flow.time_last.tv_sec = rec.time_last_sec;
+   flow.time_last.tv_usec = rec.time_last_usec;
+   flow.octet_total_length = rec.octet_total_length;
+   flow.rev_octet_total_length = rec.rev_octet_total_length;
+   flow.pkt_total_cnt = rec.pkt_total_cnt;
+   flow.rev_pkt_total_cnt = rec.rev_pkt_total_cnt;
+   flow.sampling_interval = rec.sampling_interval;
+   flow.src_port = rec.src_port;
+   flow.dst_port = rec.dst_port;
+   flow.src_ip = rec.src_ip;
+   flow.dst_ip = rec.dst_ip;
+   memcpy(flow.src_mac, rec.src_mac, 6);
+   memcpy(flow.dst_mac, rec.dst_mac, 6);
+   flow.tcp_control_bits = rec.tcp_control_bits;
+   flow.rev_tcp_control_bits = rec.rev_tcp_control_bits;
+   flow.ip_version = rec.ip_version;
+   flow.ip_tos = rec.ip_tos;
+   flow.ip_ttl = rec.ip_ttl;
+   flow.ip_proto = rec.ip_proto;
+}
+
+int NHTFlowCache::init()
+{
+   if (report_mem) {
+      cout << "Flow cache memory: " << cache_mem.describe() << endl;
+   }
+   if (reass != NULL) {
+      plugins_enable_streams();
+   }
    plugins_init();
+   return 0;
 }
 
 void NHTFlowCache::finish()
 {
+   ext_pool.bind();
+   if (reass != NULL) {
+      reass->bind();
+   }
    plugins_finish();
 
-   for (unsigned int i = 0; i < size; i++) {
+   for (unsigned int i = 0; i < size + victim_size; i++) {
       if (!flow_array[i]->is_empty()) {
          plugins_pre_export(flow_array[i]->flow);
-         exporter->export_flow(flow_array[i]->flow);
+         export_record(flow_array[i]->flow, FLOW_END_FORCED);
 
          flow_array[i]->erase();
+         flow_tags[i] = FLOW_TAG_EMPTY;
 #ifdef FLOW_CACHE_STATS
          expired++;
 #endif /* FLOW_CACHE_STATS */
@@ -147,6 +267,13 @@ void NHTFlowCache::finish()
 
 int NHTFlowCache::put_pkt(Packet &pkt)
 {
+   if (RecordExtPool::current() != &ext_pool) {
+      ext_pool.bind(); /* Cache is used from this thread. */
+      if (reass != NULL) {
+         reass->bind();
+      }
+   }
+
    int ret = plugins_pre_create(pkt);
 
    if (ret == EXPORT_PACKET) {
@@ -155,23 +282,33 @@ int NHTFlowCache::put_pkt(Packet &pkt)
       return 0;
    }
 
-   if (!create_hash_key(pkt)) { // saves key value and key length into attributes NHTFlowCache::key and NHTFlowCache::key_len
+   if (!create_hash_key(pkt, key, key_len, key_swapped)) { // saves key value and key length into attributes NHTFlowCache::key and NHTFlowCache::key_len
       return 0;
    }
 
-   uint64_t hashval = XXH64(key, key_len, 0); /* Calculates hash value from key created before. */
+   /* Calculates hash value from key created before. */
+   uint64_t hashval = key_hash(key, key_len);
 
    FlowRecord *flow; /* Pointer to flow we will be working with. */
    bool found = false;
+   uint8_t tag = flow_tag(hashval);
    uint32_t line_index = hashval & line_size_mask; /* Get index of flow line. */
-   uint32_t flow_index = 0, next_line = line_index + line_size;
+   uint32_t flow_index = 0;
 
-   /* Find existing flow record in flow cache. */
-   for (flow_index = line_index; flow_index < next_line; flow_index++) {
-      if (flow_array[flow_index]->belongs(hashval)) {
+   /* Find existing flow record in flow cache, only records with matching tag are accessed. */
+   uint32_t candidates = match_tags(line_index, tag);
+   while (candidates) {
+      flow_index = line_index + __builtin_ctz(candidates);
+      if (flow_array[flow_index]->belongs(hashval, key, key_len)) {
          found = true;
          break;
       }
+#ifdef FLOW_CACHE_STATS
+      if (flow_array[flow_index]->has_hash(hashval)) {
+         collisions++; /* Same hash, different key. */
+      }
+#endif /* FLOW_CACHE_STATS */
+      candidates &= candidates - 1;
    }
 
    if (found) {
@@ -181,48 +318,41 @@ int NHTFlowCache::put_pkt(Packet &pkt)
       lookups2 += (flow_index - line_index + 1) * (flow_index - line_index + 1);
 #endif /* FLOW_CACHE_STATS */
 
-      flow = flow_array[flow_index];
-      for (uint32_t j = flow_index; j > line_index; j--) {
-         flow_array[j] = flow_array[j - 1];
-      }
-
-      flow_array[line_index] = flow;
+      move_record(flow_index, line_index);
+      flow_index = line_index;
+#ifdef FLOW_CACHE_STATS
+      hits++;
+#endif /* FLOW_CACHE_STATS */
+   } else if (victim_size != 0 && restore(line_index, hashval, tag)) {
+      /* Flow record was moved back from victim area to the first index of flow line. */
       flow_index = line_index;
 #ifdef FLOW_CACHE_STATS
       hits++;
+      victim_hits++;
 #endif /* FLOW_CACHE_STATS */
    } else {
       /* Existing flow record was not found. Find free place in flow line. */
-      for (flow_index = line_index; flow_index < next_line; flow_index++) {
-         if (flow_array[flow_index]->is_empty()) {
-            found = true;
-            break;
-         }
-      }
-      if (!found) {
-         /* If free place was not found (flow line is full), find
-          * record which will be replaced by new record. */
-         flow_index = next_line - 1;
-
-         // Export flow
-         plugins_pre_export(flow_array[flow_index]->flow);
-         exporter->export_flow(flow_array[flow_index]->flow);
-
+      uint32_t free_slots = match_tags(line_index, FLOW_TAG_EMPTY);
+      if (free_slots) {
+         flow_index = line_index + __builtin_ctz(free_slots);
 #ifdef FLOW_CACHE_STATS
-         expired++;
+         empty++;
 #endif /* FLOW_CACHE_STATS */
-         uint32_t flow_new_index = line_index + 8;
-         flow = flow_array[flow_index];
-         flow->erase();
-         for (uint32_t j = flow_index; j > flow_new_index; j--) {
-            flow_array[j] = flow_array[j - 1];
+      } else {
+         /* If free place was not found (flow line is full), find
+          * record which will be replaced by new record. */
+         flow_index = evict_index(line_index);
+         if (victim_size != 0 && flow_array[flow_index]->flow.end_reason != FLOW_END_EOF) {
+            demote(flow_index);
+         } else {
+            evict(flow_index);
          }
+
+         uint32_t flow_new_index = line_index + insert_offset;
+         move_record(flow_index, flow_new_index);
          flow_index = flow_new_index;
-         flow_array[flow_new_index] = flow;
 #ifdef FLOW_CACHE_STATS
          not_empty++;
-      } else {
-         empty++;
 #endif /* FLOW_CACHE_STATS */
       }
    }
@@ -230,47 +360,88 @@ int NHTFlowCache::put_pkt(Packet &pkt)
    current_ts = pkt.timestamp;
    flow = flow_array[flow_index];
    if (flow->is_empty()) {
-      flow->create(pkt, hashval);
+      flow->create(pkt, hashval, key, key_len, key_swapped);
+      flow_tags[flow_index] = tag;
+      timer_insert(flow);
       ret = plugins_post_create(flow->flow, pkt);
 
       if (ret & FLOW_FLUSH) {
-         exporter->export_flow(flow->flow);
+         export_record(flow->flow, FLOW_END_FORCED);
 #ifdef FLOW_CACHE_STATS
          flushed++;
 #endif /* FLOW_CACHE_STATS */
          flow->erase();
+         flow_tags[flow_index] = FLOW_TAG_EMPTY;
+      } else {
+         if (reass != NULL && (pkt.field_indicator & PCKT_TCP)) {
+            stream_update(flow, pkt);
+         }
+         if (tcp_close && (pkt.tcp_control_bits & (TCP_FLAG_FIN | TCP_FLAG_RST))) {
+            close_tcp(flow_index);
+         }
       }
    } else {
+      if (flow->flow.end_reason == FLOW_END_EOF && (pkt.tcp_control_bits & TCP_FLAG_SYN)) {
+         /* New connection reuses flow key of closed one. */
+         plugins_pre_export(flow->flow);
+         export_record(flow->flow, FLOW_END_EOF);
+         flow->erase();
+         flow_tags[flow_index] = FLOW_TAG_EMPTY;
+#ifdef FLOW_CACHE_STATS
+         expired++;
+#endif /* FLOW_CACHE_STATS */
+
+         return put_pkt(pkt);
+      }
+
+      if (inspect_limit != 0 && flow->flow.pkt_total_cnt + flow->flow.rev_pkt_total_cnt >= inspect_limit) {
+         flow->flow.inspect_mask = 0;
+      }
+#ifdef FLOW_CACHE_STATS
+      if (flow->flow.inspect_mask == 0) {
+         uninspected++;
+      }
+#endif /* FLOW_CACHE_STATS */
       ret = plugins_pre_update(flow->flow, pkt);
 
       if (ret & FLOW_FLUSH) {
-         exporter->export_flow(flow->flow);
+         export_record(flow->flow, FLOW_END_FORCED);
 #ifdef FLOW_CACHE_STATS
          flushed++;
 #endif /* FLOW_CACHE_STATS */
          flow->erase();
+         flow_tags[flow_index] = FLOW_TAG_EMPTY;
 
          return put_pkt(pkt);
       } else {
-         flow->update(pkt);
+         flow->update(pkt, key_swapped);
          ret = plugins_post_update(flow->flow, pkt);
 
          if (ret & FLOW_FLUSH) {
-            exporter->export_flow(flow->flow);
+            export_record(flow->flow, FLOW_END_FORCED);
 #ifdef FLOW_CACHE_STATS
             flushed++;
 #endif /* FLOW_CACHE_STATS */
             flow->erase();
+            flow_tags[flow_index] = FLOW_TAG_EMPTY;
 
             return put_pkt(pkt);
          }
       }
 
+      if (reass != NULL && (pkt.field_indicator & PCKT_TCP)) {
+         stream_update(flow, pkt);
+      }
+      if (tcp_close && (pkt.tcp_control_bits & (TCP_FLAG_FIN | TCP_FLAG_RST))) {
+         close_tcp(flow_index);
+      }
+
       /* Check if flow record is expired. */
-      if (current_ts.tv_sec - flow->flow.time_first.tv_sec >= active.tv_sec) {
+      if (!flow->is_empty() && current_ts.tv_sec - flow->flow.time_first.tv_sec >= active.tv_sec) {
          plugins_pre_export(flow->flow);
-         exporter->export_flow(flow->flow);
+         export_record(flow->flow, FLOW_END_ACTIVE);
          flow->erase();
+         flow_tags[flow_index] = FLOW_TAG_EMPTY;
 #ifdef FLOW_CACHE_STATS
          expired++;
 #endif /* FLOW_CACHE_STATS */
@@ -285,55 +456,574 @@ int NHTFlowCache::put_pkt(Packet &pkt)
    return 0;
 }
 
-void NHTFlowCache::export_expired(time_t ts)
+int NHTFlowCache::save_flows(CheckpointWriter &writer)
 {
-   for (unsigned int i = 0; i < size; i++) {
-      if (!flow_array[i]->is_empty() &&
-         ts - flow_array[i]->flow.time_last.tv_sec >= inactive.tv_sec) {
+   for (unsigned int i = 0; i < size + victim_size; i++) {
+      const FlowRecord *rec = flow_array[i];
+      if (rec->is_empty()) {
+         continue;
+      }
 
-         plugins_pre_export(flow_array[i]->flow);
-         exporter->export_flow(flow_array[i]->flow);
+      rec->save(*writer.new_flow());
+      for (uint32_t mask = rec->flow.ext_mask; mask != 0; mask &= mask - 1) {
+         for (const RecordExt *ext = rec->flow.exts[__builtin_ctz(mask)]; ext != NULL; ext = ext->next) {
+            writer.add_ext(ext);
+         }
+      }
+      if (writer.write_flow() != 0) {
+         return -1;
+      }
+   }
+   return 0;
+}
 
+uint64_t NHTFlowCache::load_flows(CheckpointReader &reader)
+{
+   uint64_t loaded = 0;
+   const checkpoint_flow *rec;
+
+   while ((rec = reader.next_flow()) != NULL) {
+      if (load_flow(rec)) {
+         loaded++;
+      }
+   }
+   return loaded;
+}
+
+/**
+ * \brief Insert flow record from checkpoint. Record is placed like new flow, full flow line evicts a record.
+ * \param [in] rec Checkpoint record.
+ * \return False if key of record is not valid for this flow cache.
+ */
+bool NHTFlowCache::load_flow(const checkpoint_flow *rec)
+{
+   if (rec->key_len == 0 || rec->key_len > MAX_KEY_LENGTH) {
+      return false;
+   }
+
+   uint64_t hashval = key_hash(rec->key, rec->key_len);
+   uint32_t line_index = hashval & line_size_mask;
+   uint32_t free_slots = match_tags(line_index, FLOW_TAG_EMPTY);
+   uint32_t flow_index;
+
+   if (free_slots) {
+      flow_index = line_index + __builtin_ctz(free_slots);
+   } else {
+      flow_index = evict_index(line_index);
+      if (victim_size != 0 && flow_array[flow_index]->flow.end_reason != FLOW_END_EOF) {
+         demote(flow_index);
+      } else {
+         evict(flow_index);
+      }
+      move_record(flow_index, line_index + insert_offset);
+      flow_index = line_index + insert_offset;
+   }
+
+   FlowRecord *flow = flow_array[flow_index];
+   flow->load(*rec, hashval);
+   flow_tags[flow_index] = flow_tag(hashval);
+
+   const checkpoint_ext *ext = CheckpointReader::first_ext(rec);
+   for (int i = 0; i < rec->ext_cnt; i++, ext = CheckpointReader::next_ext(ext)) {
+      RecordExt *data = (ext->type < EXTENSION_CNT ? plugins_deserialize((extTypeEnum) ext->type, CheckpointReader::ext_data(ext), ext->length) : NULL);
+      if (data != NULL) {
+         flow->flow.addExtension(data);
+      }
+   }
+
+   timer_insert(flow);
+   return true;
+}
+
+void NHTFlowCache::drop_flows()
+{
+   for (unsigned int i = 0; i < size + victim_size; i++) {
+      if (!flow_array[i]->is_empty()) {
          flow_array[i]->erase();
+         flow_tags[i] = FLOW_TAG_EMPTY;
+      }
+   }
+}
+
+/**
+ * \brief Add TCP packet to reassembled streams of flow and pass new data to plugins which wait for them.
+ *
+ * Plugins are asked for stream data when the first packet of flow is seen, streams are allocated only
+ * for flows whose data some plugin wants.
+ * \param [in,out] rec Flow record which packet belongs to.
+ * \param [in] pkt TCP packet.
+ */
+void NHTFlowCache::stream_update(FlowRecord *rec, const Packet &pkt)
+{
+   if (rec->streams == NULL) {
+      uint32_t wanted[2][STREAM_MAX_SUBSCRIBERS];
+
+      if (rec->streams_off) {
+         return;
+      }
+      bool fwd = plugins_stream_request(rec->flow, false, wanted[0]);
+      bool rev = biflow && plugins_stream_request(rec->flow, true, wanted[1]);
+      if ((!fwd && !rev) || (rec->streams = reass->open()) == NULL) {
+         rec->streams_off = true;
+         return;
+      }
+
+      for (int dir = 0; dir < 2; dir++) {
+         TCPStream &stream = rec->streams->dir[dir];
+         if (dir == 0 ? fwd : rev) {
+            memcpy(stream.wanted, wanted[dir], sizeof(stream.wanted));
+         } else {
+            stream.closed = true;
+         }
+      }
+   }
+
+   int dir = rec->is_reverse(key_swapped);
+   TCPStream &stream = rec->streams->dir[dir];
+
+   if (reass->add(*rec->streams, dir, pkt) && !plugins_stream_data(rec->flow, stream, dir, *reass)) {
+      reass->close(*rec->streams, dir);
+   }
+}
+
+/**
+ * \brief Get time in seconds when flow record expires by inactive or active timeout or linger time of closed TCP flow.
+ * \param [in] rec Flow record.
+ * \return Expiration deadline.
+ */
+time_t NHTFlowCache::flow_deadline(const FlowRecord *rec) const
+{
+   time_t inactive_deadline = rec->flow.time_last.tv_sec + inactive.tv_sec;
+   time_t active_deadline = rec->flow.time_first.tv_sec + active.tv_sec;
+
+   if (rec->flow.end_reason == FLOW_END_EOF && rec->flow.time_last.tv_sec + (time_t) tcp_linger < inactive_deadline) {
+      inactive_deadline = rec->flow.time_last.tv_sec + tcp_linger;
+   }
+   return (inactive_deadline < active_deadline ? inactive_deadline : active_deadline);
+}
+
+/**
+ * \brief Put flow record into timer wheel slot of its expiration deadline.
+ * \param [in] rec Flow record which is not in timer wheel.
+ */
+void NHTFlowCache::timer_insert(FlowRecord *rec)
+{
+   time_t deadline = flow_deadline(rec);
+
+   if (timer_ts == 0) {
+      timer_ts = rec->flow.time_last.tv_sec;
+   }
+   if (deadline < timer_ts) {
+      deadline = timer_ts; /* Packet timestamp went backwards. */
+   }
+   rec->append_to(&timer_wheel[deadline & timer_mask]);
+}
+
+/**
+ * \brief Export flows whose deadline passed.
+ *
+ * Only timer wheel slots of seconds elapsed since previous call are visited. Deadlines are not moved
+ * when flow is updated, so records found in a slot too early are put back to slot of their current deadline.
+ * \param [in] ts Current time in seconds.
+ */
+void NHTFlowCache::export_expired(time_t ts)
+{
+   if (timer_ts == 0 || ts < timer_ts) {
+      exporter->flush();
+      return;
+   }
+
+   uint32_t slots = ts - timer_ts + 1;
+   if (slots > timer_mask + 1) {
+      slots = timer_mask + 1; /* All slots are visited after one turn of wheel. */
+   }
+
+   for (uint32_t i = 0; i < slots; i++) {
+      TimerLink *slot = &timer_wheel[(timer_ts + i) & timer_mask];
+      TimerLink pending;
+
+      if (slot->empty()) {
+         continue;
+      }
+
+      /* Detach slot content, records put back to the same slot will not be visited again. */
+      pending.next = slot->next;
+      pending.prev = slot->prev;
+      pending.next->prev = &pending;
+      pending.prev->next = &pending;
+      slot->next = slot;
+      slot->prev = slot;
+
+      while (!pending.empty()) {
+         FlowRecord *rec = static_cast<FlowRecord *>(pending.next);
+
+         rec->unlink();
+         if (ts - rec->flow.time_last.tv_sec >= inactive.tv_sec ||
+             ts - rec->flow.time_first.tv_sec >= active.tv_sec ||
+             (rec->flow.end_reason == FLOW_END_EOF && ts - rec->flow.time_last.tv_sec >= (time_t) tcp_linger)) {
+            plugins_pre_export(rec->flow);
+            export_record(rec->flow, (ts - rec->flow.time_last.tv_sec >= inactive.tv_sec ? FLOW_END_INACTIVE : FLOW_END_ACTIVE));
+
+            clear_tag(rec);
+            rec->erase();
 #ifdef FLOW_CACHE_STATS
-         expired++;
+            expired++;
 #endif /* FLOW_CACHE_STATS */
+         } else {
+            rec->append_to(&timer_wheel[flow_deadline(rec) & timer_mask]);
+#ifdef FLOW_CACHE_STATS
+            timer_reinserts++;
+#endif /* FLOW_CACHE_STATS */
+         }
       }
    }
+
+   timer_ts = ts + 1;
    exporter->flush();
 }
 
-bool NHTFlowCache::create_hash_key(Packet &pkt)
+/**
+ * \brief Find flow records with given tag in flow line.
+ * \param [in] line_index Index of first record of flow line.
+ * \param [in] tag Tag to search for.
+ * \return Bit mask of matching records, bit 0 is the first record of flow line.
+ */
+inline uint32_t NHTFlowCache::match_tags(uint32_t line_index, uint8_t tag) const
+{
+   const uint8_t *tags = flow_tags + line_index;
+   uint32_t mask = 0;
+#ifdef __SSE2__
+   const __m128i needle = _mm_set1_epi8(tag);
+
+   for (uint32_t i = 0; i < line_size; i += 16) {
+      __m128i block = _mm_load_si128((const __m128i *) (tags + i));
+      mask |= (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(block, needle)) << i;
+   }
+#else
+   for (uint32_t i = 0; i < line_size; i++) {
+      if (tags[i] == tag) {
+         mask |= 1U << i;
+      }
+   }
+#endif
+   return mask;
+}
+
+/**
+ * \brief Move flow record and its tag to lower index in flow line, records in between are shifted by one.
+ * \param [in] from Current index of record.
+ * \param [in] to New index of record.
+ */
+inline void NHTFlowCache::move_record(uint32_t from, uint32_t to)
+{
+   FlowRecord *rec = flow_array[from];
+   uint8_t tag = flow_tags[from];
+
+   for (uint32_t j = from; j > to; j--) {
+      flow_array[j] = flow_array[j - 1];
+      flow_tags[j] = flow_tags[j - 1];
+   }
+   flow_array[to] = rec;
+   flow_tags[to] = tag;
+}
+
+/**
+ * \brief Get index of victim area line where record with given hash is stored when demoted from its flow line.
+ * \param [in] hash Hash of flow key.
+ * \return Index of first record of victim line.
+ */
+inline uint32_t NHTFlowCache::victim_line(uint64_t hash) const
+{
+   return size + ((uint32_t) (hash >> 32) & victim_mask);
+}
+
+/**
+ * \brief Choose record of full flow line which is replaced by new record.
+ * \param [in] line_index Index of first record of flow line.
+ * \return Index of record, never lower than insert_offset in flow line.
+ */
+uint32_t NHTFlowCache::evict_index(uint32_t line_index) const
+{
+   uint32_t flow_index = line_index + line_size - 1;
+
+   if (tcp_close) {
+      /* Closed TCP flows only wait for late packets, their records are reclaimed first. */
+      for (uint32_t i = flow_index; i >= line_index + insert_offset; i--) {
+         if (flow_array[i]->flow.end_reason == FLOW_END_EOF) {
+            return i;
+         }
+      }
+   }
+   if (evict_policy == EVICT_SIZE) {
+      /* Small flows are cheap to split, keep records which aggregated most packets. Ties go to older record. */
+      uint64_t min_pkts = ~(uint64_t) 0;
+
+      for (uint32_t i = flow_index; i >= line_index + insert_offset; i--) {
+         const Flow &flow = flow_array[i]->flow;
+         uint64_t pkts = (uint64_t) flow.pkt_total_cnt + flow.rev_pkt_total_cnt;
+
+         if (pkts < min_pkts) {
+            min_pkts = pkts;
+            flow_index = i;
+         }
+      }
+   }
+   return flow_index;
+}
+
+/**
+ * \brief Export flow record prematurely because there is no room for new record.
+ * \param [in] flow_index Index of record.
+ */
+void NHTFlowCache::evict(uint32_t flow_index)
 {
+   FlowRecord *rec = flow_array[flow_index];
+
+   plugins_pre_export(rec->flow);
+   if (rec->flow.end_reason != FLOW_END_EOF) {
+      __atomic_store_n(&evicted, evicted + 1, __ATOMIC_RELAXED);
+#ifdef FLOW_CACHE_STATS
+      evicted_pkts += (uint64_t) rec->flow.pkt_total_cnt + rec->flow.rev_pkt_total_cnt;
+#endif /* FLOW_CACHE_STATS */
+   }
+   export_record(rec->flow, FLOW_END_NO_RES);
+#ifdef FLOW_CACHE_STATS
+   expired++;
+#endif /* FLOW_CACHE_STATS */
+
+   rec->erase();
+   flow_tags[flow_index] = FLOW_TAG_EMPTY;
+}
+
+/**
+ * \brief Pass flow record to exporter.
+ * \param [in,out] flow Flow record, its end reason is set unless TCP connection of flow was closed before.
+ * \param [in] reason Reason of export, FLOW_END_* value.
+ */
+inline void NHTFlowCache::export_record(Flow &flow, uint8_t reason)
+{
+   if (flow.end_reason != FLOW_END_EOF) {
+      flow.end_reason = reason;
+   }
+#ifdef FLOW_CACHE_STATS
+   end_reasons[flow.end_reason]++;
+   if (flow.end_reason == FLOW_END_EOF && ((flow.tcp_control_bits | flow.rev_tcp_control_bits) & TCP_FLAG_RST)) {
+      closed_rst++;
+   }
+#endif /* FLOW_CACHE_STATS */
+   exporter->export_flow(flow);
+}
+
+/**
+ * \brief Mark flow closed when its TCP connection was reset or finished by FIN in both directions (in the only direction
+ * of flow without -b). Closed flow is exported at once without linger time, otherwise its expiration is moved to linger time.
+ * \param [in] flow_index Index of flow record updated by packet with FIN or RST flag.
+ */
+void NHTFlowCache::close_tcp(uint32_t flow_index)
+{
+   FlowRecord *rec = flow_array[flow_index];
+   Flow &flow = rec->flow;
+   uint8_t fin = (biflow ? flow.tcp_control_bits & flow.rev_tcp_control_bits : flow.tcp_control_bits) & TCP_FLAG_FIN;
+
+   if (flow.end_reason == FLOW_END_EOF || (fin == 0 && ((flow.tcp_control_bits | flow.rev_tcp_control_bits) & TCP_FLAG_RST) == 0)) {
+      return;
+   }
+
+   flow.end_reason = FLOW_END_EOF;
+   if (tcp_linger == 0) {
+      plugins_pre_export(flow);
+      export_record(flow, FLOW_END_EOF);
+      rec->erase();
+      flow_tags[flow_index] = FLOW_TAG_EMPTY;
+#ifdef FLOW_CACHE_STATS
+      expired++;
+#endif /* FLOW_CACHE_STATS */
+   } else {
+      rec->unlink();
+      timer_insert(rec);
+   }
+}
+
+/**
+ * \brief Move record from flow line to the first index of its victim line, least recently used record
+ * of full victim line is exported. Empty record takes place of moved record.
+ * \param [in] flow_index Index of record in flow line.
+ */
+void NHTFlowCache::demote(uint32_t flow_index)
+{
+   uint32_t line_index = victim_line(flow_array[flow_index]->get_hash());
+   uint32_t free_slots = match_tags(line_index, FLOW_TAG_EMPTY);
+   uint32_t victim_index = line_index + line_size - 1;
+
+   if (free_slots) {
+      victim_index = line_index + __builtin_ctz(free_slots);
+   } else {
+      evict(victim_index);
+   }
+
+   FlowRecord *rec = flow_array[victim_index];
+   flow_array[victim_index] = flow_array[flow_index];
+   flow_array[flow_index] = rec;
+   flow_tags[victim_index] = flow_tags[flow_index];
+   flow_tags[flow_index] = FLOW_TAG_EMPTY;
+   move_record(victim_index, line_index);
+#ifdef FLOW_CACHE_STATS
+   demoted++;
+#endif /* FLOW_CACHE_STATS */
+}
+
+/**
+ * \brief Find flow record of current flow key in victim area and move it to the first index of its flow line.
+ * When flow line is full, its least recently used record is moved to victim area instead.
+ * \param [in] line_index Index of first record of flow line.
+ * \param [in] hash Hash of flow key.
+ * \param [in] tag Tag of flow key.
+ * \return True if record was found.
+ */
+bool NHTFlowCache::restore(uint32_t line_index, uint64_t hash, uint8_t tag)
+{
+   uint32_t victim_index = victim_line(hash);
+   uint32_t candidates = match_tags(victim_index, tag);
+
+   while (candidates) {
+      uint32_t index = victim_index + __builtin_ctz(candidates);
+      if (flow_array[index]->belongs(hash, key, key_len)) {
+         uint32_t free_slots = match_tags(line_index, FLOW_TAG_EMPTY);
+         uint32_t flow_index = (free_slots ? line_index + __builtin_ctz(free_slots) : line_index + line_size - 1);
+
+         /* Swap record with empty or least recently used record of flow line. */
+         FlowRecord *rec = flow_array[flow_index];
+         uint8_t rec_tag = flow_tags[flow_index];
+         flow_array[flow_index] = flow_array[index];
+         flow_tags[flow_index] = flow_tags[index];
+         flow_array[index] = rec;
+         flow_tags[index] = rec_tag;
+
+         move_record(flow_index, line_index);
+         if (!free_slots) {
+            move_record(index, victim_index);
+#ifdef FLOW_CACHE_STATS
+            demoted++;
+#endif /* FLOW_CACHE_STATS */
+         }
+         return true;
+      }
+      candidates &= candidates - 1;
+   }
+   return false;
+}
+
+/**
+ * \brief Clear tag of flow record which is being removed from flow cache outside of put_pkt.
+ * \param [in] rec Flow record.
+ */
+void NHTFlowCache::clear_tag(const FlowRecord *rec)
+{
+   uint32_t line_index = rec->get_hash() & line_size_mask;
+   uint8_t tag = flow_tag(rec->get_hash());
+
+   for (int area = 0; area < (victim_size != 0 ? 2 : 1); area++) {
+      uint32_t candidates = match_tags(line_index, tag);
+
+      while (candidates) {
+         uint32_t flow_index = line_index + __builtin_ctz(candidates);
+         if (flow_array[flow_index] == rec) {
+            flow_tags[flow_index] = FLOW_TAG_EMPTY;
+            return;
+         }
+         candidates &= candidates - 1;
+      }
+      line_index = victim_line(rec->get_hash());
+   }
+}
+
+/**
+ * \brief Create flow key from packet.
+ *
+ * In biflow mode endpoints are stored in key in canonical order (lower address and port first),
+ * so packets of both directions get the same key.
+ * \param [in] pkt Parsed packet.
+ * \param [out] key_buf Buffer of MAX_KEY_LENGTH bytes for key.
+ * \param [out] len Length of created key.
+ * \param [out] swapped Set to true if packet endpoints were swapped in key.
+ * \return True if packet has supported IP version and key was created.
+ */
+bool NHTFlowCache::create_hash_key(const Packet &pkt, char *key_buf, uint8_t &len, bool &swapped) const
+{
+   swapped = false;
    if (pkt.ip_version == 4) {
-      struct flow_key_v4_t *key_v4 = (struct flow_key_v4_t *) key;
+      struct flow_key_v4_t *key_v4 = (struct flow_key_v4_t *) key_buf;
 
-      key_v4->src_port = pkt.src_port;
-      key_v4->dst_port = pkt.dst_port;
+      if (biflow) {
+         swapped = (pkt.src_ip.v4 > pkt.dst_ip.v4 || (pkt.src_ip.v4 == pkt.dst_ip.v4 && pkt.src_port > pkt.dst_port));
+      }
+
+      key_v4->src_port = (swapped ? pkt.dst_port : pkt.src_port);
+      key_v4->dst_port = (swapped ? pkt.src_port : pkt.dst_port);
       key_v4->proto = pkt.ip_proto;
       key_v4->ip_version = 4;
-      key_v4->src_ip = pkt.src_ip.v4;
-      key_v4->dst_ip = pkt.dst_ip.v4;
+      key_v4->src_ip = (swapped ? pkt.dst_ip.v4 : pkt.src_ip.v4);
+      key_v4->dst_ip = (swapped ? pkt.src_ip.v4 : pkt.dst_ip.v4);
 
-      key_len = 14;
+      len = 14;
       return true;
    } else if (pkt.ip_version == 6) {
-      struct flow_key_v6_t *key_v6 = (struct flow_key_v6_t *) key;
+      struct flow_key_v6_t *key_v6 = (struct flow_key_v6_t *) key_buf;
+
+      if (biflow) {
+         int cmp = memcmp(pkt.src_ip.v6, pkt.dst_ip.v6, sizeof(pkt.src_ip.v6));
+         swapped = (cmp > 0 || (cmp == 0 && pkt.src_port > pkt.dst_port));
+      }
 
-      key_v6->src_port = pkt.src_port;
-      key_v6->dst_port = pkt.dst_port;
+      key_v6->src_port = (swapped ? pkt.dst_port : pkt.src_port);
+      key_v6->dst_port = (swapped ? pkt.src_port : pkt.dst_port);
       key_v6->proto = pkt.ip_proto;
       key_v6->ip_version = 6;
-      memcpy(key_v6->src_ip, pkt.src_ip.v6, sizeof(pkt.src_ip.v6));
-      memcpy(key_v6->dst_ip, pkt.dst_ip.v6, sizeof(pkt.dst_ip.v6));
+      memcpy(key_v6->src_ip, (swapped ? pkt.dst_ip.v6 : pkt.src_ip.v6), sizeof(pkt.src_ip.v6));
+      memcpy(key_v6->dst_ip, (swapped ? pkt.src_ip.v6 : pkt.dst_ip.v6), sizeof(pkt.dst_ip.v6));
 
-      key_len = 38;
+      len = 38;
       return true;
    }
 
    return false;
 }
 
+/**
+ * \brief Compute hash of flow key using selected hash function.
+ * \param [in] key_buf Flow key.
+ * \param [in] len Length of flow key.
+ * \return Hash value.
+ */
+inline uint64_t NHTFlowCache::key_hash(const char *key_buf, uint8_t len) const
+{
+   return (hash_type == FLOW_HASH_CRC32C ? flow_hash_crc32c(key_buf, len) : XXH64(key_buf, len, 0));
+}
+
+/**
+ * \brief Prefetch tags and record pointers of flow line where packet belongs.
+ * \param [in] pkt Parsed packet.
+ */
+void NHTFlowCache::prefetch(const Packet &pkt)
+{
+   char key_buf[MAX_KEY_LENGTH];
+   uint8_t len;
+   bool swapped;
+
+   if (!create_hash_key(pkt, key_buf, len, swapped)) {
+      return;
+   }
+
+   uint32_t line_index = key_hash(key_buf, len) & line_size_mask;
+   __builtin_prefetch(flow_tags + line_index);
+   __builtin_prefetch(flow_array + line_index);
+}
+
+uint64_t NHTFlowCache::get_evicted() const
+{
+   return __atomic_load_n(&evicted, __ATOMIC_RELAXED);
+}
+
 void NHTFlowCache::print_report()
 {
 #ifdef FLOW_CACHE_STATS
@@ -344,7 +1034,21 @@ void NHTFlowCache::print_report()
    cout << "Not empty: " << not_empty << endl;
    cout << "Expired: " << expired << endl;
    cout << "Flushed: " << flushed << endl;
+   cout << "Evicted: " << evicted << " (" << evicted_pkts << " packets)" << endl;
+   if (victim_size != 0) {
+      cout << "Victim area: " << demoted << " demoted, " << victim_hits << " hits" << endl;
+   }
+   cout << "Uninspected packets: " << uninspected << endl;
+   cout << "Export reasons: inactive " << end_reasons[FLOW_END_INACTIVE] << ", active " << end_reasons[FLOW_END_ACTIVE] <<
+      ", fin " << end_reasons[FLOW_END_EOF] - closed_rst << ", rst " << closed_rst << ", eviction " << end_reasons[FLOW_END_NO_RES] <<
+      ", forced " << end_reasons[FLOW_END_FORCED] << endl;
    cout << "Average Lookup:  " << tmp << endl;
    cout << "Variance Lookup: " << float(lookups2) / hits - tmp * tmp << endl;
+   cout << "Hash collisions: " << collisions << " (" << flow_hash_name(hash_type) << ")" << endl;
+   cout << "Timer reinserts: " << timer_reinserts << endl;
+   ext_pool.print_report();
+   if (reass != NULL) {
+      reass->print_report();
+   }
 #endif /* FLOW_CACHE_STATS */
 }
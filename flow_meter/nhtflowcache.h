@@ -48,26 +48,95 @@
 #define NHTFLOWCACHE_H
 
 #include <string>
+#include <cstdlib>
+#include <new>
 
 #include "flow_meter.h"
 #include "flowcache.h"
 #include "flowifc.h"
 #include "flowexporter.h"
+#include "flowhash.h"
+#include "tcpreassembler.h"
+#include "hugemem.h"
+#include "checkpoint.h"
 
 using namespace std;
 
 #define MAX_KEY_LENGTH 38
+#define FLOW_TAG_EMPTY 0    /**< Tag of empty flow record. */
+#define FLOW_TAG_ALIGN 64   /**< Alignment of flow tag array. */
+#define TIMER_WHEEL_SLACK 8 /**< Extra timer wheel slots covering delay between expiration checks. */
 
-class FlowRecord
+#define EVICT_LRU 0         /**< Export least recently used record of full flow line. */
+#define EVICT_SIZE 1        /**< Export record with fewest packets from least recently used half of full flow line. */
+#define EVICT_VICTIM 2      /**< Move least recently used record of full flow line to victim area. */
+
+/**
+ * \brief Link of circular list of flow records waiting in the same timer wheel slot.
+ */
+struct TimerLink {
+   TimerLink *prev;
+   TimerLink *next;
+
+   TimerLink() : prev(this), next(this)
+   {
+   }
+
+   /**
+    * \brief Check if list is empty (when used as list head) or link is not in any list.
+    */
+   inline bool empty() const
+   {
+      return next == this;
+   }
+
+   /**
+    * \brief Remove link from list. Does nothing for link which is not in list.
+    */
+   inline void unlink()
+   {
+      prev->next = next;
+      next->prev = prev;
+      prev = this;
+      next = this;
+   }
+
+   /**
+    * \brief Append link to the end of list.
+    * \param [in] head Head of list.
+    */
+   inline void append_to(TimerLink *head)
+   {
+      next = head;
+      prev = head->prev;
+      head->prev->next = this;
+      head->prev = this;
+   }
+};
+
+class FlowRecord : public TimerLink
 {
    uint64_t hash;
+   uint8_t key_len;
+   bool key_swapped;         /**< Endpoints of first packet were swapped in flow key. */
+   char key[MAX_KEY_LENGTH]; /**< Flow key, hash matches are verified against it. */
 public:
    Flow flow;
+   TCPStreams *streams;      /**< Reassembled TCP streams or NULL. */
+   bool streams_off;         /**< No plugin wants TCP stream data of flow. */
 
    void erase()
    {
+      unlink();
       flow.removeExtensions();
+      if (streams != NULL) {
+         streams->owner->release(streams);
+         streams = NULL;
+      }
+      streams_off = false;
       hash = 0;
+      key_len = 0;
+      key_swapped = false;
 
       memset(&flow.time_first, 0, sizeof(flow.time_first));
       memset(&flow.time_last, 0, sizeof(flow.time_last));
@@ -82,30 +151,68 @@ public:
       flow.pkt_total_cnt = 0;
       flow.octet_total_length = 0;
       flow.tcp_control_bits = 0;
+      flow.rev_pkt_total_cnt = 0;
+      flow.rev_octet_total_length = 0;
+      flow.rev_tcp_control_bits = 0;
+      flow.end_reason = 0;
    }
 
-   FlowRecord()
+   FlowRecord() : streams(NULL)
    {
       erase();
    };
    ~FlowRecord()
    {
+      if (streams != NULL) {
+         streams->owner->release(streams);
+      }
    };
 
    inline bool is_empty() const;
-   inline bool belongs(uint64_t pkt_hash) const;
-   void create(const Packet &pkt, uint64_t pkt_hash);
-   void update(const Packet &pkt);
+   inline bool belongs(uint64_t pkt_hash, const char *pkt_key, uint8_t pkt_key_len) const;
+   inline bool has_hash(uint64_t pkt_hash) const;
+   inline uint64_t get_hash() const
+   {
+      return hash;
+   }
+   /**
+    * \brief Check if packet goes in opposite direction than the first packet of flow.
+    */
+   inline bool is_reverse(bool pkt_key_swapped) const
+   {
+      return pkt_key_swapped != key_swapped;
+   }
+   void create(const Packet &pkt, uint64_t pkt_hash, const char *pkt_key, uint8_t pkt_key_len, bool pkt_key_swapped);
+   void update(const Packet &pkt, bool pkt_key_swapped);
+   void save(checkpoint_flow &rec) const;
+   void load(const checkpoint_flow &rec, uint64_t rec_hash);
 };
 
 class NHTFlowCache : public FlowCache
 {
    bool print_stats;
+   bool biflow;             /**< Packets of both directions are aggregated into one flow record. */
+   int hash_type;
    uint8_t key_len;
+   bool key_swapped;
    uint32_t line_size;
    uint32_t size;
    uint32_t line_size_mask;
+   int evict_policy;        /**< Policy choosing record replaced in full flow line. */
+   uint32_t insert_offset;  /**< Index in flow line where new records are inserted when line is full. */
+   uint32_t victim_size;    /**< Number of records of victim area placed after flow lines, 0 if not used. */
+   uint32_t victim_mask;    /**< Mask for getting victim line index. */
+   uint64_t evicted;        /**< Number of flows exported because their flow line was full, read by sampler. */
+   uint32_t inspect_limit;  /**< Number of packets of flow passed to plugins, 0 if not limited. */
+   bool tcp_close;          /**< Export TCP flows closed by FIN or RST before inactive timeout. */
+   uint32_t tcp_linger;     /**< Seconds closed TCP flow waits for late packets before export. */
 #ifdef FLOW_CACHE_STATS
+   uint64_t uninspected;    /**< Number of packets of flows no plugin inspects any more. */
+   uint64_t end_reasons[FLOW_END_NO_RES + 1]; /**< Number of exported flows by FLOW_END_* reason. */
+   uint64_t closed_rst;     /**< Number of FLOW_END_EOF flows closed by RST. */
+   uint64_t evicted_pkts;   /**< Number of packets of evicted flows. */
+   uint64_t demoted;        /**< Number of records moved to victim area. */
+   uint64_t victim_hits;    /**< Number of records found in victim area and moved back to their flow line. */
    uint64_t empty;
    uint64_t not_empty;
    uint64_t hits;
@@ -113,6 +220,8 @@ class NHTFlowCache : public FlowCache
    uint64_t flushed;
    uint64_t lookups;
    uint64_t lookups2;
+   uint64_t collisions;
+   uint64_t timer_reinserts;
 #endif /* FLOW_CACHE_STATS */
    struct timeval current_ts;
    struct timeval last_ts;
@@ -121,6 +230,14 @@ class NHTFlowCache : public FlowCache
    char key[MAX_KEY_LENGTH];
    FlowRecord **flow_array;
    FlowRecord *flow_records;
+   uint8_t *flow_tags;      /**< Tags of flow records in flow_array, contiguous per flow line. */
+   HugeMem cache_mem;       /**< Memory holding flow_tags, flow_array and flow_records. */
+   bool report_mem;         /**< Print achieved page size of cache memory at startup. */
+   TimerLink *timer_wheel;  /**< Lists of flow records indexed by second of expiration. */
+   uint32_t timer_mask;     /**< Mask for getting timer wheel slot. */
+   time_t timer_ts;         /**< Next second which was not processed by timer wheel, 0 if wheel is not started. */
+   RecordExtPool ext_pool;  /**< Pool of extensions created by plugins of this cache. */
+   TCPReassembler *reass;   /**< Reassembler of TCP streams or NULL when reassembly is disabled. */
 
 public:
    NHTFlowCache(const options_t &options)
@@ -130,7 +247,27 @@ public:
       last_ts.tv_sec = 0;
       /* Mask for getting flow cache line index. */
       line_size_mask = (size - 1) & ~(line_size - 1);
+      evict_policy = options.evict_policy;
+      insert_offset = line_size / 2;
+      victim_size = 0;
+      if (evict_policy == EVICT_VICTIM) {
+         victim_size = (options.victim_size != 0 ? options.victim_size : size / DEFAULT_VICTIM_RATIO);
+         if (victim_size < line_size) {
+            victim_size = line_size;
+         }
+      }
+      victim_mask = (victim_size - 1) & ~(line_size - 1);
+      evicted = 0;
+      inspect_limit = options.inspect_limit;
+      tcp_close = options.tcp_close;
+      tcp_linger = options.tcp_linger;
 #ifdef FLOW_CACHE_STATS
+      uninspected = 0;
+      memset(end_reasons, 0, sizeof(end_reasons));
+      closed_rst = 0;
+      evicted_pkts = 0;
+      demoted = 0;
+      victim_hits = 0;
       empty = 0;
       not_empty = 0;
       hits = 0;
@@ -138,32 +275,90 @@ public:
       flushed = 0;
       lookups = 0;
       lookups2 = 0;
+      collisions = 0;
+      timer_reinserts = 0;
 #endif /* FLOW_CACHE_STATS */
       print_stats = options.print_stats;
+      biflow = options.biflow;
+      hash_type = options.flow_hash;
+      flow_hash_init();
       active = options.active_timeout;
       inactive = options.inactive_timeout;
 
-      flow_array = new FlowRecord*[size];
-      flow_records = new FlowRecord[size];
-      for (unsigned int i = 0; i < size; i++) {
+      /* Victim area is organized in flow lines following the main flow lines. Tags, pointers and
+       * records share one mapping, so that huge pages cover all memory touched by lookups. */
+      uint32_t cnt = size + victim_size;
+      size_t tags_len = (cnt + FLOW_TAG_ALIGN - 1) & ~(size_t) (FLOW_TAG_ALIGN - 1);
+      size_t array_len = (cnt * sizeof(FlowRecord *) + FLOW_TAG_ALIGN - 1) & ~(size_t) (FLOW_TAG_ALIGN - 1);
+      uint8_t *mem = (uint8_t *) cache_mem.alloc(tags_len + array_len + cnt * sizeof(FlowRecord), options.hugepages, options.numa_node);
+      if (mem == NULL) {
+         throw std::bad_alloc();
+      }
+      report_mem = (options.hugepages != HUGEPAGES_OFF || options.numa_node != NUMA_NODE_NONE);
+
+      /* Each flow line has its tags in one block, 16 tags of a line fit into a single SSE register. */
+      flow_tags = mem;
+      memset(flow_tags, FLOW_TAG_EMPTY, cnt);
+      flow_array = (FlowRecord **) (mem + tags_len);
+      flow_records = (FlowRecord *) (mem + tags_len + array_len);
+      for (unsigned int i = 0; i < cnt; i++) {
+         new (flow_records + i) FlowRecord();
          flow_array[i] = flow_records + i;
       }
+
+      /* Timer wheel must cover the longest timeout, deadlines are never further in the future. */
+      uint32_t timer_slots = 2;
+      while (timer_slots < (uint32_t) (active.tv_sec > inactive.tv_sec ? active.tv_sec : inactive.tv_sec) + TIMER_WHEEL_SLACK) {
+         timer_slots <<= 1;
+      }
+      timer_wheel = new TimerLink[timer_slots];
+      timer_mask = timer_slots - 1;
+      timer_ts = 0;
+
+      reass = NULL;
+      if (options.stream_flow_limit != 0) {
+         reass = new TCPReassembler(options.stream_flow_limit, options.stream_total_limit);
+      }
    };
    ~NHTFlowCache()
    {
-      delete [] flow_records;
-      delete [] flow_array;
+      /* Releases remaining streams, must be destroyed before reassembler. Memory is unmapped by cache_mem. */
+      for (unsigned int i = 0; i < size + victim_size; i++) {
+         flow_records[i].~FlowRecord();
+      }
+      delete [] timer_wheel;
+      delete reass;
    };
 
 // Put packet into the cache (i.e. update corresponding flow record or create a new one)
    virtual int put_pkt(Packet &pkt);
-   virtual void init();
+   virtual int init();
    virtual void finish();
 
-   void export_expired(time_t ts);
+   virtual void export_expired(time_t ts);
+   virtual void prefetch(const Packet &pkt);
+   virtual uint64_t get_evicted() const;
+   virtual int save_flows(CheckpointWriter &writer);
+   virtual uint64_t load_flows(CheckpointReader &reader);
+   virtual void drop_flows();
+   bool load_flow(const checkpoint_flow *rec);
 
 protected:
-   bool create_hash_key(Packet &pkt);
+   bool create_hash_key(const Packet &pkt, char *key_buf, uint8_t &len, bool &swapped) const;
+   inline uint64_t key_hash(const char *key_buf, uint8_t len) const;
+   inline uint32_t match_tags(uint32_t line_index, uint8_t tag) const;
+   inline void move_record(uint32_t from, uint32_t to);
+   inline uint32_t victim_line(uint64_t hash) const;
+   uint32_t evict_index(uint32_t line_index) const;
+   void evict(uint32_t flow_index);
+   void demote(uint32_t flow_index);
+   inline void export_record(Flow &flow, uint8_t reason);
+   void close_tcp(uint32_t flow_index);
+   bool restore(uint32_t line_index, uint64_t hash, uint8_t tag);
+   void clear_tag(const FlowRecord *rec);
+   time_t flow_deadline(const FlowRecord *rec) const;
+   void timer_insert(FlowRecord *rec);
+   void stream_update(FlowRecord *rec, const Packet &pkt);
    void print_report();
 };
 
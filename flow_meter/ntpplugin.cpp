@@ -134,6 +134,22 @@ void NTPPlugin::finish()
    }
 }
 
+/**
+ * \brief Plugin processes NTP traffic on port 123 only.
+ */
+plugin_interest NTPPlugin::get_interest()
+{
+   return plugin_interest().port(123);
+}
+
+/**
+ * \brief Create NTP extension saved in flow cache checkpoint.
+ */
+RecordExt *NTPPlugin::deserialize(extTypeEnum type, const uint8_t *data, int size)
+{
+   return (type == ntp ? RecordExtNTP::deserialize(data, size) : NULL);
+}
+
 /**
  *\brief Get unirec template string from plugin.
  *\return Unirec template string.
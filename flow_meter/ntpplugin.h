@@ -89,6 +89,9 @@ struct RecordExtNTP : RecordExt {
    /**
          *\brief Constructor.
    */
+   RECORD_EXT_POOLED(ntp)
+   RECORD_EXT_SERIALIZED(RecordExtNTP, leap)
+
    RecordExtNTP() : RecordExt(ntp)
    {
       leap = 9;
@@ -193,8 +196,10 @@ public:
    NTPPlugin(const options_t &module_options, vector<plugin_opt> plugin_options);
    int post_create(Flow &rec, const Packet &pkt);
    void finish();
+   plugin_interest get_interest();
    string get_unirec_field_string();
    const char **get_ipfix_string();
+   RecordExt *deserialize(extTypeEnum type, const uint8_t *data, int size);
 
 private:
    bool parse_ntp(const Packet &pkt, RecordExtNTP *ntp_data_ext);
@@ -54,11 +54,25 @@
 #include "flowifc.h"
 
 #define MAXPCKTSIZE 1600
+#define PACKET_BURST_SIZE 64 /**< Default number of packets in PacketBlock. */
 
 #define PCKT_PAYLOAD 1
 #define PCKT_TCP 2
 #define PCKT_UDP 4
 #define PCKT_ICMP 8
+#define PCKT_FRAGMENT 16 /**< Packet is fragment of IP datagram, frag_* fields are valid. */
+#define PCKT_TUNNEL 32 /**< Packet was decapsulated from tunnel, tunnel_* fields are valid. */
+
+/* Types of decapsulated tunnels. */
+#define TUNNEL_GRE 1
+#define TUNNEL_VXLAN 2
+#define TUNNEL_GTPU 3
+#define TUNNEL_IPIP 4 /**< IPv4 or IPv6 encapsulated directly in IPv4 or IPv6 (IP-in-IP, 6in4). */
+
+/* Bits of Packet::tcp_control_bits. */
+#define TCP_FLAG_FIN 0x01
+#define TCP_FLAG_SYN 0x02
+#define TCP_FLAG_RST 0x04
 
 /**
  * \brief Structure for storing parsed packets up to transport layer.
@@ -78,22 +92,67 @@ struct Packet : public Record {
    uint8_t     ip_tos;
    ipaddr_t    src_ip;
    ipaddr_t    dst_ip;
+   uint32_t    frag_id;    /**< Identification of fragmented datagram. */
+   uint16_t    frag_off;   /**< Offset of fragment data in datagram in bytes. */
+   uint16_t    frag_len;   /**< Length of fragment data following network headers, 0 if it cannot be reassembled. */
+   bool        frag_more;  /**< More fragments of datagram follow. */
+   uint8_t     tunnel_type;         /**< Type of innermost decapsulated tunnel. */
+   uint8_t     tunnel_ip_version;   /**< IP version of tunnel endpoints. */
+   uint32_t    tunnel_id;           /**< GRE key, VXLAN VNI or GTP-U TEID of innermost tunnel, 0 if tunnel has none. */
+   ipaddr_t    tunnel_src_ip;       /**< Source address of innermost tunnel endpoints. */
+   ipaddr_t    tunnel_dst_ip;       /**< Destination address of innermost tunnel endpoints. */
 
    uint16_t    src_port;
    uint16_t    dst_port;
    uint8_t     tcp_control_bits;
+   uint32_t    tcp_seq;
 
    uint16_t    total_length;
    char        *packet; /**< Array containing whole packet. */
    uint16_t    payload_length;
    char        *payload; /**< Pointer to packet payload section. */
+   uint32_t    sampling_interval; /**< Sampling interval applied to packet, 0 if packet was not sampled. */
+
+   /**
+    * \brief Constructor.
+    */
+   Packet() : total_length(0), packet(NULL), payload_length(0), payload(NULL), sampling_interval(1)
+   {
+   }
+};
+
+/**
+ * \brief Burst of parsed packets returned by packet receiver in one call.
+ */
+struct PacketBlock {
+   Packet *pkts;  /**< Array of packets, each has MAXPCKTSIZE + 1 bytes of data storage. */
+   size_t cnt;    /**< Number of parsed packets stored in block. */
+   size_t total;  /**< Number of received packets including those which were not parsed. */
+   size_t size;   /**< Max number of packets in block. */
+   char *data;    /**< Storage for packets data. */
 
    /**
     * \brief Constructor.
+    * \param [in] pkts_size Max number of packets in block.
     */
-   Packet() : total_length(0), packet(NULL), payload_length(0), payload(NULL)
+   PacketBlock(size_t pkts_size) : cnt(0), total(0), size(pkts_size)
    {
+      pkts = new Packet[size];
+      data = new char[size * (MAXPCKTSIZE + 1)];
+      for (size_t i = 0; i < size; i++) {
+         pkts[i].packet = data + i * (MAXPCKTSIZE + 1);
+      }
    }
+
+   ~PacketBlock()
+   {
+      delete [] pkts;
+      delete [] data;
+   }
+
+private:
+   PacketBlock(const PacketBlock &);
+   PacketBlock &operator=(const PacketBlock &);
 };
 
 #endif
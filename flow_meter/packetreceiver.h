@@ -61,13 +61,43 @@ class PacketReceiver
 public:
    string error_msg; /**< String to store an error messages. */
 
+   virtual ~PacketReceiver()
+   {
+   }
+
+   /**
+    * \brief Install BPF filter.
+    * \param [in] filter_str String containing program.
+    * \return 0 on success, non 0 on failure + error_msg is filled with error message
+    */
+   virtual int set_filter(const string &filter_str) = 0;
+
+   /**
+    * \brief Close opened file or interface.
+    */
+   virtual void close() = 0;
+
    /**
-    * \brief Get packet from network interface or file.
-    * \param [out] packet Variable for storing parsed packet.
-    * \return 2 if packet was parsed and stored, 1 if packet was not parsed, 3 when read timeout occur,
+    * \brief Get burst of packets from network interface or file.
+    * \param [out] block Block for storing parsed packets, previous content is discarded.
+    * \return 2 if at least one packet was parsed and stored, 1 if no packet was parsed, 3 when read timeout occur,
     *         0 if EOF or value < 0 on error
     */
-   virtual int get_pkt(Packet &packet) = 0;
+   virtual int get_pkts(PacketBlock &block) = 0;
+
+   /**
+    * \brief Get packets held by parser when capture is stopped, i.e. fragments of datagrams which were not reassembled.
+    * \param [out] block Block for storing parsed packets, previous content is discarded.
+    * \return 2 if at least one packet was stored, 0 if no packets are held.
+    */
+   virtual int get_held_pkts(PacketBlock &block) = 0;
+
+   /**
+    * \brief Print statistics of packet parser when capture is finished.
+    */
+   virtual void print_report()
+   {
+   }
 };
 
 #endif
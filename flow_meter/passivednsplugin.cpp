@@ -78,18 +78,6 @@ using namespace std;
 #define DEBUG_CODE(code)
 #endif
 
-/**
- * \brief Check for label pointer in DNS name.
- */
-#define IS_POINTER(ch) ((ch & 0xC0) == 0xC0)
-
-#define MAX_LABEL_CNT 127
-
-/**
- * \brief Get offset from 2 byte pointer.
- */
-#define GET_OFFSET(half1, half2) ((((uint8_t)(half1) & 0x3F) << 8) | (uint8_t)(half2))
-
 #define DNS_UNIREC_TEMPLATE "DNS_ID,DNS_ATYPE,DNS_NAME,DNS_RR_TTL,DNS_IP"
 
 UR_FIELDS (
@@ -151,6 +139,22 @@ void PassiveDNSPlugin::finish()
    }
 }
 
+/**
+ * \brief Plugin processes DNS responses from port 53 only.
+ */
+plugin_interest PassiveDNSPlugin::get_interest()
+{
+   return plugin_interest().port(53);
+}
+
+/**
+ * \brief Create PassiveDNS extension saved in flow cache checkpoint.
+ */
+RecordExt *PassiveDNSPlugin::deserialize(extTypeEnum type, const uint8_t *data, int size)
+{
+   return (type == passivedns ? RecordExtPassiveDNS::deserialize(data, size) : NULL);
+}
+
 string PassiveDNSPlugin::get_unirec_field_string()
 {
    return DNS_UNIREC_TEMPLATE;
@@ -166,76 +170,6 @@ const char **PassiveDNSPlugin::get_ipfix_string()
    return passivedns_ipfix_string;
 }
 
-/**
- * \brief Get name length.
- * \param [in] data Pointer to string.
- * \return Number of characters in string.
- */
-size_t PassiveDNSPlugin::get_name_length(const char *data) const
-{
-   size_t len = 0;
-
-   while (1) {
-      if ((uint32_t) (data - data_begin) + 1 > data_len) {
-         throw "Error: overflow";
-      }
-      if (!data[0]) {
-         break;
-      }
-      if (IS_POINTER(data[0])) {
-         return len + 2;
-      }
-
-      len += (uint8_t) data[0] + 1;
-      data += (uint8_t) data[0] + 1;
-   }
-
-   return len + 1;
-}
-
-/**
- * \brief Decompress dns name.
- * \param [in] data Pointer to compressed data.
- * \return String with decompressed dns name.
- */
-string PassiveDNSPlugin::get_name(const char *data) const
-{
-   string name = "";
-   int label_cnt = 0;
-
-   if ((uint32_t) (data - data_begin) > data_len) {
-      throw "Error: overflow";
-   }
-
-   while (data[0]) { /* Check for terminating character. */
-      if (IS_POINTER(data[0])) { /* Check for label pointer (11xxxxxx byte) */
-         data = data_begin + GET_OFFSET(data[0], data[1]);
-
-         /* Check for possible errors.*/
-         if (label_cnt++ > MAX_LABEL_CNT || (uint32_t) (data - data_begin) > data_len) {
-            throw "Error: label count exceed or overflow";
-         }
-
-         continue;
-      }
-
-      /* Check for possible errors.*/
-      if (label_cnt++ > MAX_LABEL_CNT || (uint8_t) data[0] > 63 ||
-         (uint32_t) ((data - data_begin) + (uint8_t) data[0] + 2) > data_len) {
-         throw "Error: label count exceed or overflow";
-      }
-
-      name += '.' + string(data + 1, (uint8_t) data[0]);
-      data += ((uint8_t) data[0] + 1);
-   }
-
-   if (name[0] == '.') {
-      name.erase(0, 1);
-   }
-
-   return name;
-}
-
 /**
  * \brief Parse and store DNS packet.
  * \param [in] data Pointer to packet payload section.
@@ -246,171 +180,177 @@ string PassiveDNSPlugin::get_name(const char *data) const
 RecordExtPassiveDNS *PassiveDNSPlugin::parse_dns(const char *data, unsigned int payload_len, bool tcp)
 {
    RecordExtPassiveDNS *list = NULL;
+   char name[DNS_NAME_BUF_SIZE];
+   uint32_t name_len;
+   uint32_t skip;
 
-   try {
-      total++;
+   total++;
 
-      DEBUG_MSG("---------- dns parser #%u ----------\n", total);
-      DEBUG_MSG("Payload length: %u\n", payload_len);
+   DEBUG_MSG("---------- dns parser #%u ----------\n", total);
+   DEBUG_MSG("Payload length: %u\n", payload_len);
 
-      if (tcp) {
-         payload_len -= 2;
-         if (ntohs(*(uint16_t *) data) != payload_len) {
-            DEBUG_MSG("parser quits: fragmented tcp pkt");
-            return NULL;
-         }
-         data += 2;
+   if (tcp) {
+      payload_len -= 2;
+      if (ntohs(*(uint16_t *) data) != payload_len) {
+         DEBUG_MSG("parser quits: fragmented tcp pkt");
+         return NULL;
       }
+      data += 2;
+   }
+
+   if (payload_len < sizeof(struct dns_hdr)) {
+      DEBUG_MSG("parser quits: payload length < %ld\n", sizeof(struct dns_hdr));
+      return NULL;
+   }
 
-      if (payload_len < sizeof(struct dns_hdr)) {
-         DEBUG_MSG("parser quits: payload length < %ld\n", sizeof(struct dns_hdr));
+   data_begin = data;
+   data_len = payload_len;
+
+   struct dns_hdr *dns = (struct dns_hdr *) data;
+   //uint16_t flags = ntohs(dns->flags);
+   uint16_t question_cnt = ntohs(dns->question_rec_cnt);
+   uint16_t answer_rr_cnt = ntohs(dns->answer_rec_cnt);
+
+   DEBUG_MSG("DNS message header\n");
+   DEBUG_MSG("\tTransaction ID:\t\t%#06x\n",       ntohs(dns->id));
+   DEBUG_MSG("\tFlags:\t\t\t%#06x\n",              ntohs(dns->flags));
+
+   DEBUG_MSG("\t\tQuestion/reply:\t\t%u\n",        DNS_HDR_GET_QR(flags));
+   DEBUG_MSG("\t\tOP code:\t\t%u\n",               DNS_HDR_GET_OPCODE(flags));
+   DEBUG_MSG("\t\tAuthoritative answer:\t%u\n",    DNS_HDR_GET_AA(flags));
+   DEBUG_MSG("\t\tTruncation:\t\t%u\n",            DNS_HDR_GET_TC(flags));
+   DEBUG_MSG("\t\tRecursion desired:\t%u\n",       DNS_HDR_GET_RD(flags));
+   DEBUG_MSG("\t\tRecursion available:\t%u\n",     DNS_HDR_GET_RA(flags));
+   DEBUG_MSG("\t\tReserved:\t\t%u\n",              DNS_HDR_GET_Z(flags));
+   DEBUG_MSG("\t\tAuth data:\t\t%u\n",             DNS_HDR_GET_AD(flags));
+   DEBUG_MSG("\t\tChecking disabled:\t%u\n",       DNS_HDR_GET_CD(flags));
+   DEBUG_MSG("\t\tResponse code:\t\t%u\n",         DNS_HDR_GET_RESPCODE(flags));
+
+   DEBUG_MSG("\tQuestions:\t\t%u\n",               question_cnt);
+   DEBUG_MSG("\tAnswer RRs:\t\t%u\n",              answer_rr_cnt);
+   DEBUG_MSG("\tAuthority RRs:\t\t%u\n",           authority_rr_cnt);
+   DEBUG_MSG("\tAdditional RRs:\t\t%u\n",          additional_rr_cnt);
+
+   /********************************************************************
+   *****                   DNS Question section                    *****
+   ********************************************************************/
+   data += sizeof(struct dns_hdr);
+   for (int i = 0; i < question_cnt; i++) {
+      DEBUG_MSG("\nDNS question #%d\n",            i + 1);
+      DEBUG_MSG("\tName:\t\t\t%s\n",               name.c_str());
+
+      if (dns_name_length(data_begin, data_len, data, skip) != DNS_OK) {
+         DEBUG_MSG("DNS parser quits: overflow\n\n");
          return NULL;
       }
+      data += skip;
 
-      data_begin = data;
-      data_len = payload_len;
-
-      struct dns_hdr *dns = (struct dns_hdr *) data;
-      //uint16_t flags = ntohs(dns->flags);
-      uint16_t question_cnt = ntohs(dns->question_rec_cnt);
-      uint16_t answer_rr_cnt = ntohs(dns->answer_rec_cnt);
-
-      DEBUG_MSG("DNS message header\n");
-      DEBUG_MSG("\tTransaction ID:\t\t%#06x\n",       ntohs(dns->id));
-      DEBUG_MSG("\tFlags:\t\t\t%#06x\n",              ntohs(dns->flags));
-
-      DEBUG_MSG("\t\tQuestion/reply:\t\t%u\n",        DNS_HDR_GET_QR(flags));
-      DEBUG_MSG("\t\tOP code:\t\t%u\n",               DNS_HDR_GET_OPCODE(flags));
-      DEBUG_MSG("\t\tAuthoritative answer:\t%u\n",    DNS_HDR_GET_AA(flags));
-      DEBUG_MSG("\t\tTruncation:\t\t%u\n",            DNS_HDR_GET_TC(flags));
-      DEBUG_MSG("\t\tRecursion desired:\t%u\n",       DNS_HDR_GET_RD(flags));
-      DEBUG_MSG("\t\tRecursion available:\t%u\n",     DNS_HDR_GET_RA(flags));
-      DEBUG_MSG("\t\tReserved:\t\t%u\n",              DNS_HDR_GET_Z(flags));
-      DEBUG_MSG("\t\tAuth data:\t\t%u\n",             DNS_HDR_GET_AD(flags));
-      DEBUG_MSG("\t\tChecking disabled:\t%u\n",       DNS_HDR_GET_CD(flags));
-      DEBUG_MSG("\t\tResponse code:\t\t%u\n",         DNS_HDR_GET_RESPCODE(flags));
-
-      DEBUG_MSG("\tQuestions:\t\t%u\n",               question_cnt);
-      DEBUG_MSG("\tAnswer RRs:\t\t%u\n",              answer_rr_cnt);
-      DEBUG_MSG("\tAuthority RRs:\t\t%u\n",           authority_rr_cnt);
-      DEBUG_MSG("\tAdditional RRs:\t\t%u\n",          additional_rr_cnt);
-
-      /********************************************************************
-      *****                   DNS Question section                    *****
-      ********************************************************************/
-      data += sizeof(struct dns_hdr);
-      for (int i = 0; i < question_cnt; i++) {
-         DEBUG_MSG("\nDNS question #%d\n",            i + 1);
-         DEBUG_MSG("\tName:\t\t\t%s\n",               name.c_str());
-
-         data += get_name_length(data);
-
-         if ((data - data_begin) + sizeof(struct dns_question) > payload_len) {
-            DEBUG_MSG("DNS parser quits: overflow\n\n");
-            return NULL;
-         }
+      if ((data - data_begin) + sizeof(struct dns_question) > payload_len) {
+         DEBUG_MSG("DNS parser quits: overflow\n\n");
+         return NULL;
+      }
+
+      DEBUG_MSG("\tType:\t\t\t%u\n",               ntohs(question->qtype));
+      DEBUG_MSG("\tClass:\t\t\t%u\n",              ntohs(question->qclass));
+      data += sizeof(struct dns_question);
+   }
 
-         DEBUG_MSG("\tType:\t\t\t%u\n",               ntohs(question->qtype));
-         DEBUG_MSG("\tClass:\t\t\t%u\n",              ntohs(question->qclass));
-         data += sizeof(struct dns_question);
+   /********************************************************************
+   *****                    DNS Answers section                    *****
+   ********************************************************************/
+   size_t rdlength;
+   for (int i = 0; i < answer_rr_cnt; i++) { // Process answers section.
+      DEBUG_MSG("DNS answer #%d\n", i + 1);
+      if (dns_decode_name(data_begin, data_len, data, name, sizeof(name), name_len) != DNS_OK ||
+         dns_name_length(data_begin, data_len, data, skip) != DNS_OK) {
+         DEBUG_MSG("DNS parser quits: malformed name\n\n");
+         return list;
       }
+      DEBUG_MSG("\tAnswer name:\t\t%s\n",          name);
+      data += skip;
 
-      /********************************************************************
-      *****                    DNS Answers section                    *****
-      ********************************************************************/
-      size_t rdlength;
-      for (int i = 0; i < answer_rr_cnt; i++) { // Process answers section.
-         DEBUG_MSG("DNS answer #%d\n", i + 1);
-         DEBUG_MSG("\tAnswer name:\t\t%s\n",          get_name(data).c_str());
-         string name = get_name(data);
-         data += get_name_length(data);
-
-         struct dns_answer *answer = (struct dns_answer *) data;
-
-         uint32_t tmp = (data - data_begin) + sizeof(dns_answer);
-         if (tmp > payload_len || tmp + ntohs(answer->rdlength) > payload_len) {
-            DEBUG_MSG("DNS parser quits: overflow\n\n");
-            return list;
-         }
+      struct dns_answer *answer = (struct dns_answer *) data;
 
-         DEBUG_MSG("\tType:\t\t\t%u\n",               ntohs(answer->atype));
-         DEBUG_MSG("\tClass:\t\t\t%u\n",              ntohs(answer->aclass));
-         DEBUG_MSG("\tTTL:\t\t\t%u\n",                ntohl(answer->ttl));
-         DEBUG_MSG("\tRD length:\t\t%u\n",            ntohs(answer->rdlength));
+      uint32_t tmp = (data - data_begin) + sizeof(dns_answer);
+      if (tmp > payload_len || tmp + ntohs(answer->rdlength) > payload_len) {
+         DEBUG_MSG("DNS parser quits: overflow\n\n");
+         return list;
+      }
 
-         data += sizeof(struct dns_answer);
-         rdlength = ntohs(answer->rdlength);
+      DEBUG_MSG("\tType:\t\t\t%u\n",               ntohs(answer->atype));
+      DEBUG_MSG("\tClass:\t\t\t%u\n",              ntohs(answer->aclass));
+      DEBUG_MSG("\tTTL:\t\t\t%u\n",                ntohl(answer->ttl));
+      DEBUG_MSG("\tRD length:\t\t%u\n",            ntohs(answer->rdlength));
 
-         uint16_t type = ntohs(answer->atype);
-         if (type == DNS_TYPE_A || type == DNS_TYPE_AAAA) {
-            RecordExtPassiveDNS *rec = new RecordExtPassiveDNS();
+      data += sizeof(struct dns_answer);
+      rdlength = ntohs(answer->rdlength);
 
-            size_t length = name.length();
-            if (length >= sizeof(rec->aname)) {
-               DEBUG_MSG("Truncating aname (length = %lu) to %lu.\n", length, sizeof(rec->aname) - 1);
-               length = sizeof(rec->aname) - 1;
-            }
-            memcpy(rec->aname, name.c_str(), length);
-            rec->aname[length] = 0;
-
-            rec->id = ntohs(dns->id);
-            rec->rr_ttl = ntohl(answer->ttl);
-            rec->atype = type;
-
-            if (rec->atype == DNS_TYPE_A) {
-               // IPv4
-               rec->ip.v4 = *(uint32_t *) data;
-               parsed_a++;
-               rec->ip_version = 4;
-            } else {
-               // IPv6
-               memcpy(rec->ip.v6, data, 16);
-               parsed_aaaa++;
-               rec->ip_version = 6;
-            }
+      uint16_t type = ntohs(answer->atype);
+      if (type == DNS_TYPE_A || type == DNS_TYPE_AAAA) {
+         RecordExtPassiveDNS *rec = new RecordExtPassiveDNS();
+
+         uint32_t length = name_len;
+         if (length >= sizeof(rec->aname)) {
+            DEBUG_MSG("Truncating aname (length = %u) to %lu.\n", length, sizeof(rec->aname) - 1);
+            length = sizeof(rec->aname) - 1;
+         }
+         memcpy(rec->aname, name, length);
+         rec->aname[length] = 0;
+
+         rec->id = ntohs(dns->id);
+         rec->rr_ttl = ntohl(answer->ttl);
+         rec->atype = type;
+
+         if (rec->atype == DNS_TYPE_A) {
+            // IPv4
+            rec->ip.v4 = *(uint32_t *) data;
+            parsed_a++;
+            rec->ip_version = 4;
+         } else {
+            // IPv6
+            memcpy(rec->ip.v6, data, 16);
+            parsed_aaaa++;
+            rec->ip_version = 6;
+         }
 
+         if (list == NULL) {
+            list = rec;
+         } else {
+            list->addExtension(rec);
+         }
+      } else if (type == DNS_TYPE_PTR) {
+         RecordExtPassiveDNS *rec = new RecordExtPassiveDNS();
+
+         rec->id = ntohs(dns->id);
+         rec->rr_ttl = ntohl(answer->ttl);
+         rec->atype = type;
+
+         /* Copy domain name. */
+         uint32_t length;
+         if (dns_decode_name(data_begin, data_len, data, rec->aname, sizeof(rec->aname), length) != DNS_OK) {
+            DEBUG_MSG("DNS parser quits: malformed name\n\n");
+            delete rec;
+            return list;
+         }
+
+         /* Owner name longer than buffer can't be valid reverse lookup name. */
+         if (name_len >= sizeof(name) || !process_ptr_record(string(name, name_len), rec)) {
+            delete rec;
+         } else {
+            parsed_ptr++;
             if (list == NULL) {
                list = rec;
             } else {
                list->addExtension(rec);
             }
-         } else if (type == DNS_TYPE_PTR) {
-            RecordExtPassiveDNS *rec = new RecordExtPassiveDNS();
-
-            rec->id = ntohs(dns->id);
-            rec->rr_ttl = ntohl(answer->ttl);
-            rec->atype = type;
-
-            /* Copy domain name. */
-            string tmp = get_name(data);
-            size_t length = tmp.length();
-            if (length >= sizeof(rec->aname)) {
-               DEBUG_MSG("Truncating aname (length = %lu) to %lu.\n", length, sizeof(rec->aname) - 1);
-               length = sizeof(rec->aname) - 1;
-            }
-            memcpy(rec->aname, tmp.c_str(), length);
-            rec->aname[length] = 0;
-
-            if (!process_ptr_record(name, rec)) {
-               delete rec;
-            } else {
-               parsed_ptr++;
-               if (list == NULL) {
-                  list = rec;
-               } else {
-                  list->addExtension(rec);
-               }
-            }
          }
-
-         data += rdlength;
       }
 
-      DEBUG_MSG("DNS parser quits: parsing done\n\n");
-   } catch (const char *err) {
-      DEBUG_MSG("%s\n", err);
+      data += rdlength;
    }
 
+   DEBUG_MSG("DNS parser quits: parsing done\n\n");
+
    return list;
 }
 
@@ -446,6 +386,9 @@ bool PassiveDNSPlugin::process_ptr_record(string name, RecordExtPassiveDNS *rec)
 {
    memset(&rec->ip, 0, sizeof(rec->ip));
 
+   if (name.empty()) {
+      return false;
+   }
    if (name[name.length() - 1] == '.') {
       name.erase(name.length() - 1);
    }
@@ -459,7 +402,7 @@ bool PassiveDNSPlugin::process_ptr_record(string name, RecordExtPassiveDNS *rec)
    size_t type_pos = name.find(type_str);
    size_t begin = 0, end = 0, cnt = 0;
    uint8_t *ip;
-   if (type_pos + type_str.length() == name.length()) {
+   if (type_pos != string::npos && type_pos + type_str.length() == name.length()) {
       // IPv4
       name.erase(type_pos);
       rec->ip_version = 4;
@@ -479,7 +422,7 @@ bool PassiveDNSPlugin::process_ptr_record(string name, RecordExtPassiveDNS *rec)
    } else {
       type_str = ".ip6.arpa";
       type_pos = name.find(type_str);
-      if (type_pos + type_str.length() == name.length()) {
+      if (type_pos != string::npos && type_pos + type_str.length() == name.length()) {
          // IPv6
          name.erase(type_pos);
          rec->ip_version = 6;
@@ -53,6 +53,7 @@
 #include "packet.h"
 #include "flow_meter.h"
 #include "dns.h"
+#include "dnsparser.h"
 
 using namespace std;
 
@@ -67,6 +68,9 @@ struct RecordExtPassiveDNS : RecordExt {
    uint32_t rr_ttl;
    ipaddr_t ip;
 
+   RECORD_EXT_POOLED(passivedns)
+   RECORD_EXT_SERIALIZED(RecordExtPassiveDNS, atype)
+
    /**
     * \brief Constructor.
     */
@@ -128,15 +132,15 @@ public:
    int post_create(Flow &rec, const Packet &pkt);
    int pre_update(Flow &rec, Packet &pkt);
    void finish();
+   plugin_interest get_interest();
    string get_unirec_field_string();
    const char **get_ipfix_string();
+   RecordExt *deserialize(extTypeEnum type, const uint8_t *data, int size);
 
 private:
    RecordExtPassiveDNS *parse_dns(const char *data, unsigned int payload_len, bool tcp);
    int add_ext_dns(const char *data, unsigned int payload_len, bool tcp, Flow &rec);
 
-   string get_name(const char *data) const;
-   size_t get_name_length(const char *data) const;
    bool process_ptr_record(string name, RecordExtPassiveDNS *rec);
    bool str_to_uint4(string str, uint8_t &dst);
 
@@ -61,12 +61,6 @@
 
 using namespace std;
 
-// Read timeout in miliseconds for pcap_open_live function.
-#define READ_TIMEOUT 1000
-
-// Interval between pcap handle stats print in seconds.
-#define STATS_PRINT_INTERVAL  5
-
 //#define DEBUG_PARSER
 
 #ifdef DEBUG_PARSER
@@ -83,16 +77,6 @@ using namespace std;
 static uint32_t s_total_pkts = 0;
 #endif /* DEBUG_PARSER */
 
-/**
- * \brief Distinguish between valid (parsed) and non-valid packet.
- */
-bool packet_valid = false;
-
-/**
- * \brief Parse every packet.
- */
-bool parse_all = false;
-
 /**
  * \brief Parse specific fields from ETHERNET frame header.
  * \param [in] data_ptr Pointer to begin of header.
@@ -158,6 +142,15 @@ inline uint16_t parse_ipv4_hdr(const u_char *data_ptr, Packet *pkt)
    pkt->src_ip.v4 = ip->saddr;
    pkt->dst_ip.v4 = ip->daddr;
 
+   uint16_t frag_off = ntohs(ip->frag_off);
+   if (frag_off & (IP_MF | IP_OFFMASK)) {
+      pkt->field_indicator |= PCKT_FRAGMENT;
+      pkt->frag_id = ntohs(ip->id);
+      pkt->frag_off = (frag_off & IP_OFFMASK) << 3;
+      pkt->frag_len = (pkt->ip_length > (ip->ihl << 2) ? pkt->ip_length - (ip->ihl << 2) : 0);
+      pkt->frag_more = (frag_off & IP_MF) != 0;
+   }
+
    DEBUG_MSG("IPv4 header:\n");
    DEBUG_MSG("\tHDR version:\t%u\n",   ip->version);
    DEBUG_MSG("\tHDR length:\t%u\n",    ip->ihl);
@@ -186,6 +179,7 @@ uint16_t skip_ipv6_ext_hdrs(const u_char *data_ptr, Packet *pkt)
    struct ip6_ext *ext = (struct ip6_ext *) data_ptr;
    uint8_t next_hdr = pkt->ip_proto;
    uint16_t hdrs_len = 0;
+   uint16_t frag_end = 0;
 
    /* Skip extension headers... */
    while (1) {
@@ -198,7 +192,23 @@ uint16_t skip_ipv6_ext_hdrs(const u_char *data_ptr, Packet *pkt)
       } else if (next_hdr == IPPROTO_AH) {
          hdrs_len += (ext->ip6e_len << 2) - 2;
       } else if (next_hdr == IPPROTO_FRAGMENT) {
+         struct ip6_frag *frag = (struct ip6_frag *) ext;
+         uint16_t offlg = ntohs(frag->ip6f_offlg);
+
          hdrs_len += 8;
+         if (offlg & 0xFFF9) { /* Offset or more fragments flag is set. */
+            pkt->field_indicator |= PCKT_FRAGMENT;
+            pkt->frag_id = ntohl(frag->ip6f_ident);
+            pkt->frag_off = offlg & 0xFFF8;
+            pkt->frag_len = (pkt->ip_length > hdrs_len ? pkt->ip_length - hdrs_len : 0);
+            pkt->frag_more = (offlg & 0x1) != 0;
+            frag_end = hdrs_len;
+            if (pkt->frag_off != 0) {
+               /* Headers following fragment header are present in first fragment only. */
+               pkt->ip_proto = frag->ip6f_nxt;
+               break;
+            }
+         }
       } else {
          break;
       }
@@ -210,6 +220,11 @@ uint16_t skip_ipv6_ext_hdrs(const u_char *data_ptr, Packet *pkt)
       pkt->ip_proto = next_hdr;
    }
 
+   if (frag_end != 0 && frag_end != hdrs_len) {
+      /* Data of first fragment do not start with transport header, datagram cannot be reassembled. */
+      pkt->frag_len = 0;
+   }
+
    return hdrs_len;
 }
 
@@ -267,6 +282,7 @@ inline uint16_t parse_tcp_hdr(const u_char *data_ptr, Packet *pkt)
    pkt->src_port = ntohs(tcp->source);
    pkt->dst_port = ntohs(tcp->dest);
    pkt->tcp_control_bits = (uint8_t) *(data_ptr + 13) & 0x3F;
+   pkt->tcp_seq = ntohl(tcp->seq);
 
    DEBUG_MSG("TCP header:\n");
    DEBUG_MSG("\tSrc port:\t%u\n",   ntohs(tcp->source));
@@ -351,6 +367,28 @@ inline uint16_t parse_icmpv6_hdr(const u_char *data_ptr, Packet *pkt)
    return 0;
 }
 
+/**
+ * \brief Parse transport header of packet with parsed network header.
+ * \param [in] data_ptr Pointer to begin of header.
+ * \param [out] pkt Pointer to Packet structure where parsed fields will be stored.
+ * \return Size of header in bytes.
+ */
+inline uint16_t parse_l4_hdr(const u_char *data_ptr, Packet *pkt)
+{
+   if ((pkt->field_indicator & PCKT_FRAGMENT) && pkt->frag_off != 0) {
+      DEBUG_MSG("Non-first fragment, offset %u\n", pkt->frag_off);
+   } else if (pkt->ip_proto == IPPROTO_TCP) {
+      return parse_tcp_hdr(data_ptr, pkt);
+   } else if (pkt->ip_proto == IPPROTO_UDP) {
+      return parse_udp_hdr(data_ptr, pkt);
+   } else if (pkt->ip_proto == IPPROTO_ICMP) {
+      return parse_icmp_hdr(data_ptr, pkt);
+   } else if (pkt->ip_proto == IPPROTO_ICMPV6) {
+      return parse_icmpv6_hdr(data_ptr, pkt);
+   }
+   return 0;
+}
+
 uint16_t process_mpls_stack(const u_char *data_ptr)
 {
    uint32_t *mpls;
@@ -435,17 +473,271 @@ inline uint16_t process_pppoe(const u_char *data_ptr, Packet *pkt)
    return length;
 }
 
+/**
+ * \brief Parse GRE header (RFC 2784, RFC 2890).
+ * \param [in] data_ptr Pointer to begin of header.
+ * \param [in] avail Number of captured bytes available from begin of header.
+ * \param [out] id GRE key or 0 if key is not present.
+ * \param [out] proto Ethertype of encapsulated header or 0 if header cannot be decapsulated.
+ * \return Size of header in bytes.
+ */
+static uint16_t parse_gre_hdr(const u_char *data_ptr, uint32_t avail, uint32_t &id, uint16_t &proto)
+{
+   if (avail < 4) {
+      return 0;
+   }
+   uint16_t flags = ntohs(*(uint16_t *) data_ptr);
+   uint16_t length = 4;
+
+   DEBUG_MSG("GRE header:\n");
+   DEBUG_MSG("\tFlags:\t%#06x\n",    flags);
+   DEBUG_MSG("\tProtocol:\t%#06x\n", ntohs(*(uint16_t *) (data_ptr + 2)));
+   if ((flags & 0x4007) != 0) {
+      return 0; /* Routing present or enhanced GRE (PPTP) is not supported. */
+   }
+   if (flags & 0x8000) {
+      length += 4; /* Checksum and reserved field. */
+   }
+   if (flags & 0x2000) {
+      if (avail < (uint32_t) length + 4) {
+         return 0;
+      }
+      id = ntohl(*(uint32_t *) (data_ptr + length));
+      length += 4;
+   }
+   if (flags & 0x1000) {
+      length += 4; /* Sequence number. */
+   }
+   if (avail >= length) {
+      proto = ntohs(*(uint16_t *) (data_ptr + 2));
+   }
+
+   return length;
+}
+
+/**
+ * \brief Parse VXLAN header (RFC 7348).
+ * \param [in] data_ptr Pointer to begin of header.
+ * \param [in] avail Number of captured bytes available from begin of header.
+ * \param [out] id VXLAN network identifier.
+ * \param [out] proto Ethertype of encapsulated header or 0 if header cannot be decapsulated.
+ * \return Size of header in bytes.
+ */
+static uint16_t parse_vxlan_hdr(const u_char *data_ptr, uint32_t avail, uint32_t &id, uint16_t &proto)
+{
+   if (avail < 8 || !(data_ptr[0] & 0x08)) {
+      return 0; /* VNI is not valid. */
+   }
+   id = ntohl(*(uint32_t *) (data_ptr + 4)) >> 8;
+   proto = ETH_P_TEB;
+
+   DEBUG_MSG("VXLAN header:\n");
+   DEBUG_MSG("\tFlags:\t%#04x\n", data_ptr[0]);
+   DEBUG_MSG("\tVNI:\t%u\n",      id);
+
+   return 8;
+}
+
+/**
+ * \brief Parse GTP-U header (3GPP TS 29.281) of G-PDU message.
+ * \param [in] data_ptr Pointer to begin of header.
+ * \param [in] avail Number of captured bytes available from begin of header.
+ * \param [out] id Tunnel endpoint identifier.
+ * \param [out] proto Ethertype of encapsulated header or 0 if header cannot be decapsulated.
+ * \return Size of header in bytes.
+ */
+static uint16_t parse_gtpu_hdr(const u_char *data_ptr, uint32_t avail, uint32_t &id, uint16_t &proto)
+{
+   /* Version 1, protocol type GTP and message type G-PDU. */
+   if (avail < 8 || (data_ptr[0] & 0xF0) != 0x30 || data_ptr[1] != 0xFF) {
+      return 0;
+   }
+   uint32_t length = 8;
+
+   id = ntohl(*(uint32_t *) (data_ptr + 4));
+   DEBUG_MSG("GTP-U header:\n");
+   DEBUG_MSG("\tFlags:\t%#04x\n", data_ptr[0]);
+   DEBUG_MSG("\tTEID:\t%#x\n",    id);
+   if (data_ptr[0] & 0x07) {
+      length += 4; /* Sequence number, N-PDU number and next extension header type. */
+      if (data_ptr[0] & 0x04) {
+         while (avail >= length && data_ptr[length - 1] != 0) {
+            if (avail <= length || data_ptr[length] == 0) {
+               return 0;
+            }
+            length += data_ptr[length] << 2;
+         }
+      }
+   }
+   if (avail <= length) {
+      return 0;
+   }
+
+   uint8_t version = data_ptr[length] >> 4;
+   if (version == 4) {
+      proto = ETH_P_IP;
+   } else if (version == 6) {
+      proto = ETH_P_IPV6;
+   }
+
+   return length;
+}
+
+/**
+ * \brief Decapsulate enabled tunnels and parse headers of encapsulated packet.
+ *
+ * Innermost network and transport headers replace the outer ones, so the flow key is made of inner
+ * addresses and ports. Endpoints and identifier of the innermost tunnel are stored in tunnel_* fields.
+ * Fragmented tunnel packets are not decapsulated.
+ * \param [in] opt Packet parser state.
+ * \param [in,out] pkt Packet with parsed outer headers.
+ * \param [in] data Pointer to the captured packet data.
+ * \param [in] caplen Number of captured bytes.
+ * \param [in,out] net_offset Offset of data following network headers.
+ * \param [in] data_offset Offset of data following transport header.
+ * \return Offset of data following innermost transport header.
+ */
+static uint16_t process_tunnels(parser_opt_t *opt, Packet *pkt, const u_char *data, uint32_t caplen, uint16_t &net_offset, uint16_t data_offset)
+{
+   for (uint8_t depth = 0; depth < opt->tunnel_depth; depth++) {
+      if ((pkt->field_indicator & PCKT_FRAGMENT) || data_offset >= caplen) {
+         break;
+      }
+
+      uint8_t type = 0;
+      uint32_t id = 0;
+      uint16_t proto = 0;
+      uint32_t offset = net_offset;
+      uint16_t hdr_len = 0;
+
+      if (pkt->ip_proto == IPPROTO_UDP) {
+         offset = data_offset;
+         if (pkt->dst_port == VXLAN_PORT && (opt->tunnels & (1 << TUNNEL_VXLAN))) {
+            type = TUNNEL_VXLAN;
+            hdr_len = parse_vxlan_hdr(data + offset, caplen - offset, id, proto);
+         } else if ((pkt->dst_port == GTPU_PORT || pkt->src_port == GTPU_PORT) && (opt->tunnels & (1 << TUNNEL_GTPU))) {
+            type = TUNNEL_GTPU;
+            hdr_len = parse_gtpu_hdr(data + offset, caplen - offset, id, proto);
+         }
+      } else if (pkt->ip_proto == IPPROTO_GRE && (opt->tunnels & (1 << TUNNEL_GRE))) {
+         type = TUNNEL_GRE;
+         hdr_len = parse_gre_hdr(data + offset, caplen - offset, id, proto);
+      } else if (pkt->ip_proto == IPPROTO_IPIP && (opt->tunnels & (1 << TUNNEL_IPIP))) {
+         type = TUNNEL_IPIP;
+         proto = ETH_P_IP;
+      } else if (pkt->ip_proto == IPPROTO_IPV6 && (opt->tunnels & (1 << TUNNEL_IPIP))) {
+         type = TUNNEL_IPIP;
+         proto = ETH_P_IPV6;
+      }
+      offset += hdr_len;
+
+      if (proto == ETH_P_TEB && caplen >= offset + 14) {
+         /* Encapsulated Ethernet frame, MAC addresses of outer frame are kept. */
+         Packet tmp;
+         offset += parse_eth_hdr(data + offset, &tmp);
+         proto = tmp.ethertype;
+      }
+      if (!(proto == ETH_P_IP && caplen >= offset + 20) && !(proto == ETH_P_IPV6 && caplen >= offset + 40)) {
+         break;
+      }
+      DEBUG_MSG("Decapsulating tunnel type %u\n", type);
+
+      pkt->field_indicator = (pkt->field_indicator & ~(PCKT_TCP | PCKT_UDP | PCKT_ICMP | PCKT_PAYLOAD)) | PCKT_TUNNEL;
+      pkt->tunnel_type = type;
+      pkt->tunnel_id = id;
+      pkt->tunnel_ip_version = pkt->ip_version;
+      pkt->tunnel_src_ip = pkt->src_ip;
+      pkt->tunnel_dst_ip = pkt->dst_ip;
+      pkt->src_port = 0;
+      pkt->dst_port = 0;
+      pkt->tcp_control_bits = 0;
+      pkt->tcp_seq = 0;
+
+      if (proto == ETH_P_IP) {
+         offset += parse_ipv4_hdr(data + offset, pkt);
+      } else {
+         offset += parse_ipv6_hdr(data + offset, pkt);
+      }
+      net_offset = offset;
+      data_offset = offset + parse_l4_hdr(data + offset, pkt);
+   }
+
+   return data_offset;
+}
+
+/**
+ * \brief Track fragment of IP datagram, replace it by reassembled datagram when it is complete.
+ * \param [in] opt Packet parser state.
+ * \param [in,out] pkt Parsed fragment stored in block.
+ * \param [in] h Contains packet size.
+ * \param [in] data Pointer to the captured packet data.
+ * \param [in] net_offset Offset of fragment data following network headers.
+ * \return False if fragment is held for reassembly and must not be passed to flow cache.
+ */
+static bool process_fragment(parser_opt_t *opt, Packet *pkt, const struct pcap_pkthdr *h, const u_char *data, uint16_t net_offset)
+{
+   if (opt->frags == NULL) {
+      if (pkt->frag_off != 0) {
+         pkt->payload_length = 0; /* Fragment data do not start with transport header. */
+      }
+      return true;
+   }
+
+   const char *frag_data = NULL;
+   if (pkt->frag_len != 0 && h->caplen >= (uint32_t) net_offset + pkt->frag_len) {
+      frag_data = (const char *) data + net_offset;
+   }
+
+   const char *datagram;
+   uint16_t datagram_len;
+   int ret = opt->frags->add(*pkt, net_offset, frag_data, pkt->frag_len, datagram, datagram_len);
+   if (ret != FRAG_REASSEMBLED) {
+      return ret == FRAG_PASS;
+   }
+
+   /* Network headers of current fragment are followed by reassembled UDP datagram. */
+   uint32_t len = net_offset + datagram_len;
+   if (len > MAXPCKTSIZE) {
+      len = MAXPCKTSIZE;
+   }
+   if (len > net_offset + 8 + opt->payload_limit) {
+      len = net_offset + 8 + opt->payload_limit;
+   }
+   if (len < (uint32_t) net_offset + 8) {
+      return true;
+   }
+   memcpy(pkt->packet + net_offset, datagram, len - net_offset);
+   pkt->packet[len] = 0;
+   pkt->total_length = len;
+
+   pkt->field_indicator &= ~PCKT_FRAGMENT;
+   pkt->ip_length = pkt->ip_length - pkt->frag_len + datagram_len;
+   if (pkt->ip_version == 6) {
+      pkt->ip_length -= 8; /* Reassembled datagram has no fragment header. */
+   }
+   pkt->payload_length = len - net_offset - 8;
+   pkt->payload = pkt->packet + net_offset + 8;
+   DEBUG_MSG("Reassembled datagram of %u bytes\n", datagram_len);
+   return true;
+}
+
 /**
  * \brief Parsing callback function for pcap_dispatch() call. Parse packets up to transport layer.
- * \param [in,out] arg Serves for passing pointer to Packet structure into callback function.
+ *
+ * Headers are parsed directly from libpcap buffer, only headers and payload bytes needed
+ * by plugins are copied into the next free packet of block.
+ * \param [in,out] arg Serves for passing pointer to parser_opt_t structure into callback function.
  * \param [in] h Contains timestamp and packet size.
  * \param [in] data Pointer to the captured packet data.
  */
 void packet_handler(u_char *arg, const struct pcap_pkthdr *h, const u_char *data)
 {
-   Packet *pkt = (Packet *) arg;
+   parser_opt_t *opt = (parser_opt_t *) arg;
+   Packet *pkt = &opt->block->pkts[opt->block->cnt];
    uint16_t data_offset = 0;
 
+   opt->block->total++;
+
    DEBUG_MSG("---------- packet parser  #%u -------------\n", ++s_total_pkts);
    DEBUG_CODE(
       char timestamp[32];
@@ -462,6 +754,8 @@ void packet_handler(u_char *arg, const struct pcap_pkthdr *h, const u_char *data
    pkt->ip_proto = 0;
    pkt->ip_version = 0;
    pkt->tcp_control_bits = 0;
+   pkt->tcp_seq = 0;
+   pkt->frag_more = false;
 
    data_offset = parse_eth_hdr(data, pkt);
    if (pkt->ethertype == ETH_P_IP) {
@@ -472,19 +766,17 @@ void packet_handler(u_char *arg, const struct pcap_pkthdr *h, const u_char *data
       data_offset += process_mpls(data + data_offset, pkt);
    } else if (pkt->ethertype == ETH_P_PPP_SES) {
       data_offset += process_pppoe(data + data_offset, pkt);
-   } else if (!parse_all) {
+   } else if (!opt->parse_all) {
       DEBUG_MSG("Unknown ethertype %x\n", pkt->ethertype);
       return;
    }
 
-   if (pkt->ip_proto == IPPROTO_TCP) {
-      data_offset += parse_tcp_hdr(data + data_offset, pkt);
-   } else if (pkt->ip_proto == IPPROTO_UDP) {
-      data_offset += parse_udp_hdr(data + data_offset, pkt);
-   } else if (pkt->ip_proto == IPPROTO_ICMP) {
-      data_offset += parse_icmp_hdr(data + data_offset, pkt);
-   } else if (pkt->ip_proto == IPPROTO_ICMPV6) {
-      data_offset += parse_icmpv6_hdr(data + data_offset, pkt);
+   uint16_t net_offset = data_offset;
+   data_offset += parse_l4_hdr(data + data_offset, pkt);
+   if (opt->tunnels != 0) {
+      uint16_t inner_offset = net_offset;
+      data_offset = process_tunnels(opt, pkt, data, h->caplen, inner_offset, data_offset);
+      net_offset = inner_offset;
    }
 
    uint32_t len = h->caplen;
@@ -492,16 +784,80 @@ void packet_handler(u_char *arg, const struct pcap_pkthdr *h, const u_char *data
       len = MAXPCKTSIZE;
       DEBUG_MSG("Packet size too long, truncating to %u\n", len);
    }
+   if (len > data_offset + opt->payload_limit) {
+      len = data_offset + opt->payload_limit; /* Payload is not needed by plugins. */
+   }
    memcpy(pkt->packet, data, len);
    pkt->packet[len] = 0;
    pkt->total_length = len;
 
-   pkt->payload_length = len - data_offset;
+   pkt->payload_length = (len > data_offset ? len - data_offset : 0); /* Headers can be truncated by snapshot length. */
    pkt->payload = pkt->packet + data_offset;
 
+   if ((pkt->field_indicator & PCKT_FRAGMENT) && !process_fragment(opt, pkt, h, data, net_offset)) {
+      DEBUG_MSG("Fragment held for reassembly\n");
+      return;
+   }
+
    DEBUG_MSG("Payload length:\t%u\n", pkt->payload_length);
    DEBUG_MSG("Packet parser exits: packet parsed\n");
-   packet_valid = true;
+   opt->block->cnt++;
+}
+
+/**
+ * \brief Store fragments released from fragment table into free packets of block.
+ *
+ * Fragments are released when their datagram was not reassembled, they are passed to flow cache
+ * before newly received packets.
+ * \param [in,out] opt Packet parser state.
+ */
+void release_fragments(parser_opt_t *opt)
+{
+   PacketBlock *block = opt->block;
+
+   if (opt->frags == NULL) {
+      return;
+   }
+   while (block->cnt < block->size && opt->frags->get_released(block->pkts[block->cnt])) {
+      block->cnt++;
+   }
+}
+
+/**
+ * \brief Release fragments of datagrams which timed out on live capture, at most once per second.
+ *
+ * Fragments are stored into free packets of block.
+ * \param [in,out] opt Packet parser state.
+ */
+void expire_fragments(parser_opt_t *opt)
+{
+   if (opt->frags == NULL) {
+      return;
+   }
+   time_t now = time(NULL);
+   if (now != opt->frags_expired) {
+      opt->frags_expired = now;
+      opt->frags->expire(now);
+   }
+   release_fragments(opt);
+}
+
+/**
+ * \brief Release all fragments held for reassembly when capture is stopped.
+ *
+ * Fragments are stored into block, which is emptied first.
+ * \param [in,out] opt Packet parser state.
+ * \return 2 if at least one fragment was stored, 0 if no fragments are held.
+ */
+int release_held_fragments(parser_opt_t *opt)
+{
+   opt->block->cnt = 0;
+   opt->block->total = 0;
+   if (opt->frags != NULL) {
+      opt->frags->flush();
+      release_fragments(opt);
+   }
+   return (opt->block->cnt > 0 ? 2 : 0);
 }
 
 /**
@@ -509,6 +865,13 @@ void packet_handler(u_char *arg, const struct pcap_pkthdr *h, const u_char *data
  */
 PcapReader::PcapReader() : handle(NULL), print_pcap_stats(false), netmask(PCAP_NETMASK_UNKNOWN)
 {
+   parser.block = NULL;
+   parser.parse_all = false;
+   parser.payload_limit = MAXPCKTSIZE;
+   parser.frags = NULL;
+   parser.frags_expired = 0;
+   parser.tunnels = 0;
+   parser.tunnel_depth = 0;
 }
 
 /**
@@ -520,6 +883,13 @@ PcapReader::PcapReader(const options_t &options) : handle(NULL), netmask(PCAP_NE
    print_pcap_stats = options.print_pcap_stats;
    last_ts.tv_sec = 0;
    last_ts.tv_usec = 0;
+   parser.block = NULL;
+   parser.parse_all = false;
+   parser.payload_limit = MAXPCKTSIZE;
+   parser.frags = (options.frag_entries != 0 ? new FragmentTable(options.frag_entries, options.frag_timeout, options.frag_reassembly) : NULL);
+   parser.frags_expired = 0;
+   parser.tunnels = options.tunnels;
+   parser.tunnel_depth = options.tunnel_depth;
 }
 
 /**
@@ -528,15 +898,17 @@ PcapReader::PcapReader(const options_t &options) : handle(NULL), netmask(PCAP_NE
 PcapReader::~PcapReader()
 {
    this->close();
+   delete parser.frags;
 }
 
 /**
  * \brief Open pcap file for reading.
  * \param [in] file Input file name.
  * \param [in] parse_every_pkt Try to parse every captured packet.
+ * \param [in] payload_limit Max number of payload bytes needed by plugins.
  * \return 0 on success, non 0 on failure + error_msg is filled with error message
  */
-int PcapReader::open_file(const string &file, bool parse_every_pkt)
+int PcapReader::open_file(const string &file, bool parse_every_pkt, uint32_t payload_limit)
 {
    if (handle != NULL) {
       error_msg = "Interface or pcap file is already opened.";
@@ -555,7 +927,8 @@ int PcapReader::open_file(const string &file, bool parse_every_pkt)
    }
 
    live_capture = false;
-   parse_all = parse_every_pkt;
+   parser.parse_all = parse_every_pkt;
+   parser.payload_limit = payload_limit;
    error_msg = "";
    return 0;
 }
@@ -565,9 +938,10 @@ int PcapReader::open_file(const string &file, bool parse_every_pkt)
  * \param [in] interface Interface name.
  * \param [in] snaplen Snapshot length to be set on pcap handle.
  * \param [in] parse_every_pkt Try to parse every captured packet.
+ * \param [in] payload_limit Max number of payload bytes needed by plugins.
  * \return 0 on success, non 0 on failure + error_msg is filled with error message
  */
-int PcapReader::init_interface(const string &interface, int snaplen, bool parse_every_pkt)
+int PcapReader::init_interface(const string &interface, int snaplen, bool parse_every_pkt, uint32_t payload_limit)
 {
    if (handle != NULL) {
       error_msg = "Interface or pcap file is already opened.";
@@ -606,7 +980,8 @@ int PcapReader::init_interface(const string &interface, int snaplen, bool parse_
    }
 
    live_capture = true;
-   parse_all = parse_every_pkt;
+   parser.parse_all = parse_every_pkt;
+   parser.payload_limit = payload_limit;
    error_msg = "";
    return 0;
 }
@@ -670,7 +1045,17 @@ void PcapReader::print_stats()
    }
 }
 
-int PcapReader::get_pkt(Packet &packet)
+/**
+ * \brief Print statistics of packet parser.
+ */
+void PcapReader::print_report()
+{
+   if (parser.frags != NULL) {
+      parser.frags->print_report();
+   }
+}
+
+int PcapReader::get_pkts(PacketBlock &block)
 {
    if (handle == NULL) {
       error_msg = "No live capture or file opened.";
@@ -678,26 +1063,51 @@ int PcapReader::get_pkt(Packet &packet)
    }
 
    int ret;
-   packet_valid = false;
+   block.cnt = 0;
+   block.total = 0;
+   parser.block = &block;
 
    if (print_pcap_stats) {
       print_stats();
    }
 
-   // Get pkt from network interface or file.
-   ret = pcap_dispatch(handle, 1, packet_handler, (u_char *) (&packet));
+   if (live_capture) {
+      expire_fragments(&parser);
+   } else {
+      release_fragments(&parser);
+   }
+   if (block.cnt == block.size) {
+      return 2;
+   }
+
+   // Get burst of packets from network interface or file.
+   ret = pcap_dispatch(handle, block.size - block.cnt, packet_handler, (u_char *) (&parser));
    if (ret == 0) {
       // Read timeout occured or no more packets in file...
+      if (live_capture) {
+         expire_fragments(&parser);
+      } else if (parser.frags != NULL) {
+         /* Pass fragments of incomplete datagrams to flow cache. */
+         parser.frags->flush();
+         release_fragments(&parser);
+      }
+      if (block.cnt > 0) {
+         return 2;
+      }
       return (live_capture ? 3 : 0);
    }
 
-   if (ret == 1 && packet_valid) {
-      // Packet is valid and ready to process by flow_cache.
-      return 2;
-   }
    if (ret < 0) {
       // Error occured.
       error_msg = pcap_geterr(handle);
+      return ret;
    }
-   return ret;
+   // Return 2 if at least one packet is valid and ready to process by flow_cache.
+   return (block.cnt > 0 ? 2 : 1);
+}
+
+int PcapReader::get_held_pkts(PacketBlock &block)
+{
+   parser.block = &block;
+   return release_held_fragments(&parser);
 }
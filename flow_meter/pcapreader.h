@@ -50,6 +50,7 @@
 
 #include "flow_meter.h"
 #include "packet.h"
+#include "fragmenttable.h"
 #include "packetreceiver.h"
 
 using namespace std;
@@ -58,6 +59,13 @@ using namespace std;
 #define ETH_P_8021AD	0x88A8          /* 802.1ad Service VLAN*/
 #endif
 
+#ifndef ETH_P_TEB
+#define ETH_P_TEB	0x6558          /* Trans Ether Bridging */
+#endif
+
+#define VXLAN_PORT   4789 /**< UDP destination port of VXLAN. */
+#define GTPU_PORT    2152 /**< UDP port of GTP-U. */
+
 /*
  * \brief Minimum snapshot length of pcap handle.
  */
@@ -68,6 +76,29 @@ using namespace std;
  */
 #define MAX_SNAPLEN  65535
 
+/*
+ * \brief Read timeout in miliseconds for live capture.
+ */
+#define READ_TIMEOUT 1000
+
+/*
+ * \brief Interval between capture stats print in seconds.
+ */
+#define STATS_PRINT_INTERVAL  5
+
+/**
+ * \brief Packet parser state passed to packet_handler() callback.
+ */
+struct parser_opt_t {
+   PacketBlock *block;     /**< Block where parsed packets are stored. */
+   bool parse_all;         /**< Parse every packet. */
+   uint32_t payload_limit; /**< Max number of payload bytes copied into Packet. */
+   FragmentTable *frags;   /**< Table of IP fragments or NULL if fragments are not tracked. */
+   time_t frags_expired;   /**< Time in seconds when timed out fragments were last released on live capture. */
+   uint8_t tunnels;        /**< Bit mask of decapsulated tunnel types (1 << TUNNEL_*), 0 disables decapsulation. */
+   uint8_t tunnel_depth;   /**< Max number of decapsulated nested tunnels. */
+};
+
 /**
  * \brief Class for reading packets from file or network interface.
  */
@@ -78,20 +109,26 @@ public:
    PcapReader(const options_t &options);
    ~PcapReader();
 
-   int open_file(const string &file, bool parse_every_pkt);
-   int init_interface(const string &interface, int snaplen, bool parse_every_pkt);
+   int open_file(const string &file, bool parse_every_pkt, uint32_t payload_limit);
+   int init_interface(const string &interface, int snaplen, bool parse_every_pkt, uint32_t payload_limit);
    int set_filter(const string &filter_str);
    void print_stats();
    void close();
-   int get_pkt(Packet &packet);
+   int get_pkts(PacketBlock &block);
+   int get_held_pkts(PacketBlock &block);
+   void print_report();
 private:
    pcap_t *handle;                  /**< libpcap file handler. */
    bool live_capture;               /**< PcapReader is capturing from network interface. */
    bool print_pcap_stats;           /**< Print pcap handle stats. */
    struct timeval last_ts;          /**< Last timestamp. */
    bpf_u_int32 netmask;             /**< Network mask. Used when setting filter. */
+   parser_opt_t parser;             /**< Packet parser state. */
 };
 
 void packet_handler(u_char *arg, const struct pcap_pkthdr *h, const u_char *data);
+void release_fragments(parser_opt_t *opt);
+void expire_fragments(parser_opt_t *opt);
+int release_held_fragments(parser_opt_t *opt);
 
 #endif
@@ -0,0 +1,144 @@
+/**
+ * \file plugindispatch.cpp
+ * \brief Selection of plugins interested in packet (PluginDispatch class)
+ * \author Jiri Havranek <havraji6@fit.cvut.cz>
+ * \date 2018
+ */
+/*
+ * Copyright (C) 2018 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#include <cstring>
+#include <map>
+
+#include "plugindispatch.h"
+
+using namespace std;
+
+/**
+ * \brief Constructor, all plugins get all packets until table is built.
+ */
+PluginDispatch::PluginDispatch() : all_mask(~0U), port_class(NULL), ethertype_cnt(0)
+{
+   memset(class_mask, 0, sizeof(class_mask));
+   memset(proto_mask, 0, sizeof(proto_mask));
+}
+
+PluginDispatch::~PluginDispatch()
+{
+   delete [] port_class;
+}
+
+/**
+ * \brief Build table from interests declared by plugins.
+ *
+ * Interests which do not fit into the table (too many port classes or ethertypes) are turned into interest
+ * in all packets, so plugins never miss packets they asked for.
+ * \param [in] plugins Array of plugins, at most DISPATCH_MAX_PLUGINS.
+ * \param [in] plugin_cnt Number of plugins.
+ */
+void PluginDispatch::build(FlowCachePlugin **plugins, uint32_t plugin_cnt)
+{
+   uint32_t *port_mask = new uint32_t[65536];
+
+   all_mask = 0;
+   ethertype_cnt = 0;
+   memset(port_mask, 0, 65536 * sizeof(uint32_t));
+   memset(class_mask, 0, sizeof(class_mask));
+   memset(proto_mask, 0, sizeof(proto_mask));
+   delete [] port_class;
+   port_class = NULL;
+
+   bool any_port = false;
+   for (uint32_t i = 0; i < plugin_cnt; i++) {
+      plugin_interest interest = plugins[i]->get_interest();
+      uint32_t bit = 1U << i;
+
+      if (interest.all) {
+         all_mask |= bit;
+         continue;
+      }
+      for (size_t j = 0; j < interest.ports.size(); j++) {
+         port_mask[interest.ports[j]] |= bit;
+         any_port = true;
+      }
+      for (size_t j = 0; j < interest.protocols.size(); j++) {
+         proto_mask[interest.protocols[j]] |= bit;
+      }
+      for (size_t j = 0; j < interest.ethertypes.size(); j++) {
+         uint32_t k = 0;
+         while (k < ethertype_cnt && ethertypes[k] != interest.ethertypes[j]) {
+            k++;
+         }
+         if (k == DISPATCH_MAX_ETHERTYPES) {
+            all_mask |= bit;
+            continue;
+         }
+         if (k == ethertype_cnt) {
+            ethertypes[ethertype_cnt] = interest.ethertypes[j];
+            ethertype_mask[ethertype_cnt++] = 0;
+         }
+         ethertype_mask[k] |= bit;
+      }
+   }
+
+   if (any_port) {
+      map<uint32_t, uint8_t> classes;
+      uint32_t class_cnt = 1;
+
+      port_class = new uint8_t[65536];
+      for (uint32_t port = 0; port < 65536; port++) {
+         uint32_t mask = port_mask[port];
+         uint8_t cls = 0;
+
+         if (mask != 0) {
+            map<uint32_t, uint8_t>::const_iterator it = classes.find(mask);
+            if (it != classes.end()) {
+               cls = it->second;
+            } else if (class_cnt < DISPATCH_MAX_CLASSES) {
+               cls = class_cnt;
+               classes[mask] = cls;
+               class_mask[class_cnt++] = mask;
+            } else {
+               all_mask |= mask; /* Too many distinct sets, these plugins get all packets. */
+            }
+         }
+         port_class[port] = cls;
+      }
+   }
+
+   delete [] port_mask;
+}
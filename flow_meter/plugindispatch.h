@@ -0,0 +1,121 @@
+/**
+ * \file plugindispatch.h
+ * \brief Selection of plugins interested in packet (PluginDispatch class)
+ * \author Jiri Havranek <havraji6@fit.cvut.cz>
+ * \date 2018
+ */
+/*
+ * Copyright (C) 2018 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#ifndef PLUGINDISPATCH_H
+#define PLUGINDISPATCH_H
+
+#include <stdint.h>
+
+#include "packet.h"
+#include "flowifc.h"
+#include "flowcacheplugin.h"
+
+#define DISPATCH_MAX_PLUGINS 32     /**< Max number of plugins, plugins are selected by bit mask. */
+#define DISPATCH_MAX_CLASSES 256    /**< Max number of distinct sets of plugins interested in a port. */
+#define DISPATCH_MAX_ETHERTYPES 8   /**< Max number of distinct ethertypes plugins are interested in. */
+
+/**
+ * \brief Table mapping packet ports, IP protocol and ethertype to plugins interested in packet.
+ *
+ * Ports are mapped to classes of plugin sets, so the table takes one byte per port and per packet cost
+ * does not depend on number of plugins. Bit i of returned masks stands for i-th plugin.
+ */
+class PluginDispatch
+{
+   uint32_t all_mask;                              /**< Plugins interested in all packets. */
+   uint8_t *port_class;                            /**< Class indexed by port or NULL when no plugin wants ports. */
+   uint32_t class_mask[DISPATCH_MAX_CLASSES];      /**< Plugins of each port class, class 0 is empty. */
+   uint32_t proto_mask[256];                       /**< Plugins indexed by IP protocol. */
+   uint16_t ethertypes[DISPATCH_MAX_ETHERTYPES];   /**< Ethertypes plugins are interested in. */
+   uint32_t ethertype_mask[DISPATCH_MAX_ETHERTYPES];
+   uint32_t ethertype_cnt;
+
+   PluginDispatch(const PluginDispatch &);
+   PluginDispatch &operator=(const PluginDispatch &);
+
+public:
+   PluginDispatch();
+   ~PluginDispatch();
+
+   void build(FlowCachePlugin **plugins, uint32_t plugin_cnt);
+
+   /**
+    * \brief Get plugins interested in packet.
+    * \param [in] pkt Parsed packet.
+    * \return Bit mask of plugins.
+    */
+   uint32_t match(const Packet &pkt) const
+   {
+      uint32_t mask = all_mask;
+
+      if (pkt.ip_version == 0) {
+         for (uint32_t i = 0; i < ethertype_cnt; i++) {
+            if (pkt.ethertype == ethertypes[i]) {
+               mask |= ethertype_mask[i];
+            }
+         }
+         return mask;
+      }
+      if (port_class != NULL) {
+         mask |= class_mask[port_class[pkt.src_port]] | class_mask[port_class[pkt.dst_port]];
+      }
+      return mask | proto_mask[pkt.ip_proto];
+   }
+
+   /**
+    * \brief Get plugins interested in flow.
+    * \param [in] rec Flow record.
+    * \return Bit mask of plugins.
+    */
+   uint32_t match(const Flow &rec) const
+   {
+      uint32_t mask = all_mask;
+
+      if (port_class != NULL) {
+         mask |= class_mask[port_class[rec.src_port]] | class_mask[port_class[rec.dst_port]];
+      }
+      return mask | proto_mask[rec.ip_proto];
+   }
+};
+
+#endif
@@ -0,0 +1,193 @@
+/**
+ * \file recordextpool.cpp
+ * \brief Pool of released flow record extensions.
+ * \author Jiri Havranek <havraji6@fit.cvut.cz>
+ * \date 2018
+ */
+/*
+ * Copyright (C) 2018 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#include <iostream>
+#include <new>
+#include <stdlib.h>
+
+#include "flowifc.h"
+
+using namespace std;
+
+__thread RecordExtPool *RecordExtPool::thread_pool = NULL;
+
+/**
+ * \brief Names of extension types used in statistics.
+ */
+static const char *ext_names[] = {
+   "http_request",
+   "http_response",
+   "https",
+   "dns",
+   "sip",
+   "ntp",
+   "smtp",
+   "arp",
+   "passivedns",
+   "tunnel"
+};
+
+/* Compilation fails here when a type of extTypeEnum has no name in ext_names. */
+typedef char ext_names_check[sizeof(ext_names) / sizeof(ext_names[0]) == EXTENSION_CNT ? 1 : -1];
+
+RecordExtPool::RecordExtPool()
+{
+   for (int i = 0; i < EXTENSION_CNT; i++) {
+      free_list[i] = NULL;
+      cached[i] = 0;
+      allocs[i] = 0;
+      reused[i] = 0;
+   }
+}
+
+RecordExtPool::~RecordExtPool()
+{
+   if (thread_pool == this) {
+      thread_pool = NULL;
+   }
+   for (int i = 0; i < EXTENSION_CNT; i++) {
+      while (free_list[i] != NULL) {
+         FreeNode *node = free_list[i];
+         free_list[i] = node->next;
+         free(node);
+      }
+   }
+}
+
+/**
+ * \brief Allocate memory for extension.
+ * \param [in] type Type of extension.
+ * \param [in] size Size of extension.
+ * \return Pointer to allocated memory.
+ */
+void *RecordExtPool::alloc(extTypeEnum type, size_t size)
+{
+   RecordExtPool *pool = thread_pool;
+
+   if (pool != NULL) {
+      pool->allocs[type]++;
+      FreeNode *node = pool->free_list[type];
+      if (node != NULL) {
+         pool->free_list[type] = node->next;
+         pool->cached[type]--;
+         pool->reused[type]++;
+         return node;
+      }
+   }
+
+   void *ptr = malloc(size < sizeof(FreeNode) ? sizeof(FreeNode) : size);
+   if (ptr == NULL) {
+      throw std::bad_alloc();
+   }
+   return ptr;
+}
+
+/**
+ * \brief Release memory of deleted extension.
+ * \param [in] type Type of extension.
+ * \param [in] ptr Pointer to memory returned by alloc().
+ */
+void RecordExtPool::release(extTypeEnum type, void *ptr)
+{
+   RecordExtPool *pool = thread_pool;
+
+   if (ptr == NULL) {
+      return;
+   }
+   if (pool != NULL && pool->cached[type] < EXT_POOL_MAX_CACHED) {
+      FreeNode *node = (FreeNode *) ptr;
+      node->next = pool->free_list[type];
+      pool->free_list[type] = node;
+      pool->cached[type]++;
+      return;
+   }
+   free(ptr);
+}
+
+/**
+ * \brief Get total number of allocations of all extension types.
+ */
+uint64_t RecordExtPool::get_allocs() const
+{
+   uint64_t total = 0;
+   for (int i = 0; i < EXTENSION_CNT; i++) {
+      total += allocs[i];
+   }
+   return total;
+}
+
+/**
+ * \brief Get total number of allocations served from free lists.
+ */
+uint64_t RecordExtPool::get_reused() const
+{
+   uint64_t total = 0;
+   for (int i = 0; i < EXTENSION_CNT; i++) {
+      total += reused[i];
+   }
+   return total;
+}
+
+/**
+ * \brief Get total number of extensions kept in free lists.
+ */
+uint64_t RecordExtPool::get_cached() const
+{
+   uint64_t total = 0;
+   for (int i = 0; i < EXTENSION_CNT; i++) {
+      total += cached[i];
+   }
+   return total;
+}
+
+/**
+ * \brief Print statistics of extension types which were allocated.
+ */
+void RecordExtPool::print_report() const
+{
+   for (int i = 0; i < EXTENSION_CNT; i++) {
+      if (allocs[i] != 0) {
+         cout << "Extension pool " << ext_names[i] << ": " << allocs[i] << " allocs, " << reused[i] << " reused, " << cached[i] << " cached" << endl;
+      }
+   }
+}
@@ -0,0 +1,150 @@
+/**
+ * \file ringbuffer.h
+ * \brief Lock-free single producer single consumer ring buffer.
+ * \author Jiri Havranek <havraji6@fit.cvut.cz>
+ * \date 2018
+ */
+/*
+ * Copyright (C) 2018 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#ifndef RINGBUFFER_H
+#define RINGBUFFER_H
+
+#include <stdint.h>
+
+#define RING_CACHE_LINE 64
+
+/**
+ * \brief Lock-free ring buffer for passing items between exactly one producer and one consumer thread.
+ *
+ * Slots are preallocated and accessed in place: producer fills slot returned by producer_slot() and publishes
+ * it by push(), consumer reads slot returned by consumer_slot() and returns it by pop(). Data left in slot
+ * after pop() belongs to producer again, which allows producer to release them on its own thread.
+ */
+template <class T>
+class RingBuffer
+{
+   T *slots;               /**< Array of slots. */
+   uint32_t size;          /**< Number of slots, power of two. */
+   uint32_t mask;          /**< Mask for getting slot index. */
+   char pad1[RING_CACHE_LINE];
+   uint32_t head;          /**< Counter of pushed slots, written by producer only. */
+   char pad2[RING_CACHE_LINE];
+   uint32_t tail;          /**< Counter of popped slots, written by consumer only. */
+   char pad3[RING_CACHE_LINE];
+
+   RingBuffer(const RingBuffer &);
+   RingBuffer &operator=(const RingBuffer &);
+
+public:
+   /**
+    * \brief Constructor.
+    * \param [in] slot_cnt Minimal number of slots, rounded up to power of two.
+    */
+   RingBuffer(uint32_t slot_cnt) : head(0), tail(0)
+   {
+      size = 1;
+      while (size < slot_cnt) {
+         size <<= 1;
+      }
+      mask = size - 1;
+      slots = new T[size];
+   }
+
+   ~RingBuffer()
+   {
+      delete [] slots;
+   }
+
+   /**
+    * \brief Get free slot for writing.
+    * \return Pointer to slot or NULL if ring is full.
+    */
+   inline T *producer_slot()
+   {
+      if (head - __atomic_load_n(&tail, __ATOMIC_ACQUIRE) == size) {
+         return NULL;
+      }
+      return &slots[head & mask];
+   }
+
+   /**
+    * \brief Publish slot obtained by producer_slot() to consumer.
+    */
+   inline void push()
+   {
+      __atomic_store_n(&head, head + 1, __ATOMIC_RELEASE);
+   }
+
+   /**
+    * \brief Get oldest published slot.
+    * \return Pointer to slot or NULL if ring is empty.
+    */
+   inline T *consumer_slot()
+   {
+      if (tail == __atomic_load_n(&head, __ATOMIC_ACQUIRE)) {
+         return NULL;
+      }
+      return &slots[tail & mask];
+   }
+
+   /**
+    * \brief Return slot obtained by consumer_slot() to producer.
+    */
+   inline void pop()
+   {
+      __atomic_store_n(&tail, tail + 1, __ATOMIC_RELEASE);
+   }
+
+   /**
+    * \brief Get number of published slots which were not returned yet.
+    */
+   inline uint32_t count() const
+   {
+      return __atomic_load_n(&head, __ATOMIC_ACQUIRE) - __atomic_load_n(&tail, __ATOMIC_ACQUIRE);
+   }
+
+   /**
+    * \brief Get total number of slots.
+    */
+   inline uint32_t capacity() const
+   {
+      return size;
+   }
+};
+
+#endif
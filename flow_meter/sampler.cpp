@@ -0,0 +1,124 @@
+/**
+ * \file sampler.cpp
+ * \brief Packet sampling in front of flow cache (PacketSampler class)
+ * \author Jiri Havranek <havraji6@fit.cvut.cz>
+ * \date 2018
+ */
+/*
+ * Copyright (C) 2018 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#include <iostream>
+
+#include "sampler.h"
+
+using namespace std;
+
+/**
+ * \brief Constructor.
+ * \param [in] options Module options.
+ * \param [in] cache Flow cache which receives sampled packets.
+ * \param [in] exporter Exporter thread queue or NULL when flows are exported directly.
+ */
+PacketSampler::PacketSampler(const options_t &options, const FlowCache *cache, const AsyncExporter *exporter) :
+   mode(options.sampling_mode), skipped(0), max_interval(options.sampling_max), evict_rate(options.sampling_evict_rate),
+   backlog(options.sampling_backlog), cache(cache), exporter(exporter), next_adapt(0), last_adapt(0), last_evicted(0),
+   seen(0), sampled(0), not_ip(0), raised(0), lowered(0), peak(0)
+{
+   set_interval(mode == SAMPLING_ADAPTIVE ? 1 : options.sampling_interval);
+}
+
+/**
+ * \brief Set sampling interval.
+ * \param [in] value New interval.
+ */
+void PacketSampler::set_interval(uint32_t value)
+{
+   interval = value;
+   limit = 0xFFFFFFFF / value;
+   if (interval > peak) {
+      peak = interval;
+   }
+}
+
+/**
+ * \brief Double sampling interval when flow cache evicts flows or exporter queue fills faster than thresholds,
+ * halve it when load drops under quarter of thresholds.
+ * \param [in] now Current time.
+ */
+void PacketSampler::adapt(time_t now)
+{
+   uint64_t evicted = cache->get_evicted();
+
+   next_adapt = now + SAMPLING_ADAPT_INTERVAL;
+   if (last_adapt == 0) {
+      last_adapt = now;
+      last_evicted = evicted;
+      return;
+   }
+
+   uint64_t rate = (evicted - last_evicted) / (now - last_adapt);
+   uint32_t occupancy = (exporter != NULL ? exporter->get_occupancy() : 0);
+
+   last_adapt = now;
+   last_evicted = evicted;
+   if (rate > evict_rate || occupancy > backlog) {
+      if (interval < max_interval) {
+         set_interval(interval * 2);
+         raised++;
+      }
+   } else if (rate < evict_rate / 4 && occupancy < backlog / 4 && interval > 1) {
+      set_interval(interval / 2);
+      lowered++;
+   }
+}
+
+/**
+ * \brief Print sampling statistics.
+ */
+void PacketSampler::print_report() const
+{
+   cout << "Packets sampled: " << sampled << " of " << seen;
+   if (mode == SAMPLING_ADAPTIVE) {
+      cout << ", interval " << interval << " (peak " << peak << ", raised " << raised << "x, lowered " << lowered << "x)";
+   } else {
+      cout << ", interval " << interval;
+   }
+   if (mode != SAMPLING_COUNT) {
+      cout << ", " << not_ip << " non-IP packets kept with interval 1";
+   }
+   cout << endl;
+}
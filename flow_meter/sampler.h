@@ -0,0 +1,167 @@
+/**
+ * \file sampler.h
+ * \brief Packet sampling in front of flow cache (PacketSampler class)
+ * \author Jiri Havranek <havraji6@fit.cvut.cz>
+ * \date 2018
+ */
+/*
+ * Copyright (C) 2018 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include <stdint.h>
+#include <time.h>
+
+#include "flow_meter.h"
+#include "flowcache.h"
+#include "asyncexporter.h"
+#include "packet.h"
+
+#define SAMPLING_OFF 0        /**< All packets are processed. */
+#define SAMPLING_COUNT 1      /**< Deterministic 1-in-N packet sampling. */
+#define SAMPLING_FLOW 2       /**< Hash based 1-in-N flow sampling. */
+#define SAMPLING_ADAPTIVE 3   /**< Flow sampling with interval adapted to flow cache and exporter load. */
+
+#define DEFAULT_SAMPLING_MAX 64           /**< Default max interval of adaptive sampling. */
+#define DEFAULT_SAMPLING_EVICT_RATE 10000 /**< Default threshold of flows evicted from full cache lines per second. */
+#define DEFAULT_SAMPLING_BACKLOG 50       /**< Default threshold of export queue occupancy in percent. */
+#define SAMPLING_ADAPT_INTERVAL 1         /**< Interval between adaptations of sampling interval in seconds. */
+
+/**
+ * \brief Compute direction independent hash of flow key used to select flows.
+ *
+ * Hash is finalized differently than shard index, so sampled flows are spread over all workers.
+ * \param [in] pkt Parsed packet.
+ * \return 32 bit hash.
+ */
+inline uint32_t sampling_hash(const Packet &pkt)
+{
+   uint64_t hash = ((uint64_t) (pkt.src_port ^ pkt.dst_port) << 40) ^ ((uint64_t) pkt.ip_proto << 32);
+
+   if (pkt.ip_version == 4) {
+      hash ^= pkt.src_ip.v4 ^ pkt.dst_ip.v4;
+   } else {
+      const uint32_t *src = (const uint32_t *) pkt.src_ip.v6;
+      const uint32_t *dst = (const uint32_t *) pkt.dst_ip.v6;
+      hash ^= (src[0] ^ dst[0] ^ src[2] ^ dst[2]) ^ ((uint64_t) (src[1] ^ dst[1] ^ src[3] ^ dst[3]) << 8);
+   }
+
+   hash ^= hash >> 33;
+   hash *= 0xFF51AFD7ED558CCDULL;
+   hash ^= hash >> 33;
+   hash *= 0xC4CEB9FE1A85EC53ULL;
+   hash ^= hash >> 33;
+   return (uint32_t) (hash >> 32);
+}
+
+/**
+ * \brief Selects packets passed to flow cache.
+ *
+ * Sampling interval applied to each selected packet is stored in Packet::sampling_interval and exported
+ * with flow, unselected packets get interval 0. Flow sampling keeps all packets of flows whose hash is below
+ * limit given by interval, so raising the interval keeps a subset of flows which were sampled before.
+ * Non-IP packets are not flow sampled, they are all kept with interval 1.
+ */
+class PacketSampler
+{
+   int mode;
+   uint32_t interval;      /**< Current sampling interval. */
+   uint32_t limit;         /**< Flows with sampling hash not greater than limit are sampled. */
+   uint32_t skipped;       /**< Packets skipped since last sampled packet in count mode. */
+   uint32_t max_interval;  /**< Max interval of adaptive sampling. */
+   uint64_t evict_rate;    /**< Eviction rate threshold of adaptive sampling. */
+   uint32_t backlog;       /**< Export queue occupancy threshold of adaptive sampling. */
+   const FlowCache *cache; /**< Flow cache reporting evicted flows. */
+   const AsyncExporter *exporter; /**< Exporter reporting queue occupancy or NULL. */
+   time_t next_adapt;      /**< Time of next adaptation. */
+   time_t last_adapt;      /**< Time of last adaptation, 0 before first packet. */
+   uint64_t last_evicted;  /**< Evicted flows at last adaptation. */
+
+   uint64_t seen;          /**< Number of packets seen by sampler. */
+   uint64_t sampled;       /**< Number of sampled packets. */
+   uint64_t not_ip;        /**< Number of non-IP packets kept unsampled by flow sampling. */
+   uint32_t raised;        /**< Number of times adaptive interval was raised. */
+   uint32_t lowered;       /**< Number of times adaptive interval was lowered. */
+   uint32_t peak;          /**< Max interval used. */
+
+   void set_interval(uint32_t value);
+   void adapt(time_t now);
+
+public:
+   PacketSampler(const options_t &options, const FlowCache *cache, const AsyncExporter *exporter);
+
+   /**
+    * \brief Decide which packets of block are passed to flow cache.
+    * \param [in,out] block Parsed packets, sampling_interval of every packet is set.
+    */
+   void sample(PacketBlock &block)
+   {
+      for (size_t i = 0; i < block.cnt; i++) {
+         Packet &pkt = block.pkts[i];
+
+         if (mode == SAMPLING_COUNT) {
+            if (++skipped < interval) {
+               pkt.sampling_interval = 0;
+               continue;
+            }
+            skipped = 0;
+         } else if (pkt.ip_version == 0) {
+            /* Flow sampling does not apply to non-IP packets, all of them are kept. */
+            pkt.sampling_interval = 1;
+            sampled++;
+            not_ip++;
+            continue;
+         } else {
+            if (mode == SAMPLING_ADAPTIVE && pkt.timestamp.tv_sec >= next_adapt) {
+               adapt(pkt.timestamp.tv_sec);
+            }
+            if (sampling_hash(pkt) > limit) {
+               pkt.sampling_interval = 0;
+               continue;
+            }
+         }
+         pkt.sampling_interval = interval;
+         sampled++;
+      }
+      seen += block.cnt;
+   }
+
+   void print_report() const;
+};
+
+#endif
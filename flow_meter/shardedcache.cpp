@@ -0,0 +1,455 @@
+/**
+ * \file shardedcache.cpp
+ * \brief Flow cache distributing packets to worker threads with private flow cache partitions.
+ * \author Jiri Havranek <havraji6@fit.cvut.cz>
+ * \date 2018
+ */
+/*
+ * Copyright (C) 2018 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#include <iostream>
+#include <cstring>
+#include <sched.h>
+#include <unistd.h>
+
+#include "shardedcache.h"
+
+using namespace std;
+
+/**
+ * \brief Exporter dropping everything, used when workers are stopped without finishing.
+ */
+class DiscardExporter : public FlowExporter
+{
+public:
+   int export_flow(Flow &flow)
+   {
+      return 0;
+   }
+   int export_packet(Packet &pkt)
+   {
+      return 0;
+   }
+};
+
+FlowCacheShard::FlowCacheShard(uint32_t id, const options_t &options, pthread_mutex_t *mutex)
+   : id(id), cache(options), input(SHARD_INPUT_SIZE), output(SHARD_OUTPUT_SIZE), finish_mutex(mutex),
+   stop(0), finished(0), pause(0), inline_mode(false), packets(0), input_full(0), drained(0)
+{
+   cache.set_exporter(&output);
+}
+
+ShardedFlowCache::ShardedFlowCache(const options_t &options) : print_stats(options.print_stats), running(false), dispatched(0), last_ts(0)
+{
+   options_t shard_options = options;
+   uint32_t cnt = 1;
+
+   /* Split flow cache between shards, partition size must stay power of two. */
+   while (cnt < options.worker_cnt) {
+      cnt <<= 1;
+   }
+   shard_options.flow_cache_size = options.flow_cache_size / cnt;
+   if (shard_options.flow_cache_size < options.flow_line_size) {
+      shard_options.flow_cache_size = options.flow_line_size;
+   }
+   shard_options.victim_size = options.victim_size / cnt;
+
+   pthread_mutex_init(&finish_mutex, NULL);
+   for (uint32_t i = 0; i < options.worker_cnt; i++) {
+      shards.push_back(new FlowCacheShard(i, shard_options, &finish_mutex));
+   }
+}
+
+ShardedFlowCache::~ShardedFlowCache()
+{
+   if (running) {
+      DiscardExporter discard;
+      stop_workers(&discard);
+   }
+   for (unsigned int i = 0; i < shards.size(); i++) {
+      delete shards[i];
+   }
+   pthread_mutex_destroy(&finish_mutex);
+}
+
+/**
+ * \brief Add plugin instance to shard. Plugin is deleted together with shard.
+ * \param [in] shard Shard number.
+ * \param [in] plugin Plugin instance.
+ */
+void ShardedFlowCache::add_shard_plugin(uint32_t shard, FlowCachePlugin *plugin)
+{
+   shards[shard]->plugins.plugins.push_back(plugin);
+   shards[shard]->cache.add_plugin(plugin);
+}
+
+uint32_t ShardedFlowCache::get_shard_cnt() const
+{
+   return shards.size();
+}
+
+uint64_t ShardedFlowCache::get_evicted() const
+{
+   uint64_t evicted = 0;
+
+   for (size_t i = 0; i < shards.size(); i++) {
+      evicted += shards[i]->cache.get_evicted();
+   }
+   return evicted;
+}
+
+int ShardedFlowCache::init()
+{
+   for (unsigned int i = 0; i < shards.size(); i++) {
+      shards[i]->cache.init();
+   }
+   for (unsigned int i = 0; i < shards.size(); i++) {
+      if (pthread_create(&shards[i]->thread, NULL, &ShardedFlowCache::worker, shards[i]) != 0) {
+         if (i == 0) {
+            return 1;
+         }
+         cerr << "flow_meter: unable to start worker thread, processing packets by " << i << " workers" << endl;
+         while (shards.size() > i) {
+            delete shards.back();
+            shards.pop_back();
+         }
+         break;
+      }
+   }
+   running = true;
+   return 0;
+}
+
+/**
+ * \brief Compute shard index from direction independent hash of flow key.
+ * Both directions of a connection end in the same shard.
+ * \param [in] rec Parsed packet or flow record.
+ * \return Shard index.
+ */
+template <class T>
+inline uint32_t ShardedFlowCache::shard_index(const T &rec) const
+{
+   uint64_t hash = ((uint64_t) (rec.src_port ^ rec.dst_port) << 40) ^ ((uint64_t) rec.ip_proto << 32);
+
+   if (rec.ip_version == 4) {
+      hash ^= rec.src_ip.v4 ^ rec.dst_ip.v4;
+   } else if (rec.ip_version == 6) {
+      const uint32_t *src = (const uint32_t *) rec.src_ip.v6;
+      const uint32_t *dst = (const uint32_t *) rec.dst_ip.v6;
+      hash ^= (src[0] ^ dst[0] ^ src[2] ^ dst[2]) ^ ((uint64_t) (src[1] ^ dst[1] ^ src[3] ^ dst[3]) << 8);
+   }
+
+   hash *= 0x9E3779B97F4A7C15ULL;
+   return (uint32_t) (hash >> 32) % shards.size();
+}
+
+/**
+ * \brief Wait for free slot in shard input ring. Export queues are drained while waiting,
+ * because worker may be blocked on full export queue.
+ */
+ShardSlot *ShardedFlowCache::get_slot(FlowCacheShard *shard)
+{
+   ShardSlot *slot;
+
+   while ((slot = shard->input.producer_slot()) == NULL) {
+      shard->input_full++;
+      export_queued(exporter);
+      sched_yield();
+   }
+
+   return slot;
+}
+
+int ShardedFlowCache::put_pkt(Packet &pkt)
+{
+   FlowCacheShard *shard = shards[shard_index(pkt)];
+
+   if (shard->inline_mode) {
+      shard->cache.put_pkt(pkt);
+   } else {
+      ShardSlot *slot = get_slot(shard);
+
+      slot->type = SHARD_PACKET;
+      slot->pkt = pkt;
+      slot->pkt.detachExtensions();
+      memcpy(slot->data, pkt.packet, pkt.total_length);
+      slot->data[pkt.total_length] = 0;
+      slot->pkt.packet = slot->data;
+      if (pkt.payload != NULL) {
+         slot->pkt.payload = slot->data + (pkt.payload - pkt.packet);
+      }
+
+      shard->input.push();
+   }
+   shard->packets++;
+
+   /* Shards which do not receive packets would never check inactive timeout, broadcast current time. */
+   if (pkt.timestamp.tv_sec - last_ts > SHARD_TICK_INTERVAL) {
+      export_expired(pkt.timestamp.tv_sec);
+      last_ts = pkt.timestamp.tv_sec;
+   } else if (++dispatched % SHARD_DRAIN_INTERVAL == 0) {
+      export_queued(exporter);
+   }
+
+   return 0;
+}
+
+void ShardedFlowCache::export_expired(time_t ts)
+{
+   for (unsigned int i = 0; i < shards.size(); i++) {
+      if (shards[i]->inline_mode) {
+         shards[i]->cache.export_expired(ts);
+         continue;
+      }
+      ShardSlot *slot = get_slot(shards[i]);
+
+      slot->type = SHARD_TIMEOUT;
+      slot->ts = ts;
+      shards[i]->input.push();
+   }
+
+   export_queued(exporter);
+}
+
+/**
+ * \brief Pass flows exported by workers to exporter.
+ */
+void ShardedFlowCache::export_queued(FlowExporter *exp)
+{
+   for (unsigned int i = 0; i < shards.size(); i++) {
+      shards[i]->drained += shards[i]->output.drain(exp, SHARD_OUTPUT_SIZE);
+   }
+}
+
+/**
+ * \brief Stop workers and wait until they export all flows.
+ * \param [in] exp Exporter receiving flows exported by workers.
+ */
+void ShardedFlowCache::stop_workers(FlowExporter *exp)
+{
+   unsigned int finished = 0;
+
+   for (unsigned int i = 0; i < shards.size(); i++) {
+      if (shards[i]->inline_mode) {
+         /* Shard without worker is finished by calling thread. */
+         if (!shards[i]->pause) {
+            pthread_mutex_lock(shards[i]->finish_mutex);
+            shards[i]->cache.finish();
+            pthread_mutex_unlock(shards[i]->finish_mutex);
+         }
+         shards[i]->finished = 1;
+         continue;
+      }
+      __atomic_store_n(&shards[i]->stop, 1, __ATOMIC_RELEASE);
+   }
+
+   /* Workers export all flows from their caches, keep draining until they are done. */
+   while (finished < shards.size()) {
+      finished = 0;
+      export_queued(exp);
+      for (unsigned int i = 0; i < shards.size(); i++) {
+         finished += __atomic_load_n(&shards[i]->finished, __ATOMIC_ACQUIRE);
+      }
+      if (finished < shards.size()) {
+         usleep(SHARD_IDLE_SLEEP);
+      }
+   }
+
+   for (unsigned int i = 0; i < shards.size(); i++) {
+      if (!shards[i]->inline_mode) {
+         pthread_join(shards[i]->thread, NULL);
+      }
+   }
+   export_queued(exp);
+   running = false;
+}
+
+/**
+ * \brief Stop workers without finishing their flow caches, so that caches can be accessed by calling thread.
+ */
+void ShardedFlowCache::pause_workers()
+{
+   for (unsigned int i = 0; i < shards.size(); i++) {
+      __atomic_store_n(&shards[i]->pause, 1, __ATOMIC_RELEASE);
+   }
+   stop_workers(exporter);
+}
+
+/**
+ * \brief Start workers stopped by pause_workers().
+ *
+ * Shards hold flows, processing cannot continue with fewer shards. Shard whose worker cannot be restarted
+ * is processed by calling thread from then on and exports directly, its export queue was drained by pause.
+ */
+void ShardedFlowCache::resume_workers()
+{
+   for (unsigned int i = 0; i < shards.size(); i++) {
+      shards[i]->stop = 0;
+      shards[i]->finished = 0;
+      shards[i]->pause = 0;
+      if (!shards[i]->inline_mode &&
+          pthread_create(&shards[i]->thread, NULL, &ShardedFlowCache::worker, shards[i]) != 0) {
+         cerr << "flow_meter: unable to restart worker thread, shard " << i << " is processed by capture thread" << endl;
+         shards[i]->inline_mode = true;
+         shards[i]->cache.set_exporter(exporter);
+      }
+   }
+   running = true;
+}
+
+int ShardedFlowCache::save_flows(CheckpointWriter &writer)
+{
+   bool resume = running;
+   int ret = 0;
+
+   if (resume) {
+      pause_workers();
+   }
+   for (unsigned int i = 0; i < shards.size() && ret == 0; i++) {
+      ret = shards[i]->cache.save_flows(writer);
+   }
+   if (resume) {
+      resume_workers();
+   }
+   return ret;
+}
+
+uint64_t ShardedFlowCache::load_flows(CheckpointReader &reader)
+{
+   bool resume = running;
+   uint64_t loaded = 0;
+   const checkpoint_flow *rec;
+
+   if (resume) {
+      pause_workers();
+   }
+   /* Flows go to shards by the same hash as their packets, number of workers can differ from saved one. */
+   while ((rec = reader.next_flow()) != NULL) {
+      if (shards[shard_index(*rec)]->cache.load_flow(rec)) {
+         loaded++;
+      }
+      if (loaded % SHARD_DRAIN_INTERVAL == 0) {
+         export_queued(exporter); /* Flows evicted from full flow lines. */
+      }
+   }
+   export_queued(exporter);
+   if (resume) {
+      resume_workers();
+   }
+   return loaded;
+}
+
+void ShardedFlowCache::drop_flows()
+{
+   bool resume = running;
+
+   if (resume) {
+      pause_workers();
+   }
+   for (unsigned int i = 0; i < shards.size(); i++) {
+      shards[i]->cache.drop_flows();
+   }
+   if (resume) {
+      resume_workers();
+   }
+}
+
+void ShardedFlowCache::finish()
+{
+   if (!running) {
+      return;
+   }
+
+   stop_workers(exporter);
+
+   if (print_stats) {
+      for (unsigned int i = 0; i < shards.size(); i++) {
+         cout << "Shard " << i << ": packets " << shards[i]->packets <<
+            ", queue items " << shards[i]->drained <<
+            ", input full " << shards[i]->input_full <<
+            ", export queue full " << shards[i]->output.get_full_cnt() << endl;
+      }
+   }
+}
+
+/**
+ * \brief Worker thread processing packets of single shard.
+ * \param [in] arg Pointer to FlowCacheShard.
+ */
+void *ShardedFlowCache::worker(void *arg)
+{
+   FlowCacheShard *shard = (FlowCacheShard *) arg;
+   ShardSlot *slot;
+   uint32_t idle = 0;
+
+   while (1) {
+      slot = shard->input.consumer_slot();
+      if (slot == NULL) {
+         if (__atomic_load_n(&shard->stop, __ATOMIC_ACQUIRE)) {
+            /* Stop flag could be set after last check of ring. */
+            if (shard->input.consumer_slot() == NULL) {
+               break;
+            }
+            continue;
+         }
+         if (++idle > SHARD_IDLE_SPINS) {
+            usleep(SHARD_IDLE_SLEEP);
+         } else {
+            sched_yield();
+         }
+         continue;
+      }
+
+      idle = 0;
+      if (slot->type == SHARD_TIMEOUT) {
+         shard->cache.export_expired(slot->ts);
+      } else {
+         shard->cache.put_pkt(slot->pkt);
+      }
+      shard->input.pop();
+   }
+
+   if (!__atomic_load_n(&shard->pause, __ATOMIC_ACQUIRE)) {
+      pthread_mutex_lock(shard->finish_mutex);
+      shard->cache.finish();
+      pthread_mutex_unlock(shard->finish_mutex);
+   }
+
+   __atomic_store_n(&shard->finished, 1, __ATOMIC_RELEASE);
+
+   return NULL;
+}
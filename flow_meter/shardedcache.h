@@ -0,0 +1,149 @@
+/**
+ * \file shardedcache.h
+ * \brief Flow cache distributing packets to worker threads with private flow cache partitions.
+ * \author Jiri Havranek <havraji6@fit.cvut.cz>
+ * \date 2018
+ */
+/*
+ * Copyright (C) 2018 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#ifndef SHARDEDCACHE_H
+#define SHARDEDCACHE_H
+
+#include <pthread.h>
+#include <vector>
+
+#include "flow_meter.h"
+#include "flowcache.h"
+#include "nhtflowcache.h"
+#include "flowqueue.h"
+#include "ringbuffer.h"
+#include "packet.h"
+
+using namespace std;
+
+#define SHARD_INPUT_SIZE 4096   /**< Number of packet slots of worker input ring. */
+#define SHARD_OUTPUT_SIZE 16384 /**< Number of flow slots of worker export queue. */
+#define SHARD_DRAIN_INTERVAL 64 /**< Drain export queues after every N dispatched packets. */
+#define SHARD_TICK_INTERVAL 5   /**< Interval of checking inactive flows in all shards in seconds. */
+#define SHARD_IDLE_SPINS 1000   /**< Number of empty polls before worker goes to sleep. */
+#define SHARD_IDLE_SLEEP 100    /**< Worker sleep time in microseconds. */
+
+/**
+ * \brief Type of packet ring slot.
+ */
+enum shardSlotType {
+   SHARD_PACKET = 0,
+   SHARD_TIMEOUT
+};
+
+/**
+ * \brief Slot of worker input ring.
+ */
+struct ShardSlot {
+   int type;                     /**< Type of slot. */
+   time_t ts;                    /**< Current time for timeout slot. */
+   Packet pkt;                   /**< Parsed packet. */
+   char data[MAXPCKTSIZE + 1];   /**< Packet data. */
+};
+
+/**
+ * \brief Flow cache partition processed by worker thread.
+ */
+struct FlowCacheShard {
+   uint32_t id;                     /**< Shard number. */
+   plugins_t plugins;               /**< Plugin instances owned by shard. */
+   NHTFlowCache cache;              /**< Flow cache partition. */
+   RingBuffer<ShardSlot> input;     /**< Packets dispatched to worker. */
+   FlowQueue output;                /**< Flows exported by worker. */
+   pthread_t thread;                /**< Worker thread. */
+   pthread_mutex_t *finish_mutex;   /**< Serializes printing of statistics at the end. */
+   int stop;                        /**< Set by dispatcher when no more packets come. */
+   int finished;                    /**< Set by worker after flow cache was finished. */
+   int pause;                       /**< Set by dispatcher when worker stops without finishing flow cache. */
+   bool inline_mode;                /**< Worker could not be restarted, shard is processed by dispatcher thread. */
+
+   uint64_t packets;                /**< Number of packets dispatched to shard. */
+   uint64_t input_full;             /**< Number of times dispatcher waited for free packet slot. */
+   uint64_t drained;                /**< Number of items taken from export queue. */
+
+   FlowCacheShard(uint32_t id, const options_t &options, pthread_mutex_t *mutex);
+};
+
+/**
+ * \brief Flow cache splitting traffic into shards by symmetric hash of flow key.
+ *
+ * Each shard owns NHTFlowCache partition and plugin instances and runs in its own thread. Exported flows are
+ * passed back through per-shard queues and exported by thread which calls put_pkt, so exporters are never
+ * used concurrently.
+ */
+class ShardedFlowCache : public FlowCache
+{
+   vector<FlowCacheShard *> shards;
+   pthread_mutex_t finish_mutex;
+   bool print_stats;
+   bool running;
+   uint32_t dispatched;
+   time_t last_ts;
+
+   template <class T> uint32_t shard_index(const T &rec) const;
+   ShardSlot *get_slot(FlowCacheShard *shard);
+   void export_queued(FlowExporter *exp);
+   void stop_workers(FlowExporter *exp);
+   void pause_workers();
+   void resume_workers();
+
+   static void *worker(void *arg);
+
+public:
+   ShardedFlowCache(const options_t &options);
+   ~ShardedFlowCache();
+
+   void add_shard_plugin(uint32_t shard, FlowCachePlugin *plugin);
+   uint32_t get_shard_cnt() const;
+
+   virtual int put_pkt(Packet &pkt);
+   virtual int init();
+   virtual void finish();
+   virtual void export_expired(time_t ts);
+   virtual uint64_t get_evicted() const;
+   virtual int save_flows(CheckpointWriter &writer);
+   virtual uint64_t load_flows(CheckpointReader &reader);
+   virtual void drop_flows();
+};
+
+#endif
@@ -50,6 +50,7 @@
 #include "flowifc.h"
 #include "sipplugin.h"
 #include "ipfix-elements.h"
+#include "strscan.h"
 
 using namespace std;
 
@@ -124,6 +125,14 @@ void SIPPlugin::finish()
    }
 }
 
+/**
+ * \brief Create SIP extension saved in flow cache checkpoint.
+ */
+RecordExt *SIPPlugin::deserialize(extTypeEnum type, const uint8_t *data, int size)
+{
+   return (type == sip ? RecordExtSIP::deserialize(data, size) : NULL);
+}
+
 string SIPPlugin::get_unirec_field_string()
 {
    return SIP_UNIREC_TEMPLATE;
@@ -221,146 +230,36 @@ uint16_t SIPPlugin::parse_msg_type(const Packet &pkt)
 
 const unsigned char * SIPPlugin::parser_strtok(const unsigned char *str, unsigned int instrlen, char separator, unsigned int *strlen, parser_strtok_t * nst)
 {
-   const unsigned char *char_ptr;	/* Currently processed characters */
-   const unsigned char *beginning;	/* Beginning of the original string */
-   MAGIC_INT *longword_ptr;	/* Currently processed word */
-   MAGIC_INT longword;	/* Dereferenced longword_ptr useful for the next work */
-   MAGIC_INT longword_mask;	/* Dereferenced longword_ptr with applied separator mask */
-   const unsigned char *cp;	/* A byte which is supposed to be the next separator */
-   int len;		/* Length of the string */
-   MAGIC_INT i;
-
-   /*
-    * The idea of the algorithm comes from the implementation of stdlib function strlen().
-    * See http://www.stdlib.net/~colmmacc/strlen.c.html for further details.
-    */
+   const unsigned char *beginning;	/* Beginning of the returned token */
+   const unsigned char *cp;	/* Position of the next separator */
 
    /* First or next run? */
    if (str != NULL) {
-
-      char_ptr = str;
+      beginning = str;
       nst->saveptr = NULL;
       nst->separator = separator;
       nst->instrlen = instrlen;
-
-      /* Create a separator mask - put the separator to each byte of the integer: */
-      nst->separator_mask = 0;
-      for (i = 0; i < sizeof(longword) * 8; i += 8) {
-         nst->separator_mask |= (((MAGIC_INT) separator) << i);
-      }
-
    } else if (nst->saveptr != NULL && nst->instrlen > 0) {
       /* Next run: */
-      char_ptr = nst->saveptr;
+      beginning = nst->saveptr;
    } else {
       /* Last run: */
       return NULL;
    }
 
-   /*
-    * Handle the first few characters by reading one character at a time.
-    * Do this until CHAR_PTR is aligned on a longword boundary:
-    */
-   len = 0;
-   beginning = char_ptr;
-   for (; ((unsigned long int)char_ptr & (sizeof(longword) - 1)) != 0; ++char_ptr) {
-
-      /* We found the separator - return the string immediately: */
-      if (*char_ptr == nst->separator) {
-         *strlen = len;
-         nst->saveptr = char_ptr + 1;
-         if (nst->instrlen > 0) {
-            nst->instrlen--;
-         }
-         return beginning;
-      }
-      len++;
-
-      /* This is end of string - return the string as it is: */
-      nst->instrlen--;
-      if (nst->instrlen == 0) {
-         *strlen = len;
-         nst->saveptr = NULL;
-         return beginning;
-      }
+   cp = (const unsigned char *) scan_char((const char *) beginning, (const char *) beginning + nst->instrlen, nst->separator);
+   if (cp == NULL) {
+      /* Separator not found, so return the rest of buffer: */
+      *strlen = nst->instrlen;
+      nst->saveptr = NULL;
+      return beginning;
    }
 
-#define FOUND(A)        { nst->saveptr = cp + (A) + 1; *strlen = len + A; nst->instrlen -= A + 1; return beginning; }
-
-   /* Go across the string word by word: */
-   longword_ptr = (MAGIC_INT *)char_ptr;
-   for (;;) {
-      /*
-       * Get the current item and move to the next one. The XOR operator does the following thing:
-       * If the byte is separator, sets it to zero. Otherwise it is nonzero.
-       */
-      longword = *longword_ptr++;
-      longword_mask = longword ^ nst->separator_mask;
-
-      /* Check the end of string. If we don't have enough bytes for the next longword, return what we have: */
-      if (nst->instrlen < sizeof(longword)) {
-
-         /* The separator could be just before the end of the buffer: */
-         cp = (const unsigned char *)(longword_ptr - 1);
-         for (i = 0; i < nst->instrlen; i++) {
-
-            if (cp[i] == nst->separator) {
-               /* Correct string length: */
-               *strlen = len + i;
-
-               /* If the separator is the last character in the buffer: */
-               if (nst->instrlen == i + 1) {
-                  nst->saveptr = NULL;
-               } else {
-                  nst->saveptr = cp + i + 1;
-                  nst->instrlen -= i + 1;
-               }
-               return beginning;
-            }
-         }
-         /* Separator not found, so return the rest of buffer: */
-         *strlen = len + nst->instrlen;
-         nst->saveptr = NULL;
-         return beginning;
-      }
-
-      /*
-       * Here we will try to find the separator:
-       * Add magic_bits to longword
-       *             |      Set those bits which were unchanged by the addition
-       *             |             |        Look at the hole bits. If some of them is unchanged,
-       *             |             |            |    most likely there is zero byte, ie. our separator.
-       *             v             v            v                                                       */
-      if ((((longword_mask + MAGIC_BITS) ^ ~longword_mask) & MAGIC_BITS_NEG) != 0) {
-
-         /* Convert the integer back to the string: */
-         cp = (const unsigned char *)(longword_ptr - 1);
-
-         /* Find out which byte is the separator: */
-         if (cp[0] == nst->separator)
-            FOUND(0);
-         if (cp[1] == nst->separator)
-            FOUND(1);
-         if (cp[2] == nst->separator)
-            FOUND(2);
-         if (cp[3] == nst->separator)
-            FOUND(3);
-         if (sizeof(longword) > 4) {
-            if (cp[4] == nst->separator)
-               FOUND(4);
-            if (cp[5] == nst->separator)
-               FOUND(5);
-            if (cp[6] == nst->separator)
-               FOUND(6);
-            if (cp[7] == nst->separator)
-               FOUND(7);
-         }
-      }
-
-      /* Add the length: */
-      len += sizeof(longword);
-      nst->instrlen -= sizeof(longword);
-   }
+   *strlen = cp - beginning;
+   nst->instrlen -= *strlen + 1;
+   /* If the separator is the last character in the buffer, this is the last token: */
+   nst->saveptr = (nst->instrlen > 0 ? cp + 1 : NULL);
+   return beginning;
 }
 
 void SIPPlugin::parser_field_value(const unsigned char *line, int linelen, int skip, char *dst, unsigned int dstlen)
@@ -332,13 +332,11 @@ using namespace std;
 struct parser_strtok_t {
    parser_strtok_t()
    {
-      separator_mask = 0;
       saveptr = NULL;
       separator = 0;
       instrlen = 0;
    }
 
-   MAGIC_INT separator_mask;
    const unsigned char *saveptr;
    char separator;
    unsigned int instrlen;
@@ -355,6 +353,9 @@ struct RecordExtSIP : RecordExt {
    char cseq[SIP_FIELD_LEN];           /* CSeq field of SIP packet */
    char request_uri[SIP_FIELD_LEN];    /* Request-URI of SIP request */
 
+   RECORD_EXT_POOLED(sip)
+   RECORD_EXT_SERIALIZED(RecordExtSIP, msg_type)
+
    RecordExtSIP() : RecordExt(sip)
    {
       msg_type = 0;
@@ -456,6 +457,7 @@ public:
    void finish();
    string get_unirec_field_string();
    const char **get_ipfix_string();
+   RecordExt *deserialize(extTypeEnum type, const uint8_t *data, int size);
 
 private:
    uint16_t parse_msg_type(const Packet &pkt);
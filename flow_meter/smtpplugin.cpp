@@ -49,6 +49,7 @@
 #include "packet.h"
 #include "flow_meter.h"
 #include "ipfix-elements.h"
+#include "strscan.h"
 
 using namespace std;
 
@@ -257,6 +258,24 @@ bool SMTPPlugin::smtp_keyword(const char *data)
    return true;
 }
 
+/**
+ * \brief Copy command argument and append \0 character.
+ * \param [out] dst Destination buffer.
+ * \param [in] size Size of destination buffer.
+ * \param [in] begin Ptr to begin of argument.
+ * \param [in] end Ptr to end of argument.
+ */
+static void copy_arg(char *dst, size_t size, const char *begin, const char *end)
+{
+   size_t len = (end > begin ? end - begin : 0);
+   if (len >= size) {
+      len = size - 1;
+   }
+
+   memcpy(dst, begin, len);
+   dst[len] = 0;
+}
+
 /**
  * \brief Parse SMTP client traffic.
  *
@@ -268,6 +287,7 @@ bool SMTPPlugin::smtp_keyword(const char *data)
 bool SMTPPlugin::parse_smtp_command(const char *data, int payload_len, RecordExtSMTP *rec)
 {
    const char *begin, *end;
+   const char *payload_end = data + payload_len;
    char buffer[32];
    size_t len;
 
@@ -276,7 +296,7 @@ bool SMTPPlugin::parse_smtp_command(const char *data, int payload_len, RecordExt
    }
 
    if (rec->data_transfer) {
-      if (payload_len != 3 || strcmp(data, ".\r\n")) {
+      if (payload_len != 3 || memcmp(data, ".\r\n", 3)) {
          return false;
       }
       rec->data_transfer = 0;
@@ -284,13 +304,13 @@ bool SMTPPlugin::parse_smtp_command(const char *data, int payload_len, RecordExt
    }
 
    begin = data;
-   end = strchr(begin, '\r');
+   end = scan_char(begin, payload_end, '\r');
 
    len = end - begin;
    if (end == NULL) {
       return false;
    }
-   end = strchr(begin, ' ');
+   end = scan_char(begin, payload_end, ' ');
    if (end != NULL) {
       len = end - begin;
    }
@@ -302,15 +322,11 @@ bool SMTPPlugin::parse_smtp_command(const char *data, int payload_len, RecordExt
    buffer[len] = 0;
 
    if (!strcmp(buffer, "HELO") || !strcmp(buffer, "EHLO")) {
-      if (rec->domain[0] == 0) {
+      if (rec->domain[0] == 0 && end != NULL) {
          begin = end;
-         end = strchr(begin, '\r');
-         if (end != NULL && begin != NULL) {
-            begin++;
-            len = end - begin;
-
-            memcpy(rec->domain, begin, len);
-            rec->domain[len] = 0;
+         end = scan_char(begin, payload_end, '\r');
+         if (end != NULL) {
+            copy_arg(rec->domain, sizeof(rec->domain), begin + 1, end);
          }
       }
       if (!strcmp(buffer, "HELO")) {
@@ -320,29 +336,21 @@ bool SMTPPlugin::parse_smtp_command(const char *data, int payload_len, RecordExt
       }
    } else if (!strcmp(buffer, "RCPT")) {
       rec->mail_rcpt_cnt++;
-      if (rec->first_recipient[0] == 0) {
-         begin = strchr(end + 1, ':');
-         end = strchr(end, '\r');
+      if (rec->first_recipient[0] == 0 && end != NULL) {
+         begin = scan_char(end + 1, payload_end, ':');
+         end = scan_char(end, payload_end, '\r');
          if (end != NULL && begin != NULL) {
-            begin++;
-            len = end - begin;
-
-            memcpy(rec->first_recipient, begin, len);
-            rec->first_recipient[len] = 0;
+            copy_arg(rec->first_recipient, sizeof(rec->first_recipient), begin + 1, end);
          }
       }
       rec->command_flags |= SMTP_CMD_RCPT;
    } else if (!strcmp(buffer, "MAIL")) {
       rec->mail_cmd_cnt++;
-      if (rec->first_sender[0] == 0) {
-         begin = strchr(end + 1, ':');
-         end = strchr(end, '\r');
+      if (rec->first_sender[0] == 0 && end != NULL) {
+         begin = scan_char(end + 1, payload_end, ':');
+         end = scan_char(end, payload_end, '\r');
          if (end != NULL && begin != NULL) {
-            begin++;
-            len = end - begin;
-
-            memcpy(rec->first_sender, begin, len);
-            rec->first_sender[len] = 0;
+            copy_arg(rec->first_sender, sizeof(rec->first_sender), begin + 1, end);
          }
       }
       rec->command_flags |= SMTP_CMD_MAIL;
@@ -401,6 +409,22 @@ void SMTPPlugin::finish()
    }
 }
 
+/**
+ * \brief Plugin processes SMTP traffic on port 25 only.
+ */
+plugin_interest SMTPPlugin::get_interest()
+{
+   return plugin_interest().port(25);
+}
+
+/**
+ * \brief Create SMTP extension saved in flow cache checkpoint.
+ */
+RecordExt *SMTPPlugin::deserialize(extTypeEnum type, const uint8_t *data, int size)
+{
+   return (type == smtp ? RecordExtSMTP::deserialize(data, size) : NULL);
+}
+
 string SMTPPlugin::get_unirec_field_string()
 {
    return SMTP_UNIREC_TEMPLATE;
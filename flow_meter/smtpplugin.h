@@ -113,6 +113,9 @@ struct RecordExtSMTP : RecordExt {
    char first_recipient[255];
    int data_transfer;
 
+   RECORD_EXT_POOLED(smtp)
+   RECORD_EXT_SERIALIZED(RecordExtSMTP, code_2xx_cnt)
+
    /**
     * \brief Constructor.
     */
@@ -196,9 +199,11 @@ public:
    int post_create(Flow &rec, const Packet &pkt);
    int pre_update(Flow &rec, Packet &pkt);
    void finish();
+   plugin_interest get_interest();
    string get_unirec_field_string();
    bool include_basic_flow_fields();
    const char **get_ipfix_string();
+   RecordExt *deserialize(extTypeEnum type, const uint8_t *data, int size);
 
    bool smtp_keyword(const char *data);
    bool parse_smtp_response(const char *data, int payload_len, RecordExtSMTP *rec);
@@ -44,9 +44,11 @@
  *
  */
 #include "stats.h"
+#include "tcpreassembler.h"
 
 #include <iostream>
 #include <iomanip>
+#include <sstream>
 #include <sys/time.h>
 
 using namespace std;
@@ -63,6 +65,13 @@ void StatsPlugin::init()
    new_flows = 0;
    cache_hits = 0;
    flows_in_cache = 0;
+   ext_allocs = 0;
+   ext_reused = 0;
+   stream_segments = 0;
+   stream_ooo = 0;
+   stream_dropped = 0;
+   stream_delivered = 0;
+   stream_missed = 0;
    init_ts = true;
    print_header();
 }
@@ -111,16 +120,60 @@ void StatsPlugin::check_timestamp(const Packet &pkt)
       packets = 0;
       new_flows = 0;
       cache_hits = 0;
+      reset_ext_stats();
+   }
+}
+
+/**
+ * \brief Remember extension pool and TCP reassembly counters at the beginning of interval.
+ */
+void StatsPlugin::reset_ext_stats()
+{
+   RecordExtPool *pool = RecordExtPool::current();
+   TCPReassembler *reass = TCPReassembler::current();
+
+   if (pool != NULL) {
+      ext_allocs = pool->get_allocs();
+      ext_reused = pool->get_reused();
+   }
+   if (reass != NULL) {
+      stream_segments = reass->get_segments();
+      stream_ooo = reass->get_out_of_order();
+      stream_dropped = reass->get_dropped();
+      stream_delivered = reass->get_delivered();
+      stream_missed = reass->get_missed();
    }
 }
 
 void StatsPlugin::print_header() const
 {
-   out << "#timestamp packets hits newflows incache" << endl;
+   out << "#timestamp packets hits newflows incache extallocs extreused extcached "
+      "streammem streamsegs streamooo streamdropped streamdelivered streammissed" << endl;
 }
 
 void StatsPlugin::print_stats(const struct timeval &ts) const
 {
-   out << ts.tv_sec << "." << ts.tv_usec << " ";
-   out << packets << " " << cache_hits << " " << new_flows << " " << flows_in_cache << endl;
+   ostringstream line; /* Format whole line first, plugin instances of worker threads share output stream. */
+
+   line << ts.tv_sec << "." << ts.tv_usec << " ";
+   line << packets << " " << cache_hits << " " << new_flows << " " << flows_in_cache;
+
+   /* Extension pool of flow cache is bound to thread which calls plugins. */
+   RecordExtPool *pool = RecordExtPool::current();
+   if (pool != NULL) {
+      line << " " << pool->get_allocs() - ext_allocs << " " << pool->get_reused() - ext_reused << " " << pool->get_cached();
+   } else {
+      line << " 0 0 0";
+   }
+
+   /* TCP reassembler is bound to the same thread, counters stay zero when reassembly is disabled. */
+   TCPReassembler *reass = TCPReassembler::current();
+   if (reass != NULL) {
+      line << " " << reass->get_memory() << " " << reass->get_segments() - stream_segments << " " <<
+         reass->get_out_of_order() - stream_ooo << " " << reass->get_dropped() - stream_dropped << " " <<
+         reass->get_delivered() - stream_delivered << " " << reass->get_missed() - stream_missed << endl;
+   } else {
+      line << " 0 0 0 0 0 0" << endl;
+   }
+   out << line.str() << flush;
 }
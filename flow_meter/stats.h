@@ -58,6 +58,13 @@ class StatsPlugin : public FlowCachePlugin
    uint64_t new_flows;
    uint64_t cache_hits;
    uint64_t flows_in_cache;
+   uint64_t ext_allocs;    /**< Extension allocations at the beginning of interval. */
+   uint64_t ext_reused;    /**< Extension allocations served from pool at the beginning of interval. */
+   uint64_t stream_segments;  /**< Reassembled TCP segments at the beginning of interval. */
+   uint64_t stream_ooo;       /**< Out of order TCP segments at the beginning of interval. */
+   uint64_t stream_dropped;   /**< TCP segments dropped by reassembly limits at the beginning of interval. */
+   uint64_t stream_delivered; /**< Satisfied plugin stream requests at the beginning of interval. */
+   uint64_t stream_missed;    /**< Unsatisfied plugin stream requests at the beginning of interval. */
 
    struct timeval interval;
    struct timeval last_ts;
@@ -67,6 +74,7 @@ class StatsPlugin : public FlowCachePlugin
    void check_timestamp(const Packet &pkt);
    void print_header() const;
    void print_stats(const struct timeval &ts) const;
+   void reset_ext_stats();
 
 public:
    StatsPlugin(struct timeval interval, ostream &out);
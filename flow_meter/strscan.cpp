@@ -0,0 +1,254 @@
+/**
+ * \file strscan.cpp
+ * \brief Vectorized scanning of text protocol payloads.
+ * \author Jiri Havranek <havraji6@fit.cvut.cz>
+ * \date 2018
+ */
+/*
+ * Copyright (C) 2018 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#include <string.h>
+
+#include "strscan.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SCAN_X86
+#include <immintrin.h>
+#endif
+
+/**
+ * \brief Classify block byte by byte.
+ */
+static uint64_t scan_block_scalar(const char *block, const char *end, const scan_set &set)
+{
+   int len = (end - block < SCAN_BLOCK_SIZE ? end - block : SCAN_BLOCK_SIZE);
+   uint64_t mask = 0;
+
+   for (int j = 0; j < set.cnt; j++) {
+      char ch = set.chars[j];
+      for (int i = 0; i < len; i++) {
+         mask |= (uint64_t) (block[i] == ch) << i;
+      }
+   }
+   return mask;
+}
+
+#ifdef SCAN_X86
+/**
+ * \brief Copy last incomplete block into zero padded buffer, so it can be loaded by vector instructions.
+ * Zero byte is never a delimiter.
+ */
+static inline const char *scan_pad_block(const char *block, const char *end, char *tmp, int &len)
+{
+   len = end - block;
+   if (len >= SCAN_BLOCK_SIZE) {
+      len = SCAN_BLOCK_SIZE;
+      return block;
+   }
+   memset(tmp, 0, SCAN_BLOCK_SIZE);
+   memcpy(tmp, block, len);
+   return tmp;
+}
+
+/**
+ * \brief Classify block by 16 byte parts using SSE4.2 string comparison.
+ */
+__attribute__((target("sse4.2")))
+static uint64_t scan_block_sse42(const char *block, const char *end, const scan_set &set)
+{
+   char tmp[SCAN_BLOCK_SIZE];
+   int len;
+   const char *data = scan_pad_block(block, end, tmp, len);
+   __m128i delims = _mm_loadu_si128((const __m128i *) set.chars);
+   uint64_t mask = 0;
+
+   for (int i = 0; i < SCAN_BLOCK_SIZE / 16; i++) {
+      __m128i part = _mm_loadu_si128((const __m128i *) (data + i * 16));
+      __m128i match = _mm_cmpestrm(delims, set.cnt, part, 16,
+         _SIDD_UBYTE_OPS | _SIDD_CMP_EQUAL_ANY | _SIDD_BIT_MASK);
+      mask |= (uint64_t) (uint16_t) _mm_cvtsi128_si32(match) << (i * 16);
+   }
+   return (len == SCAN_BLOCK_SIZE ? mask : mask & (((uint64_t) 1 << len) - 1));
+}
+
+/**
+ * \brief Classify block by 32 byte parts using AVX2 byte comparison.
+ */
+__attribute__((target("avx2")))
+static uint64_t scan_block_avx2(const char *block, const char *end, const scan_set &set)
+{
+   char tmp[SCAN_BLOCK_SIZE];
+   int len;
+   const char *data = scan_pad_block(block, end, tmp, len);
+   __m256i lo = _mm256_loadu_si256((const __m256i *) data);
+   __m256i hi = _mm256_loadu_si256((const __m256i *) (data + 32));
+   __m256i match_lo = _mm256_setzero_si256();
+   __m256i match_hi = _mm256_setzero_si256();
+
+   for (int i = 0; i < set.cnt; i++) {
+      __m256i delim = _mm256_set1_epi8(set.chars[i]);
+      match_lo = _mm256_or_si256(match_lo, _mm256_cmpeq_epi8(lo, delim));
+      match_hi = _mm256_or_si256(match_hi, _mm256_cmpeq_epi8(hi, delim));
+   }
+   uint64_t mask = (uint32_t) _mm256_movemask_epi8(match_lo) | ((uint64_t) (uint32_t) _mm256_movemask_epi8(match_hi) << 32);
+   return (len == SCAN_BLOCK_SIZE ? mask : mask & (((uint64_t) 1 << len) - 1));
+}
+#endif
+
+/**
+ * \brief Select fastest implementation supported by CPU.
+ */
+static uint64_t (*scan_select())(const char *, const char *, const scan_set &)
+{
+#ifdef SCAN_X86
+   __builtin_cpu_init();
+   if (__builtin_cpu_supports("avx2")) {
+      return scan_block_avx2;
+   }
+   if (__builtin_cpu_supports("sse4.2")) {
+      return scan_block_sse42;
+   }
+#endif
+   return scan_block_scalar;
+}
+
+uint64_t (*scan_block)(const char *block, const char *end, const scan_set &set) = scan_select();
+
+/**
+ * \brief Initialize iterator.
+ * \param [out] it Iterator.
+ * \param [in] begin Begin of buffer.
+ * \param [in] end End of buffer.
+ * \param [in] delims C string with up to SCAN_SET_MAX delimiter characters.
+ */
+void scan_init(scan_iter &it, const char *begin, const char *end, const char *delims)
+{
+   it.set.cnt = 0;
+   while (it.set.cnt < SCAN_SET_MAX && delims[it.set.cnt]) {
+      it.set.chars[it.set.cnt] = delims[it.set.cnt];
+      it.set.cnt++;
+   }
+   for (int i = it.set.cnt; i < SCAN_SET_MAX; i++) {
+      it.set.chars[i] = 0;
+   }
+
+   it.block = begin;
+   it.end = end;
+   it.mask = (begin < end ? scan_block(begin, end, it.set) : 0);
+}
+
+/**
+ * \brief Get next line terminated by LF together with its first key-value delimiter.
+ * \param [in,out] it Iterator positioned at begin of line, LF and keyval_delim must be members of its delimiter set.
+ * \param [in] begin Begin of line.
+ * \param [in] keyval_delim Key-value delimiter character.
+ * \param [out] line Found line.
+ * \return True when line is terminated by LF, false otherwise.
+ */
+bool scan_next_line(scan_iter &it, const char *begin, char keyval_delim, scan_line &line)
+{
+   const char *pos;
+
+   line.begin = begin;
+   line.delim = NULL;
+   while ((pos = scan_next(it)) != NULL) {
+      if (*pos == '\n') {
+         line.end = pos;
+         return true;
+      } else if (*pos == keyval_delim && line.delim == NULL) {
+         line.delim = pos;
+      }
+   }
+
+   line.end = NULL;
+   return false;
+}
+
+/**
+ * \brief Find first occurrence of character.
+ * \param [in] begin Begin of searched data.
+ * \param [in] end End of searched data.
+ * \param [in] ch Searched character.
+ * \return Pointer to character or NULL when not found.
+ */
+const char *scan_char(const char *begin, const char *end, char ch)
+{
+   if (begin >= end) {
+      return NULL;
+   }
+   return (const char *) memchr(begin, ch, end - begin);
+}
+
+/**
+ * \brief Get name of selected implementation.
+ */
+const char *scan_impl_name()
+{
+#ifdef SCAN_X86
+   if (scan_block == scan_block_avx2) {
+      return "avx2";
+   } else if (scan_block == scan_block_sse42) {
+      return "sse4.2";
+   }
+#endif
+   return "scalar";
+}
+
+/**
+ * \brief Force implementation, used for testing and benchmarking.
+ * \param [in] name One of "avx2", "sse4.2" or "scalar".
+ * \return False when implementation is not supported by CPU.
+ */
+bool scan_use_impl(const char *name)
+{
+   if (!strcmp(name, "scalar")) {
+      scan_block = scan_block_scalar;
+      return true;
+   }
+#ifdef SCAN_X86
+   __builtin_cpu_init();
+   if (!strcmp(name, "sse4.2") && __builtin_cpu_supports("sse4.2")) {
+      scan_block = scan_block_sse42;
+      return true;
+   }
+   if (!strcmp(name, "avx2") && __builtin_cpu_supports("avx2")) {
+      scan_block = scan_block_avx2;
+      return true;
+   }
+#endif
+   return false;
+}
@@ -0,0 +1,130 @@
+/**
+ * \file strscan.h
+ * \brief Vectorized scanning of text protocol payloads.
+ * \author Jiri Havranek <havraji6@fit.cvut.cz>
+ * \date 2018
+ */
+/*
+ * Copyright (C) 2018 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#ifndef STRSCAN_H
+#define STRSCAN_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define SCAN_SET_MAX    16 /**< Maximal number of characters in delimiter set. */
+#define SCAN_BLOCK_SIZE 64 /**< Number of bytes classified at once. */
+
+/**
+ * \brief Set of delimiter characters searched at once.
+ */
+struct scan_set {
+   char chars[SCAN_SET_MAX];  /**< Delimiter characters. */
+   int cnt;                   /**< Number of delimiter characters. */
+};
+
+/**
+ * \brief Iterator over positions of delimiter characters in buffer.
+ *
+ * Buffer is classified by blocks of SCAN_BLOCK_SIZE bytes. Each block is converted into bit mask of delimiter
+ * positions using vector instructions and delimiters are then returned one by one, so every byte is examined
+ * only once regardless of how many delimiters are searched.
+ */
+struct scan_iter {
+   const char *block;   /**< Begin of current block. */
+   const char *end;     /**< End of buffer. */
+   uint64_t mask;       /**< Positions of delimiters in current block which were not returned yet. */
+   scan_set set;        /**< Searched delimiters. */
+};
+
+/**
+ * \brief Single line of text payload.
+ */
+struct scan_line {
+   const char *begin;   /**< First character of line. */
+   const char *end;     /**< Position of line delimiter, not included in line. */
+   const char *delim;   /**< First key-value delimiter inside line or NULL. */
+};
+
+/**
+ * \brief Classify one block, pointer to implementation selected at runtime.
+ */
+extern uint64_t (*scan_block)(const char *block, const char *end, const scan_set &set);
+
+void scan_init(scan_iter &it, const char *begin, const char *end, const char *delims);
+bool scan_next_line(scan_iter &it, const char *begin, char keyval_delim, scan_line &line);
+const char *scan_char(const char *begin, const char *end, char ch);
+
+const char *scan_impl_name();
+bool scan_use_impl(const char *name);
+
+/**
+ * \brief Get next delimiter.
+ * \param [in,out] it Iterator.
+ * \return Pointer to delimiter or NULL when end of buffer was reached.
+ */
+inline const char *scan_next(scan_iter &it)
+{
+   while (!it.mask) {
+      it.block += SCAN_BLOCK_SIZE;
+      if (it.block >= it.end) {
+         return NULL;
+      }
+      it.mask = scan_block(it.block, it.end, it.set);
+   }
+
+   const char *pos = it.block + __builtin_ctzll(it.mask);
+   it.mask &= it.mask - 1;
+   return pos;
+}
+
+/**
+ * \brief Skip delimiters until given one is found.
+ * \param [in,out] it Iterator.
+ * \param [in] ch Wanted delimiter, must be member of iterator delimiter set.
+ * \return Pointer to delimiter or NULL when end of buffer was reached.
+ */
+inline const char *scan_find(scan_iter &it, char ch)
+{
+   const char *pos;
+   while ((pos = scan_next(it)) != NULL && *pos != ch) {
+   }
+   return pos;
+}
+
+#endif
@@ -0,0 +1,285 @@
+/**
+ * \file tcpreassembler.cpp
+ * \brief Bounded reassembly of beginning of TCP streams.
+ * \author Jiri Havranek <havraji6@fit.cvut.cz>
+ * \date 2018
+ */
+/*
+ * Copyright (C) 2018 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+
+#include "tcpreassembler.h"
+
+using namespace std;
+
+__thread TCPReassembler *TCPReassembler::thread_reass = NULL;
+
+/**
+ * \brief Constructor.
+ * \param [in] flow_limit Max size of stream buffers of one flow in bytes.
+ * \param [in] total_limit Max size of all stream buffers and structures in bytes.
+ */
+TCPReassembler::TCPReassembler(uint32_t flow_limit, uint64_t total_limit) : flow_limit(flow_limit), total_limit(total_limit),
+   memory(0), peak_memory(0), segments(0), in_order(0), out_of_order(0), duplicate(0), dropped(0), delivered(0), missed(0)
+{
+}
+
+TCPReassembler::~TCPReassembler()
+{
+   if (thread_reass == this) {
+      thread_reass = NULL;
+   }
+}
+
+/**
+ * \brief Allocate streams of new TCP flow.
+ * \return Pointer to streams or NULL if memory limit was reached.
+ */
+TCPStreams *TCPReassembler::open()
+{
+   if (memory + sizeof(TCPStreams) > total_limit) {
+      return NULL;
+   }
+
+   TCPStreams *streams = new TCPStreams();
+   streams->owner = this;
+   memory += sizeof(TCPStreams);
+   if (memory > peak_memory) {
+      peak_memory = memory;
+   }
+   return streams;
+}
+
+/**
+ * \brief Release streams of flow, plugins still waiting for data are counted as missed.
+ * \param [in] streams Streams returned by open().
+ */
+void TCPReassembler::release(TCPStreams *streams)
+{
+   close(*streams, 0);
+   close(*streams, 1);
+   memory -= sizeof(TCPStreams);
+   delete streams;
+}
+
+/**
+ * \brief Stop buffering of stream direction and release its buffer.
+ * \param [in,out] streams Streams of flow.
+ * \param [in] dir Direction.
+ */
+void TCPReassembler::close(TCPStreams &streams, int dir)
+{
+   TCPStream &stream = streams.dir[dir];
+
+   count_missed(stream);
+   free(stream.data);
+   memory -= stream.size;
+   stream.data = NULL;
+   stream.size = 0;
+   stream.range_cnt = 0;
+   stream.closed = true;
+}
+
+/**
+ * \brief Count and clear requests of plugins which wait for data of stream.
+ * \param [in] stream Stream direction.
+ */
+void TCPReassembler::count_missed(const TCPStream &stream)
+{
+   for (int i = 0; i < STREAM_MAX_SUBSCRIBERS; i++) {
+      if (stream.wanted[i] != 0) {
+         missed++;
+      }
+   }
+}
+
+/**
+ * \brief Grow buffer of stream direction within per flow and total limits.
+ * \param [in,out] streams Streams of flow.
+ * \param [in] dir Direction.
+ * \param [in] length Required buffer size.
+ * \return Size of buffer, can be smaller than required when limit was reached.
+ */
+uint32_t TCPReassembler::reserve(TCPStreams &streams, int dir, uint32_t length)
+{
+   TCPStream &stream = streams.dir[dir];
+   uint32_t other = streams.dir[dir ^ 1].size;
+   uint32_t avail = (flow_limit > other ? flow_limit - other : 0);
+   uint32_t size = (stream.size != 0 ? stream.size : STREAM_MIN_ALLOC);
+
+   if (length <= stream.size) {
+      return stream.size;
+   }
+   if (length > avail) {
+      length = avail;
+   }
+   while (size < length) {
+      size <<= 1;
+   }
+   if (size > avail) {
+      size = avail;
+   }
+   if (size <= stream.size || memory + (size - stream.size) > total_limit) {
+      return stream.size;
+   }
+
+   char *data = (char *) realloc(stream.data, size);
+   if (data == NULL) {
+      return stream.size;
+   }
+   memory += size - stream.size;
+   if (memory > peak_memory) {
+      peak_memory = memory;
+   }
+   stream.data = data;
+   stream.size = size;
+   return size;
+}
+
+/**
+ * \brief Store payload of TCP segment into stream direction.
+ * \param [in,out] streams Streams of flow.
+ * \param [in] dir Direction of packet.
+ * \param [in] pkt TCP packet.
+ * \return True if contiguous data at beginning of stream grew.
+ */
+bool TCPReassembler::add(TCPStreams &streams, int dir, const Packet &pkt)
+{
+   TCPStream &stream = streams.dir[dir];
+   uint32_t seq = pkt.tcp_seq + ((pkt.tcp_control_bits & TCP_FLAG_SYN) ? 1 : 0); /* SYN occupies one sequence number. */
+
+   if (!stream.started) {
+      stream.started = true;
+      stream.isn = seq;
+   }
+   if (stream.closed || pkt.payload_length == 0) {
+      return false;
+   }
+   segments++;
+
+   const char *data = pkt.payload;
+   uint32_t len = pkt.payload_length;
+   int32_t offset = (int32_t) (seq - stream.isn);
+   if (offset < 0) {
+      /* Segment starts before beginning of stream, skip retransmitted part. */
+      if ((uint32_t) -offset >= len) {
+         duplicate++;
+         return false;
+      }
+      data -= offset;
+      len += offset;
+      offset = 0;
+   }
+
+   uint32_t begin = offset;
+   uint32_t end = begin + len;
+   if (end <= stream.length) {
+      duplicate++;
+      return false;
+   }
+   if (begin >= flow_limit) {
+      /* Segment is far beyond any buffer this flow can get. */
+      dropped++;
+      return false;
+   }
+
+   uint32_t size = reserve(streams, dir, end);
+   if (begin >= size) {
+      dropped++;
+      return false;
+   }
+   if (end > size) {
+      end = size;
+   }
+   memcpy(stream.data + begin, data, end - begin);
+
+   if (begin > stream.length) {
+      /* Gap before segment, remember range merged with overlapping ones. */
+      for (int i = 0; i < stream.range_cnt; ) {
+         if (stream.range_begin[i] <= end && begin <= stream.range_end[i]) {
+            begin = (stream.range_begin[i] < begin ? stream.range_begin[i] : begin);
+            end = (stream.range_end[i] > end ? stream.range_end[i] : end);
+            stream.range_cnt--;
+            stream.range_begin[i] = stream.range_begin[stream.range_cnt];
+            stream.range_end[i] = stream.range_end[stream.range_cnt];
+         } else {
+            i++;
+         }
+      }
+      if (stream.range_cnt == STREAM_MAX_RANGES) {
+         dropped++;
+         return false;
+      }
+      stream.range_begin[stream.range_cnt] = begin;
+      stream.range_end[stream.range_cnt] = end;
+      stream.range_cnt++;
+      out_of_order++;
+      return false;
+   }
+
+   /* Segment extends contiguous data, append out of order ranges which are no longer behind a gap. */
+   in_order++;
+   stream.length = end;
+   for (int i = 0; i < stream.range_cnt; ) {
+      if (stream.range_begin[i] <= stream.length) {
+         if (stream.range_end[i] > stream.length) {
+            stream.length = stream.range_end[i];
+         }
+         stream.range_cnt--;
+         stream.range_begin[i] = stream.range_begin[stream.range_cnt];
+         stream.range_end[i] = stream.range_end[stream.range_cnt];
+         i = 0;
+      } else {
+         i++;
+      }
+   }
+   return true;
+}
+
+/**
+ * \brief Print reassembly statistics.
+ */
+void TCPReassembler::print_report() const
+{
+   cout << "TCP reassembly memory: " << memory << " bytes, peak " << peak_memory << " bytes" << endl;
+   cout << "TCP reassembly segments: " << segments << " (" << in_order << " in order, " << out_of_order << " out of order, " <<
+      duplicate << " duplicate, " << dropped << " dropped)" << endl;
+   cout << "TCP reassembly requests: " << delivered << " delivered, " << missed << " missed" << endl;
+}
@@ -0,0 +1,176 @@
+/**
+ * \file tcpreassembler.h
+ * \brief Bounded reassembly of beginning of TCP streams.
+ * \author Jiri Havranek <havraji6@fit.cvut.cz>
+ * \date 2018
+ */
+/*
+ * Copyright (C) 2018 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#ifndef TCPREASSEMBLER_H
+#define TCPREASSEMBLER_H
+
+#include <stdint.h>
+
+#include "packet.h"
+
+#define STREAM_MAX_SUBSCRIBERS 16   /**< Max number of plugins which can receive stream data, plugins added later are not asked. */
+#define STREAM_MAX_RANGES 4         /**< Max number of out of order data ranges kept per stream direction. */
+#define STREAM_MIN_ALLOC 1024       /**< Initial size of stream buffer. */
+
+#define DEFAULT_STREAM_FLOW_LIMIT 16384         /**< Default max size of stream buffers of one flow in bytes. */
+#define DEFAULT_STREAM_TOTAL_LIMIT (64 << 20)   /**< Default max size of all stream buffers of flow cache in bytes. */
+
+/**
+ * \brief Reassembled beginning of one direction of TCP connection.
+ */
+struct TCPStream {
+   char *data;                               /**< Stream bytes, offset 0 is first byte after SYN or first byte of first seen segment. */
+   uint32_t size;                            /**< Allocated size of data. */
+   uint32_t length;                          /**< Number of contiguous bytes from beginning of stream. */
+   uint32_t isn;                             /**< Sequence number of stream byte at offset 0. */
+   uint32_t range_begin[STREAM_MAX_RANGES];  /**< Begin offsets of out of order data stored behind a gap. */
+   uint32_t range_end[STREAM_MAX_RANGES];    /**< End offsets of out of order data stored behind a gap. */
+   uint8_t range_cnt;                        /**< Number of out of order ranges. */
+   bool started;                             /**< First packet of direction was seen and isn is valid. */
+   bool closed;                              /**< No plugin waits for data of this direction, nothing is buffered. */
+   uint32_t wanted[STREAM_MAX_SUBSCRIBERS];  /**< Stream length each plugin waits for, 0 if plugin does not wait. */
+};
+
+class TCPReassembler;
+
+/**
+ * \brief Both directions of TCP connection, allocated for TCP flow records when reassembly is enabled.
+ */
+struct TCPStreams {
+   TCPReassembler *owner;  /**< Reassembler which allocated streams. */
+   TCPStream dir[2];       /**< Stream in direction of first packet of flow and reverse stream. */
+};
+
+/**
+ * \brief Reassembles beginning of TCP streams for plugins within per flow and per flow cache memory limits.
+ *
+ * Segments are copied to position given by their sequence number, so retransmitted and reordered segments
+ * are handled. Plugins wait for given length of contiguous data from beginning of stream and are called by
+ * flow cache when it is available. Buffer of direction is released when no plugin waits for its data.
+ */
+class TCPReassembler
+{
+   uint32_t flow_limit;    /**< Max size of stream buffers of one flow. */
+   uint64_t total_limit;   /**< Max size of all buffers and stream structures. */
+   uint64_t memory;        /**< Current size of all buffers and stream structures. */
+   uint64_t peak_memory;   /**< Max value of memory. */
+
+   uint64_t segments;      /**< Number of data segments of streams with waiting plugins. */
+   uint64_t in_order;      /**< Segments which extended contiguous data. */
+   uint64_t out_of_order;  /**< Segments stored behind a gap. */
+   uint64_t duplicate;     /**< Segments with already known data. */
+   uint64_t dropped;       /**< Segments which could not be stored due to limits. */
+   uint64_t delivered;     /**< Plugin requests for data which were satisfied. */
+   uint64_t missed;        /**< Plugin requests which were not satisfied before stream was closed. */
+
+   static __thread TCPReassembler *thread_reass; /**< Reassembler bound to current thread. */
+
+   TCPReassembler(const TCPReassembler &);
+   TCPReassembler &operator=(const TCPReassembler &);
+
+   uint32_t reserve(TCPStreams &streams, int dir, uint32_t length);
+   void count_missed(const TCPStream &stream);
+
+public:
+   TCPReassembler(uint32_t flow_limit, uint64_t total_limit);
+   ~TCPReassembler();
+
+   /**
+    * \brief Use this reassembler for statistics printed by calling thread.
+    */
+   void bind()
+   {
+      thread_reass = this;
+   }
+
+   /**
+    * \brief Get reassembler bound to calling thread.
+    * \return Pointer to reassembler or NULL.
+    */
+   static TCPReassembler *current()
+   {
+      return thread_reass;
+   }
+
+   TCPStreams *open();
+   void release(TCPStreams *streams);
+
+   bool add(TCPStreams &streams, int dir, const Packet &pkt);
+   void close(TCPStreams &streams, int dir);
+
+   /**
+    * \brief Count plugin request which was satisfied.
+    */
+   void count_delivered()
+   {
+      delivered++;
+   }
+
+   uint64_t get_memory() const
+   {
+      return memory;
+   }
+   uint64_t get_segments() const
+   {
+      return segments;
+   }
+   uint64_t get_out_of_order() const
+   {
+      return out_of_order;
+   }
+   uint64_t get_dropped() const
+   {
+      return dropped;
+   }
+   uint64_t get_delivered() const
+   {
+      return delivered;
+   }
+   uint64_t get_missed() const
+   {
+      return missed;
+   }
+   void print_report() const;
+};
+
+#endif
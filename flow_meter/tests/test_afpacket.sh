@@ -0,0 +1,32 @@
+#!/bin/bash
+
+test -z "$srcdir" && export srcdir=.
+
+. $srcdir/test_plugin.sh
+
+if ! [ -f "$flow_meter_bin" ]; then
+   echo "flow_meter not compiled"
+   exit 77
+fi
+
+if [ "$(id -u)" != "0" ]; then
+   echo "AF_PACKET capture requires root privileges"
+   exit 77
+fi
+
+# Capture 10 packets from loopback using TPACKET_V3 ring while sending UDP datagrams to it.
+timeout 10 "$flow_meter_bin" -i f:/dev/null -I lo -A 65536:4 -c 10 >/dev/null &
+pid=$!
+
+for i in $(seq 1 50); do
+   kill -0 $pid 2>/dev/null || break
+   echo "flow_meter afpacket test" > /dev/udp/127.0.0.1/5000
+   sleep 0.1
+done
+
+if wait $pid; then
+   echo "afpacket test OK"
+else
+   echo "afpacket test FAILED"
+   exit 1
+fi
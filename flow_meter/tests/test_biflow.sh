@@ -0,0 +1,21 @@
+#!/bin/bash
+
+test -z "$srcdir" && export srcdir=.
+
+. $srcdir/test_plugin.sh
+
+check_binaries || exit $?
+
+# Biflow must account for every packet of uniflow export in fewer records.
+export_flows basic "$pcap_dir/http-sample.pcap" "$output_dir/biflow-uni"
+export_flows basic "$pcap_dir/http-sample.pcap" "$output_dir/biflow-bi" -b
+read uni_flows uni_packets <<< "$(flow_stats "$output_dir/biflow-uni" sum:PACKETS)"
+read bi_flows bi_packets bi_rev_packets <<< "$(flow_stats "$output_dir/biflow-bi" sum:PACKETS sum:PACKETS_REV)"
+bi_packets=$((bi_packets + bi_rev_packets))
+
+if [ "$bi_packets" = "$uni_packets" ] && [ "$bi_flows" -lt "$uni_flows" ]; then
+   echo "biflow test OK"
+else
+   echo "biflow test FAILED: uniflow $uni_flows flows $uni_packets packets, biflow $bi_flows flows $bi_packets packets"
+   exit 1
+fi
@@ -0,0 +1,92 @@
+#!/bin/bash
+
+test -z "$srcdir" && export srcdir=.
+
+. $srcdir/test_plugin.sh
+
+check_binaries || exit $?
+
+checkpoint="$output_dir/$$.checkpoint"
+fifo="$output_dir/$$.fifo"
+rm -f "$checkpoint" "$fifo"
+
+# Usage: check_missing <test name> <records of uninterrupted run> <exported records>
+# Fails when some flow of uninterrupted run is not among exported records.
+check_missing() {
+   missing="$(grep -v "^ipaddr " "$2" | sort | comm -23 - <(grep -v "^ipaddr " "$3" | sort) | wc -l)"
+   if [ "$missing" != "0" ]; then
+      echo "checkpoint test FAILED: $missing flows were not exported after restart ($1)"
+      rm -f "$checkpoint" "$fifo"
+      exit 1
+   fi
+}
+
+export_flows http "$pcap_dir/http-sample.pcap" "$output_dir/http-full"
+
+# Flows of HTTP sample are saved at exit and loaded by next run. Traffic of mixed sample is months later,
+# so loaded flows time out and must be exported with their HTTP extensions.
+export_flows http "$pcap_dir/http-sample.pcap" "$output_dir/http-checkpoint" "-C $checkpoint"
+if ! [ -f "$checkpoint" ]; then
+   echo "checkpoint test FAILED: checkpoint was not saved"
+   exit 1
+fi
+export_flows http "$pcap_dir/mixed-sample.pcap" "$output_dir/http-restart" "-C $checkpoint"
+check_missing "restart" "$output_dir/http-full" <(cat "$output_dir/http-checkpoint" "$output_dir/http-restart")
+
+# Checkpoint of flow cache with two workers is loaded by single worker.
+export_flows http "$pcap_dir/http-sample.pcap" "$output_dir/http-checkpoint" "-C $checkpoint -w 2"
+export_flows http "$pcap_dir/mixed-sample.pcap" "$output_dir/http-restart" "-C $checkpoint -w 1"
+check_missing "workers" "$output_dir/http-full" <(cat "$output_dir/http-checkpoint" "$output_dir/http-restart")
+
+# SIGUSR1 saves checkpoint of running instance, which is then killed. Packets are read from FIFO, ARP packets
+# which are written after the signal only make the instance return from reading and save the checkpoint.
+# Flows of SMTP sample expire when traffic of HTTP sample arrives, they are exported before the signal and
+# must not be in the checkpoint, so no flow is exported twice.
+{ cat "$pcap_dir/smtp-sample.pcap"; tail -c +25 "$pcap_dir/http-sample.pcap"; } > "$output_dir/smtp-http.pcap"
+export_flows basic "$output_dir/smtp-http.pcap" "$output_dir/basic-full"
+rm -f "$checkpoint"
+mkfifo "$fifo"
+"$flow_meter_bin" -i f:"$output_dir/$file_out":buffer=off:timeout=WAIT -p basic -L 0 -r "$fifo" -C "$checkpoint" >"$output_dir/basic-signal.log" &
+pid=$!
+exec 3>"$fifo"
+cat "$output_dir/smtp-http.pcap" >&3
+sleep 1
+kill -USR1 $pid
+tail -c +25 "$pcap_dir/arp-sample.pcap" >&3
+tail -c +25 "$pcap_dir/arp-sample.pcap" >&3
+for i in $(seq 50); do
+   grep -q "^Saved " "$output_dir/basic-signal.log" && break
+   sleep 0.1
+done
+kill -KILL $pid
+wait $pid 2>/dev/null
+exec 3>&-
+rm -f "$fifo" "$output_dir/smtp-http.pcap"
+if ! grep -q "^Saved " "$output_dir/basic-signal.log"; then
+   echo "checkpoint test FAILED: checkpoint was not saved on SIGUSR1"
+   rm -f "$checkpoint" "$output_dir/$file_out"
+   exit 1
+fi
+: > "$output_dir/basic-checkpoint"
+if [ -f "$output_dir/$file_out" ]; then
+   "$logger_bin" -i f:"$output_dir/$file_out" -t > "$output_dir/basic-checkpoint"
+   rm -f "$output_dir/$file_out"
+fi
+export_flows basic "$pcap_dir/mixed-sample.pcap" "$output_dir/basic-restart" "-C $checkpoint"
+check_missing "SIGUSR1" "$output_dir/basic-full" <(cat "$output_dir/basic-checkpoint" "$output_dir/basic-restart")
+duplicate="$(cat "$output_dir/basic-checkpoint" "$output_dir/basic-restart" | grep -v "^ipaddr " | sort | uniq -d | wc -l)"
+if [ "$duplicate" != "0" ]; then
+   echo "checkpoint test FAILED: $duplicate flows exported before SIGUSR1 were exported again after restart"
+   rm -f "$checkpoint"
+   exit 1
+fi
+
+# Checkpoint with different flow keys is refused.
+if "$flow_meter_bin" -i f:"$output_dir/$file_out":buffer=off:timeout=WAIT -p http -L 0 -r "$pcap_dir/http-sample.pcap" -C "$checkpoint" -b >/dev/null 2>&1; then
+   echo "checkpoint test FAILED: checkpoint saved without -b was loaded with -b"
+   rm -f "$checkpoint" "$output_dir/$file_out"
+   exit 1
+fi
+rm -f "$checkpoint" "$output_dir/$file_out"
+
+echo "checkpoint test OK"
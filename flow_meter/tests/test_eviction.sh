@@ -0,0 +1,22 @@
+#!/bin/bash
+
+test -z "$srcdir" && export srcdir=.
+
+. $srcdir/test_plugin.sh
+
+check_binaries || exit $?
+
+# Flows are evicted from cache of single line, every policy must account for all packets.
+export_flows basic "$pcap_dir/mixed-sample.pcap" "$output_dir/eviction"
+read flows packets <<< "$(flow_stats "$output_dir/eviction" sum:PACKETS)"
+for policy in lru size victim:4 victim:5; do
+   export_flows basic "$pcap_dir/mixed-sample.pcap" "$output_dir/eviction-$policy" "-s 4 -E $policy"
+   read policy_flows policy_packets <<< "$(flow_stats "$output_dir/eviction-$policy" sum:PACKETS)"
+
+   if [ "$policy_packets" != "$packets" ] || [ "$policy_flows" -lt "$flows" ]; then
+      echo "eviction test FAILED: $policy policy $policy_flows flows $policy_packets packets, expected $packets packets in at least $flows flows"
+      exit 1
+   fi
+done
+
+echo "eviction test OK"
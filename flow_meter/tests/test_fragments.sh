@@ -0,0 +1,12 @@
+#!/bin/sh
+
+test -z "$srcdir" && export srcdir=.
+
+. $srcdir/test_plugin.sh
+
+run_plugin_test sip "$pcap_dir/sip-fragmented-sample.pcap" sip-fragments "-f default:reassembly" || exit $?
+
+# Fragments of datagrams which cannot be reassembled are counted as if reassembly was off.
+run_plugin_test basic "$pcap_dir/dns-incomplete-sample.pcap" basic-incomplete "-f default" basic-incomplete || exit $?
+run_plugin_test basic "$pcap_dir/dns-incomplete-sample.pcap" basic-incomplete-reassembly "-f default:reassembly" basic-incomplete || exit $?
+run_plugin_test basic "$pcap_dir/dns-incomplete-sample.pcap" basic-incomplete-evictions "-f 4:1:reassembly" basic-incomplete
@@ -0,0 +1,19 @@
+#!/bin/bash
+
+test -z "$srcdir" && export srcdir=.
+
+. $srcdir/test_plugin.sh
+
+# Page size must not change plugin output, missing huge pages fall back to smaller ones.
+for pages in 1g 2m:0 thp off; do
+   run_plugin_test http "$pcap_dir/http-sample.pcap" http-hugepages "-g $pages" || exit $?
+done
+
+# Achieved page size is reported at startup.
+if ! "$flow_meter_bin" -i f:"$output_dir/$file_out":buffer=off:timeout=WAIT -p basic -g 2m -r "$pcap_dir/http-sample.pcap" | grep -q "^Flow cache memory: .* pages"; then
+   echo "hugepages test FAILED: flow cache memory not reported"
+   exit 1
+fi
+rm -f "$output_dir/$file_out"
+
+echo "hugepages test OK"
@@ -0,0 +1,22 @@
+#!/bin/bash
+
+test -z "$srcdir" && export srcdir=.
+
+. $srcdir/test_plugin.sh
+
+# Limit above length of sample flows must not change plugin output.
+run_plugin_test https "$pcap_dir/https-sample.pcap" https-inspect-limit "-B 1000" || exit $?
+
+check_binaries || exit $?
+
+# Packets not passed to plugins are still counted in flows, basic interface exports flows without HTTPS extension.
+export_flows basic,https "$pcap_dir/https-sample.pcap" "$output_dir/inspect-all"
+export_flows basic,https "$pcap_dir/https-sample.pcap" "$output_dir/inspect-limited" "-B 1"
+read flows packets <<< "$(flow_stats "$output_dir/inspect-all" sum:PACKETS)"
+read limited_flows limited_packets <<< "$(flow_stats "$output_dir/inspect-limited" sum:PACKETS)"
+if [ "$limited_packets" != "$packets" ]; then
+   echo "inspect limit test FAILED: $limited_packets packets, expected $packets"
+   exit 1
+fi
+
+echo "inspect limit test OK"
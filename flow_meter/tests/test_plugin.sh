@@ -13,8 +13,9 @@ ref_dir=$srcdir/test_reference
 output_dir=./test_output
 file_out="$$.data"
 
-# Usage: run_plugin_test <plugin> <data file>
-run_plugin_test() {
+# Usage: check_binaries
+# Returns 77 (test skipped) when flow_meter or logger is not compiled, creates output directory.
+check_binaries() {
    if ! [ -f "$flow_meter_bin" ]; then
       echo "flow_meter not compiled"
       return 77
@@ -28,16 +29,63 @@ run_plugin_test() {
    if ! [ -d "$output_dir" ]; then
       mkdir "$output_dir"
    fi
+}
+
+# Usage: export_flows <plugin>[,<plugin>...] <data file> <output file> [<flow_meter arguments>]
+# Stores records exported on interface of the first plugin as logger text output, the first line is header.
+# Records of other plugins are discarded.
+export_flows() {
+   ifcs="f:$output_dir/$file_out:buffer=off:timeout=WAIT"
+   for plugin in $(echo "$1" | tr ',' ' ' | cut -d' ' -f2- -s); do
+      ifcs="$ifcs,f:$output_dir/$file_out.$plugin:buffer=off:timeout=WAIT"
+   done
 
-   "$flow_meter_bin" -i f:"$output_dir/$file_out":buffer=off:timeout=WAIT -p "$1" -L 0 -r "$2" >/dev/null
-   "$logger_bin"     -i f:"$output_dir/$file_out" -t | sort > "$output_dir/$1"
+   "$flow_meter_bin" -i "$ifcs" -p "$1" -L 0 -r "$2" $4 >/dev/null
+   "$logger_bin"     -i f:"$output_dir/$file_out" -t > "$3"
+   rm -f "$output_dir/$file_out" "$output_dir/$file_out".*
+}
+
+# Usage: flow_stats <logger output file> [<sum|min|max>:<field name>...]
+# Prints number of records followed by sum, min or max of each given field, "-" is printed
+# for min and max of field which is not exported.
+flow_stats() {
+   stats_file="$1"
+   shift
+   awk -F, -v specs="$*" '
+      BEGIN { n = split(specs, spec, " ") }
+      NR == 1 { for (i = 1; i <= NF; i++) { split($i, name, " "); col[name[2]] = i }; next }
+      {
+         records++
+         for (s = 1; s <= n; s++) {
+            split(spec[s], agg, ":")
+            if (!(agg[2] in col)) { continue }
+            v = $col[agg[2]] + 0
+            if (agg[1] == "sum") { val[s] += v }
+            else if (!(s in val) || (agg[1] == "min" && v < val[s]) || (agg[1] == "max" && v > val[s])) { val[s] = v }
+         }
+      }
+      END {
+         printf "%d", records
+         for (s = 1; s <= n; s++) { split(spec[s], agg, ":"); printf " %s", (s in val ? val[s] : (agg[1] == "sum" ? 0 : "-")) }
+         print ""
+      }' "$stats_file"
+}
+
+# Usage: run_plugin_test <plugin> <data file> [<test name> <flow_meter arguments> <reference name>]
+run_plugin_test() {
+   test_name="${3:-$1}"
+   ref_name="${5:-$1}"
+
+   check_binaries || return $?
+
+   "$flow_meter_bin" -i f:"$output_dir/$file_out":buffer=off:timeout=WAIT -p "$1" -L 0 -r "$2" $4 >/dev/null
+   "$logger_bin"     -i f:"$output_dir/$file_out" -t | sort > "$output_dir/$test_name"
    rm "$output_dir/$file_out"
 
-   if sort "$ref_dir/$1" | diff -u "$output_dir/$1" -s - ; then
-      echo "$1 plugin test OK"
+   if sort "$ref_dir/$ref_name" | diff -u "$output_dir/$test_name" -s - ; then
+      echo "$test_name plugin test OK"
    else
-      echo "$1 plugin test FAILED"
+      echo "$test_name plugin test FAILED"
       return 1
    fi
 }
-
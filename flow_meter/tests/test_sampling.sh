@@ -0,0 +1,49 @@
+#!/bin/bash
+
+test -z "$srcdir" && export srcdir=.
+
+. $srcdir/test_plugin.sh
+
+check_binaries || exit $?
+
+# Usage: sample_flows <data file> <output file> [<flow_meter arguments>]
+# Stores sorted flow records without SAMPLING_INTERVAL field and prints number of flows, sum of PACKETS
+# and min and max of SAMPLING_INTERVAL.
+sample_flows() {
+   export_flows basic "$1" "$2.raw" "$3"
+   flow_stats "$2.raw" sum:PACKETS min:SAMPLING_INTERVAL max:SAMPLING_INTERVAL
+   interval_col="$(head -n 1 "$2.raw" | tr ',' '\n' | grep -n " SAMPLING_INTERVAL$" | cut -d: -f1)"
+   if [ -n "$interval_col" ]; then
+      tail -n +2 "$2.raw" | cut -d, -f"$interval_col" --complement | sort > "$2"
+   else
+      tail -n +2 "$2.raw" | sort > "$2"
+   fi
+}
+
+pcap="$pcap_dir/http-sample.pcap"
+read all_flows all_packets <<< "$(sample_flows "$pcap" "$output_dir/sampling-all")"
+
+# Every 4th packet is passed to flow cache.
+read flows packets interval max_interval <<< "$(sample_flows "$pcap" "$output_dir/sampling-count" "-N count:4")"
+if [ "$packets" != "$((all_packets / 4))" ] || [ "$interval" != "4" ] || [ "$max_interval" != "4" ]; then
+   echo "count sampling test FAILED: $packets of $all_packets packets, interval $interval to $max_interval"
+   exit 1
+fi
+
+# Sampled flows must be complete and identical to unsampled ones.
+read flows packets interval max_interval <<< "$(sample_flows "$pcap" "$output_dir/sampling-flow" "-N flow:2")"
+if [ "$flows" -ge "$all_flows" ] || [ "$flows" -eq 0 ] || [ "$interval" != "2" ] || [ "$max_interval" != "2" ] ||
+   [ -n "$(comm -23 "$output_dir/sampling-flow" "$output_dir/sampling-all")" ]; then
+   echo "flow sampling test FAILED: $flows of $all_flows flows, interval $interval to $max_interval"
+   exit 1
+fi
+
+# Non-IP packets are not flow sampled, they are all kept with interval 1.
+stats="$("$flow_meter_bin" -i f:"$output_dir/$file_out":buffer=off:timeout=WAIT -p arp -L 0 -r "$pcap_dir/arp-sample.pcap" -N flow:2)"
+rm "$output_dir/$file_out"
+if ! echo "$stats" | grep -q "^Packets sampled: 45 of 45, interval 2, 45 non-IP packets kept with interval 1$"; then
+   echo "non-IP flow sampling test FAILED: $(echo "$stats" | grep "^Packets sampled")"
+   exit 1
+fi
+
+echo "sampling test OK"
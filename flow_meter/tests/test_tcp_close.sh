@@ -0,0 +1,27 @@
+#!/bin/bash
+
+test -z "$srcdir" && export srcdir=.
+
+. $srcdir/test_plugin.sh
+
+check_binaries || exit $?
+
+# Closed connections are exported before inactive timeout, but no packet may be lost.
+for pcap in http-sample.pcap https-sample.pcap smtp-sample.pcap; do
+   export_flows basic "$pcap_dir/$pcap" "$output_dir/tcp-close"
+   read flows packets <<< "$(flow_stats "$output_dir/tcp-close" sum:PACKETS)"
+   for linger in 0 2; do
+      export_flows basic "$pcap_dir/$pcap" "$output_dir/tcp-close-$linger" "-k $linger"
+      read tcp_flows tcp_packets min_reason max_reason <<< \
+         "$(flow_stats "$output_dir/tcp-close-$linger" sum:PACKETS min:FLOW_END_REASON max:FLOW_END_REASON)"
+
+      # FLOW_END_REASON must be one of IPFIX flowEndReason values 1 to 5.
+      if [ "$tcp_packets" != "$packets" ] || [ "$tcp_flows" -lt "$flows" ] || [ "$min_reason" = "-" ] ||
+         [ "$min_reason" -lt 1 ] || [ "$max_reason" -gt 5 ]; then
+         echo "tcp close test FAILED: $pcap linger $linger $tcp_flows flows $tcp_packets packets, end reasons $min_reason to $max_reason, expected $packets packets"
+         exit 1
+      fi
+   done
+done
+
+echo "tcp close test OK"
@@ -0,0 +1,9 @@
+#!/bin/sh
+
+test -z "$srcdir" && export srcdir=.
+
+. $srcdir/test_plugin.sh
+
+run_plugin_test https "$pcap_dir/https-sample.pcap" https-reassembly "-R default" || exit $?
+run_plugin_test https "$pcap_dir/https-sample.pcap" https-reassembly-workers "-R 4096:65536 -w 2" || exit $?
+run_plugin_test https "$pcap_dir/https-segmented-sample.pcap" https-reassembly-segmented "-R default" https-segmented
@@ -0,0 +1,8 @@
+#!/bin/sh
+
+test -z "$srcdir" && export srcdir=.
+
+. $srcdir/test_plugin.sh
+
+run_plugin_test dns "$pcap_dir/dns-tunnel-sample.pcap" dns-tunnels "-T all" || exit $?
+run_plugin_test tunnel "$pcap_dir/dns-tunnel-sample.pcap" tunnel "-T all"
@@ -0,0 +1,8 @@
+#!/bin/sh
+
+test -z "$srcdir" && export srcdir=.
+
+. $srcdir/test_plugin.sh
+
+run_plugin_test basic "$pcap_dir/mixed-sample.pcap" basic-workers "-w 4" || exit $?
+run_plugin_test http "$pcap_dir/http-sample.pcap" http-workers "-w 3"
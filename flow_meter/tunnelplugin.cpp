@@ -0,0 +1,124 @@
+/**
+ * \file tunnelplugin.cpp
+ * \brief Plugin for exporting endpoints and identifiers of decapsulated tunnels.
+ * \author Jiri Havranek <havraji6@fit.cvut.cz>
+ * \date 2018
+ */
+/*
+ * Copyright (C) 2018 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#include <iostream>
+#include <string>
+#include <unirec/unirec.h>
+
+#include "tunnelplugin.h"
+#include "flowifc.h"
+#include "flowcacheplugin.h"
+#include "packet.h"
+#include "flow_meter.h"
+#include "ipfix-elements.h"
+
+using namespace std;
+
+#define TUNNEL_UNIREC_TEMPLATE "TUNNEL_TYPE,TUNNEL_ID,TUNNEL_SRC_IP,TUNNEL_DST_IP"
+
+UR_FIELDS (
+   uint8 TUNNEL_TYPE,
+   uint32 TUNNEL_ID,
+   ipaddr TUNNEL_SRC_IP,
+   ipaddr TUNNEL_DST_IP
+)
+
+TunnelPlugin::TunnelPlugin(const options_t &module_options)
+{
+   print_stats = module_options.print_stats;
+   total = 0;
+}
+
+TunnelPlugin::TunnelPlugin(const options_t &module_options, vector<plugin_opt> plugin_options) : FlowCachePlugin(plugin_options)
+{
+   print_stats = module_options.print_stats;
+   total = 0;
+}
+
+int TunnelPlugin::post_create(Flow &rec, const Packet &pkt)
+{
+   if (pkt.field_indicator & PCKT_TUNNEL) {
+      RecordExtTunnel *ext = new RecordExtTunnel();
+
+      ext->type = pkt.tunnel_type;
+      ext->ip_version = pkt.tunnel_ip_version;
+      ext->id = pkt.tunnel_id;
+      ext->src_ip = pkt.tunnel_src_ip;
+      ext->dst_ip = pkt.tunnel_dst_ip;
+      rec.addExtension(ext);
+      total++;
+   }
+
+   return 0;
+}
+
+void TunnelPlugin::finish()
+{
+   if (print_stats) {
+      cout << "Tunnel plugin stats:" << endl;
+      cout << "   Flows with tunnel: " << total << endl;
+   }
+}
+
+/**
+ * \brief Create tunnel extension saved in flow cache checkpoint.
+ */
+RecordExt *TunnelPlugin::deserialize(extTypeEnum type, const uint8_t *data, int size)
+{
+   return (type == tunnel ? RecordExtTunnel::deserialize(data, size) : NULL);
+}
+
+string TunnelPlugin::get_unirec_field_string()
+{
+   return TUNNEL_UNIREC_TEMPLATE;
+}
+
+const char *ipfix_tunnel_fields[] = {
+   IPFIX_TUNNEL_TEMPLATE(IPFIX_FIELD_NAMES)
+   NULL
+};
+
+const char **TunnelPlugin::get_ipfix_string()
+{
+   return ipfix_tunnel_fields;
+}
@@ -0,0 +1,130 @@
+/**
+ * \file tunnelplugin.h
+ * \brief Plugin for exporting endpoints and identifiers of decapsulated tunnels.
+ * \author Jiri Havranek <havraji6@fit.cvut.cz>
+ * \date 2018
+ */
+/*
+ * Copyright (C) 2018 CESNET
+ *
+ * LICENSE TERMS
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of the Company nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * ALTERNATIVELY, provided that this notice is retained in full, this
+ * product may be distributed under the terms of the GNU General Public
+ * License (GPL) version 2 or later, in which case the provisions
+ * of the GPL apply INSTEAD OF those given above.
+ *
+ * This software is provided ``as is'', and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose are disclaimed.
+ * In no event shall the company or contributors be liable for any
+ * direct, indirect, incidental, special, exemplary, or consequential
+ * damages (including, but not limited to, procurement of substitute
+ * goods or services; loss of use, data, or profits; or business
+ * interruption) however caused and on any theory of liability, whether
+ * in contract, strict liability, or tort (including negligence or
+ * otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#ifndef TUNNELPLUGIN_H
+#define TUNNELPLUGIN_H
+
+#include <string>
+#include <cstring>
+#include <arpa/inet.h>
+
+#include "fields.h"
+#include "flowifc.h"
+#include "flowcacheplugin.h"
+#include "packet.h"
+#include "flow_meter.h"
+
+using namespace std;
+
+/**
+ * \brief Flow record extension header for storing tunnel of the first packet of flow.
+ */
+struct RecordExtTunnel : RecordExt {
+   uint8_t type;        /**< Type of innermost tunnel (TUNNEL_*). */
+   uint8_t ip_version;  /**< IP version of tunnel endpoints. */
+   uint32_t id;         /**< GRE key, VXLAN VNI or GTP-U TEID. */
+   ipaddr_t src_ip;     /**< Source address of tunnel endpoints. */
+   ipaddr_t dst_ip;     /**< Destination address of tunnel endpoints. */
+
+   RECORD_EXT_POOLED(tunnel)
+   RECORD_EXT_SERIALIZED(RecordExtTunnel, type)
+
+   /**
+    * \brief Constructor.
+    */
+   RecordExtTunnel() : RecordExt(tunnel), type(0), ip_version(0), id(0)
+   {
+   }
+
+   virtual void fillUnirec(ur_template_t *tmplt, void *record)
+   {
+      ur_set(tmplt, record, F_TUNNEL_TYPE, type);
+      ur_set(tmplt, record, F_TUNNEL_ID, id);
+      if (ip_version == 4) {
+         ur_set(tmplt, record, F_TUNNEL_SRC_IP, ip_from_4_bytes_be((char *) &src_ip.v4));
+         ur_set(tmplt, record, F_TUNNEL_DST_IP, ip_from_4_bytes_be((char *) &dst_ip.v4));
+      } else {
+         ur_set(tmplt, record, F_TUNNEL_SRC_IP, ip_from_16_bytes_be((char *) src_ip.v6));
+         ur_set(tmplt, record, F_TUNNEL_DST_IP, ip_from_16_bytes_be((char *) dst_ip.v6));
+      }
+   }
+
+   virtual int fillIPFIX(uint8_t *buffer, int size)
+   {
+      int ip_len = (ip_version == 4 ? 4 : 16);
+
+      if (2 * ip_len + 7 > size) {
+         return -1;
+      }
+
+      buffer[0] = type;
+      *(uint32_t *) (buffer + 1) = htonl(id);
+      buffer[5] = ip_len;
+      memcpy(buffer + 6, (ip_version == 4 ? (void *) &src_ip.v4 : (void *) src_ip.v6), ip_len);
+      buffer[6 + ip_len] = ip_len;
+      memcpy(buffer + 7 + ip_len, (ip_version == 4 ? (void *) &dst_ip.v4 : (void *) dst_ip.v6), ip_len);
+
+      return 2 * ip_len + 7;
+   }
+};
+
+/**
+ * \brief Flow cache plugin for exporting tunnels decapsulated by packet parser (-T).
+ */
+class TunnelPlugin : public FlowCachePlugin
+{
+public:
+   TunnelPlugin(const options_t &module_options);
+   TunnelPlugin(const options_t &module_options, vector<plugin_opt> plugin_options);
+   int post_create(Flow &rec, const Packet &pkt);
+   void finish();
+   string get_unirec_field_string();
+   const char **get_ipfix_string();
+   RecordExt *deserialize(extTypeEnum type, const uint8_t *data, int size);
+
+private:
+   bool print_stats;       /**< Indicator whether to print stats when flow cache is finishing or not. */
+   uint32_t total;         /**< Total number of flows with tunnel. */
+};
+
+#endif
@@ -60,22 +60,33 @@ using namespace std;
 
 #define BASIC_FLOW_TEMPLATE "SRC_IP,DST_IP,SRC_PORT,DST_PORT,PROTOCOL,PACKETS,BYTES,TIME_FIRST,TIME_LAST,TCP_FLAGS,DIR_BIT_FIELD,TOS,TTL,SRC_MAC,DST_MAC" /* LINK_BIT_FIELD or ODID will be added at init. */
 
+#define BIFLOW_TEMPLATE "BYTES_REV,PACKETS_REV,TCP_FLAGS_REV" /* Added to basic flow template in biflow mode. */
+
+#define SAMPLING_TEMPLATE "SAMPLING_INTERVAL" /* Added to basic flow template when packets are sampled. */
+
+#define END_REASON_TEMPLATE "FLOW_END_REASON" /* Added to basic flow template when TCP connections are tracked. */
+
 #define PACKET_TEMPLATE "SRC_MAC,DST_MAC,ETHERTYPE,TIME"
 
 UR_FIELDS (
    ipaddr DST_IP,
    ipaddr SRC_IP,
    uint64 BYTES,
+   uint64 BYTES_REV,
    uint64 LINK_BIT_FIELD,
    uint32 ODID,
    time TIME_FIRST,
    time TIME_LAST,
    uint32 PACKETS,
+   uint32 PACKETS_REV,
+   uint32 SAMPLING_INTERVAL,
    uint16 DST_PORT,
    uint16 SRC_PORT,
    uint8 DIR_BIT_FIELD,
+   uint8 FLOW_END_REASON,
    uint8 PROTOCOL,
    uint8 TCP_FLAGS,
+   uint8 TCP_FLAGS_REV,
    uint8 TOS,
    uint8 TTL,
 
@@ -89,7 +100,7 @@ UR_FIELDS (
  * \brief Constructor.
  */
 UnirecExporter::UnirecExporter(bool send_eof) : out_ifc_cnt(0), ifc_mapping(NULL),
-tmplt(NULL), record(NULL), eof(send_eof), send_odid(false)
+tmplt(NULL), basic_offsets(NULL), record(NULL), eof(send_eof), send_odid(false), send_biflow(false), send_sampling(false), send_end_reason(false)
 {
 }
 
@@ -101,9 +112,13 @@ tmplt(NULL), record(NULL), eof(send_eof), send_odid(false)
  * \param [in] link Link bit field value.
  * \param [in] dir Direction bit field value.
  * \param [in] odid Send ODID field instead of LINK_BIT_FIELD.
+ * \param [in] biflow Send counters of reverse direction.
+ * \param [in] sampling Send sampling interval.
+ * \param [in] end_reason Send reason of flow export.
  * \return 0 on success or negative value when error occur.
  */
-int UnirecExporter::init(const vector<FlowCachePlugin *> &plugins, int ifc_cnt, int basic_ifc_number, uint64_t link = 0, uint8_t dir = 0, bool odid = false)
+int UnirecExporter::init(const vector<FlowCachePlugin *> &plugins, int ifc_cnt, int basic_ifc_number, uint64_t link = 0, uint8_t dir = 0, bool odid = false, bool biflow = false, bool sampling = false,
+   bool end_reason = false)
 {
    string basic_tmplt = BASIC_FLOW_TEMPLATE;
 
@@ -112,8 +127,12 @@ int UnirecExporter::init(const vector<FlowCachePlugin *> &plugins, int ifc_cnt,
    link_bit_field = link;
    dir_bit_field = dir;
    send_odid = odid;
+   send_biflow = biflow;
+   send_sampling = sampling;
+   send_end_reason = end_reason;
 
    tmplt = new ur_template_t*[out_ifc_cnt];
+   basic_offsets = new UnirecBasicOffsets[out_ifc_cnt];
    record = new void*[out_ifc_cnt];
 
    for (int i = 0; i < out_ifc_cnt; i++) {
@@ -126,6 +145,15 @@ int UnirecExporter::init(const vector<FlowCachePlugin *> &plugins, int ifc_cnt,
    } else {
       basic_tmplt += ",LINK_BIT_FIELD";
    }
+   if (biflow) {
+      basic_tmplt += string(",") + BIFLOW_TEMPLATE;
+   }
+   if (sampling) {
+      basic_tmplt += string(",") + SAMPLING_TEMPLATE;
+   }
+   if (end_reason) {
+      basic_tmplt += string(",") + END_REASON_TEMPLATE;
+   }
 
    char *error = NULL;
    if (basic_ifc_num >= 0) {
@@ -136,6 +164,7 @@ int UnirecExporter::init(const vector<FlowCachePlugin *> &plugins, int ifc_cnt,
          free_unirec_resources();
          return -2;
       }
+      resolve_basic_offsets(tmplt[basic_ifc_num], basic_offsets[basic_ifc_num]);
    }
 
    ifc_mapping = new int[EXTENSION_CNT];
@@ -167,19 +196,22 @@ int UnirecExporter::init(const vector<FlowCachePlugin *> &plugins, int ifc_cnt,
       }
 
       tmplt[ifc] = ur_create_output_template(ifc, template_str.c_str(), &error);
-      if (tmplt == NULL) {
+      if (tmplt[ifc] == NULL) {
          fprintf(stderr, "UnirecExporter: %s\n", error);
          free(error);
          free_unirec_resources();
          return -2;
       }
+      if (tmp->include_basic_flow_fields()) {
+         resolve_basic_offsets(tmplt[ifc], basic_offsets[ifc]);
+      }
    }
 
    for (int i = 0; i < out_ifc_cnt; i++) { // Create unirec records.
       if (tmplt[i] != NULL) {
          record[i] = ur_create_record(tmplt[i], (i == basic_ifc_num ? 0 : 2048));
 
-         if (record == NULL) {
+         if (record[i] == NULL) {
             free_unirec_resources();
             return -3;
          }
@@ -221,6 +253,10 @@ void UnirecExporter::free_unirec_resources()
       delete [] tmplt;
       tmplt = NULL;
    }
+   if (basic_offsets) {
+      delete [] basic_offsets;
+      basic_offsets = NULL;
+   }
    if (record) {
       for (int i = 0; i < out_ifc_cnt; i++) {
          if (record[i] != NULL) {
@@ -238,16 +274,21 @@ void UnirecExporter::free_unirec_resources()
 
 int UnirecExporter::export_packet(Packet &pkt)
 {
-   RecordExt *ext = pkt.exts;
+   uint32_t mask = pkt.ext_mask;
    ur_template_t *tmplt_ptr = NULL;
    void *record_ptr = NULL;
 
-   while (ext != NULL) {
-      int ifc_num = ifc_mapping[ext->extType];
-      if (ifc_num >= 0) {
-         tmplt_ptr = tmplt[ifc_num];
-         record_ptr = record[ifc_num];
+   while (mask) {
+      int type = __builtin_ctz(mask);
+      int ifc_num = ifc_mapping[type];
+      mask &= mask - 1;
+      if (ifc_num < 0) {
+         continue;
+      }
 
+      tmplt_ptr = tmplt[ifc_num];
+      record_ptr = record[ifc_num];
+      for (RecordExt *ext = pkt.exts[type]; ext != NULL; ext = ext->next) {
          ur_clear_varlen(tmplt_ptr, record_ptr);
          memset(record_ptr, 0, ur_rec_fixlen_size(tmplt_ptr));
          fill_packet_fields(pkt, tmplt_ptr, record_ptr);
@@ -255,7 +296,6 @@ int UnirecExporter::export_packet(Packet &pkt)
 
          trap_send(ifc_num, record_ptr, ur_rec_fixlen_size(tmplt_ptr) + ur_rec_varlen_size(tmplt_ptr, record_ptr));
       }
-      ext = ext->next;
    }
 
    return 0;
@@ -263,9 +303,17 @@ int UnirecExporter::export_packet(Packet &pkt)
 
 int UnirecExporter::export_flow(Flow &flow)
 {
-   RecordExt *ext = flow.exts;
+   uint32_t mask = flow.ext_mask;
    ur_template_t *tmplt_ptr = NULL;
    void *record_ptr = NULL;
+   UnirecBasicFlow basic;
+
+   if (basic_ifc_num < 0 && mask == 0) {
+      return 0;
+   }
+
+   /* Conversions are done once, records of all interfaces share converted values. */
+   convert_basic_flow(flow, basic);
 
    if (basic_ifc_num >= 0) { // Process basic flow.
       tmplt_ptr = tmplt[basic_ifc_num];
@@ -273,73 +321,137 @@ int UnirecExporter::export_flow(Flow &flow)
 
       ur_clear_varlen(tmplt_ptr, record_ptr);
 
-      fill_basic_flow(flow, tmplt_ptr, record_ptr);
+      fill_basic_flow(flow, basic, basic_offsets[basic_ifc_num], record_ptr);
 
       trap_send(basic_ifc_num, record_ptr, ur_rec_fixlen_size(tmplt_ptr) + ur_rec_varlen_size(tmplt_ptr, record_ptr));
    }
 
-   while (ext != NULL) {
-      int ifc_num = ifc_mapping[ext->extType];
-      if (ifc_num >= 0) {
-         tmplt_ptr = tmplt[ifc_num];
-         record_ptr = record[ifc_num];
+   while (mask) {
+      int type = __builtin_ctz(mask);
+      int ifc_num = ifc_mapping[type];
+      mask &= mask - 1;
+      if (ifc_num < 0) {
+         continue;
+      }
 
+      tmplt_ptr = tmplt[ifc_num];
+      record_ptr = record[ifc_num];
+      for (RecordExt *ext = flow.exts[type]; ext != NULL; ext = ext->next) {
          ur_clear_varlen(tmplt_ptr, record_ptr);
          memset(record_ptr, 0, ur_rec_fixlen_size(tmplt_ptr));
 
-         fill_basic_flow(flow, tmplt_ptr, record_ptr);
+         fill_basic_flow(flow, basic, basic_offsets[ifc_num], record_ptr);
          ext->fillUnirec(tmplt_ptr, record_ptr); /* Add each extension header into unirec record. */
 
          trap_send(ifc_num, record_ptr, ur_rec_fixlen_size(tmplt_ptr) + ur_rec_varlen_size(tmplt_ptr, record_ptr));
       }
-      ext = ext->next;
    }
 
    return 0;
 }
 
 /**
- * \brief Fill record with basic flow fields.
- * \param [in] flow Flow record.
- * \param [in] tmplt_ptr Pointer to unirec template.
- * \param [out] record_ptr Pointer to unirec record.
+ * \brief Get offsets of basic flow fields in records of given template.
+ * \param [in] tmplt_ptr Pointer to unirec template containing basic flow fields.
+ * \param [out] off Field offsets.
  */
-void UnirecExporter::fill_basic_flow(Flow &flow, ur_template_t *tmplt_ptr, void *record_ptr)
+void UnirecExporter::resolve_basic_offsets(ur_template_t *tmplt_ptr, UnirecBasicOffsets &off)
 {
-   ur_time_t tmp_time;
+   off.src_ip = tmplt_ptr->offset[F_SRC_IP];
+   off.dst_ip = tmplt_ptr->offset[F_DST_IP];
+   off.time_first = tmplt_ptr->offset[F_TIME_FIRST];
+   off.time_last = tmplt_ptr->offset[F_TIME_LAST];
+   off.link = tmplt_ptr->offset[send_odid ? F_ODID : F_LINK_BIT_FIELD];
+   off.dir = tmplt_ptr->offset[F_DIR_BIT_FIELD];
+   off.protocol = tmplt_ptr->offset[F_PROTOCOL];
+   off.src_port = tmplt_ptr->offset[F_SRC_PORT];
+   off.dst_port = tmplt_ptr->offset[F_DST_PORT];
+   off.packets = tmplt_ptr->offset[F_PACKETS];
+   off.bytes = tmplt_ptr->offset[F_BYTES];
+   off.tcp_flags = tmplt_ptr->offset[F_TCP_FLAGS];
+   off.tos = tmplt_ptr->offset[F_TOS];
+   off.ttl = tmplt_ptr->offset[F_TTL];
+   if (send_biflow) {
+      off.packets_rev = tmplt_ptr->offset[F_PACKETS_REV];
+      off.bytes_rev = tmplt_ptr->offset[F_BYTES_REV];
+      off.tcp_flags_rev = tmplt_ptr->offset[F_TCP_FLAGS_REV];
+   }
+   if (send_sampling) {
+      off.sampling_interval = tmplt_ptr->offset[F_SAMPLING_INTERVAL];
+   }
+   if (send_end_reason) {
+      off.end_reason = tmplt_ptr->offset[F_FLOW_END_REASON];
+   }
+   off.src_mac = tmplt_ptr->offset[F_SRC_MAC];
+   off.dst_mac = tmplt_ptr->offset[F_DST_MAC];
+}
 
+/**
+ * \brief Convert basic flow fields which need conversion to unirec types.
+ * \param [in] flow Flow record.
+ * \param [out] basic Converted fields.
+ */
+void UnirecExporter::convert_basic_flow(Flow &flow, UnirecBasicFlow &basic)
+{
    if (flow.ip_version == 4) {
-      ur_set(tmplt_ptr, record_ptr, F_SRC_IP, ip_from_4_bytes_be((char *) &flow.src_ip.v4));
-      ur_set(tmplt_ptr, record_ptr, F_DST_IP, ip_from_4_bytes_be((char *) &flow.dst_ip.v4));
+      basic.src_ip = ip_from_4_bytes_be((char *) &flow.src_ip.v4);
+      basic.dst_ip = ip_from_4_bytes_be((char *) &flow.dst_ip.v4);
    } else {
-      ur_set(tmplt_ptr, record_ptr, F_SRC_IP, ip_from_16_bytes_be((char *) flow.src_ip.v6));
-      ur_set(tmplt_ptr, record_ptr, F_DST_IP, ip_from_16_bytes_be((char *) flow.dst_ip.v6));
+      basic.src_ip = ip_from_16_bytes_be((char *) flow.src_ip.v6);
+      basic.dst_ip = ip_from_16_bytes_be((char *) flow.dst_ip.v6);
    }
 
-   tmp_time = ur_time_from_sec_msec(flow.time_first.tv_sec, flow.time_first.tv_usec / 1000.0);
-   ur_set(tmplt_ptr, record_ptr, F_TIME_FIRST, tmp_time);
+   basic.time_first = ur_time_from_sec_msec(flow.time_first.tv_sec, flow.time_first.tv_usec / 1000.0);
+   basic.time_last = ur_time_from_sec_msec(flow.time_last.tv_sec, flow.time_last.tv_usec / 1000.0);
+
+   basic.src_mac = mac_from_bytes(flow.src_mac);
+   basic.dst_mac = mac_from_bytes(flow.dst_mac);
+}
 
-   tmp_time = ur_time_from_sec_msec(flow.time_last.tv_sec, flow.time_last.tv_usec / 1000.0);
-   ur_set(tmplt_ptr, record_ptr, F_TIME_LAST, tmp_time);
+/**
+ * \brief Fill record with basic flow fields.
+ * \param [in] flow Flow record.
+ * \param [in] basic Converted basic flow fields.
+ * \param [in] off Offsets of basic flow fields in record.
+ * \param [out] record_ptr Pointer to unirec record.
+ */
+void UnirecExporter::fill_basic_flow(Flow &flow, const UnirecBasicFlow &basic, const UnirecBasicOffsets &off, void *record_ptr)
+{
+   char *rec = (char *) record_ptr;
 
+   *(ip_addr_t *) (rec + off.src_ip) = basic.src_ip;
+   *(ip_addr_t *) (rec + off.dst_ip) = basic.dst_ip;
+   *(ur_time_t *) (rec + off.time_first) = basic.time_first;
+   *(ur_time_t *) (rec + off.time_last) = basic.time_last;
 
    if (send_odid) {
-      ur_set(tmplt_ptr, record_ptr, F_ODID, link_bit_field);
+      *(uint32_t *) (rec + off.link) = link_bit_field;
    } else {
-      ur_set(tmplt_ptr, record_ptr, F_LINK_BIT_FIELD, link_bit_field);
+      *(uint64_t *) (rec + off.link) = link_bit_field;
+   }
+   *(uint8_t *) (rec + off.dir) = dir_bit_field;
+   *(uint8_t *) (rec + off.protocol) = flow.ip_proto;
+   *(uint16_t *) (rec + off.src_port) = flow.src_port;
+   *(uint16_t *) (rec + off.dst_port) = flow.dst_port;
+   *(uint32_t *) (rec + off.packets) = flow.pkt_total_cnt;
+   *(uint64_t *) (rec + off.bytes) = flow.octet_total_length;
+   *(uint8_t *) (rec + off.tcp_flags) = flow.tcp_control_bits;
+   *(uint8_t *) (rec + off.tos) = flow.ip_tos;
+   *(uint8_t *) (rec + off.ttl) = flow.ip_ttl;
+   if (send_biflow) {
+      *(uint32_t *) (rec + off.packets_rev) = flow.rev_pkt_total_cnt;
+      *(uint64_t *) (rec + off.bytes_rev) = flow.rev_octet_total_length;
+      *(uint8_t *) (rec + off.tcp_flags_rev) = flow.rev_tcp_control_bits;
+   }
+   if (send_sampling) {
+      *(uint32_t *) (rec + off.sampling_interval) = flow.sampling_interval;
    }
-   ur_set(tmplt_ptr, record_ptr, F_DIR_BIT_FIELD, dir_bit_field);
-   ur_set(tmplt_ptr, record_ptr, F_PROTOCOL, flow.ip_proto);
-   ur_set(tmplt_ptr, record_ptr, F_SRC_PORT, flow.src_port);
-   ur_set(tmplt_ptr, record_ptr, F_DST_PORT, flow.dst_port);
-   ur_set(tmplt_ptr, record_ptr, F_PACKETS, flow.pkt_total_cnt);
-   ur_set(tmplt_ptr, record_ptr, F_BYTES, flow.octet_total_length);
-   ur_set(tmplt_ptr, record_ptr, F_TCP_FLAGS, flow.tcp_control_bits);
-   ur_set(tmplt_ptr, record_ptr, F_TOS, flow.ip_tos);
-   ur_set(tmplt_ptr, record_ptr, F_TTL, flow.ip_ttl);
-
-   ur_set(tmplt_ptr, record_ptr, F_DST_MAC, mac_from_bytes(flow.dst_mac));
-   ur_set(tmplt_ptr, record_ptr, F_SRC_MAC, mac_from_bytes(flow.src_mac));
+   if (send_end_reason) {
+      *(uint8_t *) (rec + off.end_reason) = flow.end_reason;
+   }
+
+   *(mac_addr_t *) (rec + off.dst_mac) = basic.dst_mac;
+   *(mac_addr_t *) (rec + off.src_mac) = basic.src_mac;
 }
 
 
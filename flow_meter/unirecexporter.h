@@ -59,6 +59,45 @@
 
 using namespace std;
 
+/**
+ * \brief Offsets of basic flow fields in unirec record of one output interface.
+ */
+struct UnirecBasicOffsets {
+   uint16_t src_ip;
+   uint16_t dst_ip;
+   uint16_t time_first;
+   uint16_t time_last;
+   uint16_t link;          /**< Offset of ODID or LINK_BIT_FIELD. */
+   uint16_t dir;
+   uint16_t protocol;
+   uint16_t src_port;
+   uint16_t dst_port;
+   uint16_t packets;
+   uint16_t bytes;
+   uint16_t tcp_flags;
+   uint16_t tos;
+   uint16_t ttl;
+   uint16_t packets_rev;
+   uint16_t bytes_rev;
+   uint16_t tcp_flags_rev;
+   uint16_t sampling_interval;
+   uint16_t end_reason;
+   uint16_t src_mac;
+   uint16_t dst_mac;
+};
+
+/**
+ * \brief Basic flow fields converted to unirec types, shared by all records of exported flow.
+ */
+struct UnirecBasicFlow {
+   ip_addr_t src_ip;
+   ip_addr_t dst_ip;
+   ur_time_t time_first;
+   ur_time_t time_last;
+   mac_addr_t src_mac;
+   mac_addr_t dst_mac;
+};
+
 /**
  * \brief Class for exporting flow records.
  */
@@ -66,13 +105,15 @@ class UnirecExporter : public FlowExporter
 {
 public:
    UnirecExporter(bool send_eof);
-   int init(const vector<FlowCachePlugin *> &plugins, int ifc_cnt, int basic_ifc_num, uint64_t link, uint8_t dir, bool odid);
+   int init(const vector<FlowCachePlugin *> &plugins, int ifc_cnt, int basic_ifc_num, uint64_t link, uint8_t dir, bool odid, bool biflow, bool sampling, bool end_reason);
    void close();
    int export_flow(Flow &flow);
    int export_packet(Packet &pkt);
 
 private:
-   void fill_basic_flow(Flow &flow, ur_template_t *tmplt_ptr, void *record_ptr);
+   void resolve_basic_offsets(ur_template_t *tmplt_ptr, UnirecBasicOffsets &off);
+   void convert_basic_flow(Flow &flow, UnirecBasicFlow &basic);
+   void fill_basic_flow(Flow &flow, const UnirecBasicFlow &basic, const UnirecBasicOffsets &off, void *record_ptr);
    void fill_packet_fields(Packet &pkt, ur_template_t *tmplt_ptr, void *record_ptr);
    void free_unirec_resources();
 
@@ -80,9 +121,13 @@ private:
    int basic_ifc_num;         /**< Basic output interface number. */
    int *ifc_mapping;          /**< Contain extension id (as index) -> output interface number mapping. */
    ur_template_t **tmplt;     /**< Pointer to unirec templates. */
+   UnirecBasicOffsets *basic_offsets; /**< Offsets of basic flow fields for each output interface. */
    void **record;             /**< Pointer to unirec records. */
    bool eof;                  /**< Send eof when module exits. */
    bool send_odid;            /**< Export ODID field instead of LINK_BIT_FIELD. */
+   bool send_biflow;          /**< Export counters of reverse direction. */
+   bool send_sampling;        /**< Export sampling interval. */
+   bool send_end_reason;      /**< Export reason of flow export. */
 
    uint64_t link_bit_field;   /**< Link bit field value. */
    uint8_t dir_bit_field;     /**< Direction bit field value. */